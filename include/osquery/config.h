@@ -13,6 +13,7 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <set>
 #include <vector>
 
 #include <boost/iterator/filter_iterator.hpp>
@@ -29,7 +30,7 @@ class Pack;
 class Schedule;
 class ConfigParserPlugin;
 
-/// The name of the executing query within the single-threaded schedule.
+/// The names of the executing queries within the schedule.
 extern const std::string kExecutingQuery;
 
 /**
@@ -73,16 +74,11 @@ class Config : private boost::noncopyable {
    * to the updates/changes reflected in the schedule, from the config.
    *
    * @param name The unique name of the scheduled item
-   * @param delay Number of seconds (wall time) taken by the query
-   * @param size Number of characters generated by query
-   * @param r0 the process row before the query
-   * @param r1 the process row after the query
+   * @param execution The performance of a single execution, where the
+   * average_memory is the resident memory differential
    */
   void recordQueryPerformance(const std::string& name,
-                              size_t delay,
-                              size_t size,
-                              const Row& r0,
-                              const Row& r1);
+                              const QueryPerformance& execution);
 
   /**
    * @brief Record a query 'initialization', meaning the query will run.
@@ -93,10 +89,19 @@ class Config : private boost::noncopyable {
    * store. On process start, or worker state, if any dirty bit is set then
    * it is assumed that the current start is a result of a previous abort.
    *
+   * Scheduled queries execute concurrently, each is recorded and the calling
+   * thread's query is available from Config::getExecutingQuery.
+   *
    * @param name THe unique name of the scheduled item
    */
   void recordQueryStart(const std::string& name);
 
+  /// Clear the dirty status of a query, recordQueryPerformance includes this.
+  void recordQueryEnd(const std::string& name);
+
+  /// The scheduled query executing on the calling thread, or empty.
+  static const std::string& getExecutingQuery();
+
   /**
    * @brief Calculate the hash of the osquery config
    *
@@ -297,6 +302,9 @@ class Config : private boost::noncopyable {
   /// A set of performance stats for each query in the schedule.
   std::map<std::string, QueryPerformance> performance_;
 
+  /// The names of scheduled queries started and not yet finished.
+  std::set<std::string> executing_;
+
   /// A set of named categories filled with filesystem globbing paths.
   using FileCategories = std::map<std::string, std::vector<std::string>>;
   std::map<std::string, FileCategories> files_;
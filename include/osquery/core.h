@@ -16,6 +16,8 @@
 #include <string>
 #include <vector>
 
+#include <boost/thread/shared_mutex.hpp>
+
 #include <osquery/status.h>
 
 // clang-format off
@@ -180,6 +182,15 @@ using Mutex = std::mutex;
 /// Helper alias for write locking a mutex.
 using WriteLock = std::lock_guard<Mutex>;
 
+/// Helper alias for defining mutexes with shared (read) access.
+using SharedMutex = boost::shared_mutex;
+
+/// Helper alias for read locking a shared mutex.
+using ReadLock = boost::shared_lock<SharedMutex>;
+
+/// Helper alias for write locking a shared mutex.
+using SharedWriteLock = boost::unique_lock<SharedMutex>;
+
 /// Helper alias for defining recursive mutexes.
 using RecursiveMutex = std::recursive_mutex;
 
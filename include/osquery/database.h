@@ -11,6 +11,7 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
@@ -59,6 +60,18 @@ extern const std::string kEvents;
  */
 extern const std::string kLogs;
 
+/**
+ * @brief The "domain" where content hashes of files are cached.
+ *
+ * Hashes are keyed by the file's identity (such as device and inode) and
+ * reused while the file's size and change times are unchanged.
+ */
+extern const std::string kHashes;
+
+/// An ordered list of key/value pairs written together into one domain.
+using DatabaseStringValueList =
+    std::vector<std::pair<std::string, std::string>>;
+
 /**
  * @brief A variant type for the SQLite type affinities.
  */
@@ -196,9 +209,49 @@ Status serializeDiffResults(const DiffResults& d,
  */
 Status serializeDiffResultsJSON(const DiffResults& d, std::string& json);
 
+/**
+ * @brief A 64-bit fingerprint of a Row's column names and values.
+ *
+ * Fingerprints are used to compare rows without walking each Row's map.
+ * Two equal rows always have the same fingerprint, the inverse is only
+ * probably true, so callers must compare the Rows on a hashRow match.
+ */
+using RowHash = uint64_t;
+
+/**
+ * @brief Compute the fingerprint of a Row.
+ *
+ * @param r the Row to hash
+ *
+ * @return a stable (across runs and hosts) 64-bit fingerprint
+ */
+RowHash hashRow(const Row& r);
+
+/**
+ * @brief Compute a keyed fingerprint of a Row that is safe to persist.
+ *
+ * The fingerprint is a truncated SHA-256 of the key and the Row's column
+ * names and values. Without the key, rows with colliding fingerprints cannot
+ * be constructed, so stored results may identify rows by fingerprint alone.
+ *
+ * @param r the Row to fingerprint
+ * @param key a secret, per-install key
+ *
+ * @return a 64-bit fingerprint, stable for the same key
+ */
+RowHash fingerprintRow(const Row& r, const std::string& key);
+
 /**
  * @brief Diff two QueryData objects and create a DiffResults object
  *
+ * Each row is fingerprinted once using hashRow, the fingerprint sets are
+ * compared, and only the added and removed rows are copied. The cost is
+ * linear in the size of both result sets.
+ *
+ * Added rows are reported in the order of new_, removed rows in the order
+ * of old_. A row repeated N times in old_ and M times in new_ is reported as
+ * removed N - M times if N > M.
+ *
  * @param old_ the "old" set of results
  * @param new_ the "new" set of results
  *
@@ -251,18 +304,32 @@ struct QueryPerformance {
   /// Total wall time taken
   unsigned long long int wall_time;
 
-  /// Total user time (cycles)
+  /// Total user time of the executing worker thread (cycles)
   unsigned long long int user_time;
 
-  /// Total system time (cycles)
+  /// Total system time of the executing worker thread (cycles)
   unsigned long long int system_time;
 
-  /// Average memory differentials. This should be near 0.
+  /**
+   * @brief Average process-wide resident memory differentials.
+   *
+   * Memory is not attributed per thread, growth from concurrently executing
+   * queries is included. This should be near 0.
+   */
   unsigned long long int average_memory;
 
   /// Total characters, bytes, generated by query.
   unsigned long long int output_size;
 
+  /// Total CPU time in nanoseconds, excluding table helper threads.
+  unsigned long long int cpu_time;
+
+  /// Largest process-wide growth of peak resident memory during an execution.
+  unsigned long long int peak_memory;
+
+  /// Total number of rows generated by query.
+  unsigned long long int output_rows;
+
   QueryPerformance()
       : executions(0),
         last_executed(0),
@@ -270,7 +337,10 @@ struct QueryPerformance {
         user_time(0),
         system_time(0),
         average_memory(0),
-        output_size(0) {}
+        output_size(0),
+        cpu_time(0),
+        peak_memory(0),
+        output_rows(0) {}
 };
 
 /**
@@ -444,9 +514,37 @@ class DatabasePlugin : public Plugin {
                      const std::string& key,
                      const std::string& value) = 0;
 
+  /**
+   * @brief Store several key/value pairs into a domain as one write.
+   *
+   * Callers that produce many small values at once, such as event
+   * subscribers, should prefer a batch to a put per value. The default
+   * implementation falls back to a put for each pair, in order. Plugins with
+   * an atomic batch primitive should override this method.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param data The ordered key/value pairs to store.
+   * @return Failure if any of the data could not be stored.
+   */
+  virtual Status putBatch(const std::string& domain,
+                          const DatabaseStringValueList& data);
+
   /// Data removal method.
   virtual Status remove(const std::string& domain, const std::string& k) = 0;
 
+  /**
+   * @brief Remove several keys from a domain as one write.
+   *
+   * See DatabasePlugin::putBatch, the default implementation falls back to a
+   * remove for each key.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param keys The keys to remove.
+   * @return Failure if any of the keys could not be removed.
+   */
+  virtual Status removeBatch(const std::string& domain,
+                             const std::vector<std::string>& keys);
+
   virtual Status scan(const std::string& domain,
                       std::vector<std::string>& results,
                       const std::string& prefix,
@@ -454,6 +552,41 @@ class DatabasePlugin : public Plugin {
     return Status(0, "Not used");
   }
 
+  /**
+   * @brief Return the key/value pairs with keys in [low, high), in key order.
+   *
+   * Keys are compared as byte strings. Callers that need a time or sequence
+   * ordering should encode keys with a fixed-width, most-significant-first
+   * representation. The default implementation scans and sorts every key in
+   * the domain, plugins with ordered iterators should override this method.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param low The inclusive lower bound key.
+   * @param high The exclusive upper bound key.
+   * @param results The output ordered key/value pairs.
+   * @param max Optionally stop after max pairs, 0 means no limit.
+   * @return Failure if the domain could not be iterated.
+   */
+  virtual Status scanRange(const std::string& domain,
+                           const std::string& low,
+                           const std::string& high,
+                           DatabaseStringValueList& results,
+                           size_t max = 0) const;
+
+  /**
+   * @brief Remove every key in [low, high) from a domain as one write.
+   *
+   * See DatabasePlugin::scanRange for discussion around key ordering.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param low The inclusive lower bound key.
+   * @param high The exclusive upper bound key.
+   * @return Failure if the keys could not be removed.
+   */
+  virtual Status removeRange(const std::string& domain,
+                             const std::string& low,
+                             const std::string& high);
+
   /**
    * @brief Shutdown the database and release initialization resources.
    *
@@ -555,9 +688,35 @@ Status setDatabaseValue(const std::string& domain,
                         const std::string& key,
                         const std::string& value);
 
+/**
+ * @brief Put several values into the active DatabasePlugin storage at once.
+ *
+ * See DatabasePlugin::putBatch. Within extensions each pair is forwarded to
+ * the core as an individual put.
+ *
+ * @param domain A string value representing abstract storage indexing.
+ * @param data The ordered key/value pairs to store.
+ * @return Storage operation status.
+ */
+Status setDatabaseBatch(const std::string& domain,
+                        const DatabaseStringValueList& data);
+
 /// Remove a domain/key identified value from backing-store.
 Status deleteDatabaseValue(const std::string& domain, const std::string& key);
 
+/**
+ * @brief Remove several values from the active DatabasePlugin storage at once.
+ *
+ * See DatabasePlugin::removeBatch. Within extensions each key is forwarded to
+ * the core as an individual remove.
+ *
+ * @param domain A string value representing abstract storage indexing.
+ * @param keys The keys to remove.
+ * @return Storage operation status.
+ */
+Status deleteDatabaseBatch(const std::string& domain,
+                           const std::vector<std::string>& keys);
+
 /// Get a list of keys for a given domain.
 Status scanDatabaseKeys(const std::string& domain,
                         std::vector<std::string>& keys,
@@ -569,6 +728,29 @@ Status scanDatabaseKeys(const std::string& domain,
                         const std::string& prefix,
                         size_t max = 0);
 
+/**
+ * @brief Get the ordered key/value pairs with keys in [low, high).
+ *
+ * See DatabasePlugin::scanRange for discussion around key ordering.
+ *
+ * @param domain A string value representing abstract storage indexing.
+ * @param low The inclusive lower bound key.
+ * @param high The exclusive upper bound key.
+ * @param results The output ordered key/value pairs.
+ * @param max Optionally stop after max pairs, 0 means no limit.
+ * @return Storage operation status.
+ */
+Status scanDatabaseRange(const std::string& domain,
+                         const std::string& low,
+                         const std::string& high,
+                         DatabaseStringValueList& results,
+                         size_t max = 0);
+
+/// Remove every key in [low, high) from the backing-store.
+Status deleteDatabaseRange(const std::string& domain,
+                           const std::string& low,
+                           const std::string& high);
+
 /// Allow callers to scan each column family and print each value.
 void dumpDatabase();
 }
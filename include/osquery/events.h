@@ -15,6 +15,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <thread>
 #include <vector>
 
@@ -72,6 +73,29 @@ struct EventContext : private boost::noncopyable {
   EventTime time{0};
 };
 
+/**
+ * @brief Optimize subscriber selects by tracking the last select.
+ *
+ * Event subscribers may optimize selects when used in a daemon schedule by
+ * requiring an event 'time' constraint and otherwise applying a minimum time
+ * as the last time the scheduled query ran. Scheduled queries run
+ * concurrently, this state belongs to a single select and is persisted for
+ * the executing query.
+ */
+struct EventOptimization {
+  /// The minimum event time of the select, the last time the query ran.
+  EventTime time{0};
+
+  /**
+   * @brief Last event ID returned while using events-optimization.
+   *
+   * A time with second precision is not sufficient, but it works for index
+   * retrieval. While sorting using the time optimization, discard events
+   * before or equal to the optimization ID.
+   */
+  size_t eid{0};
+};
+
 using SubscriptionRef = std::shared_ptr<Subscription>;
 using BaseEventPublisher = EventPublisher<SubscriptionContext, EventContext>;
 using EventPublisherRef = std::shared_ptr<BaseEventPublisher>;
@@ -322,6 +346,16 @@ class EventPublisherPlugin : public Plugin,
     return restart_count_;
   }
 
+  /// Get the number of times the publisher's event queue overflowed.
+  size_t overflowCount() const {
+    return overflow_count_;
+  }
+
+  /// Get the number of duplicate events coalesced before firing.
+  size_t coalescedCount() const {
+    return coalesced_count_;
+  }
+
  public:
   explicit EventPublisherPlugin(EventPublisherPlugin const&) = delete;
   EventPublisherPlugin& operator=(EventPublisherPlugin const&) = delete;
@@ -342,6 +376,22 @@ class EventPublisherPlugin : public Plugin,
   virtual void fireCallback(const SubscriptionRef& sub,
                             const EventContextRef& ec) const = 0;
 
+  /**
+   * @brief Select the Subscription%s that may want an EventContext.
+   *
+   * Publishers with many Subscription%s may keep an index and return only the
+   * candidates for an event. Each candidate is still checked by `shouldFire`.
+   * This is called while the subscription lock is held for reading.
+   *
+   * @param ec The EventContext about to be fired.
+   * @param subscriptions Output, the candidate Subscription%s.
+   * @return false if every Subscription should be considered.
+   */
+  virtual bool selectSubscriptions(const EventContextRef& ec,
+                                   SubscriptionVector& subscriptions) const {
+    return false;
+  }
+
   /// The EventPublisher will keep track of Subscription%s that contain callins.
   SubscriptionVector subscriptions_;
 
@@ -349,6 +399,12 @@ class EventPublisherPlugin : public Plugin,
   /// This is not used to store event date in the backing store.
   std::atomic<EventContextID> next_ec_id_{0};
 
+  /// Incremented by publishers when events were lost to a queue overflow.
+  std::atomic<size_t> overflow_count_{0};
+
+  /// Incremented by publishers for each duplicate event that was not fired.
+  std::atomic<size_t> coalesced_count_{0};
+
  private:
   /// Set ending to True to cause event type run loops to finish.
   std::atomic<bool> ending_{false};
@@ -359,8 +415,8 @@ class EventPublisherPlugin : public Plugin,
   /// A lock for incrementing the next EventContextID.
   std::mutex ec_id_lock_;
 
-  /// A lock for subscription manipulation.
-  std::mutex subscription_lock_;
+  /// A lock for subscription manipulation, firing events only reads.
+  SharedMutex subscription_lock_;
 
   /// A helper count of event publisher runloop iterations.
   std::atomic<size_t> restart_count_{0};
@@ -410,29 +466,63 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    *
    * This is used internally (for the most part) by EventSubscriber::genTable.
    *
+   * If an indexed column and value are provided only the events with that
+   * column value are read from the backing store.
+   *
    * @param start Inclusive lower bound time limit.
    * @param stop Inclusive upper bound time limit.
+   * @param column Optional indexed column to select on.
+   * @param value The value the indexed column must equal.
+   * @param optimize Optional events-optimization state of the select.
    * @return Set of event rows matching time limits.
    */
-  virtual QueryData get(EventTime start, EventTime stop) final;
+  virtual QueryData get(EventTime start,
+                        EventTime stop,
+                        const std::string& column = "",
+                        const std::string& value = "",
+                        EventOptimization* optimize = nullptr) final;
 
  private:
   /// Overload add for tests and allow them to override the event time.
   virtual Status add(Row& r, EventTime event_time) final;
 
  private:
-  /*
-   * @brief When `get`ing event results, return EventID%s from time indexes.
+  /**
+   * @brief Get the stored events with an EventTime within start, stop.
    *
-   * Used by EventSubscriber::get to retrieve EventID, EventTime indexes. This
-   * applies the lookup-efficiency checks for time list appropriate bins.
-   * If the time range in 24 hours and there is a 24-hour list bin it will
-   * be queried using a single backing store `Get` followed by two `Get`s of
-   * the most-specific boundary lists.
+   * Each event row is stored under a key ordered by EventTime then EventID:
+   * 'data.<namespace>.<time><eid>' with both values written as fixed-width,
+   * most-significant-first hex. A time range is one ordered range scan of
+   * the backing store, there are no index lists to parse.
    *
-   * @return List of EventID, EventTime%s
+   * Columns marked 'optimized' in the subscriber's table spec are also
+   * indexed by value: 'index.<namespace>.<column>.<value>.<time><eid>'. When
+   * a column is provided the value's index range is scanned instead, and
+   * only the matching records are read.
+   *
+   * @param start Inclusive lower bound time limit.
+   * @param stop Inclusive upper bound time limit, 0 means no limit.
+   * @param records The output event keys and serialized rows, in time order.
+   * @param column Optional indexed column to select on.
+   * @param value The value the indexed column must equal.
+   * @return The status of the backing store range scan.
    */
-  std::vector<EventRecord> getRecords(const std::vector<std::string>& indexes);
+  Status getRecords(EventTime start,
+                    EventTime stop,
+                    DatabaseStringValueList& records,
+                    const std::string& column = "",
+                    const std::string& value = "");
+
+  /**
+   * @brief Remove a range of records and their index entries.
+   *
+   * @param low The inclusive lower bound time and EventID record key suffix.
+   * @param high The exclusive upper bound time and EventID record key suffix.
+   */
+  void removeRecords(const std::string& low, const std::string& high);
+
+  /// Read the 'optimized' columns of this subscriber's table spec.
+  void setIndexedColumns();
 
   /**
    * @brief Get a unique storage-related EventID.
@@ -445,35 +535,43 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * indexing is required within-EventCallback consider an
    * EventSubscriber%-unique indexing, counting mechanic.
    *
+   * EventIDs are assigned from an in-memory counter, seeded once from the
+   * backing store. The counter is persisted with each flushed batch.
+   *
    * @return A unique ID for backing storage.
    */
   EventID getEventID();
 
   /**
-   * @brief Plan the best set of indexes for event record access.
+   * @brief Write all staged events to the backing store.
    *
-   * @param start an inclusive time to begin searching.
-   * @param stop an inclusive time to end searching.
+   * Events added within a flush window are staged in memory. A flush writes
+   * their data, the time bin records, the bin index, and the EventID counter
+   * as a single database batch. Each touched bin is read once per flush,
+   * not once per event.
    *
-   * @return List of 'index.step' index strings.
+   * A flush happens when the staging buffer is full, when the oldest staged
+   * event exceeds the flush window, before records are read, and when the
+   * EventFactory ends. The publisher run loop also flushes staged events
+   * older than the flush window, see flushStagedEvents.
+   *
+   * @return The status of the batched write.
    */
-  std::vector<std::string> getIndexes(EventTime start, EventTime stop);
+  Status flushEvents();
 
   /**
-   * @brief Expire indexes and eventually records.
+   * @brief Flush the staged events if the oldest exceeds the flush window.
+   *
+   * A subscriber that stops receiving events would otherwise keep its staged
+   * events in memory until a query reads them or osquery exits.
    *
-   * @param list_type the string representation of list binning type.
-   * @param indexes complete set of 'index.step' indexes for the list_type.
-   * @param expirations of the indexes, the set to expire.
+   * @param now The current time.
+   * @return The status of the batched write, if one was needed.
    */
-  void expireIndexes(const std::string& list_type,
-                     const std::vector<std::string>& indexes,
-                     const std::vector<std::string>& expirations);
+  Status flushStagedEvents(EventTime now);
 
-  /// Expire all datums within a bin.
-  void expireRecords(const std::string& list_type,
-                     const std::string& index,
-                     bool all);
+  /// Remove every record with an EventTime at or before expire_time_.
+  void expireRecords();
 
   /**
    * @brief Inspect the number of events, expire those overflowing events_max.
@@ -485,25 +583,11 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * that count exceeds the configured `events_max` limit. If an overflow
    * occurs the subscriber will expire N-events_max from the end of the queue.
    *
-   * @param cleanup Perform an intense scan of zombie event IDs.
+   * @param cleanup Also remove values written by the previous bin-list
+   * record layout, used once when the subscriber is registered.
    */
   void expireCheck(bool cleanup = false);
 
-  /**
-   * @brief Add an EventID, EventTime pair to all matching list types.
-   *
-   * The list types are defined by time size. Based on the EventTime this pair
-   * is added to the list bin for each list type. If there are two list types:
-   * 60 seconds and 3600 seconds and `time` is 92, this pair will be added to
-   * list type 1 bin 4 and list type 2 bin 1.
-   *
-   * @param eid A unique EventID.
-   * @param time The time when this EventID%'s event occurred.
-   *
-   * @return Were the indexes recorded.
-   */
-  Status recordEvent(EventID& eid, EventTime time);
-
   /**
    * @brief Get the expiration timeout for this event type
    *
@@ -535,8 +619,7 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * EventPublisher instances will have run `setUp` and initialized their run
    * loops.
    */
-  EventSubscriberPlugin()
-      : expire_events_(true), expire_time_(0), optimize_time_(0) {}
+  EventSubscriberPlugin() : expire_events_(true), expire_time_(0) {}
   virtual ~EventSubscriberPlugin() {}
 
   /**
@@ -612,41 +695,51 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   EventTime expire_time_{0};
 
   /// Cached value of last generated EventID.
-  size_t last_eid_{0};
+  std::atomic<size_t> last_eid_{0};
 
-  /**
-   * @brief Optimize subscriber selects by tracking the last select time.
-   *
-   * Event subscribers may optimize selects when used in a daemon schedule by
-   * requiring an event 'time' constraint and otherwise applying a minimum time
-   * as the last time the scheduled query ran.
-   */
-  EventTime optimize_time_{0};
+  /// Set once last_eid_ is seeded from the backing store.
+  std::atomic<bool> eid_loaded_{false};
 
-  /**
-   * @brief Last event ID returned while using events-optimization.
-   *
-   * A time with second precision is not sufficient, but it works for index
-   * retrieval. While sorting using the time optimization, discard events
-   * before or equal to the optimization ID.
-   */
-  size_t optimize_eid_{0};
-
-  /// Lock used when incrementing the EventID database index.
+  /// Lock used when seeding the EventID counter from the database.
   std::mutex event_id_lock_;
 
   /// Lock used when recording an EventID and time into search bins.
   std::mutex event_record_lock_;
 
+  /// An event waiting in the staging buffer for the next flush.
+  struct StagedEvent {
+    size_t eid;
+    EventTime time;
+    std::string data;
+
+    /// The indexed column and value pairs of the event row.
+    std::vector<std::pair<std::string, std::string>> indexes;
+  };
+
+  /// Events added since the last flush, in EventID order.
+  std::vector<StagedEvent> staged_events_;
+
+  /// The time the oldest staged event was added.
+  EventTime staged_time_{0};
+
+  /// Lock used when staging events or taking the staged events for a flush.
+  std::mutex event_stage_lock_;
+
+  /// Columns with a value index, set when the subscriber is registered.
+  std::set<std::string> indexed_columns_;
+
  private:
   friend class EventFactory;
   friend class EventPublisherPlugin;
 
  private:
   FRIEND_TEST(EventsDatabaseTests, test_event_module_id);
-  FRIEND_TEST(EventsDatabaseTests, test_record_indexing);
+  FRIEND_TEST(EventsDatabaseTests, test_event_batch);
+  FRIEND_TEST(EventsDatabaseTests, test_event_stage_age);
+  FRIEND_TEST(EventsDatabaseTests, test_record_keys);
   FRIEND_TEST(EventsDatabaseTests, test_record_range);
   FRIEND_TEST(EventsDatabaseTests, test_record_expiration);
+  FRIEND_TEST(EventsDatabaseTests, test_indexed_records);
   FRIEND_TEST(EventsDatabaseTests, test_gentable);
   FRIEND_TEST(EventsDatabaseTests, test_expire_check);
   FRIEND_TEST(EventsDatabaseTests, test_optimize);
@@ -778,6 +871,9 @@ class EventFactory : private boost::noncopyable {
   /// Set log forwarding by adding a logger receiver.
   static void addForwarder(const std::string& logger);
 
+  /// Flush the staged events of a publisher's subscribers, when expired.
+  static void flushStagedEvents(const EventPublisherID& type_id);
+
   /// Optionally forward events to loggers.
   static void forwardEvent(const std::string& event);
 
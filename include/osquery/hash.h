@@ -12,7 +12,9 @@
 
 #include <boost/noncopyable.hpp>
 
+#include <ctime>
 #include <string>
+#include <vector>
 
 namespace osquery {
 
@@ -27,6 +29,9 @@ enum HashType {
   HASH_TYPE_SHA256 = 8,
 };
 
+/// Files changed within this many seconds are hashed but not cached.
+extern const time_t kHashCacheSettleTime;
+
 /// A result structure for multiple hash requests.
 struct MultiHashes {
   int mask;
@@ -123,4 +128,56 @@ std::string hashFromFile(HashType hash_type, const std::string& path);
 
 /// Get multiple hashes from a file simultaneously.
 MultiHashes hashMultiFromFile(int mask, const std::string& path);
+
+/**
+ * @brief Get multiple hashes from a file, reusing cached hashes.
+ *
+ * Hashes are cached in the backing store (the kHashes domain) keyed by the
+ * file's device and inode, and reused while the file's size, mtime, and ctime
+ * are unchanged. An unchanged file costs a single stat, even across restarts.
+ * Files changed within the last few seconds are hashed but not cached, as a
+ * later write within the same timestamp granularity could go unnoticed.
+ *
+ * The cache is bounded by `--hash_cache_max`, the oldest entries are evicted.
+ *
+ * @param mask A mask of HashType%s.
+ * @param path Filesystem path, the hash target.
+ */
+MultiHashes hashMultiFromFileCached(int mask, const std::string& path);
+
+/**
+ * @brief Get multiple hashes from many files, reusing cached hashes.
+ *
+ * Independent files are hashed by up to `--hash_threads` threads on Linux,
+ * so reading one file overlaps with hashing others. When running as a worker
+ * hashing is paced to stay within the watchdog's CPU utilization limit.
+ *
+ * @param mask A mask of HashType%s.
+ * @param paths Filesystem paths, the hash targets.
+ * @return The hashes of each path, in the order of the input paths.
+ */
+std::vector<MultiHashes> hashMultiFromFiles(
+    int mask, const std::vector<std::string>& paths);
+
+/**
+ * @brief Find cached hashes for content identified by the caller.
+ *
+ * Callers that hash content without a live filesystem path, such as an inode
+ * read from a disk image, may use the hash cache with their own identity.
+ *
+ * @param key The identity of the content's container, such as an inode.
+ * @param version The state of the content, such as size and change times.
+ * @param mask A mask of HashType%s, each must be cached.
+ * @param hashes The output cached hashes.
+ * @return true if the hashes for this key and version are cached.
+ */
+bool getCachedHashes(const std::string& key,
+                     const std::string& version,
+                     int mask,
+                     MultiHashes& hashes);
+
+/// Cache hashes for content identified by the caller, see getCachedHashes.
+void setCachedHashes(const std::string& key,
+                     const std::string& version,
+                     const MultiHashes& hashes);
 }
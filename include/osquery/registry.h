@@ -182,6 +182,7 @@ using ModuleInitalizer = void (*)(void);
 
 /// The registry includes a single optimization for table generation.
 struct QueryContext;
+class ColumnarQueryData;
 
 template <class PluginItem>
 class PluginFactory {};
@@ -550,6 +551,7 @@ class RegistryHelper : public RegistryHelperCore {
  private:
   FRIEND_TEST(EventsTests, test_event_subscriber_configure);
   FRIEND_TEST(VirtualTableTests, test_indexing_costs);
+  FRIEND_TEST(VirtualTableTests, test_table_result_cache);
 };
 
 /// Helper definition for a shared pointer to a Plugin.
@@ -738,6 +740,11 @@ class RegistryFactory : private boost::noncopyable {
                           QueryContext& context,
                           PluginResponse& response);
 
+  /// A helper call for typed, columnar table data generation.
+  static Status callTable(const std::string& table_name,
+                          QueryContext& context,
+                          ColumnarQueryData& results);
+
   /// Set a registry's active plugin.
   static Status setActive(const std::string& registry_name,
                           const std::string& item_name);
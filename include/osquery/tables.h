@@ -11,12 +11,15 @@
 #pragma once
 
 #include <deque>
+#include <list>
 #include <map>
 #include <memory>
 #include <set>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include <boost/coroutine/asymmetric_coroutine.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/property_tree/ptree.hpp>
 
@@ -116,6 +119,9 @@ enum ColumnType {
 /// Map of type constant to the SQLite string-name representation.
 extern const std::map<ColumnType, std::string> kColumnTypeNames;
 
+/// The extension table call encoding negotiated using route info.
+extern const std::string kTableColumnarEncoding;
+
 /**
  * @brief A ConstraintOperator is applied in an query predicate.
  *
@@ -639,6 +645,260 @@ struct QueryContext : private boost::noncopyable {
 using QueryContext = struct QueryContext;
 using Constraint = struct Constraint;
 
+/**
+ * @brief A pull-based table row generator, see TablePlugin::generator.
+ *
+ * This uses Boost.Coroutine, coroutine2 requires C++14 in Boost 1.60.
+ */
+using RowGenerator = boost::coroutines::asymmetric_coroutine<Row&>;
+
+/// The output of a table row generator, call with each generated Row.
+using RowYield = RowGenerator::push_type;
+
+/**
+ * @brief A typed, columnar alternative to QueryData.
+ *
+ * Rows are appended with ColumnarQueryData::addRow and each cell of the last
+ * row is set using a column ordinal, the position of the column within
+ * TablePlugin::columns. INTEGER, BIGINT, and DOUBLE cells are stored as
+ * literals and TEXT cells are interned. The virtual table cursor returns each
+ * cell without a column name lookup or a string to integer conversion.
+ *
+ * Cells that are never set are NULL.
+ */
+class ColumnarQueryData : private boost::noncopyable {
+ public:
+  ColumnarQueryData() {}
+
+  /// Create an empty result set using a table's column layout.
+  explicit ColumnarQueryData(const TableColumns& columns) {
+    reset(columns);
+  }
+
+  /// Replace the column layout and remove all rows.
+  void reset(const TableColumns& columns);
+
+  /// Remove all rows and interned text, the column layout is kept.
+  void clear();
+
+  /// Append a row of NULL cells and return the row index.
+  size_t addRow();
+
+  /// Allocate cells for a number of rows, the size is not changed.
+  void reserve(size_t rows);
+
+  /// The number of rows.
+  size_t size() const {
+    return rows_;
+  }
+
+  /// The number of columns.
+  size_t columns() const {
+    return columns_.size();
+  }
+
+  /// Lookup a column ordinal by name, returns columns() if the name is unknown.
+  size_t columnIndex(const std::string& name) const;
+
+  /// The SQLite affinity of a column.
+  ColumnType columnType(size_t column) const {
+    return columns_[column].type;
+  }
+
+  /// Set an INTEGER, BIGINT, or UNSIGNED BIGINT cell in the last row.
+  void setInteger(size_t column, long long value);
+
+  /// Set a DOUBLE cell in the last row.
+  void setDouble(size_t column, double value);
+
+  /**
+   * @brief Set a cell in the last row from a TEXT representation.
+   *
+   * Non-TEXT cells are converted using the column's affinity, cells that
+   * cannot be converted are NULL.
+   */
+  void setText(size_t column, const std::string& value);
+
+  /**
+   * @brief Append QueryData rows, the compatibility adapter for generate.
+   *
+   * Each cell is converted once, columns unknown to the layout are dropped.
+   */
+  void append(const QueryData& rows);
+
+  /// Append a single Row, see ColumnarQueryData::append.
+  void append(const Row& r);
+
+  /// Convert the columnar results into QueryData.
+  QueryData rows() const;
+
+  /// The approximate memory used by the cells and interned text.
+  size_t bytes() const;
+
+  /**
+   * @brief Serialize the column layout and typed cells.
+   *
+   * Extension tables respond using this encoding when the core requests it.
+   * Each column name is written once, followed by a bitmap of NULL cells and
+   * the column's cells. Integers are written as variable-length integers.
+   */
+  void serialize(std::string& output) const;
+
+  /**
+   * @brief Append serialized results, see ColumnarQueryData::serialize.
+   *
+   * Columns are matched to this layout by name and cells are converted when
+   * the types differ, columns unknown to the layout are dropped.
+   */
+  Status deserialize(const std::string& input);
+
+  /// Check if a cell is NULL.
+  bool isNull(size_t row, size_t column) const {
+    return columns_[column].nulls[row];
+  }
+
+  /// Access an INTEGER, BIGINT, or UNSIGNED BIGINT cell.
+  long long getInteger(size_t row, size_t column) const {
+    return columns_[column].integers[row];
+  }
+
+  /// Access a DOUBLE cell.
+  double getDouble(size_t row, size_t column) const {
+    return columns_[column].doubles[row];
+  }
+
+  /// Access a TEXT cell, the reference is valid until clear or reset.
+  const std::string& getText(size_t row, size_t column) const {
+    return *columns_[column].texts[row];
+  }
+
+ private:
+  /// Set an integer cell in any row, see ColumnarQueryData::setInteger.
+  void setInteger(size_t row, size_t column, long long value);
+
+  /// Set a DOUBLE cell in any row, see ColumnarQueryData::setDouble.
+  void setDouble(size_t row, size_t column, double value);
+
+  /// Set a cell in any row from TEXT, see ColumnarQueryData::setText.
+  void setText(size_t row, size_t column, const std::string& value);
+
+ private:
+  /// A column's typed cell storage, only one cell vector is used per type.
+  struct Column {
+    std::string name;
+    ColumnType type{UNKNOWN_TYPE};
+    std::vector<long long> integers;
+    std::vector<double> doubles;
+    std::vector<const std::string*> texts;
+    std::vector<bool> nulls;
+  };
+
+  /// Columns indexed by ordinal.
+  std::vector<Column> columns_;
+
+  /// The set of interned TEXT cells.
+  std::unordered_set<std::string> strings_;
+
+  /// The number of rows.
+  size_t rows_{0};
+};
+
+/// Counters describing the use of a table's cached results.
+struct TableCacheStats {
+  /// Queries that reused fresh results.
+  size_t hits{0};
+
+  /// Queries that generated results.
+  size_t misses{0};
+
+  /// Results removed to stay within the memory limit.
+  size_t evictions{0};
+
+  /// The number of cached result sets.
+  size_t entries{0};
+
+  /// The approximate memory used by cached result sets.
+  size_t bytes{0};
+};
+
+/**
+ * @brief An in-memory cache of table results.
+ *
+ * Results of CACHEABLE tables are reused by any query, scheduled or
+ * distributed, scanning the same table with the same constraints while the
+ * results are fresh. Every constraint distinguishes entries, tables may filter
+ * generated rows on any constrained column, not only on index columns.
+ *
+ * Cached results are shared with the virtual table cursors reading them. The
+ * cache is bounded in bytes and evicts the least recently used results.
+ */
+class TableResultCache : private boost::noncopyable {
+ public:
+  /// The cache used by virtual table scans.
+  static TableResultCache& instance();
+
+  /**
+   * @brief Seconds the results of a table remain fresh.
+   *
+   * Only CACHEABLE, and not EVENT_BASED, tables are cached. A scheduled query
+   * does not reuse results older than its interval.
+   *
+   * @return 0 if results should not be cached.
+   */
+  static size_t getTTL(TableAttributes attributes);
+
+  /// Create a normalized key from every constraint passed to a table.
+  static std::string getKey(const QueryContext& context);
+
+  /// Find results younger than ttl seconds, or nullptr.
+  std::shared_ptr<const ColumnarQueryData> find(const std::string& table,
+                                                const std::string& key,
+                                                size_t ttl);
+
+  /// Keep generated results, counted as a miss.
+  void insert(const std::string& table,
+              const std::string& key,
+              std::shared_ptr<const ColumnarQueryData> results);
+
+  /// Remove every cached result set, counters are kept.
+  void clear();
+
+  /// The counters for each table that was cached.
+  std::map<std::string, TableCacheStats> getStats() const;
+
+  /// The memory limit in bytes, bounded by the watchdog's worker limit.
+  static size_t getCapacity();
+
+ private:
+  /// A cached result set.
+  struct Entry {
+    std::string table;
+    std::string key;
+    size_t time{0};
+    size_t bytes{0};
+    std::shared_ptr<const ColumnarQueryData> results;
+  };
+
+  /// Evict the least recently used results until size fits within capacity.
+  void evict(size_t capacity);
+
+ private:
+  /// Protects the entries and counters.
+  mutable Mutex mutex_;
+
+  /// Cached results ordered from most recently used.
+  std::list<Entry> entries_;
+
+  /// Lookup from a table and key into the ordered entries.
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+
+  /// Counters for each table.
+  std::map<std::string, TableCacheStats> stats_;
+
+  /// The approximate memory used by all entries.
+  size_t bytes_{0};
+};
+
 /**
  * @brief The TablePlugin defines the name, types, and column information.
  *
@@ -699,70 +959,64 @@ class TablePlugin : public Plugin {
     return QueryData();
   }
 
- protected:
-  /// An SQL table containing the table definition/syntax.
-  std::string columnDefinition() const;
-
-  /// Return the name and column pairs for attaching virtual tables.
-  PluginResponse routeInfo() const override;
-
   /**
-   * @brief Check if there are fresh cache results for this table.
-   *
-   * Table results are considered fresh when evaluated against a given interval.
-   * The interval is the expected rate for which this data should be generated.
-   * Caching and cache freshness only applies to queries acting on tables
-   * within a schedule. If two queries "one" and "two" both inspect the
-   * table "processes" at the interval 60. The first executed will cache results
-   * and the second will use the cached results.
-   *
-   * Table results are not cached if a QueryContext contains constraints or
-   * provides HOB (hand-off blocks) to additional tables within a query.
-   * Currently, the query scheduler cannot communicate to table implementations.
-   * An interval is set globally by the scheduler and passed to the table
-   * implementation as a future-proof API. There is no "shortcut" for caching
-   * when used in external tables. A cache lookup within an extension means
-   * a database call API and re-serialization to the virtual table APIs. In
-   * practice this does not perform well and is explicitly disabled.
-   *
-   * @param interval The interval this query expects the tables results.
-   * @return True if the cache contains fresh results, otherwise false.
+   * @brief Generate a typed, columnar table representation.
+   *
+   * Tables may fill typed cells by column ordinal instead of returning rows.
+   * The virtual table cursor always requests columnar results, the default
+   * implementation adapts the results of TablePlugin::generate.
+   *
+   * @param request A query context filled in by SQLite's virtual table API.
+   * @param results The output results, using the table's column layout.
    */
-  bool isCached(size_t interval);
+  virtual void generateColumnar(QueryContext& request,
+                                ColumnarQueryData& results) {
+    results.append(generate(request));
+  }
 
   /**
-   * @brief Perform a database lookup of cached results and deserialize.
+   * @brief Generate table rows one at a time.
+   *
+   * Tables that may generate very large result sets can yield each row
+   * instead of returning a complete QueryData. The virtual table cursor pulls
+   * a single row from the generator as SQLite advances, so the rows are not
+   * all held in memory and a LIMIT stops the generation early.
    *
-   * If a query determined the table's cached results are fresh, it may ask the
-   * table to retrieve results from the database and deserialized them into
-   * table row data.
+   * Tables implementing a generator must also return true for
+   * TablePlugin::usesGenerator. A yielded row may be moved by the caller.
    *
-   * @return The deserialized row data of cached results.
+   * @param yield Called with each generated row.
+   * @param request A query context filled in by SQLite's virtual table API.
    */
-  QueryData getCache() const;
+  virtual void generator(RowYield& yield, QueryContext& request) {}
 
-  /// Similar to TablePlugin::getCache, if TablePlugin::generate is called.
-  void setCache(size_t step, size_t interval, const QueryData& results);
+  /// Check if the table implements TablePlugin::generator.
+  virtual bool usesGenerator() const {
+    return false;
+  }
 
- private:
-  /// The last time in seconds the table data results were saved to cache.
-  size_t last_cached_{0};
+  /// Collect every row yielded by TablePlugin::generator.
+  QueryData generateAll(QueryContext& request);
 
-  /// The last interval in seconds when the table data was cached.
-  size_t last_interval_{0};
+ protected:
+  /// An SQL table containing the table definition/syntax.
+  std::string columnDefinition() const;
+
+  /// Return the name and column pairs for attaching virtual tables.
+  PluginResponse routeInfo() const override;
 
  public:
   /**
    * @brief The scheduled interval for the executing query.
    *
-   * Scheduled queries execute within a pseudo-mutex, and each may communicate
-   * their scheduled interval to internal TablePlugin implementations. If the
-   * table is cachable then the interval can be used to calculate freshness.
+   * Each scheduler worker communicates the interval of the query it executes
+   * to internal TablePlugin implementations. If the table is cacheable the
+   * interval limits the age of reused results, see TableResultCache.
    */
-  static size_t kCacheInterval;
+  static thread_local size_t kCacheInterval;
 
-  /// The schedule step, this is the current position of the schedule.
-  static size_t kCacheStep;
+  /// The schedule step the calling worker's query was launched from.
+  static thread_local size_t kCacheStep;
 
  public:
   /**
@@ -785,6 +1039,19 @@ class TablePlugin : public Plugin {
   static void setRequestFromContext(const QueryContext& context,
                                     PluginRequest& request);
 
+  /**
+   * @brief Start a pull-based row generator for a local table.
+   *
+   * The generator runs until the first row is yielded. The context must
+   * outlive the returned generator.
+   *
+   * @param name The table name.
+   * @param context The query context used for the generation.
+   * @return nullptr if the table is not local or does not use a generator.
+   */
+  static std::unique_ptr<RowGenerator::pull_type> startGenerator(
+      const std::string& name, QueryContext& context);
+
   /// Helper data structure transformation methods.
   static void setContextFromRequest(const PluginRequest& request,
                                     QueryContext& context);
@@ -809,6 +1076,7 @@ class TablePlugin : public Plugin {
   friend class RegistryFactory;
   FRIEND_TEST(VirtualTableTests, test_tableplugin_columndefinition);
   FRIEND_TEST(VirtualTableTests, test_tableplugin_statement);
+  FRIEND_TEST(VirtualTableTests, test_table_result_cache);
   FRIEND_TEST(VirtualTableTests, test_indexing_costs);
 };
 
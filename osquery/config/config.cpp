@@ -8,6 +8,7 @@
  *
  */
 
+#include <algorithm>
 #include <chrono>
 #include <mutex>
 #include <random>
@@ -28,6 +29,7 @@
 
 #include "osquery/core/conversions.h"
 #include "osquery/core/json.h"
+#include "osquery/database/query.h"
 
 namespace pt = boost::property_tree;
 
@@ -66,11 +68,12 @@ DECLARE_string(pack_delimiter);
 DECLARE_bool(disable_events);
 
 /**
- * @brief The backing store key name for the executing query.
+ * @brief The backing store key name for the executing queries.
  *
  * The config maintains schedule statistics and tracks failed executions.
  * On process or worker resume an initializer or config may check if the
- * resume was the result of a failure during an executing query.
+ * resume was the result of a failure during an executing query. Scheduled
+ * queries run concurrently, the value is a newline-separated list of names.
  */
 const std::string kExecutingQuery{"executing_query"};
 const std::string kFailedQueries{"failed_queries"};
@@ -84,6 +87,12 @@ RecursiveMutex config_schedule_mutex_;
 RecursiveMutex config_files_mutex_;
 RecursiveMutex config_performance_mutex_;
 
+/// Protects the set of executing scheduled queries.
+Mutex config_executing_mutex_;
+
+/// The scheduled query executing on each scheduler worker thread.
+static thread_local std::string kThreadExecutingQuery;
+
 using PackRef = std::shared_ptr<Pack>;
 
 /**
@@ -175,10 +184,10 @@ class Schedule : private boost::noncopyable {
   /**
    * @brief The schedule will check and record previously executing queries.
    *
-   * If a query is found on initialization, the name will be recorded, it is
-   * possible to skip previously failed queries.
+   * If queries are found on initialization, the names will be recorded, it
+   * is possible to skip previously failed queries.
    */
-  std::string failed_query_;
+  std::set<std::string> failed_queries_;
 
   /**
    * @brief List of blacklisted queries.
@@ -233,12 +242,19 @@ Schedule::Schedule() {
   restoreScheduleBlacklist(blacklist_);
 
   // Check if any queries were executing when the tool last stopped.
-  getDatabaseValue(kPersistentSettings, kExecutingQuery, failed_query_);
-  if (!failed_query_.empty()) {
-    LOG(WARNING) << "Scheduled query may have failed: " << failed_query_;
+  std::string content;
+  getDatabaseValue(kPersistentSettings, kExecutingQuery, content);
+  for (const auto& name : osquery::split(content, "\n")) {
+    failed_queries_.insert(name);
+  }
+
+  if (!failed_queries_.empty()) {
+    for (const auto& name : failed_queries_) {
+      LOG(WARNING) << "Scheduled query may have failed: " << name;
+      // Add this query name to the blacklist.
+      blacklist_[name] = getUnixTime() + 86400;
+    }
     setDatabaseValue(kPersistentSettings, kExecutingQuery, "");
-    // Add this query name to the blacklist and save the blacklist.
-    blacklist_[failed_query_] = getUnixTime() + 86400;
     saveScheduleBlacklist(blacklist_);
   }
 }
@@ -563,8 +579,7 @@ Status Config::update(const std::map<std::string, std::string>& config) {
 
 void Config::purge() {
   // The first use of purge is removing expired query results.
-  std::vector<std::string> saved_queries;
-  scanDatabaseKeys(kQueries, saved_queries);
+  auto saved_queries = Query::getStoredQueryNames();
 
   const auto& schedule = this->schedule_;
   auto queryExists = [&schedule](const std::string& query_name) {
@@ -607,7 +622,7 @@ void Config::purge() {
 
     if (last_executed < getUnixTime() - 592200) {
       // Query has not run in the last week, expire results and interval.
-      deleteDatabaseValue(kQueries, saved_query);
+      Query::deleteStoredResults(saved_query);
       deleteDatabaseValue(kPersistentSettings, "interval." + saved_query);
       deleteDatabaseValue(kPersistentSettings, "timestamp." + saved_query);
       VLOG(1) << "Expiring results for scheduled query: " << saved_query;
@@ -616,6 +631,11 @@ void Config::purge() {
 }
 
 void Config::reset() {
+  {
+    WriteLock lock(config_executing_mutex_);
+    executing_.clear();
+  }
+  kThreadExecutingQuery.clear();
   schedule_ = std::make_shared<Schedule>();
   std::map<std::string, QueryPerformance>().swap(performance_);
   std::map<std::string, FileCategories>().swap(files_);
@@ -647,10 +667,7 @@ void ConfigParserPlugin::reset() {
 }
 
 void Config::recordQueryPerformance(const std::string& name,
-                                    size_t delay,
-                                    size_t size,
-                                    const Row& r0,
-                                    const Row& r1) {
+                                    const QueryPerformance& execution) {
   RecursiveLock lock(config_performance_mutex_);
   if (performance_.count(name) == 0) {
     performance_[name] = QueryPerformance();
@@ -658,45 +675,47 @@ void Config::recordQueryPerformance(const std::string& name,
 
   // Grab access to the non-const schedule item.
   auto& query = performance_.at(name);
-  BIGINT_LITERAL diff = 0;
-  if (!r1.at("user_time").empty() && !r0.at("user_time").empty()) {
-    diff = AS_LITERAL(BIGINT_LITERAL, r1.at("user_time")) -
-           AS_LITERAL(BIGINT_LITERAL, r0.at("user_time"));
-    if (diff > 0) {
-      query.user_time += diff;
-    }
-  }
-
-  if (!r1.at("system_time").empty() && !r0.at("system_time").empty()) {
-    diff = AS_LITERAL(BIGINT_LITERAL, r1.at("system_time")) -
-           AS_LITERAL(BIGINT_LITERAL, r0.at("system_time"));
-    if (diff > 0) {
-      query.system_time += diff;
-    }
-  }
-
-  if (!r1.at("resident_size").empty() && !r0.at("resident_size").empty()) {
-    diff = AS_LITERAL(BIGINT_LITERAL, r1.at("resident_size")) -
-           AS_LITERAL(BIGINT_LITERAL, r0.at("resident_size"));
-    if (diff > 0) {
-      // Memory is stored as an average of RSS changes between query executions.
-      query.average_memory = (query.average_memory * query.executions) + diff;
-      query.average_memory = (query.average_memory / (query.executions + 1));
-    }
-  }
-
-  query.wall_time += delay;
-  query.output_size += size;
+  query.user_time += execution.user_time;
+  query.system_time += execution.system_time;
+  query.cpu_time += execution.cpu_time;
+  if (execution.average_memory > 0) {
+    // Memory is stored as an average of RSS changes between query executions.
+    query.average_memory = (query.average_memory * query.executions) +
+                           execution.average_memory;
+    query.average_memory = (query.average_memory / (query.executions + 1));
+  }
+  query.peak_memory = std::max(query.peak_memory, execution.peak_memory);
+
+  query.wall_time += execution.wall_time;
+  query.output_size += execution.output_size;
+  query.output_rows += execution.output_rows;
   query.executions += 1;
   query.last_executed = getUnixTime();
 
   // Clear the executing query (remove the dirty bit).
-  setDatabaseValue(kPersistentSettings, kExecutingQuery, "");
+  recordQueryEnd(name);
+}
+
+/// Persist the names of the executing queries, the lock must be held.
+static void saveExecutingQueries(const std::set<std::string>& executing) {
+  std::string content;
+  for (const auto& name : executing) {
+    if (!content.empty()) {
+      content += '\n';
+    }
+    content += name;
+  }
+  setDatabaseValue(kPersistentSettings, kExecutingQuery, content);
 }
 
 void Config::recordQueryStart(const std::string& name) {
-  // There should only ever be a single executing query in the schedule.
-  setDatabaseValue(kPersistentSettings, kExecutingQuery, name);
+  // Scheduler workers may execute several queries at the same time.
+  kThreadExecutingQuery = name;
+  {
+    WriteLock lock(config_executing_mutex_);
+    executing_.insert(name);
+    saveExecutingQueries(executing_);
+  }
   // Store the time this query name last executed for later results eviction.
   // When configuration updates occur the previous schedule is searched for
   // 'stale' query names, aka those that have week-old or longer last execute
@@ -705,6 +724,21 @@ void Config::recordQueryStart(const std::string& name) {
       kPersistentSettings, "timestamp." + name, std::to_string(getUnixTime()));
 }
 
+void Config::recordQueryEnd(const std::string& name) {
+  if (kThreadExecutingQuery == name) {
+    kThreadExecutingQuery.clear();
+  }
+
+  WriteLock lock(config_executing_mutex_);
+  if (executing_.erase(name) > 0) {
+    saveExecutingQueries(executing_);
+  }
+}
+
+const std::string& Config::getExecutingQuery() {
+  return kThreadExecutingQuery;
+}
+
 void Config::getPerformanceStats(
     const std::string& name,
     std::function<void(const QueryPerformance& query)> predicate) {
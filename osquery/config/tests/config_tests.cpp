@@ -9,6 +9,7 @@
  */
 
 #include <memory>
+#include <thread>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -46,6 +47,7 @@ class ConfigTests : public testing::Test {
  protected:
   Status load() { return Config::getInstance().load(); }
   void setLoaded() { Config::getInstance().loaded_ = true; }
+  void reset() { Config::getInstance().reset(); }
   Config& get() { return Config::getInstance(); }
 };
 
@@ -139,6 +141,41 @@ TEST_F(ConfigTests, test_schedule_blacklist) {
   EXPECT_EQ(blacklist.size(), 1U);
 }
 
+TEST_F(ConfigTests, test_executing_queries) {
+  std::map<std::string, size_t> blacklist;
+  saveScheduleBlacklist(blacklist);
+
+  // Scheduler workers record their queries concurrently.
+  std::thread first([this]() {
+    get().recordQueryStart("executing_1");
+    EXPECT_EQ(Config::getExecutingQuery(), "executing_1");
+  });
+  std::thread second([this]() {
+    get().recordQueryStart("executing_2");
+    get().recordQueryStart("executing_3");
+    get().recordQueryEnd("executing_3");
+    EXPECT_TRUE(Config::getExecutingQuery().empty());
+  });
+  first.join();
+  second.join();
+  EXPECT_TRUE(Config::getExecutingQuery().empty());
+
+  // Both unfinished queries are blacklisted when the schedule is restored.
+  reset();
+  restoreScheduleBlacklist(blacklist);
+  EXPECT_EQ(blacklist.size(), 2U);
+  EXPECT_EQ(blacklist.count("executing_1"), 1U);
+  EXPECT_EQ(blacklist.count("executing_2"), 1U);
+
+  std::string content;
+  getDatabaseValue(kPersistentSettings, kExecutingQuery, content);
+  EXPECT_TRUE(content.empty());
+
+  blacklist.clear();
+  saveScheduleBlacklist(blacklist);
+  reset();
+}
+
 TEST_F(ConfigTests, test_pack_noninline) {
   Registry::add<TestConfigPlugin>("config", "test");
   // Change the active config plugin.
@@ -8,13 +8,28 @@
  *
  */
 
+#ifndef WIN32
+#include <sys/resource.h>
+#include <sys/stat.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
 #include <iomanip>
 #include <sstream>
+#include <thread>
 #include <vector>
 
+#include <osquery/core.h>
+#include <osquery/database.h>
 #include <osquery/filesystem.h>
+#include <osquery/flags.h>
 #include <osquery/hash.h>
 #include <osquery/logger.h>
+#include <osquery/system.h>
+
+#include "osquery/core/watcher.h"
 
 namespace osquery {
 
@@ -30,7 +45,56 @@ namespace osquery {
 #define SHA1_CTX SHA_CTX
 #endif
 
-#define HASH_CHUNK_SIZE 4096
+#define HASH_CHUNK_SIZE (256 * 1024)
+
+FLAG(uint64,
+     hash_threads,
+     4,
+     "Number of threads used when hashing many files (Linux)");
+
+FLAG(uint64,
+     hash_cache_max,
+     50000,
+     "Max number of files with cached hashes (0 = disabled)");
+
+/// Key prefix for cached hashes in the hashes domain.
+const std::string kHashCacheEntryPrefix = "entry.";
+
+/// Key prefix for the insertion order of cached hashes, used for eviction.
+const std::string kHashCacheOrderPrefix = "order.";
+
+const time_t kHashCacheSettleTime = 2;
+
+/// A cached set of hashes, parsed from the hashes domain.
+struct HashCacheEntry {
+  /// The insertion order of this entry.
+  uint64_t sequence{0};
+
+  /// The state of the content that was hashed.
+  std::string version;
+
+  MultiHashes hashes;
+};
+
+/// Bookkeeping for the persistent hash cache.
+struct HashCacheState {
+  /// Set when the count and sequence were read from the backing store.
+  bool loaded{false};
+
+  /// The number of cached entries.
+  size_t count{0};
+
+  /// The last insertion order assigned.
+  uint64_t sequence{0};
+
+  /// Access to the count and sequence, and serialize cache writes.
+  Mutex mutex;
+};
+
+static HashCacheState& getHashCacheState() {
+  static HashCacheState state;
+  return state;
+}
 
 Hash::~Hash() {
   if (ctx_ != nullptr) {
@@ -95,27 +159,80 @@ std::string hashFromBuffer(HashType hash_type,
   return hash.digest();
 }
 
-MultiHashes hashMultiFromFile(int mask, const std::string& path) {
+#ifndef WIN32
+/// The CPU time, user and system, used by this process in milliseconds.
+static size_t getProcessCPUTime() {
+  struct rusage usage;
+  if (::getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  return static_cast<size_t>(
+      (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000 +
+      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000);
+}
+#endif
+
+/**
+ * @brief Pause hashing when the worker uses its share of CPU for this second.
+ *
+ * The watchdog stops a worker that sustains more than the utilization limit
+ * of CPU milliseconds per second. Hashing a large set of files is allowed
+ * half of that limit, hashing threads pause until the next second.
+ */
+static void throttleHashing() {
+#ifndef WIN32
+  if (!Initializer::isWorker()) {
+    return;
+  }
+
+  static Mutex mutex;
+  static std::chrono::steady_clock::time_point window;
+  static size_t window_cpu{0};
+
+  std::chrono::steady_clock::duration pause;
+  {
+    WriteLock lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    auto cpu = getProcessCPUTime();
+    if (now - window >= std::chrono::seconds(1)) {
+      window = now;
+      window_cpu = cpu;
+      return;
+    }
+
+    if (cpu - window_cpu < getWorkerLimit(UTILIZATION_LIMIT) / 2) {
+      return;
+    }
+    pause = window + std::chrono::seconds(1) - now;
+  }
+  std::this_thread::sleep_for(pause);
+#endif
+}
+
+/// Hash the content of a file, returns the status of reading the file.
+static Status hashFileContent(int mask,
+                              const std::string& path,
+                              MultiHashes& mh) {
   std::map<HashType, std::shared_ptr<Hash>> hashes = {
       {HASH_TYPE_MD5, std::make_shared<Hash>(HASH_TYPE_MD5)},
       {HASH_TYPE_SHA1, std::make_shared<Hash>(HASH_TYPE_SHA1)},
       {HASH_TYPE_SHA256, std::make_shared<Hash>(HASH_TYPE_SHA256)},
   };
 
-  readFile(path,
-           0,
-           HASH_CHUNK_SIZE,
-           false,
-           true,
-           ([&hashes, &mask](std::string& buffer, size_t size) {
-             for (auto& hash : hashes) {
-               if (mask & hash.first) {
-                 hash.second->update(&buffer[0], size);
-               }
-             }
-           }));
+  auto status = readFile(path,
+                         0,
+                         HASH_CHUNK_SIZE,
+                         false,
+                         true,
+                         ([&hashes, &mask](std::string& buffer, size_t size) {
+                           for (auto& hash : hashes) {
+                             if (mask & hash.first) {
+                               hash.second->update(&buffer[0], size);
+                             }
+                           }
+                           throttleHashing();
+                         }));
 
-  MultiHashes mh;
   mh.mask = mask;
   if (mask & HASH_TYPE_MD5) {
     mh.md5 = hashes.at(HASH_TYPE_MD5)->digest();
@@ -126,9 +243,237 @@ MultiHashes hashMultiFromFile(int mask, const std::string& path) {
   if (mask & HASH_TYPE_SHA256) {
     mh.sha256 = hashes.at(HASH_TYPE_SHA256)->digest();
   }
+  return status;
+}
+
+MultiHashes hashMultiFromFile(int mask, const std::string& path) {
+  MultiHashes mh;
+  hashFileContent(mask, path, mh);
   return mh;
 }
 
+static std::string genHashCacheOrderKey(uint64_t sequence) {
+  std::stringstream key;
+  key << kHashCacheOrderPrefix << std::setw(20) << std::setfill('0')
+      << sequence;
+  return key.str();
+}
+
+static bool parseHashCacheEntry(const std::string& value,
+                                HashCacheEntry& entry) {
+  // Entries are: sequence,version,mask,md5,sha1,sha256
+  std::vector<std::string> fields;
+  std::stringstream input(value);
+  std::string field;
+  while (std::getline(input, field, ',')) {
+    fields.push_back(std::move(field));
+  }
+  if (fields.size() == 5) {
+    // The last hash is empty.
+    fields.push_back("");
+  }
+
+  if (fields.size() != 6) {
+    return false;
+  }
+
+  try {
+    entry.sequence = std::stoull(fields[0]);
+    entry.hashes.mask = std::stoi(fields[2]);
+  } catch (const std::exception& /* e */) {
+    return false;
+  }
+  entry.version = std::move(fields[1]);
+  entry.hashes.md5 = std::move(fields[3]);
+  entry.hashes.sha1 = std::move(fields[4]);
+  entry.hashes.sha256 = std::move(fields[5]);
+  return true;
+}
+
+/// Read the count and last insertion order of cached hashes.
+static void loadHashCacheState(HashCacheState& state) {
+  std::vector<std::string> orders;
+  scanDatabaseKeys(kHashes, orders, kHashCacheOrderPrefix);
+  state.count = orders.size();
+  for (const auto& order : orders) {
+    try {
+      auto sequence = std::stoull(order.substr(kHashCacheOrderPrefix.size()));
+      state.sequence = std::max<uint64_t>(state.sequence, sequence);
+    } catch (const std::exception& /* e */) {
+      continue;
+    }
+  }
+  state.loaded = true;
+}
+
+/// Evict the oldest cached hashes, leaving room for more entries.
+static void evictHashCache(HashCacheState& state) {
+  // Evict an additional tenth of the max to amortize scanning for the oldest.
+  size_t max = static_cast<size_t>(FLAGS_hash_cache_max);
+  size_t evict = state.count - max + max / 10;
+
+  // This assumes that keys are returned in ascending lexicographic order.
+  std::vector<std::string> orders;
+  scanDatabaseKeys(kHashes, orders, kHashCacheOrderPrefix, evict);
+  for (const auto& order : orders) {
+    std::string key;
+    if (getDatabaseValue(kHashes, order, key).ok()) {
+      // Only remove the entry if it was not cached again since.
+      std::string value;
+      HashCacheEntry entry;
+      if (getDatabaseValue(kHashes, key, value).ok() &&
+          parseHashCacheEntry(value, entry) &&
+          genHashCacheOrderKey(entry.sequence) == order) {
+        deleteDatabaseValue(kHashes, key);
+      }
+    }
+    if (deleteDatabaseValue(kHashes, order).ok() && state.count > 0) {
+      state.count--;
+    }
+  }
+}
+
+bool getCachedHashes(const std::string& key,
+                     const std::string& version,
+                     int mask,
+                     MultiHashes& hashes) {
+  if (FLAGS_hash_cache_max == 0) {
+    return false;
+  }
+
+  std::string value;
+  HashCacheEntry entry;
+  if (!getDatabaseValue(kHashes, kHashCacheEntryPrefix + key, value).ok() ||
+      !parseHashCacheEntry(value, entry)) {
+    return false;
+  }
+
+  if (entry.version != version || (entry.hashes.mask & mask) != mask) {
+    return false;
+  }
+  hashes = std::move(entry.hashes);
+  return true;
+}
+
+void setCachedHashes(const std::string& key,
+                     const std::string& version,
+                     const MultiHashes& hashes) {
+  if (FLAGS_hash_cache_max == 0 ||
+      version.find(',') != std::string::npos) {
+    return;
+  }
+
+  auto& state = getHashCacheState();
+  WriteLock lock(state.mutex);
+  if (!state.loaded) {
+    loadHashCacheState(state);
+  }
+
+  // Replace a previous entry for the same key, such as a changed file.
+  auto entry_key = kHashCacheEntryPrefix + key;
+  std::string value;
+  HashCacheEntry previous;
+  if (getDatabaseValue(kHashes, entry_key, value).ok() &&
+      parseHashCacheEntry(value, previous)) {
+    auto order = genHashCacheOrderKey(previous.sequence);
+    if (deleteDatabaseValue(kHashes, order).ok() && state.count > 0) {
+      state.count--;
+    }
+  }
+
+  auto sequence = ++state.sequence;
+  value = std::to_string(sequence) + "," + version + "," +
+          std::to_string(hashes.mask) + "," + hashes.md5 + "," + hashes.sha1 +
+          "," + hashes.sha256;
+  if (!setDatabaseValue(kHashes, entry_key, value).ok() ||
+      !setDatabaseValue(kHashes, genHashCacheOrderKey(sequence), entry_key)
+           .ok()) {
+    return;
+  }
+
+  state.count++;
+  if (state.count > FLAGS_hash_cache_max) {
+    evictHashCache(state);
+  }
+}
+
+#ifndef WIN32
+/// Identify the state of a file's content from its size and change times.
+static std::string getFileVersion(const struct stat& file_stat) {
+#ifdef __APPLE__
+  const auto& mtime = file_stat.st_mtimespec;
+  const auto& ctime = file_stat.st_ctimespec;
+#else
+  const auto& mtime = file_stat.st_mtim;
+  const auto& ctime = file_stat.st_ctim;
+#endif
+  return std::to_string(file_stat.st_size) + "." +
+         std::to_string(mtime.tv_sec) + "." + std::to_string(mtime.tv_nsec) +
+         "." + std::to_string(ctime.tv_sec) + "." +
+         std::to_string(ctime.tv_nsec);
+}
+#endif
+
+MultiHashes hashMultiFromFileCached(int mask, const std::string& path) {
+#ifndef WIN32
+  struct stat file_stat;
+  if (FLAGS_hash_cache_max == 0 || ::stat(path.c_str(), &file_stat) != 0 ||
+      !S_ISREG(file_stat.st_mode)) {
+    return hashMultiFromFile(mask, path);
+  }
+
+  auto key = "file." + std::to_string(file_stat.st_dev) + "." +
+             std::to_string(file_stat.st_ino);
+  auto version = getFileVersion(file_stat);
+  MultiHashes hashes;
+  if (getCachedHashes(key, version, mask, hashes)) {
+    return hashes;
+  }
+
+  auto status = hashFileContent(mask, path, hashes);
+
+  // A write within the same timestamp granularity would keep the version.
+  auto changed = std::max(file_stat.st_mtime, file_stat.st_ctime);
+  if (status.ok() && std::time(nullptr) - changed >= kHashCacheSettleTime) {
+    setCachedHashes(key, version, hashes);
+  }
+  return hashes;
+#else
+  // Windows files do not provide a stable device and inode identity here.
+  return hashMultiFromFile(mask, path);
+#endif
+}
+
+std::vector<MultiHashes> hashMultiFromFiles(
+    int mask, const std::vector<std::string>& paths) {
+  std::vector<MultiHashes> results(paths.size());
+
+  size_t threads = 1;
+#ifdef __linux__
+  // Dropping privileges to read a file applies to the calling thread only on
+  // Linux, elsewhere files are read by one thread.
+  threads = std::min(static_cast<size_t>(FLAGS_hash_threads), paths.size());
+#endif
+
+  // Each thread hashes the next unclaimed file, results keep the input order.
+  std::atomic<size_t> next{0};
+  auto hash_files = ([&results, &paths, &next, mask]() {
+    for (size_t i = next++; i < paths.size(); i = next++) {
+      results[i] = hashMultiFromFileCached(mask, paths[i]);
+    }
+  });
+
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < threads; i++) {
+    workers.emplace_back(hash_files);
+  }
+  hash_files();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  return results;
+}
+
 std::string hashFromFile(HashType hash_type, const std::string& path) {
   auto hashes = hashMultiFromFile(hash_type, path);
   if (hash_type == HASH_TYPE_MD5) {
@@ -11,7 +11,10 @@
 #include <string>
 
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <sys/resource.h>
 #include <sys/time.h>
@@ -20,6 +23,10 @@
 
 #include <boost/optional.hpp>
 
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
 #include "osquery/core/process.h"
 
 namespace osquery {
@@ -86,4 +93,72 @@ bool isUserAdmin() {
 int platformGetPid() {
   return (int)getpid();
 }
+
+#ifdef __linux__
+/// Read the resident pages from /proc/self/statm without allocating.
+static unsigned long long int getResidentPages() {
+  auto fd = ::open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return 0;
+  }
+
+  char buffer[128];
+  auto bytes = ::read(fd, buffer, sizeof(buffer) - 1);
+  ::close(fd);
+  if (bytes <= 0) {
+    return 0;
+  }
+  buffer[bytes] = 0;
+
+  // The second field is the resident set size in pages.
+  char* field = nullptr;
+  ::strtoull(buffer, &field, 10);
+  return ::strtoull(field, nullptr, 10);
+}
+#endif
+
+bool getResourceUsage(ResourceUsage& usage) {
+  struct rusage ru;
+#ifdef RUSAGE_THREAD
+  auto status = ::getrusage(RUSAGE_THREAD, &ru);
+#else
+  auto status = ::getrusage(RUSAGE_SELF, &ru);
+#endif
+  if (status != 0) {
+    return false;
+  }
+
+  usage.user_time = ru.ru_utime.tv_sec * 1000ULL + ru.ru_utime.tv_usec / 1000;
+  usage.system_time = ru.ru_stime.tv_sec * 1000ULL + ru.ru_stime.tv_usec / 1000;
+
+  struct timespec ts;
+  if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+    usage.cpu_time = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  } else {
+    usage.cpu_time = (usage.user_time + usage.system_time) * 1000000ULL;
+  }
+
+#ifdef __APPLE__
+  // Darwin reports the maximum resident size in bytes.
+  usage.peak_resident_size = ru.ru_maxrss;
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(),
+                MACH_TASK_BASIC_INFO,
+                (task_info_t)&info,
+                &count) == KERN_SUCCESS) {
+    usage.resident_size = info.resident_size;
+  }
+#else
+  // The maximum resident size is reported in kilobytes.
+  usage.peak_resident_size = ru.ru_maxrss * 1024ULL;
+#ifdef __linux__
+  static const auto page_size = ::sysconf(_SC_PAGESIZE);
+  usage.resident_size = getResidentPages() * page_size;
+#else
+  usage.resident_size = usage.peak_resident_size;
+#endif
+#endif
+  return true;
+}
 }
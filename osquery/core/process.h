@@ -208,6 +208,38 @@ class SecurityDescriptor {
 };
 #endif
 
+/**
+ * @brief A sample of the resources used by the calling thread.
+ *
+ * CPU times are measured for the calling thread, such that concurrent work
+ * within the process is not attributed to the caller. Work the caller hands
+ * to other threads, such as hashing or YARA scan workers, is not counted.
+ * Memory is measured for the process and includes concurrent allocations.
+ */
+struct ResourceUsage {
+  /// User CPU time in milliseconds.
+  unsigned long long int user_time{0};
+
+  /// System CPU time in milliseconds.
+  unsigned long long int system_time{0};
+
+  /// Total CPU time in nanoseconds.
+  unsigned long long int cpu_time{0};
+
+  /// Resident memory in bytes.
+  unsigned long long int resident_size{0};
+
+  /// Highest resident memory in bytes since the process started.
+  unsigned long long int peak_resident_size{0};
+};
+
+/**
+ * @brief Sample the resources used by the calling thread and its process.
+ *
+ * This does not allocate and is cheap enough to wrap each scheduled query.
+ */
+bool getResourceUsage(ResourceUsage& usage);
+
 /// Returns the current user's ID (UID on POSIX systems and RID for Windows)
 int platformGetUid();
 
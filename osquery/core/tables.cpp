@@ -8,12 +8,21 @@
  *
  */
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include <boost/coroutine/protected_stack_allocator.hpp>
+
 #include <osquery/database.h>
 #include <osquery/flags.h>
 #include <osquery/logger.h>
+#include <osquery/system.h>
 #include <osquery/tables.h>
 
+#include "osquery/core/conversions.h"
 #include "osquery/core/json.h"
+#include "osquery/core/watcher.h"
 
 namespace pt = boost::property_tree;
 
@@ -21,8 +30,21 @@ namespace osquery {
 
 FLAG(bool, disable_caching, false, "Disable scheduled query caching");
 
-size_t TablePlugin::kCacheInterval = 0;
-size_t TablePlugin::kCacheStep = 0;
+FLAG(uint64,
+     table_cache_ttl,
+     60,
+     "Seconds results of cacheable tables are reused by any query");
+
+FLAG(uint64,
+     table_cache_size,
+     16,
+     "Megabytes of table results kept in memory for reuse");
+
+/// Table row generators run on their own stack, with a guard page.
+const size_t kTableGeneratorStackSize = 1024 * 1024;
+
+thread_local size_t TablePlugin::kCacheInterval = 0;
+thread_local size_t TablePlugin::kCacheStep = 0;
 
 const std::map<ColumnType, std::string> kColumnTypeNames = {
     {UNKNOWN_TYPE, "UNKNOWN"},
@@ -34,6 +56,84 @@ const std::map<ColumnType, std::string> kColumnTypeNames = {
     {BLOB_TYPE, "BLOB"},
 };
 
+const std::string kTableColumnarEncoding = "columnar";
+
+/// The version of the binary context and columnar results encodings.
+const unsigned char kTableEncodingVersion = 1;
+
+/// Append an unsigned variable-length integer, 7 bits per byte.
+static void putVarint(std::string& output, unsigned long long value) {
+  while (value >= 0x80) {
+    output.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  output.push_back(static_cast<char>(value));
+}
+
+/// Append a length-prefixed string.
+static void putString(std::string& output, const std::string& value) {
+  putVarint(output, value.size());
+  output.append(value);
+}
+
+/// A bounds-checked reader of the binary encodings.
+class EncodingReader {
+ public:
+  explicit EncodingReader(const std::string& input) : input_(input) {}
+
+  bool getByte(unsigned char& value) {
+    if (offset_ >= input_.size()) {
+      return false;
+    }
+    value = static_cast<unsigned char>(input_[offset_++]);
+    return true;
+  }
+
+  bool getVarint(unsigned long long& value) {
+    value = 0;
+    for (size_t shift = 0; shift < 64; shift += 7) {
+      unsigned char byte = 0;
+      if (!getByte(byte)) {
+        return false;
+      }
+      value |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Point to the next size bytes of the input.
+  bool getBytes(size_t size, const char*& bytes) {
+    if (size > input_.size() - offset_) {
+      return false;
+    }
+    bytes = input_.data() + offset_;
+    offset_ += size;
+    return true;
+  }
+
+  bool getString(std::string& value) {
+    unsigned long long size = 0;
+    const char* bytes = nullptr;
+    if (!getVarint(size) || !getBytes(size, bytes)) {
+      return false;
+    }
+    value.assign(bytes, size);
+    return true;
+  }
+
+  /// The number of bytes not read.
+  size_t remaining() const {
+    return input_.size() - offset_;
+  }
+
+ private:
+  const std::string& input_;
+  size_t offset_{0};
+};
+
 Status TablePlugin::addExternal(const std::string& name,
                                 const PluginResponse& response) {
   // Attach the table.
@@ -55,6 +155,24 @@ void TablePlugin::removeExternal(const std::string& name) {
 
 void TablePlugin::setRequestFromContext(const QueryContext& context,
                                         PluginRequest& request) {
+  if (request.count("encoding") > 0 &&
+      request.at("encoding") == kTableColumnarEncoding) {
+    // Extensions supporting the columnar encoding read a binary context.
+    std::string output(1, static_cast<char>(kTableEncodingVersion));
+    putVarint(output, context.constraints.size());
+    for (const auto& constraint : context.constraints) {
+      putString(output, constraint.first);
+      output.push_back(static_cast<char>(constraint.second.affinity));
+      putVarint(output, constraint.second.getAll().size());
+      for (const auto& expression : constraint.second.getAll()) {
+        output.push_back(static_cast<char>(expression.op));
+        putString(output, expression.expr);
+      }
+    }
+    request["context"] = std::move(output);
+    return;
+  }
+
   pt::ptree tree;
 
   // The QueryContext contains a constraint map from column to type information
@@ -79,12 +197,79 @@ void TablePlugin::setRequestFromContext(const QueryContext& context,
   request["context"] = output.str();
 }
 
+std::unique_ptr<RowGenerator::pull_type> TablePlugin::startGenerator(
+    const std::string& name, QueryContext& context) {
+  if (!Registry::exists("table", name, true)) {
+    return nullptr;
+  }
+
+  auto plugin = std::dynamic_pointer_cast<TablePlugin>(
+      Registry::get("table", name));
+  if (plugin == nullptr || !plugin->usesGenerator()) {
+    return nullptr;
+  }
+
+  // The generator holds a reference to the plugin while rows are pulled.
+  return std::unique_ptr<RowGenerator::pull_type>(new RowGenerator::pull_type(
+      [plugin, &context](RowYield& yield) {
+        plugin->generator(yield, context);
+      },
+      boost::coroutines::attributes(kTableGeneratorStackSize),
+      boost::coroutines::protected_stack_allocator()));
+}
+
+QueryData TablePlugin::generateAll(QueryContext& request) {
+  QueryData results;
+  RowGenerator::pull_type source(
+      [this, &request](RowYield& yield) { generator(yield, request); },
+      boost::coroutines::attributes(kTableGeneratorStackSize),
+      boost::coroutines::protected_stack_allocator());
+  for (auto& r : source) {
+    results.push_back(std::move(r));
+  }
+  return results;
+}
+
 void TablePlugin::setContextFromRequest(const PluginRequest& request,
                                         QueryContext& context) {
   if (request.count("context") == 0) {
     return;
   }
 
+  if (request.count("encoding") > 0 &&
+      request.at("encoding") == kTableColumnarEncoding) {
+    // Read the binary context, see TablePlugin::setRequestFromContext.
+    EncodingReader reader(request.at("context"));
+    unsigned char version = 0;
+    unsigned long long columns = 0;
+    if (!reader.getByte(version) || version != kTableEncodingVersion ||
+        !reader.getVarint(columns)) {
+      return;
+    }
+
+    for (size_t i = 0; i < columns; i++) {
+      std::string column_name;
+      unsigned char affinity = 0;
+      unsigned long long count = 0;
+      if (!reader.getString(column_name) || !reader.getByte(affinity) ||
+          affinity > BLOB_TYPE || !reader.getVarint(count)) {
+        return;
+      }
+
+      auto& constraints = context.constraints[column_name];
+      constraints.affinity = static_cast<ColumnType>(affinity);
+      for (size_t j = 0; j < count; j++) {
+        unsigned char op = 0;
+        std::string expr;
+        if (!reader.getByte(op) || !reader.getString(expr)) {
+          return;
+        }
+        constraints.add(Constraint(op, expr));
+      }
+    }
+    return;
+  }
+
   // Read serialized context from PluginRequest.
   pt::ptree tree;
   try {
@@ -120,7 +305,19 @@ Status TablePlugin::call(const PluginRequest& request,
     if (request.count("context") > 0) {
       setContextFromRequest(request, context);
     }
-    response = generate(context);
+
+    if (request.count("encoding") > 0 &&
+        request.at("encoding") == kTableColumnarEncoding) {
+      // The core negotiated columnar results, see TablePlugin::routeInfo.
+      ColumnarQueryData results(columns());
+      generateColumnar(context, results);
+      std::string encoded;
+      results.serialize(encoded);
+      response.push_back(
+          {{"encoding", kTableColumnarEncoding}, {"results", encoded}});
+    } else {
+      response = generate(context);
+    }
   } else if (request.at("action") == "columns") {
     // The "columns" action returns a PluginRequest filled with column
     // information such as name and type.
@@ -164,33 +361,473 @@ PluginResponse TablePlugin::routeInfo() const {
   response.push_back(
       {{"id", "attributes"},
        {"attributes", INTEGER(static_cast<size_t>(attributes()))}});
+
+  // The core may request results, and send the context, using an encoding.
+  response.push_back(
+      {{"id", "encoding"}, {"encoding", kTableColumnarEncoding}});
   return response;
 }
 
-bool TablePlugin::isCached(size_t step) {
-  return (!FLAGS_disable_caching && step < last_cached_ + last_interval_);
+TableResultCache& TableResultCache::instance() {
+  static TableResultCache cache;
+  return cache;
 }
 
-QueryData TablePlugin::getCache() const {
-  VLOG(1) << "Retrieving results from cache for table: " << getName();
-  // Lookup results from database and deserialize.
-  std::string content;
-  getDatabaseValue(kQueries, "cache." + getName(), content);
-  QueryData results;
-  deserializeQueryDataJSON(content, results);
+size_t TableResultCache::getTTL(TableAttributes attributes) {
+  auto flags = static_cast<int>(attributes);
+  if (FLAGS_disable_caching ||
+      (flags & static_cast<int>(TableAttributes::CACHEABLE)) == 0 ||
+      (flags & static_cast<int>(TableAttributes::EVENT_BASED)) != 0) {
+    return 0;
+  }
+
+  auto ttl = static_cast<size_t>(FLAGS_table_cache_ttl);
+  if (TablePlugin::kCacheInterval > 0) {
+    ttl = std::min(ttl, TablePlugin::kCacheInterval);
+  }
+  return ttl;
+}
+
+std::string TableResultCache::getKey(const QueryContext& context) {
+  // The constraint map is ordered by column, each list is sorted.
+  std::string key;
+  for (const auto& list : context.constraints) {
+    if (list.second.getAll().empty()) {
+      continue;
+    }
+
+    std::vector<std::string> terms;
+    for (const auto& constraint : list.second.getAll()) {
+      terms.push_back(std::to_string(constraint.op) + " " + constraint.expr);
+    }
+    std::sort(terms.begin(), terms.end());
+    key += list.first;
+    for (const auto& term : terms) {
+      key += '\0' + term;
+    }
+    key += '\n';
+  }
+  return key;
+}
+
+std::shared_ptr<const ColumnarQueryData> TableResultCache::find(
+    const std::string& table, const std::string& key, size_t ttl) {
+  WriteLock lock(mutex_);
+  auto& stats = stats_[table];
+  auto entry = index_.find(table + '\n' + key);
+  if (entry == index_.end() || entry->second->time + ttl <= getUnixTime()) {
+    stats.misses++;
+    return nullptr;
+  }
+
+  stats.hits++;
+  entries_.splice(entries_.begin(), entries_, entry->second);
+  return entry->second->results;
+}
+
+void TableResultCache::insert(
+    const std::string& table,
+    const std::string& key,
+    std::shared_ptr<const ColumnarQueryData> results) {
+  auto capacity = getCapacity();
+  auto bytes = results->bytes() + table.size() + key.size();
+  if (bytes > capacity) {
+    return;
+  }
+
+  WriteLock lock(mutex_);
+  auto name = table + '\n' + key;
+  auto existing = index_.find(name);
+  if (existing != index_.end()) {
+    // Replace the stale results.
+    bytes_ -= existing->second->bytes;
+    stats_[table].entries--;
+    stats_[table].bytes -= existing->second->bytes;
+    entries_.erase(existing->second);
+    index_.erase(existing);
+  }
+
+  evict(capacity - bytes);
+  Entry entry;
+  entry.table = table;
+  entry.key = key;
+  entry.time = getUnixTime();
+  entry.bytes = bytes;
+  entry.results = std::move(results);
+  entries_.push_front(std::move(entry));
+  index_[name] = entries_.begin();
+
+  bytes_ += bytes;
+  auto& stats = stats_[table];
+  stats.entries++;
+  stats.bytes += bytes;
+}
+
+void TableResultCache::evict(size_t capacity) {
+  while (!entries_.empty() && bytes_ > capacity) {
+    const auto& oldest = entries_.back();
+    auto& stats = stats_[oldest.table];
+    stats.evictions++;
+    stats.entries--;
+    stats.bytes -= oldest.bytes;
+    bytes_ -= oldest.bytes;
+    index_.erase(oldest.table + '\n' + oldest.key);
+    entries_.pop_back();
+  }
+}
+
+void TableResultCache::clear() {
+  WriteLock lock(mutex_);
+  entries_.clear();
+  index_.clear();
+  bytes_ = 0;
+  for (auto& stats : stats_) {
+    stats.second.entries = 0;
+    stats.second.bytes = 0;
+  }
+}
+
+std::map<std::string, TableCacheStats> TableResultCache::getStats() const {
+  WriteLock lock(mutex_);
+  return stats_;
+}
+
+size_t TableResultCache::getCapacity() {
+  auto capacity = static_cast<size_t>(FLAGS_table_cache_size);
+  if (!FLAGS_disable_watchdog && FLAGS_watchdog_level >= 0) {
+    // The cache is resident in the worker, keep within the watchdog's limit.
+    capacity = std::min(capacity, getWorkerLimit(MEMORY_LIMIT) / 4);
+  }
+  return capacity * 1024 * 1024;
+}
+
+void ColumnarQueryData::reset(const TableColumns& columns) {
+  clear();
+  columns_.clear();
+  columns_.resize(columns.size());
+  for (size_t i = 0; i < columns.size(); i++) {
+    columns_[i].name = std::get<0>(columns[i]);
+    columns_[i].type = std::get<1>(columns[i]);
+  }
+}
+
+void ColumnarQueryData::clear() {
+  for (auto& column : columns_) {
+    column.integers.clear();
+    column.doubles.clear();
+    column.texts.clear();
+    column.nulls.clear();
+  }
+  strings_.clear();
+  rows_ = 0;
+}
+
+size_t ColumnarQueryData::addRow() {
+  for (auto& column : columns_) {
+    if (column.type == TEXT_TYPE) {
+      column.texts.push_back(nullptr);
+    } else if (column.type == DOUBLE_TYPE) {
+      column.doubles.push_back(0);
+    } else {
+      column.integers.push_back(0);
+    }
+    column.nulls.push_back(true);
+  }
+  return rows_++;
+}
+
+void ColumnarQueryData::reserve(size_t rows) {
+  for (auto& column : columns_) {
+    if (column.type == TEXT_TYPE) {
+      column.texts.reserve(rows);
+    } else if (column.type == DOUBLE_TYPE) {
+      column.doubles.reserve(rows);
+    } else {
+      column.integers.reserve(rows);
+    }
+    column.nulls.reserve(rows);
+  }
+}
+
+size_t ColumnarQueryData::columnIndex(const std::string& name) const {
+  for (size_t i = 0; i < columns_.size(); i++) {
+    if (columns_[i].name == name) {
+      return i;
+    }
+  }
+  return columns_.size();
+}
+
+void ColumnarQueryData::setInteger(size_t column, long long value) {
+  setInteger(rows_ - 1, column, value);
+}
+
+void ColumnarQueryData::setDouble(size_t column, double value) {
+  setDouble(rows_ - 1, column, value);
+}
+
+void ColumnarQueryData::setText(size_t column, const std::string& value) {
+  setText(rows_ - 1, column, value);
+}
+
+void ColumnarQueryData::setInteger(size_t row, size_t column, long long value) {
+  auto& cells = columns_[column];
+  if (cells.type == TEXT_TYPE) {
+    setText(row, column, std::to_string(value));
+    return;
+  } else if (cells.type == DOUBLE_TYPE) {
+    setDouble(row, column, static_cast<double>(value));
+    return;
+  } else if (cells.type == INTEGER_TYPE &&
+             (value < INT_MIN || value > INT_MAX)) {
+    return;
+  }
+  cells.integers[row] = value;
+  cells.nulls[row] = false;
+}
+
+void ColumnarQueryData::setDouble(size_t row, size_t column, double value) {
+  auto& cells = columns_[column];
+  if (cells.type != DOUBLE_TYPE) {
+    setText(row, column, DOUBLE(value));
+    return;
+  }
+  cells.doubles[row] = value;
+  cells.nulls[row] = false;
+}
+
+void ColumnarQueryData::setText(size_t row,
+                                size_t column,
+                                const std::string& value) {
+  auto& cells = columns_[column];
+  if (cells.type == TEXT_TYPE) {
+    cells.texts[row] = &(*strings_.insert(value).first);
+    cells.nulls[row] = false;
+  } else if (cells.type == INTEGER_TYPE) {
+    long afinite;
+    if (safeStrtol(value, 0, afinite) && afinite >= INT_MIN &&
+        afinite <= INT_MAX) {
+      cells.integers[row] = afinite;
+      cells.nulls[row] = false;
+    }
+  } else if (cells.type == BIGINT_TYPE || cells.type == UNSIGNED_BIGINT_TYPE) {
+    long long afinite;
+    if (safeStrtoll(value, 0, afinite)) {
+      cells.integers[row] = afinite;
+      cells.nulls[row] = false;
+    }
+  } else if (cells.type == DOUBLE_TYPE) {
+    char* end = nullptr;
+    double afinite = strtod(value.c_str(), &end);
+    if (end != nullptr && end != value.c_str() && *end == '\0') {
+      cells.doubles[row] = afinite;
+      cells.nulls[row] = false;
+    }
+  }
+}
+
+void ColumnarQueryData::append(const QueryData& rows) {
+  // Map each distinct column name once, rows usually share their columns.
+  std::unordered_map<std::string, size_t> ordinals;
+  for (size_t i = 0; i < columns_.size(); i++) {
+    ordinals.emplace(columns_[i].name, i);
+  }
+
+  reserve(rows_ + rows.size());
+  for (const auto& r : rows) {
+    addRow();
+    for (const auto& cell : r) {
+      auto ordinal = ordinals.find(cell.first);
+      if (ordinal != ordinals.end()) {
+        setText(ordinal->second, cell.second);
+      }
+    }
+  }
+}
+
+void ColumnarQueryData::append(const Row& r) {
+  addRow();
+  for (const auto& cell : r) {
+    auto ordinal = columnIndex(cell.first);
+    if (ordinal < columns_.size()) {
+      setText(ordinal, cell.second);
+    }
+  }
+}
+
+QueryData ColumnarQueryData::rows() const {
+  QueryData results(rows_);
+  for (const auto& column : columns_) {
+    if (column.type == UNKNOWN_TYPE) {
+      // Aliased columns are not included in generated rows.
+      continue;
+    }
+
+    for (size_t row = 0; row < rows_; row++) {
+      if (column.nulls[row]) {
+        continue;
+      } else if (column.type == TEXT_TYPE) {
+        results[row][column.name] = *column.texts[row];
+      } else if (column.type == DOUBLE_TYPE) {
+        results[row][column.name] = DOUBLE(column.doubles[row]);
+      } else {
+        results[row][column.name] = std::to_string(column.integers[row]);
+      }
+    }
+  }
   return results;
 }
 
-void TablePlugin::setCache(size_t step,
-                           size_t interval,
-                           const QueryData& results) {
-  // Serialize QueryData and save to database.
-  std::string content;
-  if (!FLAGS_disable_caching && serializeQueryDataJSON(results, content)) {
-    last_cached_ = step;
-    last_interval_ = interval;
-    setDatabaseValue(kQueries, "cache." + getName(), content);
+size_t ColumnarQueryData::bytes() const {
+  size_t bytes = sizeof(ColumnarQueryData);
+  for (const auto& column : columns_) {
+    bytes += sizeof(Column) + column.name.size();
+    bytes += column.integers.capacity() * sizeof(long long);
+    bytes += column.doubles.capacity() * sizeof(double);
+    bytes += column.texts.capacity() * sizeof(const std::string*);
+    bytes += column.nulls.capacity() / 8;
+  }
+  // Each interned string is a hash node with its own allocation.
+  for (const auto& text : strings_) {
+    bytes += sizeof(std::string) + sizeof(void*) * 2 + text.capacity();
+  }
+  return bytes;
+}
+
+void ColumnarQueryData::serialize(std::string& output) const {
+  output.push_back(static_cast<char>(kTableEncodingVersion));
+  putVarint(output, columns_.size());
+  for (const auto& column : columns_) {
+    putString(output, column.name);
+    output.push_back(static_cast<char>(column.type));
+  }
+
+  putVarint(output, rows_);
+  for (const auto& column : columns_) {
+    std::string nulls((rows_ + 7) / 8, '\0');
+    for (size_t row = 0; row < rows_; row++) {
+      if (column.nulls[row]) {
+        nulls[row / 8] |= static_cast<char>(1 << (row % 8));
+      }
+    }
+    output.append(nulls);
+
+    for (size_t row = 0; row < rows_; row++) {
+      if (column.nulls[row]) {
+        continue;
+      } else if (column.type == TEXT_TYPE) {
+        putString(output, *column.texts[row]);
+      } else if (column.type == DOUBLE_TYPE) {
+        unsigned long long bits = 0;
+        memcpy(&bits, &column.doubles[row], sizeof(bits));
+        for (size_t i = 0; i < sizeof(bits); i++) {
+          output.push_back(static_cast<char>((bits >> (i * 8)) & 0xff));
+        }
+      } else {
+        // Zigzag encoding keeps small negative integers short.
+        auto value = column.integers[row];
+        putVarint(output,
+                  (static_cast<unsigned long long>(value) << 1) ^
+                      static_cast<unsigned long long>(value >> 63));
+      }
+    }
+  }
+}
+
+Status ColumnarQueryData::deserialize(const std::string& input) {
+  EncodingReader reader(input);
+  unsigned char version = 0;
+  unsigned long long count = 0;
+  if (!reader.getByte(version) || version != kTableEncodingVersion ||
+      !reader.getVarint(count) || count > reader.remaining()) {
+    return Status(1, "Unsupported columnar encoding");
+  }
+
+  // Map each encoded column to an ordinal of this layout.
+  std::vector<std::pair<size_t, ColumnType>> encoded;
+  for (size_t i = 0; i < count; i++) {
+    std::string name;
+    unsigned char type = 0;
+    if (!reader.getString(name) || !reader.getByte(type) || type > BLOB_TYPE) {
+      return Status(1, "Invalid columnar encoding");
+    }
+    encoded.push_back(
+        std::make_pair(columnIndex(name), static_cast<ColumnType>(type)));
+  }
+
+  // Each encoded column includes a bitmap with a bit for every row.
+  unsigned long long rows = 0;
+  if (!reader.getVarint(rows) || rows / 8 > reader.remaining() ||
+      (count == 0 && rows > 0)) {
+    return Status(1, "Invalid columnar encoding");
+  }
+
+  auto first = rows_;
+  for (size_t row = 0; row < rows; row++) {
+    addRow();
+  }
+
+  // Remove the appended rows if the encoding is truncated or invalid.
+  auto invalid = ([this, first]() {
+    for (auto& column : columns_) {
+      column.integers.resize(std::min(column.integers.size(), first));
+      column.doubles.resize(std::min(column.doubles.size(), first));
+      column.texts.resize(std::min(column.texts.size(), first));
+      column.nulls.resize(first);
+    }
+    rows_ = first;
+    return Status(1, "Invalid columnar encoding");
+  });
+
+  // Cells are read column by column, into the appended rows.
+  for (const auto& column : encoded) {
+    const char* nulls = nullptr;
+    if (!reader.getBytes((rows + 7) / 8, nulls)) {
+      return invalid();
+    }
+
+    bool known = (column.first < columns_.size());
+    for (size_t row = 0; row < rows; row++) {
+      if (nulls[row / 8] & (1 << (row % 8))) {
+        continue;
+      } else if (column.second == TEXT_TYPE) {
+        std::string value;
+        if (!reader.getString(value)) {
+          return invalid();
+        }
+        if (known) {
+          setText(first + row, column.first, value);
+        }
+      } else if (column.second == DOUBLE_TYPE) {
+        const char* bytes = nullptr;
+        if (!reader.getBytes(sizeof(unsigned long long), bytes)) {
+          return invalid();
+        }
+        unsigned long long bits = 0;
+        for (size_t i = 0; i < sizeof(bits); i++) {
+          bits |= static_cast<unsigned long long>(
+                      static_cast<unsigned char>(bytes[i]))
+                  << (i * 8);
+        }
+        double value = 0;
+        memcpy(&value, &bits, sizeof(value));
+        if (known) {
+          setDouble(first + row, column.first, value);
+        }
+      } else {
+        unsigned long long value = 0;
+        if (!reader.getVarint(value)) {
+          return invalid();
+        }
+        if (known) {
+          setInteger(first + row,
+                     column.first,
+                     static_cast<long long>((value >> 1) ^ (~(value & 1) + 1)));
+        }
+      }
+    }
   }
+  return Status(0, "OK");
 }
 
 std::string columnDefinition(const TableColumns& columns) {
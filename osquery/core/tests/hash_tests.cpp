@@ -10,12 +10,16 @@
 
 #include <gtest/gtest.h>
 
+#include <osquery/database.h>
+#include <osquery/flags.h>
 #include <osquery/hash.h>
 
 #include "osquery/tests/test_util.h"
 
 namespace osquery {
 
+DECLARE_uint64(hash_cache_max);
+
 class HashTests : public testing::Test {};
 
 TEST_F(HashTests, test_algorithms) {
@@ -46,4 +50,66 @@ TEST_F(HashTests, test_file_hashing) {
   auto digest = hashFromFile(HASH_TYPE_MD5, kTestDataPath + "test_hashing.bin");
   EXPECT_EQ(digest, "88ee11f2aa7903f34b8b8785d92208b1");
 }
+
+TEST_F(HashTests, test_cached_hashes) {
+  auto hashes = hashMultiFromFile(HASH_TYPE_MD5 | HASH_TYPE_SHA256,
+                                  kTestDataPath + "test_hashing.bin");
+
+  MultiHashes cached;
+  EXPECT_FALSE(getCachedHashes("test.cached", "1", HASH_TYPE_MD5, cached));
+  setCachedHashes("test.cached", "1", hashes);
+  EXPECT_TRUE(getCachedHashes("test.cached", "1", HASH_TYPE_MD5, cached));
+  EXPECT_EQ(cached.md5, "88ee11f2aa7903f34b8b8785d92208b1");
+  EXPECT_EQ(cached.sha256, hashes.sha256);
+
+  // A changed version, or a hash type that was not cached, is not reused.
+  EXPECT_FALSE(getCachedHashes("test.cached", "2", HASH_TYPE_MD5, cached));
+  EXPECT_FALSE(getCachedHashes("test.cached", "1", HASH_TYPE_SHA1, cached));
+
+  // Unchanged files are hashed once, and return the same hashes.
+  auto path = kTestDataPath + "test_hashing.bin";
+  auto first = hashMultiFromFileCached(HASH_TYPE_MD5, path);
+  auto second = hashMultiFromFileCached(HASH_TYPE_MD5, path);
+  EXPECT_EQ(first.md5, "88ee11f2aa7903f34b8b8785d92208b1");
+  EXPECT_EQ(second.md5, first.md5);
+}
+
+TEST_F(HashTests, test_cached_hashes_eviction) {
+  auto hash_cache_max = FLAGS_hash_cache_max;
+  FLAGS_hash_cache_max = 10;
+
+  MultiHashes hashes;
+  hashes.mask = HASH_TYPE_MD5;
+  hashes.md5 = "88ee11f2aa7903f34b8b8785d92208b1";
+  for (size_t i = 0; i < 30; i++) {
+    setCachedHashes("test.evict." + std::to_string(i), "1", hashes);
+  }
+
+  // The oldest entries were evicted to keep the cache bounded.
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kHashes, keys, "entry.");
+  EXPECT_LE(keys.size(), 10U);
+
+  MultiHashes cached;
+  EXPECT_FALSE(getCachedHashes("test.evict.0", "1", HASH_TYPE_MD5, cached));
+  EXPECT_TRUE(getCachedHashes("test.evict.29", "1", HASH_TYPE_MD5, cached));
+  FLAGS_hash_cache_max = hash_cache_max;
+}
+
+TEST_F(HashTests, test_multiple_files) {
+  std::vector<std::string> paths = {
+      kTestDataPath + "test_hashing.bin",
+      kTestDataPath + "test_hashing_does_not_exist.bin",
+      kTestDataPath + "test_hashing.bin",
+  };
+
+  // Results are returned in the order of the input paths.
+  auto hashes = hashMultiFromFiles(HASH_TYPE_MD5 | HASH_TYPE_SHA1, paths);
+  ASSERT_EQ(hashes.size(), 3U);
+  EXPECT_EQ(hashes[0].md5, "88ee11f2aa7903f34b8b8785d92208b1");
+  EXPECT_EQ(hashes[0].sha1,
+            hashFromFile(HASH_TYPE_SHA1, kTestDataPath + "test_hashing.bin"));
+  EXPECT_EQ(hashes[2].md5, hashes[0].md5);
+  EXPECT_NE(hashes[1].md5, hashes[0].md5);
+}
 }
@@ -121,6 +121,20 @@ TEST_F(ProcessTests, test_envVar) {
   EXPECT_FALSE(val.is_initialized());
 }
 
+TEST_F(ProcessTests, test_getResourceUsage) {
+  ResourceUsage u0;
+  ASSERT_TRUE(getResourceUsage(u0));
+  EXPECT_GT(u0.resident_size, 0U);
+  EXPECT_GE(u0.peak_resident_size, u0.resident_size);
+
+  // Spin this thread such that its CPU time advances.
+  ResourceUsage u1;
+  do {
+    ASSERT_TRUE(getResourceUsage(u1));
+  } while (u1.cpu_time == u0.cpu_time);
+  EXPECT_GT(u1.cpu_time, u0.cpu_time);
+}
+
 TEST_F(ProcessTests, test_launchExtension) {
   {
     std::shared_ptr<osquery::PlatformProcess> process =
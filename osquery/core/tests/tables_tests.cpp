@@ -10,10 +10,13 @@
 
 #include <gtest/gtest.h>
 
+#include <osquery/flags.h>
 #include <osquery/tables.h>
 
 namespace osquery {
 
+DECLARE_uint64(table_cache_size);
+
 class TablesTests : public testing::Test {};
 
 TEST_F(TablesTests, test_constraint) {
@@ -129,39 +132,256 @@ TEST_F(TablesTests, test_constraint_map) {
   EXPECT_TRUE(cm["path"].existsAndMatches("some"));
 }
 
-class TestTablePlugin : public TablePlugin {
- public:
-  void testSetCache(size_t step, size_t interval) {
-    QueryData r;
-    setCache(step, interval, r);
+TEST_F(TablesTests, test_cache_ttl) {
+  auto interval = TablePlugin::kCacheInterval;
+  TablePlugin::kCacheInterval = 0;
+
+  // Only cacheable tables, that are not event-based, are cached.
+  EXPECT_EQ(TableResultCache::getTTL(TableAttributes::NONE), 0U);
+  EXPECT_EQ(TableResultCache::getTTL(TableAttributes::CACHEABLE), 60U);
+  EXPECT_EQ(TableResultCache::getTTL(TableAttributes::CACHEABLE |
+                                     TableAttributes::EVENT_BASED),
+            0U);
+
+  // A scheduled query does not reuse results older than its interval.
+  TablePlugin::kCacheInterval = 5;
+  EXPECT_EQ(TableResultCache::getTTL(TableAttributes::CACHEABLE), 5U);
+  TablePlugin::kCacheInterval = interval;
+}
+
+TEST_F(TablesTests, test_cache_key) {
+  QueryContext empty;
+  EXPECT_TRUE(TableResultCache::getKey(empty).empty());
+
+  // Tables may filter on any constrained column, not only indexes.
+  QueryContext filtered;
+  filtered.constraints["size"].add(Constraint(EQUALS, "1"));
+  EXPECT_FALSE(TableResultCache::getKey(filtered).empty());
+
+  // The order of constraints does not change the key.
+  QueryContext first;
+  first.constraints["path"].add(Constraint(EQUALS, "/a"));
+  first.constraints["path"].add(Constraint(EQUALS, "/b"));
+  QueryContext second;
+  second.constraints["path"].add(Constraint(EQUALS, "/b"));
+  second.constraints["path"].add(Constraint(EQUALS, "/a"));
+  auto key = TableResultCache::getKey(first);
+  EXPECT_FALSE(key.empty());
+  EXPECT_EQ(key, TableResultCache::getKey(second));
+
+  second.constraints["size"].add(Constraint(EQUALS, "2"));
+  EXPECT_NE(key, TableResultCache::getKey(second));
+
+  QueryContext other;
+  other.constraints["path"].add(Constraint(EQUALS, "/a"));
+  EXPECT_NE(key, TableResultCache::getKey(other));
+}
+
+/// Create results of a single TEXT column with about bytes of text.
+static std::shared_ptr<ColumnarQueryData> getCacheResults(size_t bytes) {
+  auto results = std::make_shared<ColumnarQueryData>(TableColumns{
+      std::make_tuple("t", TEXT_TYPE, ColumnOptions::DEFAULT)});
+  for (size_t i = 0; i < bytes / 1024; i++) {
+    results->addRow();
+    results->setText(0, std::to_string(i) + std::string(1024, 'x'));
   }
+  return results;
+}
 
-  bool testIsCached(size_t interval) { return isCached(interval); }
-};
+TEST_F(TablesTests, test_cache) {
+  TableResultCache cache;
+  EXPECT_EQ(cache.find("test_table", "", 10), nullptr);
 
-TEST_F(TablesTests, test_caching) {
-  TestTablePlugin test;
-  // By default the interval and step is 0, so a step of 5 will not be cached.
-  EXPECT_FALSE(test.testIsCached(5));
+  auto results = getCacheResults(1024);
+  cache.insert("test_table", "", results);
+  EXPECT_EQ(cache.find("test_table", "", 10), results);
+  EXPECT_EQ(cache.find("test_table", "other", 10), nullptr);
 
-  TablePlugin::kCacheInterval = 5;
-  TablePlugin::kCacheStep = 1;
-  EXPECT_FALSE(test.testIsCached(5));
-  // Set the current time to 1, and the interval at 5.
-  test.testSetCache(TablePlugin::kCacheStep, TablePlugin::kCacheInterval);
-  // Time at 1 is cached for an interval of 5, so at time 5 the cache is fresh.
-  EXPECT_TRUE(test.testIsCached(5));
-  // 6 is the end of the cache, it is not fresh.
-  EXPECT_FALSE(test.testIsCached(6));
-  // 7 is past the cache, it is not fresh.
-  EXPECT_FALSE(test.testIsCached(7));
-
-  // Set the time at now to 2.
-  TablePlugin::kCacheStep = 2;
-  test.testSetCache(TablePlugin::kCacheStep, TablePlugin::kCacheInterval);
-  EXPECT_TRUE(test.testIsCached(5));
-  // Now 6 is within the freshness of 2 + 5.
-  EXPECT_TRUE(test.testIsCached(6));
-  EXPECT_FALSE(test.testIsCached(7));
+  // Results are fresh for less than the requested time-to-live.
+  EXPECT_EQ(cache.find("test_table", "", 0), nullptr);
+
+  auto stats = cache.getStats()["test_table"];
+  EXPECT_EQ(stats.hits, 1U);
+  EXPECT_EQ(stats.misses, 3U);
+  EXPECT_EQ(stats.entries, 1U);
+  EXPECT_GE(stats.bytes, 1024U);
+
+  cache.clear();
+  EXPECT_EQ(cache.find("test_table", "", 10), nullptr);
+  EXPECT_EQ(cache.getStats()["test_table"].entries, 0U);
+}
+
+TEST_F(TablesTests, test_cache_eviction) {
+  auto size = FLAGS_table_cache_size;
+  FLAGS_table_cache_size = 1;
+
+  // Two result sets do not fit within a megabyte.
+  TableResultCache cache;
+  cache.insert("test_table", "1", getCacheResults(600 * 1024));
+  cache.insert("test_table", "2", getCacheResults(600 * 1024));
+  EXPECT_EQ(cache.find("test_table", "1", 10), nullptr);
+  EXPECT_NE(cache.find("test_table", "2", 10), nullptr);
+
+  auto stats = cache.getStats()["test_table"];
+  EXPECT_EQ(stats.evictions, 1U);
+  EXPECT_EQ(stats.entries, 1U);
+  EXPECT_LE(stats.bytes, TableResultCache::getCapacity());
+  FLAGS_table_cache_size = size;
+}
+
+TEST_F(TablesTests, test_columnar_query_data) {
+  ColumnarQueryData data({
+      std::make_tuple("i", INTEGER_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("b", BIGINT_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("d", DOUBLE_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("t", TEXT_TYPE, ColumnOptions::DEFAULT),
+  });
+  EXPECT_EQ(data.columns(), 4U);
+  EXPECT_EQ(data.columnIndex("t"), 3U);
+  EXPECT_EQ(data.columnIndex("none"), 4U);
+
+  data.addRow();
+  data.setInteger(0, 1);
+  data.setInteger(1, 1LL << 40);
+  data.setDouble(2, 0.5);
+  data.setText(3, "text");
+  EXPECT_EQ(data.getInteger(0, 0), 1);
+  EXPECT_EQ(data.getInteger(0, 1), 1LL << 40);
+  EXPECT_EQ(data.getDouble(0, 2), 0.5);
+  EXPECT_EQ(data.getText(0, 3), "text");
+
+  // The compatibility adapter types each cell once.
+  data.append(
+      QueryData{{{"i", "2"}, {"b", "invalid"}, {"t", "text"}, {"x", "1"}}});
+  ASSERT_EQ(data.size(), 2U);
+  EXPECT_EQ(data.getInteger(1, 0), 2);
+  EXPECT_TRUE(data.isNull(1, 1));
+  EXPECT_TRUE(data.isNull(1, 2));
+  // Interned TEXT cells share storage.
+  EXPECT_EQ(&data.getText(0, 3), &data.getText(1, 3));
+
+  // Rows are converted back without NULL cells.
+  auto rows = data.rows();
+  ASSERT_EQ(rows.size(), 2U);
+  EXPECT_EQ(rows[0]["b"], "1099511627776");
+  EXPECT_EQ(rows[1], Row({{"i", "2"}, {"t", "text"}}));
+
+  data.clear();
+  EXPECT_EQ(data.size(), 0U);
+  EXPECT_EQ(data.columns(), 4U);
+}
+
+TEST_F(TablesTests, test_columnar_encoding) {
+  ColumnarQueryData data({
+      std::make_tuple("i", INTEGER_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("b", BIGINT_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("d", DOUBLE_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("t", TEXT_TYPE, ColumnOptions::DEFAULT),
+  });
+  data.addRow();
+  data.setInteger(0, -1);
+  data.setInteger(1, 1LL << 40);
+  data.setDouble(2, -0.25);
+  data.setText(3, std::string("te\0xt", 5));
+  data.addRow();
+  data.setText(3, "");
+
+  std::string encoded;
+  data.serialize(encoded);
+
+  // Columns are matched by name, types are converted, unknown are dropped.
+  ColumnarQueryData results({
+      std::make_tuple("t", TEXT_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("i", TEXT_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("b", BIGINT_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("d", DOUBLE_TYPE, ColumnOptions::DEFAULT),
+  });
+  ASSERT_TRUE(results.deserialize(encoded).ok());
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_EQ(results.getText(0, 0), std::string("te\0xt", 5));
+  EXPECT_EQ(results.getText(0, 1), "-1");
+  EXPECT_EQ(results.getInteger(0, 2), 1LL << 40);
+  EXPECT_EQ(results.getDouble(0, 3), -0.25);
+  EXPECT_EQ(results.getText(1, 0), "");
+  EXPECT_TRUE(results.isNull(1, 1));
+  EXPECT_TRUE(results.isNull(1, 2));
+
+  // Invalid or truncated encodings do not append rows.
+  EXPECT_FALSE(results.deserialize("").ok());
+  EXPECT_FALSE(results.deserialize(encoded.substr(0, encoded.size() - 1)).ok());
+  EXPECT_EQ(results.size(), 2U);
+}
+
+TEST_F(TablesTests, test_binary_context) {
+  QueryContext context;
+  context.constraints["path"].affinity = TEXT_TYPE;
+  context.constraints["path"].add(Constraint(EQUALS, "/etc/hosts"));
+  context.constraints["path"].add(Constraint(LIKE, "/etc/%"));
+  context.constraints["size"].affinity = BIGINT_TYPE;
+  context.constraints["size"].add(Constraint(GREATER_THAN, "100"));
+
+  PluginRequest request = {{"action", "generate"},
+                           {"encoding", kTableColumnarEncoding}};
+  TablePlugin::setRequestFromContext(context, request);
+
+  QueryContext decoded;
+  TablePlugin::setContextFromRequest(request, decoded);
+  ASSERT_EQ(decoded.constraints.size(), 2U);
+  EXPECT_EQ(decoded.constraints["path"].getAll(EQUALS),
+            std::set<std::string>({"/etc/hosts"}));
+  EXPECT_EQ(decoded.constraints["path"].getAll(LIKE),
+            std::set<std::string>({"/etc/%"}));
+  EXPECT_EQ(decoded.constraints["size"].affinity, BIGINT_TYPE);
+  EXPECT_TRUE(decoded.constraints["size"].matches<long long>(101));
+  EXPECT_FALSE(decoded.constraints["size"].matches<long long>(100));
+}
+
+class columnarTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("size", BIGINT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  QueryData generate(QueryContext& context) override {
+    QueryData results;
+    for (const auto& name : context.constraints["name"].getAll(EQUALS)) {
+      results.push_back({{"name", name}, {"size", "10"}});
+    }
+    return results;
+  }
+};
+
+TEST_F(TablesTests, test_columnar_table_call) {
+  auto table = std::make_shared<columnarTablePlugin>();
+
+  QueryContext context;
+  context.constraints["name"].add(Constraint(EQUALS, "first"));
+  context.constraints["name"].add(Constraint(EQUALS, "second"));
+
+  // Without the encoding the table responds with rows.
+  PluginRequest request = {{"action", "generate"}};
+  TablePlugin::setRequestFromContext(context, request);
+  PluginResponse response;
+  EXPECT_TRUE(table->call(request, response).ok());
+  EXPECT_EQ(response.size(), 2U);
+
+  request = {{"action", "generate"}, {"encoding", kTableColumnarEncoding}};
+  TablePlugin::setRequestFromContext(context, request);
+  EXPECT_TRUE(table->call(request, response).ok());
+  ASSERT_EQ(response.size(), 1U);
+  EXPECT_EQ(response[0]["encoding"], kTableColumnarEncoding);
+
+  ColumnarQueryData results({
+      std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("size", BIGINT_TYPE, ColumnOptions::DEFAULT),
+  });
+  EXPECT_TRUE(results.deserialize(response[0]["results"]).ok());
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_EQ(results.getText(0, 0), "first");
+  EXPECT_EQ(results.getText(1, 0), "second");
+  EXPECT_EQ(results.getInteger(1, 1), 10);
 }
 }
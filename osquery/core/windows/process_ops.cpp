@@ -13,6 +13,7 @@
 #include <Windows.h>
 // clang-format off
 #include <LM.h>
+#include <psapi.h>
 // clang-format on
 
 #include <string>
@@ -187,4 +188,32 @@ bool isUserAdmin() {
 int platformGetPid() {
   return (int)GetCurrentProcessId();
 }
+
+/// Convert a FILETIME interval, in 100 nanosecond units, to nanoseconds.
+static unsigned long long int getFileTimeNanos(const FILETIME& ft) {
+  ULARGE_INTEGER time;
+  time.LowPart = ft.dwLowDateTime;
+  time.HighPart = ft.dwHighDateTime;
+  return time.QuadPart * 100ULL;
+}
+
+bool getResourceUsage(ResourceUsage& usage) {
+  FILETIME creation, exit, kernel, user;
+  if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+    return false;
+  }
+
+  auto user_nanos = getFileTimeNanos(user);
+  auto kernel_nanos = getFileTimeNanos(kernel);
+  usage.user_time = user_nanos / 1000000ULL;
+  usage.system_time = kernel_nanos / 1000000ULL;
+  usage.cpu_time = user_nanos + kernel_nanos;
+
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    usage.resident_size = counters.WorkingSetSize;
+    usage.peak_resident_size = counters.PeakWorkingSetSize;
+  }
+  return true;
+}
 }
@@ -63,7 +63,33 @@ static void DATABASE_diff(benchmark::State& state) {
   }
 }
 
-BENCHMARK(DATABASE_diff)->ArgPair(1, 1)->ArgPair(10, 10)->ArgPair(10, 100);
+BENCHMARK(DATABASE_diff)
+    ->ArgPair(1, 1)
+    ->ArgPair(10, 10)
+    ->ArgPair(10, 100)
+    ->ArgPair(10, 10000)
+    ->ArgPair(10, 100000);
+
+static void DATABASE_diff_changes(benchmark::State& state) {
+  // Each row is unique, and 1% of the rows change between executions.
+  auto old_qd = getExampleQueryData(state.range_x(), state.range_y());
+  for (size_t i = 0; i < old_qd.size(); i++) {
+    old_qd[i]["id"] = std::to_string(i);
+  }
+  auto current_qd = old_qd;
+  for (size_t i = 0; i < current_qd.size(); i += 100) {
+    current_qd[i]["id"] = "changed";
+  }
+
+  while (state.KeepRunning()) {
+    auto d = diff(old_qd, current_qd);
+  }
+}
+
+BENCHMARK(DATABASE_diff_changes)
+    ->ArgPair(10, 100)
+    ->ArgPair(10, 10000)
+    ->ArgPair(10, 100000);
 
 static void DATABASE_query_results(benchmark::State& state) {
   auto qd = getExampleQueryData(state.range_x(), state.range_y());
@@ -8,11 +8,13 @@
  *
  */
 
-#include <set>
+#include <algorithm>
+#include <unordered_map>
 
 #include <boost/lexical_cast.hpp>
 
 #include <osquery/database.h>
+#include <osquery/hash.h>
 #include <osquery/logger.h>
 
 #include "osquery/core/json.h"
@@ -46,9 +48,10 @@ const std::string kPersistentSettings = "configurations";
 const std::string kQueries = "queries";
 const std::string kEvents = "events";
 const std::string kLogs = "logs";
+const std::string kHashes = "hashes";
 
-const std::vector<std::string> kDomains = {kPersistentSettings, kQueries,
-                                           kEvents, kLogs};
+const std::vector<std::string> kDomains = {
+    kPersistentSettings, kQueries, kEvents, kLogs, kHashes};
 
 bool DatabasePlugin::kDBHandleOptionAllowOpen(false);
 bool DatabasePlugin::kDBHandleOptionRequireWrite(false);
@@ -214,26 +217,117 @@ Status serializeDiffResultsJSON(const DiffResults& d, std::string& json) {
   return Status(0, "OK");
 }
 
+/// FNV-1a 64-bit offset basis and prime.
+const RowHash kRowHashBasis = 14695981039346656037ULL;
+const RowHash kRowHashPrime = 1099511628211ULL;
+
+static inline void hashBytes(RowHash& h, const std::string& s) {
+  // Mix in the length first so column name and value boundaries are kept.
+  auto length = s.size();
+  for (size_t i = 0; i < sizeof(length); i++) {
+    h = (h ^ ((length >> (i * 8)) & 0xff)) * kRowHashPrime;
+  }
+  for (const auto& c : s) {
+    h = (h ^ static_cast<unsigned char>(c)) * kRowHashPrime;
+  }
+}
+
+RowHash hashRow(const Row& r) {
+  RowHash h = kRowHashBasis;
+  // A Row is an ordered map, the iteration order is stable for equal rows.
+  for (const auto& column : r) {
+    hashBytes(h, column.first);
+    hashBytes(h, column.second);
+  }
+  return h;
+}
+
+static inline void appendBytes(std::string& content, const std::string& s) {
+  // The same length-prefixed encoding as hashBytes.
+  auto length = s.size();
+  for (size_t i = 0; i < sizeof(length); i++) {
+    content += static_cast<char>((length >> (i * 8)) & 0xff);
+  }
+  content += s;
+}
+
+RowHash fingerprintRow(const Row& r, const std::string& key) {
+  std::string content = key;
+  for (const auto& column : r) {
+    appendBytes(content, column.first);
+    appendBytes(content, column.second);
+  }
+
+  auto digest =
+      hashFromBuffer(HASH_TYPE_SHA256, content.data(), content.size());
+  return std::stoull(digest.substr(0, sizeof(RowHash) * 2), nullptr, 16);
+}
+
+namespace {
+
+/// A distinct previous row and the number of times it was seen.
+struct DiffEntry {
+  const Row* row;
+  size_t count;
+};
+
+/// Previous rows bucketed by fingerprint, buckets only grow on collisions.
+using DiffIndex = std::unordered_map<RowHash, std::vector<DiffEntry>>;
+
+inline DiffEntry* findDiffEntry(DiffIndex& index, RowHash h, const Row& r) {
+  auto bucket = index.find(h);
+  if (bucket == index.end()) {
+    return nullptr;
+  }
+  for (auto& entry : bucket->second) {
+    if (*entry.row == r) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+}
+
 DiffResults diff(const QueryData& old, const QueryData& current) {
   DiffResults r;
-  QueryData overlap;
 
-  for (const auto& i : current) {
-    auto item = std::find(old.begin(), old.end(), i);
-    if (item != old.end()) {
-      overlap.push_back(i);
+  // Fingerprint each previous row once, and count duplicates.
+  std::vector<RowHash> old_hashes;
+  old_hashes.reserve(old.size());
+  DiffIndex index;
+  index.reserve(old.size());
+  for (const auto& row : old) {
+    auto h = hashRow(row);
+    old_hashes.push_back(h);
+    auto entry = findDiffEntry(index, h, row);
+    if (entry != nullptr) {
+      entry->count++;
     } else {
-      r.added.push_back(i);
+      index[h].push_back({&row, 1});
     }
   }
 
-  std::multiset<Row> overlap_set(overlap.begin(), overlap.end());
-  std::multiset<Row> old_set(old.begin(), old.end());
-  std::set_difference(old_set.begin(),
-                      old_set.end(),
-                      overlap_set.begin(),
-                      overlap_set.end(),
-                      std::back_inserter(r.removed));
+  // Rows unknown to the previous set are added, the others consume a count.
+  // A current row repeated more often than its previous row still overlaps.
+  for (const auto& row : current) {
+    auto entry = findDiffEntry(index, hashRow(row), row);
+    if (entry == nullptr) {
+      r.added.push_back(row);
+    } else if (entry->count > 0) {
+      entry->count--;
+    }
+  }
+
+  // Previous rows with remaining counts were removed.
+  for (size_t i = 0; i < old.size(); i++) {
+    auto entry = findDiffEntry(index, old_hashes[i], old[i]);
+    if (entry->row == &old[i]) {
+      // Emit the remaining count at the first occurrence of the row.
+      for (size_t j = 0; j < entry->count; j++) {
+        r.removed.push_back(old[i]);
+      }
+    }
+  }
   return r;
 }
 
@@ -480,11 +574,96 @@ Status DatabasePlugin::call(const PluginRequest& request,
       response.push_back({{"k", k}});
     }
     return status;
+  } else if (request.at("action") == "scanRange") {
+    if (request.count("low") == 0 || request.count("high") == 0) {
+      return Status(1, "Database plugin range actions require low and high");
+    }
+    size_t max = 0;
+    if (request.count("max") > 0) {
+      max = std::stoul(request.at("max"));
+    }
+    DatabaseStringValueList data;
+    auto status = this->scanRange(
+        domain, request.at("low"), request.at("high"), data, max);
+    for (auto& item : data) {
+      response.push_back({{"k", std::move(item.first)},
+                          {"v", std::move(item.second)}});
+    }
+    return status;
+  } else if (request.at("action") == "removeRange") {
+    if (request.count("low") == 0 || request.count("high") == 0) {
+      return Status(1, "Database plugin range actions require low and high");
+    }
+    return this->removeRange(domain, request.at("low"), request.at("high"));
   }
 
   return Status(1, "Unknown database plugin action");
 }
 
+Status DatabasePlugin::putBatch(const std::string& domain,
+                                const DatabaseStringValueList& data) {
+  for (const auto& item : data) {
+    auto status = this->put(domain, item.first, item.second);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status(0, "OK");
+}
+
+Status DatabasePlugin::removeBatch(const std::string& domain,
+                                   const std::vector<std::string>& keys) {
+  for (const auto& key : keys) {
+    auto status = this->remove(domain, key);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status(0, "OK");
+}
+
+Status DatabasePlugin::scanRange(const std::string& domain,
+                                 const std::string& low,
+                                 const std::string& high,
+                                 DatabaseStringValueList& results,
+                                 size_t max) const {
+  std::vector<std::string> keys;
+  auto status = this->scan(domain, keys, "");
+  if (!status.ok()) {
+    return status;
+  }
+
+  std::sort(keys.begin(), keys.end());
+  auto it = std::lower_bound(keys.begin(), keys.end(), low);
+  for (; it != keys.end() && *it < high; ++it) {
+    std::string value;
+    if (this->get(domain, *it, value).ok()) {
+      results.emplace_back(std::move(*it), std::move(value));
+      if (max > 0 && results.size() >= max) {
+        break;
+      }
+    }
+  }
+  return Status(0, "OK");
+}
+
+Status DatabasePlugin::removeRange(const std::string& domain,
+                                   const std::string& low,
+                                   const std::string& high) {
+  std::vector<std::string> keys;
+  auto status = this->scan(domain, keys, "");
+  if (!status.ok()) {
+    return status;
+  }
+
+  for (const auto& key : keys) {
+    if (key >= low && key < high) {
+      this->remove(domain, key);
+    }
+  }
+  return Status(0, "OK");
+}
+
 static inline std::shared_ptr<DatabasePlugin> getDatabasePlugin() {
   if (!Registry::exists("database", Registry::getActive("database"), true)) {
     return nullptr;
@@ -532,6 +711,23 @@ Status setDatabaseValue(const std::string& domain,
   }
 }
 
+Status setDatabaseBatch(const std::string& domain,
+                        const DatabaseStringValueList& data) {
+  if (Registry::external()) {
+    // Extensions forward each value, the core owns the batch primitive.
+    for (const auto& item : data) {
+      auto status = setDatabaseValue(domain, item.first, item.second);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    return Status(0, "OK");
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->putBatch(domain, data);
+  }
+}
+
 Status deleteDatabaseValue(const std::string& domain, const std::string& key) {
   if (Registry::external()) {
     // External registries (extensions) do not have databases active.
@@ -545,6 +741,23 @@ Status deleteDatabaseValue(const std::string& domain, const std::string& key) {
   }
 }
 
+Status deleteDatabaseBatch(const std::string& domain,
+                           const std::vector<std::string>& keys) {
+  if (Registry::external()) {
+    // Extensions forward each key, the core owns the batch primitive.
+    for (const auto& key : keys) {
+      auto status = deleteDatabaseValue(domain, key);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    return Status(0, "OK");
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->removeBatch(domain, keys);
+  }
+}
+
 Status scanDatabaseKeys(const std::string& domain,
                         std::vector<std::string>& keys,
                         size_t max) {
@@ -578,6 +791,51 @@ Status scanDatabaseKeys(const std::string& domain,
   }
 }
 
+Status scanDatabaseRange(const std::string& domain,
+                         const std::string& low,
+                         const std::string& high,
+                         DatabaseStringValueList& results,
+                         size_t max) {
+  if (Registry::external()) {
+    // External registries (extensions) do not have databases active.
+    // It is not possible to use an extension-based database.
+    PluginRequest request = {{"action", "scanRange"},
+                             {"domain", domain},
+                             {"low", low},
+                             {"high", high},
+                             {"max", std::to_string(max)}};
+    PluginResponse response;
+    auto status = Registry::call("database", request, response);
+
+    for (auto& item : response) {
+      if (item.count("k") > 0 && item.count("v") > 0) {
+        results.emplace_back(std::move(item["k"]), std::move(item["v"]));
+      }
+    }
+    return status;
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->scanRange(domain, low, high, results, max);
+  }
+}
+
+Status deleteDatabaseRange(const std::string& domain,
+                           const std::string& low,
+                           const std::string& high) {
+  if (Registry::external()) {
+    // External registries (extensions) do not have databases active.
+    // It is not possible to use an extension-based database.
+    PluginRequest request = {{"action", "removeRange"},
+                             {"domain", domain},
+                             {"low", low},
+                             {"high", high}};
+    return Registry::call("database", request);
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->removeRange(domain, low, high);
+  }
+}
+
 void dumpDatabase() {
   for (const auto& domain : kDomains) {
     std::vector<std::string> keys;
@@ -38,6 +38,18 @@ class EphemeralDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               size_t max = 0) const override;
 
+  /// Ordered key/value range lookup method.
+  Status scanRange(const std::string& domain,
+                   const std::string& low,
+                   const std::string& high,
+                   DatabaseStringValueList& results,
+                   size_t max = 0) const override;
+
+  /// Range removal method.
+  Status removeRange(const std::string& domain,
+                     const std::string& low,
+                     const std::string& high) override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override {
@@ -97,4 +109,36 @@ Status EphemeralDatabasePlugin::scan(const std::string& domain,
   }
   return Status(0);
 }
+
+Status EphemeralDatabasePlugin::scanRange(const std::string& domain,
+                                          const std::string& low,
+                                          const std::string& high,
+                                          DatabaseStringValueList& results,
+                                          size_t max) const {
+  if (db_.count(domain) == 0) {
+    return Status(0);
+  }
+
+  const auto& keys = db_.at(domain);
+  for (auto it = keys.lower_bound(low); it != keys.end() && it->first < high;
+       ++it) {
+    results.push_back(*it);
+    if (max > 0 && results.size() >= max) {
+      break;
+    }
+  }
+  return Status(0);
+}
+
+Status EphemeralDatabasePlugin::removeRange(const std::string& domain,
+                                            const std::string& low,
+                                            const std::string& high) {
+  if (!(low < high)) {
+    return Status(0);
+  }
+
+  auto& keys = db_[domain];
+  keys.erase(keys.lower_bound(low), keys.lower_bound(high));
+  return Status(0);
+}
 }
@@ -17,6 +17,7 @@
 #include <rocksdb/db.h>
 #include <rocksdb/env.h>
 #include <rocksdb/options.h>
+#include <rocksdb/write_batch.h>
 
 #include <osquery/database.h>
 #include <osquery/filesystem.h>
@@ -47,15 +48,35 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
              const std::string& key,
              const std::string& value) override;
 
+  /// Batched data storage method, applied atomically.
+  Status putBatch(const std::string& domain,
+                  const DatabaseStringValueList& data) override;
+
   /// Data removal method.
   Status remove(const std::string& domain, const std::string& k) override;
 
+  /// Batched data removal method, applied atomically.
+  Status removeBatch(const std::string& domain,
+                     const std::vector<std::string>& keys) override;
+
   /// Key/index lookup method.
   Status scan(const std::string& domain,
               std::vector<std::string>& results,
               const std::string& prefix,
               size_t max = 0) const override;
 
+  /// Ordered key/value range lookup method.
+  Status scanRange(const std::string& domain,
+                   const std::string& low,
+                   const std::string& high,
+                   DatabaseStringValueList& results,
+                   size_t max = 0) const override;
+
+  /// Range removal method, applied atomically.
+  Status removeRange(const std::string& domain,
+                     const std::string& low,
+                     const std::string& high) override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override;
@@ -297,6 +318,31 @@ Status RocksDBDatabasePlugin::put(const std::string& domain,
   return Status(s.code(), s.ToString());
 }
 
+Status RocksDBDatabasePlugin::putBatch(const std::string& domain,
+                                       const DatabaseStringValueList& data) {
+  if (read_only_) {
+    return Status(0, "Database in readonly mode");
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+
+  rocksdb::WriteBatch batch;
+  for (const auto& item : data) {
+    batch.Put(cfh, item.first, item.second);
+  }
+
+  auto options = rocksdb::WriteOptions();
+  // Events should be fast, and do not need to force syncs.
+  if (kEvents != domain) {
+    options.sync = true;
+  }
+  auto s = getDB()->Write(options, &batch);
+  return Status(s.code(), s.ToString());
+}
+
 Status RocksDBDatabasePlugin::remove(const std::string& domain,
                                      const std::string& key) {
   if (read_only_) {
@@ -318,6 +364,30 @@ Status RocksDBDatabasePlugin::remove(const std::string& domain,
   return Status(s.code(), s.ToString());
 }
 
+Status RocksDBDatabasePlugin::removeBatch(
+    const std::string& domain, const std::vector<std::string>& keys) {
+  if (read_only_) {
+    return Status(0, "Database in readonly mode");
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+
+  rocksdb::WriteBatch batch;
+  for (const auto& key : keys) {
+    batch.Delete(cfh, key);
+  }
+
+  auto options = rocksdb::WriteOptions();
+  if (kEvents != domain) {
+    options.sync = true;
+  }
+  auto s = getDB()->Write(options, &batch);
+  return Status(s.code(), s.ToString());
+}
+
 Status RocksDBDatabasePlugin::scan(const std::string& domain,
                                    std::vector<std::string>& results,
                                    const std::string& prefix,
@@ -338,17 +408,85 @@ Status RocksDBDatabasePlugin::scan(const std::string& domain,
     return Status(1, "Could not get iterator for " + domain);
   }
 
+  // Keys are ordered, all prefixed keys follow the first match.
   size_t count = 0;
-  for (it->SeekToFirst(); it->Valid(); it->Next()) {
-    auto key = it->key().ToString();
-    if (key.find(prefix) == 0) {
-      results.push_back(std::move(key));
-      if (max > 0 && ++count >= max) {
-        break;
-      }
+  for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);
+       it->Next()) {
+    results.push_back(it->key().ToString());
+    if (max > 0 && ++count >= max) {
+      break;
+    }
+  }
+  delete it;
+  return Status(0, "OK");
+}
+
+Status RocksDBDatabasePlugin::scanRange(const std::string& domain,
+                                        const std::string& low,
+                                        const std::string& high,
+                                        DatabaseStringValueList& results,
+                                        size_t max) const {
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+  auto options = rocksdb::ReadOptions();
+  options.verify_checksums = false;
+  rocksdb::Slice upper(high);
+  auto it = getDB()->NewIterator(options, cfh);
+  if (it == nullptr) {
+    return Status(1, "Could not get iterator for " + domain);
+  }
+
+  for (it->Seek(low); it->Valid() && it->key().compare(upper) < 0;
+       it->Next()) {
+    results.emplace_back(it->key().ToString(), it->value().ToString());
+    if (max > 0 && results.size() >= max) {
+      break;
     }
   }
   delete it;
   return Status(0, "OK");
 }
+
+Status RocksDBDatabasePlugin::removeRange(const std::string& domain,
+                                          const std::string& low,
+                                          const std::string& high) {
+  if (read_only_) {
+    return Status(0, "Database in readonly mode");
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+
+  // The bundled RocksDB has no DeleteRange, delete each key in one batch.
+  auto read_options = rocksdb::ReadOptions();
+  read_options.verify_checksums = false;
+  read_options.fill_cache = false;
+  rocksdb::Slice upper(high);
+  auto it = getDB()->NewIterator(read_options, cfh);
+  if (it == nullptr) {
+    return Status(1, "Could not get iterator for " + domain);
+  }
+
+  rocksdb::WriteBatch batch;
+  for (it->Seek(low); it->Valid() && it->key().compare(upper) < 0;
+       it->Next()) {
+    batch.Delete(cfh, it->key());
+  }
+  delete it;
+
+  auto options = rocksdb::WriteOptions();
+  if (kEvents != domain) {
+    options.sync = true;
+  }
+  auto s = getDB()->Write(options, &batch);
+  return Status(s.code(), s.ToString());
+}
 }
@@ -52,6 +52,18 @@ class SQLiteDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               size_t max = 0) const override;
 
+  /// Ordered key/value range lookup method.
+  Status scanRange(const std::string& domain,
+                   const std::string& low,
+                   const std::string& high,
+                   DatabaseStringValueList& results,
+                   size_t max = 0) const override;
+
+  /// Range removal method.
+  Status removeRange(const std::string& domain,
+                     const std::string& low,
+                     const std::string& high) override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override;
@@ -273,4 +285,53 @@ Status SQLiteDatabasePlugin::scan(const std::string& domain,
 
   return Status(0, "OK");
 }
+
+Status SQLiteDatabasePlugin::scanRange(const std::string& domain,
+                                       const std::string& low,
+                                       const std::string& high,
+                                       DatabaseStringValueList& results,
+                                       size_t max) const {
+  sqlite3_stmt* stmt = nullptr;
+  std::string q = "select key, value from " + domain +
+                  " where key >= ?1 and key < ?2 order by key";
+  if (max > 0) {
+    q += " limit " + std::to_string(max);
+  }
+  if (sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    return Status(1, "Could not prepare range scan");
+  }
+
+  sqlite3_bind_text(stmt, 1, low.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, high.c_str(), -1, SQLITE_STATIC);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    auto key = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    auto value = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    results.emplace_back((key == nullptr) ? "" : key,
+                         (value == nullptr) ? "" : value);
+  }
+
+  sqlite3_finalize(stmt);
+  return Status(0, "OK");
+}
+
+Status SQLiteDatabasePlugin::removeRange(const std::string& domain,
+                                         const std::string& low,
+                                         const std::string& high) {
+  if (read_only_) {
+    return Status(0, "Database in readonly mode");
+  }
+
+  sqlite3_stmt* stmt = nullptr;
+  std::string q = "delete from " + domain + " where key >= ?1 and key < ?2;";
+  sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr);
+
+  sqlite3_bind_text(stmt, 1, low.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, high.c_str(), -1, SQLITE_STATIC);
+  auto rc = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (rc != SQLITE_DONE) {
+    return Status(1);
+  }
+  return Status(0);
+}
 }
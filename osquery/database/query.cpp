@@ -9,13 +9,142 @@
  */
 
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
+
+#include <osquery/core.h>
 #include <osquery/logger.h>
 
 #include "osquery/database/query.h"
 
 namespace osquery {
 
+/**
+ * @brief Row payloads are stored as "rows.<size>.<name>.<row fingerprint>".
+ *
+ * The query name is prefixed with its length, so the payloads of a query
+ * named "a" are not within the prefix of a query named "a.b".
+ */
+const std::string kQueryRowsPrefix = "rows.";
+
+/// The saved SQL text of a scheduled query is stored as "query.<name>".
+const std::string kQueryTextPrefix = "query.";
+
+/// The per-install key used to fingerprint stored rows, see fingerprintRow.
+const std::string kRowFingerprintKey = "row_fingerprint_key";
+
+/// The width of a hex-encoded row fingerprint within the stored index.
+const size_t kRowHashWidth = sizeof(RowHash) * 2;
+
+static inline std::string encodeRowHash(RowHash h) {
+  static const char kHex[] = "0123456789abcdef";
+  std::string encoded(kRowHashWidth, '0');
+  for (size_t i = kRowHashWidth; i > 0; i--) {
+    encoded[i - 1] = kHex[h & 0xf];
+    h >>= 4;
+  }
+  return encoded;
+}
+
+static inline bool decodeRowHash(const std::string& s, size_t pos, RowHash& h) {
+  h = 0;
+  for (size_t i = pos; i < pos + kRowHashWidth; i++) {
+    h <<= 4;
+    if (s[i] >= '0' && s[i] <= '9') {
+      h |= static_cast<RowHash>(s[i] - '0');
+    } else if (s[i] >= 'a' && s[i] <= 'f') {
+      h |= static_cast<RowHash>(s[i] - 'a' + 10);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Check if a stored result index is a legacy JSON result set.
+ *
+ * Before row fingerprints were persisted the entire result set was stored as
+ * a JSON array under the query name.
+ */
+static inline bool isLegacyResults(const std::string& raw) {
+  return !raw.empty() && (raw[0] == '[' || raw[0] == '{' || raw[0] == '"');
+}
+
+static Status decodeResultsIndex(const std::string& raw,
+                                 std::vector<RowHash>& index) {
+  if (raw.size() % kRowHashWidth != 0) {
+    return Status(1, "Invalid stored results index");
+  }
+
+  index.reserve(raw.size() / kRowHashWidth);
+  for (size_t pos = 0; pos < raw.size(); pos += kRowHashWidth) {
+    RowHash h = 0;
+    if (!decodeRowHash(raw, pos, h)) {
+      return Status(1, "Invalid stored results index");
+    }
+    index.push_back(h);
+  }
+  return Status(0, "OK");
+}
+
+static inline std::string encodeResultsIndex(
+    const std::vector<RowHash>& index) {
+  std::string raw;
+  raw.reserve(index.size() * kRowHashWidth);
+  for (const auto& h : index) {
+    raw += encodeRowHash(h);
+  }
+  return raw;
+}
+
+/**
+ * @brief Read, or create, the key used to fingerprint stored rows.
+ *
+ * The key is random and never leaves the backing store, so a row whose
+ * fingerprint collides with a stored row cannot be chosen by its content.
+ */
+static std::string getRowFingerprintKey() {
+  static Mutex key_mutex;
+  static std::string key;
+
+  WriteLock lock(key_mutex);
+  if (key.empty()) {
+    getDatabaseValue(kPersistentSettings, kRowFingerprintKey, key);
+  }
+  if (key.empty()) {
+    boost::uuids::random_generator generator;
+    key = boost::uuids::to_string(generator()) +
+          boost::uuids::to_string(generator());
+    setDatabaseValue(kPersistentSettings, kRowFingerprintKey, key);
+  }
+  return key;
+}
+
+static inline std::string rowsPrefix(const std::string& name) {
+  return kQueryRowsPrefix + std::to_string(name.size()) + "." + name + ".";
+}
+
+static inline std::string rowKey(const std::string& name, RowHash h) {
+  return rowsPrefix(name) + encodeRowHash(h);
+}
+
+/// Read and parse the stored payload of a row fingerprint.
+static inline Status getRowPayload(const std::string& name,
+                                   RowHash h,
+                                   Row& r) {
+  std::string json;
+  auto status = getDatabaseValue(kQueries, rowKey(name, h), json);
+  if (!status.ok()) {
+    return status;
+  }
+  return deserializeRowJSON(json, r);
+}
+
 Status Query::getPreviousQueryResults(QueryData& results) {
   std::string raw;
   auto status = getDatabaseValue(kQueries, name_, raw);
@@ -23,32 +152,72 @@ Status Query::getPreviousQueryResults(QueryData& results) {
     return status;
   }
 
-  status = deserializeQueryDataJSON(raw, results);
+  if (isLegacyResults(raw)) {
+    return deserializeQueryDataJSON(raw, results);
+  }
+
+  std::vector<RowHash> index;
+  status = decodeResultsIndex(raw, index);
   if (!status.ok()) {
     return status;
   }
+
+  // Duplicate rows share a payload, read each payload once.
+  std::map<RowHash, Row> payloads;
+  results.reserve(index.size());
+  for (const auto& h : index) {
+    auto payload = payloads.find(h);
+    if (payload == payloads.end()) {
+      Row r;
+      if (!getRowPayload(name_, h, r).ok()) {
+        // An incomplete result set is treated as no previous results.
+        VLOG(1) << "Missing stored row for scheduled query: " << name_;
+        results.clear();
+        return Status(0, "OK");
+      }
+      payload = payloads.emplace(h, std::move(r)).first;
+    }
+    results.push_back(payload->second);
+  }
   return Status(0, "OK");
 }
 
 std::vector<std::string> Query::getStoredQueryNames() {
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kQueries, keys);
+
+  // Row payloads are an implementation detail of the stored results.
   std::vector<std::string> results;
-  scanDatabaseKeys(kQueries, results);
+  for (auto& key : keys) {
+    if (key.find(kQueryRowsPrefix) != 0) {
+      results.push_back(std::move(key));
+    }
+  }
   return results;
 }
 
+void Query::deleteStoredResults(const std::string& name) {
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kQueries, keys, rowsPrefix(name));
+  for (const auto& key : keys) {
+    deleteDatabaseValue(kQueries, key);
+  }
+  deleteDatabaseValue(kQueries, name);
+}
+
 bool Query::isQueryNameInDatabase() {
-  auto names = Query::getStoredQueryNames();
-  return std::find(names.begin(), names.end(), name_) != names.end();
+  std::string raw;
+  return getDatabaseValue(kQueries, name_, raw).ok();
 }
 
 static inline void saveQuery(const std::string& name,
                              const std::string& query) {
-  setDatabaseValue(kQueries, "query." + name, query);
+  setDatabaseValue(kQueries, kQueryTextPrefix + name, query);
 }
 
 bool Query::isNewQuery() {
   std::string query;
-  getDatabaseValue(kQueries, "query." + name_, query);
+  getDatabaseValue(kQueries, kQueryTextPrefix + name_, query);
   return (query != query_.query);
 }
 
@@ -57,6 +226,59 @@ Status Query::addNewResults(const QueryData& qd) {
   return addNewResults(qd, dr, false);
 }
 
+namespace {
+
+/// The number of occurrences of a fingerprint in the previous/current results.
+struct RowHashCount {
+  size_t previous{0};
+  size_t current{0};
+  bool written{false};
+};
+
+using RowHashCounts = std::unordered_map<RowHash, RowHashCount>;
+}
+
+/**
+ * @brief Calculate a differential using the stored fingerprints.
+ *
+ * This has the same semantics as ::diff, but only the payloads of removed
+ * rows are read from the backing store. If a payload is missing the previous
+ * results cannot be reconstructed and an error is returned.
+ */
+static Status diffResultsIndex(const std::string& name,
+                               const std::vector<RowHash>& previous_index,
+                               const QueryData& current_qd,
+                               const std::vector<RowHash>& current_index,
+                               const RowHashCounts& counts,
+                               DiffResults& dr) {
+  // Current rows unknown to the previous results are added.
+  for (size_t i = 0; i < current_qd.size(); i++) {
+    if (counts.at(current_index[i]).previous == 0) {
+      dr.added.push_back(current_qd[i]);
+    }
+  }
+
+  // Previous rows repeated more often than in the current results are removed
+  // and reported at their first occurrence.
+  std::unordered_set<RowHash> reported;
+  for (const auto& h : previous_index) {
+    const auto& count = counts.at(h);
+    if (count.previous <= count.current || !reported.insert(h).second) {
+      continue;
+    }
+
+    Row r;
+    auto status = getRowPayload(name, h, r);
+    if (!status.ok()) {
+      return status;
+    }
+    for (size_t i = count.current; i < count.previous; i++) {
+      dr.removed.push_back(r);
+    }
+  }
+  return Status(0, "OK");
+}
+
 Status Query::addNewResults(const QueryData& current_qd,
                             DiffResults& dr,
                             bool calculate_diff) {
@@ -73,38 +295,102 @@ Status Query::addNewResults(const QueryData& current_qd,
     saveQuery(name_, query_.query);
   }
 
-  // Use a 'target' avoid copying the query data when serializing and saving.
-  // If a differential is requested and needed the target remains the original
-  // query data, otherwise the content is moved to the differential's added set.
-  const auto* target_gd = &current_qd;
-  if (!fresh_results && calculate_diff) {
-    // Get the rows from the last run of this query name.
-    QueryData previous_qd;
-    auto status = getPreviousQueryResults(previous_qd);
+  // Fingerprint each current row once, the order of the results is kept.
+  // Stored rows are identified by fingerprint alone, so the key is required.
+  auto key = getRowFingerprintKey();
+  std::vector<RowHash> current_index;
+  current_index.reserve(current_qd.size());
+  RowHashCounts counts;
+  counts.reserve(current_qd.size());
+  for (const auto& row : current_qd) {
+    auto h = fingerprintRow(row, key);
+    current_index.push_back(h);
+    counts[h].current++;
+  }
+
+  // Read the fingerprints from the last run of this query name.
+  // Results stored before fingerprints were persisted are read in full and
+  // rewritten using the compact form.
+  std::vector<RowHash> previous_index;
+  QueryData legacy_qd;
+  bool legacy = false;
+  std::string raw;
+  if (getDatabaseValue(kQueries, name_, raw).ok()) {
+    Status status;
+    if (isLegacyResults(raw)) {
+      legacy = true;
+      status = deserializeQueryDataJSON(raw, legacy_qd);
+    } else {
+      status = decodeResultsIndex(raw, previous_index);
+    }
     if (!status.ok()) {
       return status;
     }
+  }
 
+  for (const auto& h : previous_index) {
+    counts[h].previous++;
+  }
+
+  bool missing_rows = false;
+  if (!fresh_results && calculate_diff) {
     // Calculate the differential between previous and current query results.
-    dr = diff(previous_qd, current_qd);
-    fresh_results = (!dr.added.empty() || !dr.removed.empty());
+    if (legacy) {
+      dr = diff(legacy_qd, current_qd);
+    } else {
+      auto status = diffResultsIndex(
+          name_, previous_index, current_qd, current_index, counts, dr);
+      if (!status.ok()) {
+        // Treat an incomplete result set as no previous results.
+        LOG(WARNING) << "Missing stored rows for scheduled query: " << name_;
+        dr = DiffResults();
+        dr.added = current_qd;
+        missing_rows = true;
+      }
+    }
+    fresh_results = legacy || missing_rows || !dr.added.empty() ||
+                    !dr.removed.empty();
   } else {
-    dr.added = std::move(current_qd);
-    target_gd = &dr.added;
+    dr.added = current_qd;
+  }
+
+  if (!fresh_results) {
+    // The set of fingerprints is unchanged, nothing is rewritten.
+    return Status(0, "OK");
   }
 
-  if (fresh_results) {
-    // Replace the "previous" query data with the current.
+  // Only write the payloads of rows that were not previously stored.
+  for (size_t i = 0; i < current_qd.size(); i++) {
+    auto& count = counts[current_index[i]];
+    if ((count.previous > 0 && !missing_rows) || count.written) {
+      continue;
+    }
+
     std::string json;
-    auto status = serializeQueryDataJSON(*target_gd, json);
+    auto status = serializeRowJSON(current_qd[i], json);
     if (!status.ok()) {
       return status;
     }
 
-    status = setDatabaseValue(kQueries, name_, json);
+    status = setDatabaseValue(kQueries, rowKey(name_, current_index[i]), json);
     if (!status.ok()) {
       return status;
     }
+    count.written = true;
+  }
+
+  // Replace the "previous" fingerprints with the current.
+  auto status =
+      setDatabaseValue(kQueries, name_, encodeResultsIndex(current_index));
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Payloads are removed after the index no longer references them.
+  for (const auto& count : counts) {
+    if (count.second.current == 0 && count.second.previous > 0) {
+      deleteDatabaseValue(kQueries, rowKey(name_, count.first));
+    }
   }
   return Status(0, "OK");
 }
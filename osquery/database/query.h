@@ -61,6 +61,16 @@ class Query {
    */
   static std::vector<std::string> getStoredQueryNames();
 
+  /**
+   * @brief Remove the stored results of a scheduled query.
+   *
+   * Stored results are a list of row fingerprints kept under the query name
+   * and a row payload for each distinct fingerprint.
+   *
+   * @param name the scheduled query name.
+   */
+  static void deleteStoredResults(const std::string& name);
+
   /**
    * @brief Check if a given scheduled query exists in the database.
    *
@@ -96,6 +106,10 @@ class Query {
    * to the database using addNewResults and get back a data structure
    * indicating what rows in the query's results have changed.
    *
+   * Only the row fingerprints of the previous results are read. If the set of
+   * fingerprints has not changed nothing is written, otherwise only the
+   * payloads of added rows are written and those of removed rows deleted.
+   *
    * @param qd the QueryData object containing query results to store.
    * @param dr an output to a DiffResults object populated based on last run.
    *
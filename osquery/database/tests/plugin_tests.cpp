@@ -40,6 +40,21 @@ void DatabasePluginTests::testPut() {
   EXPECT_EQ(s.getMessage(), "OK");
 }
 
+void DatabasePluginTests::testPutBatch() {
+  DatabaseStringValueList data = {{"test_put_batch1", "foo"},
+                                  {"test_put_batch2", "bar"},
+                                  {"test_put_batch1", "baz"}};
+  auto s = getPlugin()->putBatch(kQueries, data);
+  EXPECT_TRUE(s.ok());
+
+  // Pairs are applied in order, the last write for a key wins.
+  std::string r;
+  getPlugin()->get(kQueries, "test_put_batch1", r);
+  EXPECT_EQ(r, "baz");
+  getPlugin()->get(kQueries, "test_put_batch2", r);
+  EXPECT_EQ(r, "bar");
+}
+
 void DatabasePluginTests::testGet() {
   getPlugin()->put(kQueries, "test_get", "bar");
 
@@ -57,6 +72,21 @@ void DatabasePluginTests::testDelete() {
   EXPECT_EQ(s.getMessage(), "OK");
 }
 
+void DatabasePluginTests::testRemoveBatch() {
+  getPlugin()->put(kQueries, "test_remove_batch1", "1");
+  getPlugin()->put(kQueries, "test_remove_batch2", "2");
+  getPlugin()->put(kQueries, "test_remove_batch3", "3");
+
+  auto s = getPlugin()->removeBatch(
+      kQueries, {"test_remove_batch1", "test_remove_batch3"});
+  EXPECT_TRUE(s.ok());
+
+  std::vector<std::string> keys;
+  getPlugin()->scan(kQueries, keys, "test_remove_batch");
+  ASSERT_EQ(1U, keys.size());
+  EXPECT_EQ("test_remove_batch2", keys[0]);
+}
+
 void DatabasePluginTests::testScan() {
   getPlugin()->put(kQueries, "test_scan_foo1", "baz");
   getPlugin()->put(kQueries, "test_scan_foo2", "baz");
@@ -85,4 +115,40 @@ void DatabasePluginTests::testScanLimit() {
   EXPECT_EQ(s.getMessage(), "OK");
   EXPECT_EQ(keys.size(), 2U);
 }
+
+void DatabasePluginTests::testScanRange() {
+  getPlugin()->put(kQueries, "test_range_c", "3");
+  getPlugin()->put(kQueries, "test_range_a", "1");
+  getPlugin()->put(kQueries, "test_range_b", "2");
+  getPlugin()->put(kQueries, "test_range_d", "4");
+
+  // Pairs are returned in key order, the upper bound is exclusive.
+  DatabaseStringValueList results;
+  auto s = getPlugin()->scanRange(
+      kQueries, "test_range_a", "test_range_d", results);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(3U, results.size());
+  EXPECT_EQ("test_range_a", results[0].first);
+  EXPECT_EQ("1", results[0].second);
+  EXPECT_EQ("test_range_c", results[2].first);
+
+  results.clear();
+  getPlugin()->scanRange(kQueries, "test_range_b", "test_range_z", results, 1);
+  ASSERT_EQ(1U, results.size());
+  EXPECT_EQ("test_range_b", results[0].first);
+}
+
+void DatabasePluginTests::testRemoveRange() {
+  getPlugin()->put(kQueries, "test_range_a", "1");
+  getPlugin()->put(kQueries, "test_range_b", "2");
+  getPlugin()->put(kQueries, "test_range_c", "3");
+
+  auto s = getPlugin()->removeRange(kQueries, "test_range_a", "test_range_c");
+  EXPECT_TRUE(s.ok());
+
+  std::vector<std::string> keys;
+  getPlugin()->scan(kQueries, keys, "test_range_");
+  ASSERT_EQ(1U, keys.size());
+  EXPECT_EQ("test_range_c", keys[0]);
+}
 }
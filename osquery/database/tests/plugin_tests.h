@@ -23,10 +23,14 @@
 #define CREATE_DATABASE_TESTS(n)                      \
   TEST_F(n, test_plugin_check) { testPluginCheck(); } \
   TEST_F(n, test_put) { testPut(); }                  \
+  TEST_F(n, test_put_batch) { testPutBatch(); }       \
   TEST_F(n, test_get) { testGet(); }                  \
   TEST_F(n, test_delete) { testDelete(); }            \
+  TEST_F(n, test_remove_batch) { testRemoveBatch(); } \
   TEST_F(n, test_scan) { testScan(); }                \
-  TEST_F(n, test_scan_limit) { testScanLimit(); }
+  TEST_F(n, test_scan_limit) { testScanLimit(); }     \
+  TEST_F(n, test_scan_range) { testScanRange(); }     \
+  TEST_F(n, test_remove_range) { testRemoveRange(); }
 
 namespace osquery {
 
@@ -78,9 +82,13 @@ class DatabasePluginTests : public testing::Test {
  protected:
   void testPluginCheck();
   void testPut();
+  void testPutBatch();
   void testGet();
   void testDelete();
+  void testRemoveBatch();
   void testScan();
   void testScanLimit();
+  void testScanRange();
+  void testRemoveRange();
 };
 }
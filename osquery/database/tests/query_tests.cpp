@@ -61,6 +61,126 @@ TEST_F(QueryTests, test_add_and_get_current_results) {
   }
 }
 
+TEST_F(QueryTests, test_add_results_stores_fingerprints) {
+  auto query = getOsqueryScheduledQuery();
+  auto cf = Query("fingerprints", query);
+  auto results = getTestDBExpectedResults();
+  DiffResults dr;
+  EXPECT_TRUE(cf.addNewResults(results, dr));
+  EXPECT_EQ(dr.added, results);
+
+  // Each distinct row has a payload, the names do not include payloads.
+  std::vector<std::string> payloads;
+  scanDatabaseKeys(kQueries, payloads, "rows.12.fingerprints.");
+  EXPECT_EQ(payloads.size(), results.size());
+  auto names = Query::getStoredQueryNames();
+  EXPECT_EQ(std::count(names.begin(), names.end(), "fingerprints"), 1);
+  for (const auto& name : names) {
+    EXPECT_NE(name.find("rows."), 0U);
+  }
+
+  // An unchanged result set yields an empty differential.
+  DiffResults unchanged;
+  EXPECT_TRUE(cf.addNewResults(results, unchanged));
+  EXPECT_TRUE(unchanged.added.empty());
+  EXPECT_TRUE(unchanged.removed.empty());
+
+  // Replacing a row adds and removes a single payload.
+  auto changed = results;
+  changed[0]["age"] = "99";
+  DiffResults delta;
+  EXPECT_TRUE(cf.addNewResults(changed, delta));
+  EXPECT_EQ(delta.added, QueryData({changed[0]}));
+  EXPECT_EQ(delta.removed, QueryData({results[0]}));
+  payloads.clear();
+  scanDatabaseKeys(kQueries, payloads, "rows.12.fingerprints.");
+  EXPECT_EQ(payloads.size(), changed.size());
+
+  QueryData previous_qd;
+  EXPECT_TRUE(cf.getPreviousQueryResults(previous_qd));
+  EXPECT_EQ(previous_qd, changed);
+
+  Query::deleteStoredResults("fingerprints");
+  payloads.clear();
+  scanDatabaseKeys(kQueries, payloads, "rows.12.fingerprints.");
+  EXPECT_TRUE(payloads.empty());
+  EXPECT_FALSE(cf.isQueryNameInDatabase());
+}
+
+TEST_F(QueryTests, test_stored_results_name_prefix) {
+  // A query name that is a prefix of another name does not share payloads.
+  auto query = getOsqueryScheduledQuery();
+  auto results = getTestDBExpectedResults();
+  auto prefix = Query("prefix", query);
+  auto dotted = Query("prefix.dotted", query);
+  EXPECT_TRUE(prefix.addNewResults(results));
+  EXPECT_TRUE(dotted.addNewResults(results));
+
+  Query::deleteStoredResults("prefix");
+  QueryData previous_qd;
+  EXPECT_TRUE(dotted.getPreviousQueryResults(previous_qd));
+  EXPECT_EQ(previous_qd, results);
+
+  DiffResults dr;
+  EXPECT_TRUE(dotted.addNewResults(results, dr));
+  EXPECT_TRUE(dr.added.empty());
+  EXPECT_TRUE(dr.removed.empty());
+  Query::deleteStoredResults("prefix.dotted");
+}
+
+TEST_F(QueryTests, test_add_results_missing_payload) {
+  auto query = getOsqueryScheduledQuery();
+  auto cf = Query("missing", query);
+  auto results = getTestDBExpectedResults();
+  EXPECT_TRUE(cf.addNewResults(results));
+
+  // Remove the payloads, the stored index is incomplete.
+  std::vector<std::string> payloads;
+  scanDatabaseKeys(kQueries, payloads, "rows.7.missing.");
+  ASSERT_FALSE(payloads.empty());
+  for (const auto& key : payloads) {
+    deleteDatabaseValue(kQueries, key);
+  }
+
+  QueryData previous_qd;
+  EXPECT_TRUE(cf.getPreviousQueryResults(previous_qd));
+  EXPECT_TRUE(previous_qd.empty());
+
+  // The current results are reported as added and stored again.
+  auto changed = results;
+  changed[0]["age"] = "99";
+  DiffResults dr;
+  EXPECT_TRUE(cf.addNewResults(changed, dr));
+  EXPECT_EQ(dr.added, changed);
+  EXPECT_TRUE(dr.removed.empty());
+  EXPECT_TRUE(cf.getPreviousQueryResults(previous_qd));
+  EXPECT_EQ(previous_qd, changed);
+  Query::deleteStoredResults("missing");
+}
+
+TEST_F(QueryTests, test_add_results_from_legacy) {
+  // Results stored as a JSON result set are diffed and then converted.
+  auto query = getOsqueryScheduledQuery();
+  auto results = getTestDBExpectedResults();
+  std::string json;
+  serializeQueryDataJSON(results, json);
+  setDatabaseValue(kQueries, "legacy", json);
+
+  auto cf = Query("legacy", query);
+  DiffResults dr;
+  EXPECT_TRUE(cf.addNewResults(results, dr));
+  EXPECT_TRUE(dr.added.empty());
+  EXPECT_TRUE(dr.removed.empty());
+
+  std::string raw;
+  getDatabaseValue(kQueries, "legacy", raw);
+  EXPECT_NE(raw, json);
+
+  QueryData previous_qd;
+  EXPECT_TRUE(cf.getPreviousQueryResults(previous_qd));
+  EXPECT_EQ(previous_qd, results);
+}
+
 TEST_F(QueryTests, test_get_query_results) {
   // Grab an expected set of query data and add it as the previous result.
   auto encoded_qd = getSerializedQueryDataJSON();
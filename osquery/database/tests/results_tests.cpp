@@ -38,6 +38,52 @@ TEST_F(ResultsTests, test_simple_diff) {
   EXPECT_EQ(results.removed, o);
 }
 
+TEST_F(ResultsTests, test_diff_duplicates) {
+  Row r1;
+  r1["foo"] = "bar";
+  Row r2;
+  r2["foo"] = "baz";
+
+  // A row repeated in the previous results is removed once per missing copy.
+  auto results = diff({r1, r2, r1}, {r1});
+  EXPECT_TRUE(results.added.empty());
+  EXPECT_EQ(results.removed, QueryData({r1, r2}));
+
+  // A row repeated in the current results still overlaps.
+  results = diff({r1}, {r1, r1, r2});
+  EXPECT_EQ(results.added, QueryData({r2}));
+  EXPECT_TRUE(results.removed.empty());
+}
+
+TEST_F(ResultsTests, test_hash_row) {
+  Row r1;
+  r1["foo"] = "bar";
+  Row r2;
+  r2["foo"] = "bar";
+  EXPECT_EQ(hashRow(r1), hashRow(r2));
+
+  // Column and value boundaries are part of the fingerprint.
+  Row r3;
+  r3["foob"] = "ar";
+  EXPECT_NE(hashRow(r1), hashRow(r3));
+}
+
+TEST_F(ResultsTests, test_fingerprint_row) {
+  Row r1;
+  r1["foo"] = "bar";
+  Row r2;
+  r2["foo"] = "bar";
+  EXPECT_EQ(fingerprintRow(r1, "key"), fingerprintRow(r2, "key"));
+
+  // The fingerprint depends on the key.
+  EXPECT_NE(fingerprintRow(r1, "key"), fingerprintRow(r1, "other"));
+
+  // Column and value boundaries are part of the fingerprint.
+  Row r3;
+  r3["foob"] = "ar";
+  EXPECT_NE(fingerprintRow(r1, "key"), fingerprintRow(r3, "key"));
+}
+
 TEST_F(ResultsTests, test_serialize_row) {
   auto results = getSerializedRow();
   pt::ptree tree;
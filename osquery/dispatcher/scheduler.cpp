@@ -8,6 +8,8 @@
  *
  */
 
+#include <algorithm>
+#include <atomic>
 #include <ctime>
 
 #include <osquery/config.h>
@@ -28,32 +30,66 @@ FLAG(bool, enable_monitor, true, "Enable the schedule monitor");
 
 FLAG(uint64, schedule_timeout, 0, "Limit the schedule, 0 for no limit")
 
+FLAG(uint64,
+     schedule_cost_budget,
+     4,
+     "Expected query cost per second the planner targets, 0 to disable");
+
 /// Used to bypass (optimize-out) the set-differential of query results.
 DECLARE_bool(events_optimize);
 
+/// The scheduler's worker pool is sized by the dispatcher's thread count.
+DECLARE_int32(worker_threads);
+
+/// Seconds the most recent schedule step started behind wall-clock time.
+static std::atomic<size_t> kScheduleLag{0};
+
+/// The longest planned cycle, queries with larger common multiples overlap.
+const size_t kMaxPlanHorizon{86400};
+
+/// Steps between replanning with updated query performance.
+const size_t kPlanRefresh{3600};
+
+/// Bytes of query output considered as expensive as a second of wall time.
+const double kCostOutputBytes{1024 * 1024};
+
 SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
-  // Snapshot the performance and times for the worker before running.
-  auto pid = std::to_string(PlatformProcess::getCurrentProcess()->pid());
-  auto r0 = SQL::selectAllFrom("processes", "pid", EQUALS, pid);
+  // Snapshot the resources used by this worker thread before running.
+  ResourceUsage u0;
+  bool sampled = getResourceUsage(u0);
   auto t0 = getUnixTime();
   Config::getInstance().recordQueryStart(name);
   auto sql = SQLInternal(query.query);
-  // Snapshot the performance after, and compare.
+  // Snapshot the resources after, and compare.
   auto t1 = getUnixTime();
-  auto r1 = SQL::selectAllFrom("processes", "pid", EQUALS, pid);
-  if (r0.size() > 0 && r1.size() > 0) {
+  ResourceUsage u1;
+  if (sampled && getResourceUsage(u1)) {
+    QueryPerformance execution;
+    execution.wall_time = t1 - t0;
+    execution.output_rows = sql.rows().size();
     // Calculate a size as the expected byte output of results.
     // This does not dedup result differentials and is not aware of snapshots.
-    size_t size = 0;
     for (const auto& row : sql.rows()) {
       for (const auto& column : row) {
-        size += column.first.size();
-        size += column.second.size();
+        execution.output_size += column.first.size();
+        execution.output_size += column.second.size();
       }
     }
-    // Always called while processes table is working.
-    Config::getInstance().recordQueryPerformance(
-        name, t1 - t0, size, r0[0], r1[0]);
+
+    auto delta = [](unsigned long long int before,
+                    unsigned long long int after) {
+      return (after > before) ? after - before : 0;
+    };
+    execution.user_time = delta(u0.user_time, u1.user_time);
+    execution.system_time = delta(u0.system_time, u1.system_time);
+    execution.cpu_time = delta(u0.cpu_time, u1.cpu_time);
+    // Memory is process-wide and includes concurrently executing queries.
+    execution.average_memory = delta(u0.resident_size, u1.resident_size);
+    execution.peak_memory =
+        delta(u0.peak_resident_size, u1.peak_resident_size);
+    Config::getInstance().recordQueryPerformance(name, execution);
+  } else {
+    Config::getInstance().recordQueryEnd(name);
   }
   return sql;
 }
@@ -135,16 +171,321 @@ inline void launchQuery(const std::string& name, const ScheduledQuery& query) {
   }
 }
 
+SchedulerPool::SchedulerPool(size_t threads) {
+  for (size_t i = 0; i < threads; i++) {
+    threads_.emplace_back(&SchedulerPool::work, this);
+  }
+}
+
+SchedulerPool::~SchedulerPool() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Queries not yet started are dropped, running queries finish.
+    stopping_ = true;
+    queue_.clear();
+  }
+  queued_.notify_all();
+
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+bool SchedulerPool::launch(const std::string& name,
+                           const ScheduledQuery& query,
+                           size_t step) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (pending_.count(name) > 0) {
+      // A query never overlaps a previous execution of itself.
+      return false;
+    }
+
+    pending_.insert(name);
+    QueuedQuery next;
+    next.name = name;
+    next.query = query;
+    next.step = step;
+    queue_.push_back(std::move(next));
+  }
+  queued_.notify_one();
+  return true;
+}
+
+void SchedulerPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_.wait(lock, [this]() { return pending_.empty(); });
+}
+
+size_t SchedulerPool::pending() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return pending_.size();
+}
+
+void SchedulerPool::work() {
+  while (true) {
+    QueuedQuery next;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queued_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+      if (stopping_) {
+        break;
+      }
+
+      next = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    // Table caches read the step and interval of this worker's query.
+    TablePlugin::kCacheStep = next.step;
+    TablePlugin::kCacheInterval = next.query.splayed_interval;
+    launchQuery(next.name, next.query);
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      pending_.erase(next.name);
+    }
+    finished_.notify_all();
+  }
+}
+
+static size_t getCommonMultiple(size_t a, size_t b) {
+  size_t x = a;
+  size_t y = b;
+  while (y != 0) {
+    auto t = x % y;
+    x = y;
+    y = t;
+  }
+  return (x == 0) ? 0 : (a / x) * b;
+}
+
+SchedulePlanner& SchedulePlanner::get() {
+  static SchedulePlanner planner;
+  return planner;
+}
+
+double SchedulePlanner::getCost(const QueryPerformance& perf) {
+  if (perf.executions == 0) {
+    return 1;
+  }
+
+  // Every execution costs at least a step, longer queries cost their runtime.
+  double wall_time = static_cast<double>(perf.wall_time) / perf.executions;
+  double output = static_cast<double>(perf.output_size) / perf.executions;
+  return std::max(wall_time, 1.0) + output / kCostOutputBytes;
+}
+
+void SchedulePlanner::update(size_t step) {
+  if (FLAGS_schedule_cost_budget == 0) {
+    return;
+  }
+
+  std::map<std::string, PlannedQuery> queries;
+  Config::getInstance().scheduledQueries(
+      ([&queries](const std::string& name, const ScheduledQuery& query) {
+        if (query.splayed_interval > 0) {
+          queries[name].interval = query.splayed_interval;
+        }
+      }));
+
+  {
+    WriteLock lock(mutex_);
+    if (step < planned_step_ + kPlanRefresh &&
+        queries.size() == planned_.size() &&
+        std::equal(queries.begin(),
+                   queries.end(),
+                   planned_.begin(),
+                   [](const std::pair<const std::string, PlannedQuery>& a,
+                      const std::pair<const std::string, PlannedQuery>& b) {
+                     return a.first == b.first &&
+                            a.second.interval == b.second.interval;
+                   })) {
+      // The schedule is unchanged and the costs are recent.
+      return;
+    }
+    planned_step_ = step;
+  }
+
+  for (auto& query : queries) {
+    auto& planned = query.second;
+    Config::getInstance().getPerformanceStats(
+        query.first, ([&planned](const QueryPerformance& perf) {
+          planned.cost = getCost(perf);
+        }));
+  }
+
+  plan(std::move(queries));
+  auto highest = peak();
+  if (highest > FLAGS_schedule_cost_budget) {
+    LOG(WARNING) << "Scheduled query cost " << highest
+                 << " exceeds the schedule cost budget of "
+                 << FLAGS_schedule_cost_budget;
+  }
+}
+
+void SchedulePlanner::plan(std::map<std::string, PlannedQuery> queries) {
+  // The plan repeats after the least common multiple of all intervals.
+  size_t horizon = 1;
+  for (const auto& query : queries) {
+    horizon = getCommonMultiple(horizon, query.second.interval);
+    if (horizon == 0 || horizon > kMaxPlanHorizon) {
+      horizon = kMaxPlanHorizon;
+      break;
+    }
+  }
+
+  // Queries keeping their interval keep their phase, moving a phase within
+  // a cycle would run the query twice or skip an execution.
+  std::vector<double> load(horizon, 0);
+  std::vector<PlannedQuery*> order;
+  {
+    WriteLock lock(mutex_);
+    for (auto& query : queries) {
+      auto previous = planned_.find(query.first);
+      if (previous == planned_.end() ||
+          previous->second.interval != query.second.interval) {
+        order.push_back(&query.second);
+        continue;
+      }
+
+      query.second.phase = previous->second.phase;
+      for (size_t t = query.second.phase; t < horizon;
+           t += query.second.interval) {
+        load[t] += query.second.cost;
+      }
+    }
+  }
+
+  // Place the most expensive new queries first, they leave the least room.
+  std::stable_sort(order.begin(),
+                   order.end(),
+                   [](const PlannedQuery* a, const PlannedQuery* b) {
+                     if (a->cost != b->cost) {
+                       return a->cost > b->cost;
+                     }
+                     return a->interval < b->interval;
+                   });
+
+  for (auto* query : order) {
+    auto interval = query->interval;
+    size_t best_phase = 0;
+    double best_peak = 0;
+    double best_total = 0;
+    for (size_t phase = 0; phase < interval && phase < horizon; ++phase) {
+      double phase_peak = 0;
+      double phase_total = 0;
+      for (size_t t = phase; t < horizon; t += interval) {
+        phase_peak = std::max(phase_peak, load[t]);
+        phase_total += load[t];
+      }
+
+      // Prefer the lowest peak, then the least crowded steps.
+      if (phase == 0 || phase_peak < best_peak ||
+          (phase_peak == best_peak && phase_total < best_total)) {
+        best_phase = phase;
+        best_peak = phase_peak;
+        best_total = phase_total;
+      }
+    }
+
+    query->phase = best_phase;
+    for (size_t t = best_phase; t < horizon; t += interval) {
+      load[t] += query->cost;
+    }
+  }
+
+  WriteLock lock(mutex_);
+  planned_ = std::move(queries);
+  load_ = std::move(load);
+}
+
+bool SchedulePlanner::isDue(const std::string& name,
+                            const ScheduledQuery& query,
+                            size_t step) const {
+  if (query.splayed_interval == 0) {
+    return false;
+  }
+
+  if (FLAGS_schedule_cost_budget > 0) {
+    WriteLock lock(mutex_);
+    auto planned = planned_.find(name);
+    if (planned != planned_.end() &&
+        planned->second.interval == query.splayed_interval) {
+      return step % planned->second.interval == planned->second.phase;
+    }
+  }
+
+  // Queries without a plan run at the start of each interval.
+  return step % query.splayed_interval == 0;
+}
+
+std::vector<TimelineEntry> SchedulePlanner::timeline(size_t step,
+                                                     size_t span) const {
+  std::vector<TimelineEntry> entries;
+
+  WriteLock lock(mutex_);
+  if (load_.empty()) {
+    return entries;
+  }
+
+  for (auto t = step; t < step + span; ++t) {
+    for (const auto& query : planned_) {
+      if (t % query.second.interval == query.second.phase) {
+        TimelineEntry entry;
+        entry.time = t;
+        entry.name = query.first;
+        entry.query = query.second;
+        entry.load = load_[t % load_.size()];
+        entries.push_back(std::move(entry));
+      }
+    }
+  }
+  return entries;
+}
+
+double SchedulePlanner::peak() const {
+  WriteLock lock(mutex_);
+  double highest = 0;
+  for (const auto& load : load_) {
+    highest = std::max(highest, load);
+  }
+  return highest;
+}
+
+size_t getScheduleLag() {
+  return kScheduleLag;
+}
+
 void SchedulerRunner::start() {
+  // Due queries are executed by workers, the runner only keeps time.
+  SchedulerPool pool(static_cast<size_t>(std::max(FLAGS_worker_threads, 1)));
+
   // Start the counter at the second.
-  auto i = osquery::getUnixTime();
+  auto start = osquery::getUnixTime();
+  auto i = start;
   for (; (timeout_ == 0) || (i <= timeout_); ++i) {
+    // Measure how far this step trails the wall clock.
+    auto expected = start + (i - start) * interval_;
+    auto now = osquery::getUnixTime();
+    kScheduleLag = (now > expected) ? now - expected : 0;
+    if (kScheduleLag > 0) {
+      VLOG(1) << "Schedule step " << i << " started " << kScheduleLag
+              << " seconds late with " << pool.pending()
+              << " queries pending";
+    }
+
+    TablePlugin::kCacheStep = i;
+    auto& planner = SchedulePlanner::get();
+    planner.update(i);
     Config::getInstance().scheduledQueries(
-        ([&i](const std::string& name, const ScheduledQuery& query) {
-          if (query.splayed_interval > 0 && i % query.splayed_interval == 0) {
-            TablePlugin::kCacheInterval = query.splayed_interval;
-            TablePlugin::kCacheStep = i;
-            launchQuery(name, query);
+        ([&i, &pool, &planner](const std::string& name,
+                               const ScheduledQuery& query) {
+          if (planner.isDue(name, query, i)) {
+            if (!pool.launch(name, query, i)) {
+              LOG(WARNING) << "Scheduled query is still running, skipping: "
+                           << name;
+            }
           }
         }));
     // Configuration decorators run on 60 second intervals only.
@@ -152,11 +493,17 @@ void SchedulerRunner::start() {
       runDecorators(DECORATE_INTERVAL, i);
     }
     // Put the thread into an interruptible sleep without a config instance.
-    pauseMilli(interval_ * 1000);
+    // A late step does not sleep such that the schedule catches up.
+    if (kScheduleLag == 0) {
+      pauseMilli(interval_ * 1000);
+    }
     if (interrupted()) {
-      break;
+      return;
     }
   }
+
+  // A limited schedule completes its last step before returning.
+  pool.wait();
 }
 
 void startScheduler() {
@@ -10,14 +10,158 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <set>
+#include <thread>
+#include <vector>
 
+#include <osquery/config.h>
 #include <osquery/dispatcher.h>
 
 #include "osquery/sql/sqlite_util.h"
 
 namespace osquery {
 
+/**
+ * @brief A bounded pool of threads executing scheduled queries.
+ *
+ * Queries due in the same schedule step run concurrently, such that a slow
+ * query does not delay the others. A query is never queued while a previous
+ * execution of the same name is queued or running.
+ */
+class SchedulerPool : private boost::noncopyable {
+ public:
+  explicit SchedulerPool(size_t threads);
+  ~SchedulerPool();
+
+  /**
+   * @brief Queue a scheduled query for execution.
+   *
+   * @param step The schedule step the query was due, set for its worker.
+   * @return false if the query is already queued or running.
+   */
+  bool launch(const std::string& name,
+              const ScheduledQuery& query,
+              size_t step);
+
+  /// Block until every queued query has finished.
+  void wait();
+
+  /// The number of queries queued or running.
+  size_t pending();
+
+ private:
+  /// Worker thread body.
+  void work();
+
+ private:
+  /// Protects the queue and the set of pending query names.
+  std::mutex mutex_;
+
+  /// Signaled when a query is queued or the pool is stopping.
+  std::condition_variable queued_;
+
+  /// Signaled when a query finishes.
+  std::condition_variable finished_;
+
+  /// A scheduled query and the step it was launched from.
+  struct QueuedQuery {
+    std::string name;
+    ScheduledQuery query;
+    size_t step{0};
+  };
+
+  /// Queries waiting for a worker.
+  std::deque<QueuedQuery> queue_;
+
+  /// Names of queries queued or running.
+  std::set<std::string> pending_;
+
+  /// Set when the pool is destroyed.
+  bool stopping_{false};
+
+  /// The worker threads.
+  std::vector<std::thread> threads_;
+};
+
+/// A scheduled query's placement within the planned schedule.
+struct PlannedQuery {
+  /// The splayed interval in seconds.
+  size_t interval{0};
+
+  /// The step, modulo interval, the query is executed.
+  size_t phase{0};
+
+  /// Expected cost of an execution, see SchedulePlanner::getCost.
+  double cost{1};
+};
+
+/// A single planned execution, used by the osquery_schedule_timeline table.
+struct TimelineEntry {
+  size_t time{0};
+  std::string name;
+  PlannedQuery query;
+
+  /// The expected cost of all queries planned for the same step.
+  double load{0};
+};
+
+/**
+ * @brief Assign scheduled queries a phase within their interval.
+ *
+ * Without a plan every query runs when `step % interval == 0`, such that all
+ * queries sharing an interval, or a multiple, run within the same second.
+ * The planner uses the wall time and output size recorded by the schedule
+ * monitor to estimate the cost of each query and greedily picks, from the
+ * most expensive query down, the phase with the lowest peak expected cost.
+ */
+class SchedulePlanner : private boost::noncopyable {
+ public:
+  /// The planner used by the SchedulerRunner.
+  static SchedulePlanner& get();
+
+  /// Replan if the schedule changed or the plan is stale.
+  void update(size_t step);
+
+  /**
+   * @brief Assign phases to a set of queries.
+   *
+   * Costs and intervals must be filled. Previously planned queries with an
+   * unchanged interval keep their phase, only new or changed queries are
+   * placed around them.
+   */
+  void plan(std::map<std::string, PlannedQuery> queries);
+
+  /// Check if a scheduled query should be executed at this step.
+  bool isDue(const std::string& name,
+             const ScheduledQuery& query,
+             size_t step) const;
+
+  /// The planned executions within the next span seconds after a step.
+  std::vector<TimelineEntry> timeline(size_t step, size_t span) const;
+
+  /// The highest expected cost of any planned step.
+  double peak() const;
+
+  /// Estimate the cost of an execution from a query's performance.
+  static double getCost(const QueryPerformance& perf);
+
+ private:
+  /// Protects the plan, the runner updates and the timeline table reads.
+  mutable Mutex mutex_;
+
+  /// The planned queries by name.
+  std::map<std::string, PlannedQuery> planned_;
+
+  /// Expected cost for each step modulo the horizon.
+  std::vector<double> load_;
+
+  /// The step when the plan was last computed.
+  size_t planned_step_{0};
+};
+
 /// A Dispatcher service thread that watches an ExtensionManagerHandler.
 class SchedulerRunner : public InternalRunnable {
  public:
@@ -44,6 +188,9 @@ class SchedulerRunner : public InternalRunnable {
 
 SQLInternal monitor(const std::string& name, const ScheduledQuery& query);
 
+/// Seconds the most recent schedule step started behind wall-clock time.
+size_t getScheduleLag();
+
 /// Start querying according to the config's schedule
 void startScheduler();
 
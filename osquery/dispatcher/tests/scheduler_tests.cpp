@@ -62,6 +62,8 @@ TEST_F(SchedulerTests, test_monitor) {
   // performance stats are tracked independently.
   EXPECT_EQ(perf.executions, 1U);
   EXPECT_GT(perf.output_size, 0U);
+  EXPECT_EQ(perf.output_rows, 1U);
+  EXPECT_GT(perf.cpu_time, 0U);
 
   // A bit more testing, potentially redundant, check the database results.
   // Since we are only monitoring, no 'actual' results are stored.
@@ -136,6 +138,121 @@ TEST_F(SchedulerTests, test_config_results_purge) {
   }
 }
 
+TEST_F(SchedulerTests, test_scheduler_pool) {
+  ScheduledQuery query;
+  query.interval = 10;
+  query.splayed_interval = 10;
+  query.query = "select * from time";
+
+  SchedulerPool pool(2);
+  EXPECT_TRUE(pool.launch("pool_test_1", query, 0));
+  EXPECT_TRUE(pool.launch("pool_test_2", query, 0));
+
+  // The same query is not queued while an execution is pending.
+  if (pool.pending() == 2) {
+    EXPECT_FALSE(pool.launch("pool_test_1", query, 0));
+  }
+
+  pool.wait();
+  EXPECT_EQ(pool.pending(), 0U);
+
+  // Once finished the query may run again.
+  EXPECT_TRUE(pool.launch("pool_test_1", query, 0));
+  pool.wait();
+  EXPECT_EQ(pool.pending(), 0U);
+}
+
+TEST_F(SchedulerTests, test_schedule_planner) {
+  // Four equally expensive queries sharing an interval.
+  std::map<std::string, PlannedQuery> queries;
+  for (size_t i = 0; i < 4; i++) {
+    queries["planner_test_" + std::to_string(i)].interval = 10;
+  }
+  // A more expensive query is placed first, at the start of its interval.
+  queries["planner_test_expensive"].interval = 5;
+  queries["planner_test_expensive"].cost = 3;
+
+  SchedulePlanner planner;
+  planner.plan(queries);
+  // No step runs more than a single query.
+  EXPECT_EQ(planner.peak(), 3);
+
+  auto timeline = planner.timeline(1000, 10);
+  ASSERT_EQ(timeline.size(), 6U);
+  std::set<size_t> times;
+  for (const auto& entry : timeline) {
+    times.insert(entry.time);
+    EXPECT_EQ(entry.load, entry.query.cost);
+  }
+  EXPECT_EQ(times.size(), 6U);
+
+  // Each query is due once within its interval.
+  ScheduledQuery query;
+  query.splayed_interval = 10;
+  size_t due = 0;
+  for (size_t step = 1000; step < 1010; step++) {
+    if (planner.isDue("planner_test_1", query, step)) {
+      due++;
+    }
+  }
+  EXPECT_EQ(due, 1U);
+
+  // Queries without a plan run at the start of their interval.
+  EXPECT_TRUE(planner.isDue("planner_test_unknown", query, 1000));
+  EXPECT_FALSE(planner.isDue("planner_test_unknown", query, 1001));
+
+  // Without historic performance a query has a single unit of cost.
+  EXPECT_EQ(SchedulePlanner::getCost(QueryPerformance()), 1);
+}
+
+TEST_F(SchedulerTests, test_schedule_replan) {
+  std::map<std::string, PlannedQuery> queries;
+  for (size_t i = 0; i < 4; i++) {
+    queries["replan_test_" + std::to_string(i)].interval = 10;
+  }
+
+  SchedulePlanner planner;
+  planner.plan(queries);
+
+  ScheduledQuery query;
+  query.splayed_interval = 10;
+  std::map<std::string, size_t> runs;
+  for (size_t step = 1000; step < 1030; step++) {
+    if (step == 1015) {
+      // Replan mid-cycle with new costs and an additional query.
+      queries["replan_test_0"].cost = 4;
+      queries["replan_test_3"].cost = 2;
+      queries["replan_test_new"].interval = 10;
+      planner.plan(queries);
+    }
+
+    for (const auto& planned : queries) {
+      if (planner.isDue(planned.first, query, step)) {
+        runs[planned.first]++;
+      }
+    }
+  }
+
+  // Existing queries run exactly once per interval across the replan.
+  for (size_t i = 0; i < 4; i++) {
+    EXPECT_EQ(runs["replan_test_" + std::to_string(i)], 3U);
+  }
+  // The new query is placed in a step not used by the existing queries.
+  EXPECT_EQ(planner.peak(), 4);
+
+  // A changed interval is placed again.
+  queries["replan_test_1"].interval = 20;
+  planner.plan(queries);
+  query.splayed_interval = 20;
+  size_t due = 0;
+  for (size_t step = 2000; step < 2020; step++) {
+    if (planner.isDue("replan_test_1", query, step)) {
+      due++;
+    }
+  }
+  EXPECT_EQ(due, 1U);
+}
+
 TEST_F(SchedulerTests, test_scheduler) {
   auto backup_step = TablePlugin::kCacheStep;
   auto backup_interval = TablePlugin::kCacheInterval;
@@ -62,12 +62,19 @@ class BenchmarkEventSubscriber
     auto et = expire_time_;
     expire_events_ = true;
     expire_time_ = -1;
-    getIndexes(0, 0);
+    flushEvents();
+    expireRecords();
     expire_events_ = ee;
     expire_time_ = et;
   }
 
   void benchmarkGet(int low, int high) { auto results = get(low, high); }
+
+ private:
+  /// Keep every stored event, retrieval benchmarks control the store size.
+  size_t getEventsExpiry() override { return 0; }
+
+  size_t getEventsMax() override { return 10000000; }
 };
 
 static void EVENTS_subscribe_fire(benchmark::State& state) {
@@ -115,22 +122,24 @@ static void EVENTS_add_events(benchmark::State& state) {
 BENCHMARK(EVENTS_add_events);
 
 static void EVENTS_retrieve_events(benchmark::State& state) {
-  auto sub = std::make_shared<BenchmarkEventSubscriber>();
-
-  for (int i = 0; i < 1000; i++) {
-    sub->benchmarkAdd(i++);
+  // Stored events are shared between runs, only add those missing.
+  static auto sub = std::make_shared<BenchmarkEventSubscriber>();
+  static int stored = 0;
+  while (stored < state.range_x()) {
+    sub->benchmarkAdd(stored++);
   }
 
+  // Each event has a unique time, retrieve the most recent range_y events.
   while (state.KeepRunning()) {
-    sub->benchmarkGet(state.range_x(), state.range_y());
+    sub->benchmarkGet(stored - state.range_y(), stored);
   }
-
-  sub->clearRows();
 }
 
 BENCHMARK(EVENTS_retrieve_events)
-    ->ArgPair(0, 10)
-    ->ArgPair(0, 50)
-    ->ArgPair(0, 100)
-    ->ArgPair(0, 1000);
+    ->ArgPair(1000, 10)
+    ->ArgPair(1000, 100)
+    ->ArgPair(1000, 1000)
+    ->ArgPair(1000000, 10)
+    ->ArgPair(1000000, 1000)
+    ->ArgPair(1000000, 100000);
 }
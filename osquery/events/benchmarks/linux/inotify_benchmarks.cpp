@@ -0,0 +1,75 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <osquery/events.h>
+
+#include "osquery/events/linux/inotify.h"
+
+namespace osquery {
+
+class BenchmarkINotifyEventSubscriber
+    : public EventSubscriber<INotifyEventPublisher> {
+ public:
+  BenchmarkINotifyEventSubscriber() {
+    setName("benchmark_inotify");
+  }
+};
+
+class INotifyBenchmark {
+ public:
+  /// Subscribe to files spread over directories, similar to FIM file_paths.
+  static void subscribe(std::shared_ptr<INotifyEventPublisher>& pub,
+                        size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      auto sc = pub->createSubscriptionContext();
+      sc->path = "/benchmark/inotify/" + std::to_string(i % 100) + "/file" +
+                 std::to_string(i);
+      pub->monitorSubscription(sc, false);
+
+      auto sub = Subscription::create("benchmark_inotify", sc);
+      sub->callback = [](const EventContextRef& ec,
+                         const SubscriptionContextRef& sc) {
+        return Status(0, "OK");
+      };
+      pub->addSubscription(sub);
+    }
+    pub->indexSubscriptions();
+  }
+
+  static void fire(std::shared_ptr<INotifyEventPublisher>& pub,
+                   const INotifyEventContextRef& ec) {
+    pub->fire(ec, 1);
+  }
+};
+
+static void EVENTS_inotify_fire(benchmark::State& state) {
+  // The publisher is not set up, subscriptions are indexed without watches.
+  auto pub = std::make_shared<INotifyEventPublisher>();
+  auto sub = std::make_shared<BenchmarkINotifyEventSubscriber>();
+  EventFactory::registerEventSubscriber(sub);
+  INotifyBenchmark::subscribe(pub, state.range_x());
+
+  auto ec = pub->createEventContext();
+  ec->event = std::make_shared<struct inotify_event>();
+  ec->event->mask = IN_MODIFY;
+  ec->action = "UPDATED";
+  auto i = state.range_x() / 2;
+  ec->path = "/benchmark/inotify/" + std::to_string(i % 100) + "/file" +
+             std::to_string(i);
+
+  while (state.KeepRunning()) {
+    INotifyBenchmark::fire(pub, ec);
+  }
+}
+
+BENCHMARK(EVENTS_inotify_fire)->Arg(100)->Arg(1000)->Arg(10000);
+}
@@ -10,11 +10,11 @@
 
 #include <chrono>
 #include <exception>
+#include <limits>
 #include <thread>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/classification.hpp>
-#include <boost/lexical_cast.hpp>
 
 #include <osquery/config.h>
 #include <osquery/core.h>
@@ -51,6 +51,14 @@ FLAG(uint64,
 // overriding in subclasses
 FLAG(uint64, events_max, 1000, "Maximum number of events per type to buffer");
 
+FLAG(uint64,
+     events_batch_size,
+     128,
+     "Maximum number of events per type staged before a batched write");
+
+/// Seconds an event may remain staged before it is flushed.
+const EventTime kEventsFlushWindow = 1;
+
 static inline EventTime timeFromRecord(const std::string& record) {
   // Convert a stored index "as string bytes" to a time value.
   long long afinite;
@@ -60,12 +68,54 @@ static inline EventTime timeFromRecord(const std::string& record) {
   return afinite;
 }
 
+/// Width of the hex-encoded time and EventID fields of a record key.
+static const size_t kRecordFieldWidth = 16;
+
+static inline void appendRecordField(std::string& key, uint64_t value) {
+  // Fixed-width, most-significant-first hex keeps keys in numeric order.
+  static const char kHexDigits[] = "0123456789abcdef";
+  for (int shift = 60; shift >= 0; shift -= 4) {
+    key.push_back(kHexDigits[(value >> shift) & 0xf]);
+  }
+}
+
+static inline bool readRecordField(const std::string& key,
+                                   size_t offset,
+                                   uint64_t& value) {
+  value = 0;
+  for (size_t i = offset; i < offset + kRecordFieldWidth; i++) {
+    auto c = key[i];
+    value <<= 4;
+    if (c >= '0' && c <= '9') {
+      value |= static_cast<uint64_t>(c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+      value |= static_cast<uint64_t>(c - 'a' + 10);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// The first key ordered after every record with an EventTime of time.
+static inline std::string recordBound(const std::string& prefix,
+                                      EventTime time) {
+  auto bound = prefix;
+  if (time == std::numeric_limits<EventTime>::max()) {
+    // The prefix ends with '.', a trailing '/' sorts after every record.
+    bound.back() = '/';
+  } else {
+    appendRecordField(bound, time + 1);
+  }
+  return bound;
+}
+
 static inline void getOptimizeData(EventTime& o_time,
                                    size_t& o_eid,
                                    const std::string& publisher) {
   // Read the optimization time for the current executing query.
-  std::string query_name;
-  getDatabaseValue(kPersistentSettings, kExecutingQuery, query_name);
+  // Scheduled queries execute concurrently, use this thread's query.
+  auto query_name = Config::getExecutingQuery();
   if (query_name.empty()) {
     // Fallback when daemons disable query monitoring.
     query_name = publisher;
@@ -92,8 +142,8 @@ static inline void setOptimizeData(EventTime time,
                                    size_t eid,
                                    const std::string& publisher) {
   // Store the optimization time and eid.
-  std::string query_name;
-  getDatabaseValue(kPersistentSettings, kExecutingQuery, query_name);
+  // Scheduled queries execute concurrently, use this thread's query.
+  auto query_name = Config::getExecutingQuery();
   if (query_name.empty()) {
     // Fallback when daemons disable query monitoring.
     query_name = publisher;
@@ -106,6 +156,9 @@ static inline void setOptimizeData(EventTime time,
 QueryData EventSubscriberPlugin::genTable(QueryContext& context) {
   // Stop is an unsigned (-1), our end of time equivalent.
   EventTime start = 0, stop = 0;
+  // Optimization state is local, the same table may be selected concurrently.
+  EventOptimization optimization;
+  EventOptimization* optimize = nullptr;
   if (context.constraints["time"].getAll().size() > 0) {
     // Use the 'time' constraint to optimize backing-store lookups.
     for (const auto& constraint : context.constraints["time"].getAll()) {
@@ -126,11 +179,22 @@ QueryData EventSubscriberPlugin::genTable(QueryContext& context) {
   } else if (kToolType == ToolType::DAEMON && FLAGS_events_optimize) {
     // If the daemon is querying a subscriber without a 'time' constraint and
     // allows optimization, only emit events since the last query.
-    getOptimizeData(optimize_time_, optimize_eid_, dbNamespace());
-    start = optimize_time_;
-    optimize_time_ = getUnixTime() - 1;
+    optimize = &optimization;
+    getOptimizeData(optimize->time, optimize->eid, dbNamespace());
+    start = optimize->time;
+    optimize->time = getUnixTime() - 1;
+  }
+
+  // An equality constraint on an indexed column selects only matching events.
+  for (const auto& column : indexed_columns_) {
+    if (context.constraints.count(column) > 0) {
+      auto values = context.constraints[column].getAll(EQUALS);
+      if (values.size() == 1) {
+        return get(start, stop, column, *values.begin(), optimize);
+      }
+    }
   }
-  return get(start, stop);
+  return get(start, stop, "", "", optimize);
 }
 
 void EventPublisherPlugin::fire(const EventContextRef& ec, EventTime time) {
@@ -156,8 +220,11 @@ void EventPublisherPlugin::fire(const EventContextRef& ec, EventTime time) {
     }
   }
 
-  WriteLock lock(subscription_lock_);
-  for (const auto& subscription : subscriptions_) {
+  ReadLock lock(subscription_lock_);
+  SubscriptionVector candidates;
+  const auto& subscriptions =
+      (selectSubscriptions(ec, candidates)) ? candidates : subscriptions_;
+  for (const auto& subscription : subscriptions) {
     auto es = EventFactory::getEventSubscriber(subscription->subscriber_name);
     if (es != nullptr && es->state() == EventState::EVENT_RUNNING) {
       fireCallback(subscription, ec);
@@ -165,245 +232,159 @@ void EventPublisherPlugin::fire(const EventContextRef& ec, EventTime time) {
   }
 }
 
-std::vector<std::string> EventSubscriberPlugin::getIndexes(EventTime start,
-                                                           EventTime stop) {
-  auto index_key = "indexes." + dbNamespace();
-  std::vector<std::string> indexes;
-
-  EventTime l_start = (start > 0) ? start / 60 : 0;
-  EventTime r_stop = (stop > 0) ? stop / 60 + 1 : 0;
-
-  std::string content;
-  getDatabaseValue(kEvents, index_key + ".60", content);
-  if (content.empty()) {
-    return indexes;
+void EventSubscriberPlugin::expireRecords() {
+  if (!expire_events_ || expire_time_ == 0) {
+    return;
   }
 
-  std::vector<std::string> bins, expirations;
-  boost::split(bins, content, boost::is_any_of(","));
-  for (const auto& bin : bins) {
-    auto step = timeFromRecord(bin);
-    auto step_start = step * 60;
-    auto step_stop = (step + 1) * 60;
-    if (step_stop < expire_time_) {
-      expirations.push_back(bin);
-    } else if (step_start < expire_time_) {
-      expireRecords("60", bin, false);
-    }
-
-    if (step >= l_start && (r_stop == 0 || step < r_stop)) {
-      indexes.push_back("60." + bin);
+  // Records are time-ordered, all expired records form a single range.
+  std::string high;
+  appendRecordField(high, expire_time_ + 1);
+  removeRecords("", high);
+}
+
+void EventSubscriberPlugin::removeRecords(const std::string& low,
+                                          const std::string& high) {
+  // Index entries are ordered by value, each has a time-ordered expire entry
+  // holding its key. Entries of columns no longer indexed are removed too.
+  auto expire_prefix = "expire." + dbNamespace() + ".";
+  DatabaseStringValueList entries;
+  scanDatabaseRange(
+      kEvents, expire_prefix + low, expire_prefix + high, entries);
+  if (!entries.empty()) {
+    std::vector<std::string> index_keys;
+    index_keys.reserve(entries.size());
+    for (auto& entry : entries) {
+      index_keys.push_back(std::move(entry.second));
     }
+    deleteDatabaseBatch(kEvents, index_keys);
+    deleteDatabaseRange(kEvents, expire_prefix + low, expire_prefix + high);
   }
 
-  // Rewrite the index lists and delete each expired item.
-  if (!expirations.empty()) {
-    expireIndexes("60", bins, expirations);
-  }
-
-  // Return indexes in binning order.
-  std::sort(indexes.begin(),
-            indexes.end(),
-            [](const std::string& left, const std::string& right) {
-              auto n1 = timeFromRecord(left.substr(left.find(".") + 1));
-              auto n2 = timeFromRecord(right.substr(right.find(".") + 1));
-              return n1 < n2;
-            });
-
-  // Update the new time that events expire to now - expiry.
-  return indexes;
+  auto prefix = "data." + dbNamespace() + ".";
+  deleteDatabaseRange(kEvents, prefix + low, prefix + high);
 }
 
-void EventSubscriberPlugin::expireRecords(const std::string& list_type,
-                                          const std::string& index,
-                                          bool all) {
-  auto record_key = "records." + dbNamespace();
-  auto data_key = "data." + dbNamespace();
+void EventSubscriberPlugin::setIndexedColumns() {
+  indexed_columns_.clear();
+  if (!Registry::exists("table", getName())) {
+    return;
+  }
 
-  // If the expirations is not removing all records, rewrite the persisting.
-  std::vector<std::string> persisting_records;
-  // Request all records within this list-size + bin offset.
-  auto expired_records = getRecords({list_type + "." + index});
-  for (const auto& record : expired_records) {
-    if (all || record.second <= expire_time_) {
-      deleteDatabaseValue(kEvents, data_key + "." + record.first);
-    } else {
-      persisting_records.push_back(record.first + ":" +
-                                   std::to_string(record.second));
+  // Columns marked 'optimized' in the table spec are indexed by value.
+  PluginResponse response;
+  Registry::call("table", getName(), {{"action", "columns"}}, response);
+  for (const auto& column : response) {
+    if (column.count("id") == 0 || column.at("id") != "column" ||
+        column.count("name") == 0 || column.count("op") == 0) {
+      continue;
     }
-  }
 
-  // Either drop or overwrite the record list.
-  if (all) {
-    deleteDatabaseValue(kEvents, record_key + "." + list_type + "." + index);
-  } else if (persisting_records.size() < expired_records.size()) {
-    auto new_records = boost::algorithm::join(persisting_records, ",");
-    setDatabaseValue(
-        kEvents, record_key + "." + list_type + "." + index, new_records);
+    long long options = 0;
+    if (safeStrtoll(column.at("op"), 10, options) &&
+        (static_cast<ColumnOptions>(options) & ColumnOptions::OPTIMIZED)) {
+      indexed_columns_.insert(column.at("name"));
+    }
   }
 }
 
-void EventSubscriberPlugin::expireIndexes(
-    const std::string& list_type,
-    const std::vector<std::string>& indexes,
-    const std::vector<std::string>& expirations) {
-  auto index_key = "indexes." + dbNamespace();
+void EventSubscriberPlugin::expireCheck(bool cleanup) {
+  auto prefix = "data." + dbNamespace() + ".";
+  if (cleanup) {
+    // Remove the bin index and record lists of the previous layout.
+    std::vector<std::string> legacy_keys;
+    scanDatabaseKeys(kEvents, legacy_keys, "indexes." + dbNamespace() + ".");
+    scanDatabaseKeys(kEvents, legacy_keys, "records." + dbNamespace() + ".");
+    for (const auto& key : legacy_keys) {
+      deleteDatabaseValue(kEvents, key);
+    }
 
-  // Construct a mutable list of persisting indexes to rewrite as records.
-  std::vector<std::string> persisting_indexes = indexes;
-  // Remove the records using the list of expired indexes.
-  for (const auto& bin : expirations) {
-    expireRecords(list_type, bin, true);
-    persisting_indexes.erase(
-        std::remove(persisting_indexes.begin(), persisting_indexes.end(), bin),
-        persisting_indexes.end());
+    // Remove the index entries of columns that are no longer indexed.
+    auto index_prefix = "index." + dbNamespace() + ".";
+    std::vector<std::string> index_keys;
+    scanDatabaseKeys(kEvents, index_keys, index_prefix);
+    for (const auto& key : index_keys) {
+      auto column = key.substr(index_prefix.size(),
+                               key.find('.', index_prefix.size()) -
+                                   index_prefix.size());
+      if (indexed_columns_.count(column) == 0) {
+        deleteDatabaseValue(kEvents, key);
+      }
+    }
   }
 
-  // Update the list of indexes with the non-expired indexes.
-  auto new_indexes = boost::algorithm::join(persisting_indexes, ",");
-  setDatabaseValue(kEvents, index_key + "." + list_type, new_indexes);
-}
-
-void EventSubscriberPlugin::expireCheck(bool cleanup) {
-  auto data_key = "data." + dbNamespace();
-  auto eid_key = "eid." + dbNamespace();
-  // Min key will be the last surviving key.
-  size_t min_key = 0;
-
+  std::vector<std::string> keys;
   {
-    auto limit = getEventsMax();
-    std::vector<std::string> keys;
-    scanDatabaseKeys(kEvents, keys, data_key);
-    if (keys.size() <= limit) {
-      return;
-    }
-
-    // There is an overflow of events buffered for this subscriber.
-    LOG(WARNING) << "Expiring events for subscriber: " << getName()
-                 << " (limit " << limit << ")";
-    VLOG(1) << "Subscriber events " << getName() << " exceeded limit " << limit
-            << " by: " << keys.size() - limit;
-    // Inspect the N-FLAGS_events_max -th event's value and expire before the
-    // time within the content.
-    std::string last_key;
-    getDatabaseValue(kEvents, eid_key, last_key);
-    // The EID is the next-index.
-    // EID - events_max is the most last-recent event to keep.
-    min_key = boost::lexical_cast<size_t>(last_key) - getEventsMax();
-
-    if (cleanup) {
-      // Scan each of the keys in keys, if their ID portion is < min_key.
-      // Nix them, this requires lots of conversions, use with care.
-      for (const auto& key : keys) {
-        if (std::stoul(key.substr(key.rfind('.') + 1)) < min_key) {
-          deleteDatabaseValue(kEvents, key);
-        }
+    std::vector<std::string> data_keys;
+    scanDatabaseKeys(kEvents, data_keys, prefix);
+    keys.reserve(data_keys.size());
+    for (auto& key : data_keys) {
+      if (key.size() == prefix.size() + 2 * kRecordFieldWidth) {
+        keys.push_back(std::move(key));
+      } else if (cleanup) {
+        // Rows of the previous layout were keyed by EventID alone.
+        deleteDatabaseValue(kEvents, key);
       }
     }
   }
 
-  // Convert the key index into a time using the content.
-  // The last-recent event is fetched and the corresponding time is used as
-  // the expiration time for the subscriber.
-  std::string content;
-  getDatabaseValue(kEvents, data_key + "." + std::to_string(min_key), content);
-
-  // Decode the value into a row structure to extract the time.
-  Row r;
-  if (!deserializeRowJSON(content, r) || r.count("time") == 0) {
+  auto limit = getEventsMax();
+  if (keys.size() <= limit) {
     return;
   }
 
-  // The last time will become the implicit expiration time.
-  size_t last_time = boost::lexical_cast<size_t>(r.at("time"));
-  if (last_time > 0) {
-    expire_time_ = last_time;
-  }
-
-  // Finally, attempt an index query to trigger expirations.
-  // In this case the result set is not used.
-  getIndexes(expire_time_, 0);
-}
-
-std::vector<EventRecord> EventSubscriberPlugin::getRecords(
-    const std::vector<std::string>& indexes) {
-  auto record_key = "records." + dbNamespace();
-
-  std::vector<EventRecord> records;
-  for (const auto& index : indexes) {
-    std::vector<std::string> bin_records;
-    {
-      std::string record_value;
-      getDatabaseValue(kEvents, record_key + "." + index, record_value);
-      if (record_value.empty()) {
-        // There are actually no events in this bin, interesting error case.
-        continue;
-      }
-
-      // Each list is tokenized into a record=event_id:time.
-      boost::split(bin_records, record_value, boost::is_any_of(",:"));
+  // There is an overflow of events buffered for this subscriber.
+  LOG(WARNING) << "Expiring events for subscriber: " << getName() << " (limit "
+               << limit << ")";
+  VLOG(1) << "Subscriber events " << getName() << " exceeded limit " << limit
+          << " by: " << keys.size() - limit;
+
+  // The oldest N-events_max records are a single range of ordered keys.
+  std::sort(keys.begin(), keys.end());
+  removeRecords(keys.front().substr(prefix.size()),
+                keys[keys.size() - limit].substr(prefix.size()));
+}
+
+Status EventSubscriberPlugin::getRecords(EventTime start,
+                                         EventTime stop,
+                                         DatabaseStringValueList& records,
+                                         const std::string& column,
+                                         const std::string& value) {
+  // Staged events must be visible to readers, expired events must not.
+  flushEvents();
+  expireRecords();
+
+  if (stop == 0) {
+    stop = std::numeric_limits<EventTime>::max();
+  }
+
+  auto prefix = "data." + dbNamespace() + ".";
+  if (column.empty()) {
+    auto low = prefix;
+    appendRecordField(low, start);
+    return scanDatabaseRange(kEvents, low, recordBound(prefix, stop), records);
+  }
+
+  // The value index holds the time and EventID suffix of each record key.
+  auto index_prefix =
+      "index." + dbNamespace() + "." + column + "." + value + ".";
+  auto low = index_prefix;
+  appendRecordField(low, start);
+  DatabaseStringValueList entries;
+  auto status = scanDatabaseRange(
+      kEvents, low, recordBound(index_prefix, stop), entries);
+  for (const auto& entry : entries) {
+    if (entry.first.size() != index_prefix.size() + 2 * kRecordFieldWidth) {
+      continue;
     }
 
-    auto bin_it = bin_records.begin();
-    // Iterate over every 2 items: EID:TIME.
-    for (; bin_it != bin_records.end(); bin_it++) {
-      const auto& eid = *bin_it;
-      EventTime et = timeFromRecord(*(++bin_it));
-      if (FLAGS_events_optimize && et <= optimize_time_ + 1) {
-        // There is an optimization collision, check for colliding IDs.
-        auto eidr = timeFromRecord(eid);
-        if (eidr <= optimize_eid_) {
-          continue;
-        }
-      }
-      records.push_back(std::make_pair(eid, et));
+    auto record_key = prefix + entry.first.substr(index_prefix.size());
+    std::string data;
+    if (getDatabaseValue(kEvents, record_key, data).ok() && !data.empty()) {
+      records.emplace_back(std::move(record_key), std::move(data));
     }
   }
-
-  return records;
-}
-
-Status EventSubscriberPlugin::recordEvent(EventID& eid, EventTime et) {
-  std::string time_value = boost::lexical_cast<std::string>(et);
-
-  // The record is identified by the event type then module name.
-  std::string index_key = "indexes." + dbNamespace();
-  std::string record_key = "records." + dbNamespace();
-  // The list key includes the list type (bin size) and the list ID (bin).
-  std::string list_id;
-
-  // The list_id is the MOST-Specific key ID, the bin for this list.
-  // If the event time was 13 and the time_list is 5 seconds, lid = 2.
-  list_id = boost::lexical_cast<std::string>(et / 60);
-
-  WriteLock lock(event_record_lock_);
-  // Append the record (eid, unix_time) to the list bin.
-  std::string record_value;
-  getDatabaseValue(kEvents, record_key + ".60." + list_id, record_value);
-
-  if (record_value.length() == 0) {
-    // This is a new list_id for list_key, append the ID to the indirect
-    // lookup for this list_key.
-    std::string index_value;
-    getDatabaseValue(kEvents, index_key + ".60", index_value);
-    if (index_value.length() == 0) {
-      // A new index.
-      index_value = list_id;
-    } else {
-      index_value += "," + list_id;
-    }
-    setDatabaseValue(kEvents, index_key + ".60", index_value);
-    record_value = eid + ":" + time_value;
-  } else {
-    // Tokenize a record using ',' and the EID/time using ':'.
-    record_value += "," + eid + ":" + time_value;
-  }
-  auto status =
-      setDatabaseValue(kEvents, record_key + ".60." + list_id, record_value);
-  if (!status.ok()) {
-    LOG(ERROR) << "Could not put Event Record key: " << record_key;
-  }
-  return Status(0, "OK");
+  return status;
 }
 
 size_t EventSubscriberPlugin::getEventsExpiry() {
@@ -415,92 +396,162 @@ size_t EventSubscriberPlugin::getEventsMax() {
 }
 
 EventID EventSubscriberPlugin::getEventID() {
+  if (!eid_loaded_) {
+    // Seed the counter from the last EventID persisted by a flush.
+    WriteLock lock(event_id_lock_);
+    if (!eid_loaded_) {
+      std::string last_eid_value;
+      getDatabaseValue(kEvents, "eid." + dbNamespace(), last_eid_value);
+      unsigned long int last_eid = 0;
+      safeStrtoul(last_eid_value, 10, last_eid);
+      last_eid_ = static_cast<size_t>(last_eid);
+      eid_loaded_ = true;
+    }
+  }
+
+  return std::to_string(++last_eid_);
+}
+
+Status EventSubscriberPlugin::flushEvents() {
+  size_t first_eid = 0;
+  size_t last_eid = 0;
   Status status;
-  // First get an event ID from the meta key.
-  std::string eid_key = "eid." + dbNamespace();
-  std::string last_eid_value;
-  std::string eid_value;
 
   {
-    WriteLock lock(event_id_lock_);
-    status = getDatabaseValue(kEvents, eid_key, last_eid_value);
-    if (!status.ok() || last_eid_value.empty()) {
-      last_eid_value = "0";
+    // Flushes are serialized so the stored EventID counter only increases.
+    WriteLock lock(event_record_lock_);
+    std::vector<StagedEvent> events;
+    {
+      WriteLock stage_lock(event_stage_lock_);
+      events.swap(staged_events_);
     }
 
-    last_eid_ = boost::lexical_cast<size_t>(last_eid_value) + 1;
-    eid_value = boost::lexical_cast<std::string>(last_eid_);
-    status = setDatabaseValue(kEvents, eid_key, eid_value);
+    if (events.empty()) {
+      return Status(0, "OK");
+    }
+    first_eid = events.front().eid;
+    last_eid = events.back().eid;
+
+    // Each record is written once, there are no index values to rewrite.
+    auto prefix = "data." + dbNamespace() + ".";
+    DatabaseStringValueList batch;
+    batch.reserve(events.size() + 1);
+    auto index_prefix = "index." + dbNamespace() + ".";
+    auto expire_prefix = "expire." + dbNamespace() + ".";
+    for (auto& event : events) {
+      std::string suffix;
+      suffix.reserve(2 * kRecordFieldWidth);
+      appendRecordField(suffix, event.time);
+      appendRecordField(suffix, event.eid);
+      for (const auto& index : event.indexes) {
+        auto index_key =
+            index_prefix + index.first + "." + index.second + "." + suffix;
+        batch.emplace_back(index_key, "");
+        // Expiry finds the index key through a time-ordered entry.
+        batch.emplace_back(expire_prefix + suffix + index.first,
+                           std::move(index_key));
+      }
+      batch.emplace_back(prefix + suffix, std::move(event.data));
+    }
+    batch.emplace_back("eid." + dbNamespace(),
+                       std::to_string(last_eid_.load()));
+
+    status = setDatabaseBatch(kEvents, batch);
+    if (!status.ok()) {
+      LOG(ERROR) << "Could not write event batch for subscriber: "
+                 << getName();
+    }
   }
 
-  if (!status.ok()) {
-    return "0";
+  // Apply buffer eviction when this batch crossed an EventID checkpoint.
+  // Eviction occurs if the total count exceeds events_max.
+  if ((first_eid - 1) / EVENTS_CHECKPOINT != last_eid / EVENTS_CHECKPOINT) {
+    expireCheck();
   }
+  return status;
+}
 
-  return eid_value;
+Status EventSubscriberPlugin::flushStagedEvents(EventTime now) {
+  {
+    WriteLock lock(event_stage_lock_);
+    if (staged_events_.empty() || now < staged_time_ + kEventsFlushWindow) {
+      return Status(0, "OK");
+    }
+  }
+  return flushEvents();
 }
 
-QueryData EventSubscriberPlugin::get(EventTime start, EventTime stop) {
+QueryData EventSubscriberPlugin::get(EventTime start,
+                                     EventTime stop,
+                                     const std::string& column,
+                                     const std::string& value,
+                                     EventOptimization* optimize) {
   QueryData results;
 
   // Get the records for this time range.
-  auto indexes = getIndexes(start, stop);
-  auto records = getRecords(indexes);
+  DatabaseStringValueList records;
+  getRecords(start, stop, records, column, value);
 
-  std::string events_key = "data." + dbNamespace();
-  std::vector<std::string> mapped_records;
+  auto prefix_size = ("data." + dbNamespace() + ".").size();
+  size_t last_eid = 0;
+  results.reserve(records.size());
   for (const auto& record : records) {
-    if (record.second >= start && (record.second <= stop || stop == 0)) {
-      mapped_records.push_back(events_key + "." + record.first);
+    // Decode the EventTime and EventID from the record key.
+    uint64_t time = 0;
+    uint64_t eid = 0;
+    if (record.first.size() != prefix_size + 2 * kRecordFieldWidth ||
+        !readRecordField(record.first, prefix_size, time) ||
+        !readRecordField(record.first, prefix_size + kRecordFieldWidth, eid)) {
+      continue;
     }
-  }
 
-  if (FLAGS_events_optimize && !records.empty()) {
-    // If records were returned save the ordered-last as the optimization EID.
-    unsigned long int eidr = 0;
-    if (safeStrtoul(records.back().first, 10, eidr)) {
-      optimize_eid_ = static_cast<size_t>(eidr);
+    if (optimize != nullptr && time <= optimize->time + 1 &&
+        eid <= optimize->eid) {
+      // There is an optimization collision, the event was already returned.
+      continue;
     }
-  }
+    last_eid = std::max(last_eid, static_cast<size_t>(eid));
 
-  // Select mapped_records using event_ids as keys.
-  std::string data_value;
-  for (const auto& record : mapped_records) {
     Row r;
-    auto status = getDatabaseValue(kEvents, record, data_value);
-    if (data_value.length() == 0) {
-      // There is no record here, interesting error case.
-      continue;
-    }
-    status = deserializeRowJSON(data_value, r);
-    data_value.clear();
-    if (status.ok()) {
+    if (deserializeRowJSON(record.second, r).ok()) {
       results.push_back(std::move(r));
     }
   }
 
+  if (optimize != nullptr && last_eid > 0) {
+    // If records were returned save the greatest as the optimization EID.
+    optimize->eid = last_eid;
+  }
+
   if (getEventsExpiry() > 0) {
     // Set the expire time to NOW - "configured lifetime".
     // Index retrieval will apply the constraints checking and auto-expire.
     expire_time_ = getUnixTime() - getEventsExpiry();
   }
 
-  if (FLAGS_events_optimize) {
-    setOptimizeData(optimize_time_, optimize_eid_, dbNamespace());
+  if (optimize != nullptr) {
+    setOptimizeData(optimize->time, optimize->eid, dbNamespace());
   }
 
   return results;
 }
 
 Status EventSubscriberPlugin::add(Row& r, EventTime event_time) {
-  // Get and increment the EID for this module.
-  EventID eid = getEventID();
   // Without encouraging a missing event time, do not support a 0-time.
   if (event_time == 0) {
     event_time = getUnixTime();
   }
 
   r["time"] = std::to_string(event_time);
+  StagedEvent event;
+  event.time = event_time;
+  for (const auto& column : indexed_columns_) {
+    auto value = r.find(column);
+    if (value != r.end() && !value->second.empty()) {
+      event.indexes.push_back(*value);
+    }
+  }
+
   // Serialize and store the row data, for query-time retrieval.
   std::string data;
   auto status = serializeRowJSON(r, data);
@@ -512,23 +563,34 @@ Status EventSubscriberPlugin::add(Row& r, EventTime event_time) {
     data.pop_back();
   }
 
-  // Use the last EventID and a checkpoint bucket size to periodically apply
-  // buffer eviction. Eviction occurs if the total count exceeds events_max.
-  if (last_eid_ % EVENTS_CHECKPOINT == 0) {
-    expireCheck();
-  }
-
   // Logger plugins may request events to be forwarded directly.
   // If no active logger is marked 'usesLogEvent' then this is a no-op.
   EventFactory::forwardEvent(data);
 
-  // Store the event data.
-  std::string event_key = "data." + dbNamespace() + "." + eid;
-  status = setDatabaseValue(kEvents, event_key, data);
-  // Record the event in the indexing bins, using the index time.
-  recordEvent(eid, event_time);
+  bool flush = false;
+  {
+    // Stage the event, the EventID is assigned here to keep staging ordered.
+    WriteLock lock(event_stage_lock_);
+    auto now = getUnixTime();
+    if (staged_events_.empty()) {
+      staged_events_.reserve(FLAGS_events_batch_size);
+      staged_time_ = now;
+    }
+
+    unsigned long int eid = 0;
+    safeStrtoul(getEventID(), 10, eid);
+    event.eid = static_cast<size_t>(eid);
+    event.data = std::move(data);
+    staged_events_.push_back(std::move(event));
+    flush = (staged_events_.size() >= FLAGS_events_batch_size ||
+             now >= staged_time_ + kEventsFlushWindow);
+  }
   event_count_++;
-  return status;
+
+  if (flush) {
+    return flushEvents();
+  }
+  return Status(0, "OK");
 }
 
 EventPublisherRef EventSubscriberPlugin::getPublisher() const {
@@ -568,14 +630,14 @@ Status EventPublisherPlugin::addSubscription(
     const SubscriptionRef& subscription) {
   // The publisher threads may be running and if they fire events the list of
   // subscriptions will be walked.
-  WriteLock lock(subscription_lock_);
+  SharedWriteLock lock(subscription_lock_);
   subscriptions_.push_back(subscription);
   return Status(0);
 }
 
 void EventPublisherPlugin::removeSubscriptions(const std::string& subscriber) {
   // See addSubscription for details on the critical section.
-  WriteLock lock(subscription_lock_);
+  SharedWriteLock lock(subscription_lock_);
   auto end =
       std::remove_if(subscriptions_.begin(),
                      subscriptions_.end(),
@@ -595,6 +657,24 @@ void EventFactory::forwardEvent(const std::string& event) {
   }
 }
 
+void EventFactory::flushStagedEvents(const EventPublisherID& type_id) {
+  std::vector<EventSubscriberRef> subscribers;
+  {
+    auto& ef = EventFactory::getInstance();
+    WriteLock lock(ef.factory_lock_);
+    for (const auto& subscriber : ef.event_subs_) {
+      if (subscriber.second->getType() == type_id) {
+        subscribers.push_back(subscriber.second);
+      }
+    }
+  }
+
+  auto now = getUnixTime();
+  for (const auto& subscriber : subscribers) {
+    subscriber->flushStagedEvents(now);
+  }
+}
+
 Status EventFactory::run(EventPublisherID& type_id) {
   if (FLAGS_disable_events) {
     return Status(0, "Events disabled");
@@ -628,6 +708,9 @@ Status EventFactory::run(EventPublisherID& type_id) {
       break;
     }
     publisher->restart_count_++;
+    // A quiet publisher still writes the events staged by its subscribers.
+    // Publishers that read in their own loop must also flush from that loop.
+    flushStagedEvents(type_id);
     // This is a 'default' cool-off implemented in InterruptableRunnable.
     // If a publisher fails to perform some sort of interruption point, this
     // prevents the thread from thrashing through exiting checks.
@@ -750,6 +833,7 @@ Status EventFactory::registerEventSubscriber(const PluginRef& sub) {
 
   // Let the subscriber initialize any Subscriptions.
   if (!FLAGS_disable_events && !specialized_sub->disabled) {
+    specialized_sub->setIndexedColumns();
     specialized_sub->expireCheck(true);
     status = specialized_sub->init();
     specialized_sub->state(EventState::EVENT_RUNNING);
@@ -890,6 +974,11 @@ void EventFactory::end(bool join) {
       ef.threads_.clear();
     }
 
+    // Write any staged events before releasing the subscribers.
+    for (const auto& subscriber : ef.event_subs_) {
+      subscriber.second->flushEvents();
+    }
+
     // Threads may still be executing, when they finish, release publishers.
     ef.event_pubs_.clear();
     ef.event_subs_.clear();
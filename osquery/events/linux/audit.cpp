@@ -8,6 +8,11 @@
  *
  */
 
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <chrono>
+
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/filesystem.hpp>
@@ -15,6 +20,7 @@
 #include <osquery/filesystem.h>
 #include <osquery/flags.h>
 #include <osquery/logger.h>
+#include <osquery/system.h>
 
 #include "osquery/core/conversions.h"
 #include "osquery/events/linux/audit.h"
@@ -44,7 +50,20 @@ enum AuditStatus {
   AUDIT_IMMUTABLE = 2,
 };
 
-static const int kAuditMTimeout = 4000;
+const size_t AuditEventPublisher::kAuditQueueSize;
+const size_t AuditEventPublisher::kAuditBatchSize;
+
+/// Milliseconds the reader waits for netlink data before checking state.
+static const int kAuditPollTimeout = 200;
+
+/// Milliseconds the parse thread sleeps when the record queue is empty.
+static const size_t kAuditParseIdle = 10;
+
+/// Seconds between audit status requests.
+static const size_t kAuditStatusInterval = 2;
+
+/// Requested size of the netlink socket receive buffer.
+static const int kAuditReceiveBuffer = 8 * 1024 * 1024;
 
 Status AuditEventPublisher::setUp() {
   if (FLAGS_disable_audit) {
@@ -89,6 +108,16 @@ Status AuditEventPublisher::setUp() {
     // Request only the highest priority of audit status messages.
     set_aumessage_mode(MSG_QUIET, DBG_NO);
   }
+
+  // Bursts of records are absorbed by the socket buffer while the reader is
+  // between batches. The forced variant ignores rmem_max but needs root.
+  int size = kAuditReceiveBuffer;
+  if (setsockopt(handle_, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size))) {
+    setsockopt(handle_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  }
+
+  replies_.resize(kAuditBatchSize);
+  startParsing();
   return Status(0, "OK");
 }
 
@@ -96,9 +125,6 @@ void AuditEventPublisher::configure() {
   // Able to issue libaudit API calls.
   struct AuditRuleInternal rule;
 
-  // Before reply data is ever filled in, assure an empty message.
-  memset(&reply_, 0, sizeof(struct audit_reply));
-
   if (handle_ <= 0 || FLAGS_disable_audit || immutable_) {
     // No configuration or rule manipulation needed.
     // The publisher run loop may still receive audit metadata events.
@@ -159,6 +185,9 @@ void AuditEventPublisher::tearDown() {
     return;
   }
 
+  // Subscribers may not be called once the publisher is torn down.
+  stopParsing();
+
   // The configure step will store successful rule adds.
   // Each of these rules has been added by the publisher and should be remove
   // when the process tears down.
@@ -288,63 +317,49 @@ static inline bool adjust_reply(struct audit_reply* rep, int len) {
   return true;
 }
 
-static inline int safe_audit_get_reply(int fd, struct audit_reply* rep) {
-  if (fd < 0) {
-    return -EBADF;
-  }
-
-  struct timeval timeout = {0, kAuditMTimeout};
-
-  fd_set readSet;
-  FD_ZERO(&readSet);
-  FD_SET(fd, &readSet);
-
-  if (select(fd + 1, &readSet, nullptr, nullptr, &timeout) < 0) {
-    return -1;
-  }
-
-  if (!FD_ISSET(fd, &readSet)) {
+int AuditEventPublisher::readReplies() {
+  if (handle_ <= 0) {
     return -1;
   }
 
-  struct sockaddr_nl nladdr;
-  socklen_t nladdrlen = sizeof(nladdr);
-
-  int len = recvfrom(fd,
-                     &rep->msg,
-                     sizeof(rep->msg),
-                     0,
-                     (struct sockaddr*)&nladdr,
-                     &nladdrlen);
-  if (len < 0) {
-    return -errno;
-  }
-
-  if (nladdrlen != sizeof(nladdr)) {
-    return -EPROTO;
+  struct mmsghdr messages[kAuditBatchSize];
+  struct iovec vectors[kAuditBatchSize];
+  struct sockaddr_nl addresses[kAuditBatchSize];
+  memset(messages, 0, sizeof(messages));
+  for (size_t i = 0; i < kAuditBatchSize; i++) {
+    vectors[i].iov_base = &replies_[i].msg;
+    vectors[i].iov_len = sizeof(replies_[i].msg);
+    messages[i].msg_hdr.msg_iov = &vectors[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+    messages[i].msg_hdr.msg_name = &addresses[i];
+    messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
   }
 
-  if (nladdr.nl_pid) {
-    return -EINVAL;
+  // A single non-blocking syscall drains up to a full batch of replies.
+  int count =
+      recvmmsg(handle_, messages, kAuditBatchSize, MSG_DONTWAIT, nullptr);
+  if (count <= 0) {
+    return count;
   }
 
-  if (!adjust_reply(rep, len)) {
-    return -errno;
+  for (int i = 0; i < count; i++) {
+    auto& reply = replies_[i];
+    // Only replies from the kernel are accepted.
+    if (messages[i].msg_hdr.msg_namelen != sizeof(addresses[i]) ||
+        addresses[i].nl_pid != 0 ||
+        !adjust_reply(&reply, messages[i].msg_len)) {
+      reply.type = NLMSG_NOOP;
+    }
   }
-  return len;
+  return count;
 }
 
-Status AuditEventPublisher::run() {
-  if (!FLAGS_disable_audit && (count_ == 0 || count_++ % 10 == 0)) {
-    // Request an update to the audit status.
-    // This will also fill in the status on first run.
-    audit_request_status(handle_);
-  }
-
-  auto inspectReply = ([this]() {
+void AuditEventPublisher::handleReplies(size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const auto& reply = replies_[i];
     bool handle_reply = false;
 
-    switch (reply_.type) {
+    switch (reply.type) {
     case NLMSG_NOOP:
     case NLMSG_DONE:
     case NLMSG_ERROR:
@@ -356,8 +371,14 @@ Status AuditEventPublisher::run() {
       break;
     case AUDIT_GET:
       // Make a copy of the status reply and store as the most-recent.
-      if (reply_.status != nullptr) {
-        memcpy(&status_, reply_.status, sizeof(struct audit_status));
+      if (reply.status != nullptr) {
+        memcpy(&status_, reply.status, sizeof(struct audit_status));
+        if (status_.lost > kernel_lost_) {
+          VLOG(1) << "Audit kernel queue lost "
+                  << status_.lost - kernel_lost_
+                  << " records (backlog: " << status_.backlog << ")";
+        }
+        kernel_lost_ = status_.lost;
       }
       break;
     case AUDIT_FIRST_USER_MSG... AUDIT_LAST_USER_MSG:
@@ -369,7 +390,7 @@ Status AuditEventPublisher::run() {
       break;
     case AUDIT_DAEMON_START... AUDIT_DAEMON_CONFIG: // 1200 - 1203
     case AUDIT_CONFIG_CHANGE:
-      handleAuditConfigChange(reply_);
+      handleAuditConfigChange(reply);
       break;
     case AUDIT_SYSCALL: // 1300
       // A monitored syscall was issued, most likely part of a multi-record.
@@ -387,29 +408,78 @@ Status AuditEventPublisher::run() {
     }
 
     // Replies are 'handled' as potential events for several audit types.
-    if (handle_reply) {
-      auto ec = createEventContext();
-      // Build the event context from the reply type and parse the message.
-      if (handleAuditReply(reply_, ec)) {
-        fire(ec);
+    // The message is copied out of the batch buffer and parsed off-thread.
+    if (handle_reply && reply.message != nullptr) {
+      if (!records_.push(reply.type, reply.message, reply.len)) {
+        dropped_records_++;
       }
     }
-  });
-
-  // Reset the reply data.
-  int result = 0;
-  do {
-    // Request a reply in a non-blocking mode.
-    // This allows the publisher's run loop to periodically request an audit
-    // status update. These updates can check for other processes attempting to
-    // gain control over the audit sink.
-    // This non-blocking also allows faster receipt of multi-message events.
-    result = safe_audit_get_reply(handle_, &reply_);
-
-    if (result > 0) {
-      inspectReply();
+  }
+}
+
+void AuditEventPublisher::parseRecords() {
+  AuditRecord record;
+  struct audit_reply reply;
+  memset(&reply, 0, sizeof(struct audit_reply));
+
+  while (!stop_parsing_) {
+    if (!records_.pop(record)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(kAuditParseIdle));
+      continue;
     }
-  } while (result > 0);
+
+    // Records are fired in the order they were read, from this thread only,
+    // so subscribers may assemble multi-record events without locking.
+    reply.type = record.type;
+    reply.len = record.message.size();
+    reply.message = record.message.data();
+
+    auto ec = createEventContext();
+    // Build the event context from the reply type and parse the message.
+    if (handleAuditReply(reply, ec)) {
+      fire(ec);
+    }
+    processed_records_++;
+  }
+}
+
+void AuditEventPublisher::startParsing() {
+  if (parser_ != nullptr) {
+    return;
+  }
+
+  stop_parsing_ = false;
+  parser_ = std::unique_ptr<std::thread>(
+      new std::thread(&AuditEventPublisher::parseRecords, this));
+}
+
+void AuditEventPublisher::stopParsing() {
+  if (parser_ == nullptr) {
+    return;
+  }
+
+  stop_parsing_ = true;
+  parser_->join();
+  parser_.reset();
+}
+
+void AuditEventPublisher::checkStatus() {
+  auto now = getUnixTime();
+  if (now < last_status_ + kAuditStatusInterval) {
+    return;
+  }
+
+  // Request an update to the audit status.
+  // This will also fill in the status on first run.
+  last_status_ = now;
+  audit_request_status(handle_);
+
+  if (dropped_records_ > last_dropped_) {
+    LOG(WARNING) << "Audit dropped " << dropped_records_ - last_dropped_
+                 << " records (backlog: " << records_.size()
+                 << ", processed: " << processed_records_ << ")";
+    last_dropped_ = dropped_records_;
+  }
 
   if (static_cast<pid_t>(status_.pid) != getpid()) {
     if (control_ && status_.pid != 0) {
@@ -425,8 +495,42 @@ Status AuditEventPublisher::run() {
       control_ = true;
     }
   }
+}
+
+Status AuditEventPublisher::run() {
+  if (FLAGS_disable_audit || handle_ <= 0) {
+    return Status(1, "Audit subsystem is not open");
+  }
 
-  // Only apply a cool down if the reply request failed.
+  // The reader stays in this loop rather than returning to the run loop's
+  // cool off between reads. Waking on data allows faster receipt of
+  // multi-message events, and the timeout allows the periodic status checks.
+  struct pollfd descriptor;
+  descriptor.fd = handle_;
+  descriptor.events = POLLIN;
+  while (!isEnding() && !interrupted()) {
+    checkStatus();
+    // This loop does not return to the run loop, which flushes staged events.
+    // The poll timeout bounds how long a quiet host keeps events staged.
+    EventFactory::flushStagedEvents(type());
+
+    descriptor.revents = 0;
+    int result = poll(&descriptor, 1, kAuditPollTimeout);
+    if (result < 0 && errno != EINTR) {
+      return Status(1, "Cannot poll audit handle");
+    } else if (result <= 0) {
+      continue;
+    }
+
+    // Drain the socket while full batches are returned.
+    int count = 0;
+    do {
+      count = readReplies();
+      if (count > 0) {
+        handleReplies(count);
+      }
+    } while (count == static_cast<int>(kAuditBatchSize));
+  }
   return Status(0, "OK");
 }
 
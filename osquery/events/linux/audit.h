@@ -10,10 +10,15 @@
 
 #pragma once
 
+#include <atomic>
 #include <map>
 #include <set>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include <boost/noncopyable.hpp>
+
 #include <libaudit.h>
 
 #include <osquery/events.h>
@@ -121,6 +126,76 @@ struct AuditEventContext : public EventContext {
   std::string preamble;
 };
 
+/// An event-type audit reply copied out of the netlink receive batch.
+struct AuditRecord {
+  /// The audit reply type.
+  int type{0};
+
+  /// The unparsed audit message.
+  std::string message;
+};
+
+/**
+ * @brief A fixed-capacity single-producer, single-consumer record queue.
+ *
+ * The audit reader thread pushes records copied from netlink replies and the
+ * parse thread pops them. Neither side takes a lock. Each slot owns a string
+ * that is reused, so after a warm up neither side allocates.
+ */
+class AuditRecordQueue : private boost::noncopyable {
+ public:
+  explicit AuditRecordQueue(size_t capacity) : slots_(capacity + 1) {}
+
+  /// Copy a message into the next free slot, false if the queue is full.
+  bool push(int type, const char* message, size_t length) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    auto next = (tail + 1) % slots_.size();
+    if (next == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    slots_[tail].type = type;
+    slots_[tail].message.assign(message, length);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /// Swap the oldest record into the output, false if the queue is empty.
+  bool pop(AuditRecord& record) {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    record.type = slots_[head].type;
+    record.message.swap(slots_[head].message);
+    head_.store((head + 1) % slots_.size(), std::memory_order_release);
+    return true;
+  }
+
+  /// The number of records waiting to be parsed.
+  size_t size() const {
+    auto head = head_.load(std::memory_order_acquire);
+    auto tail = tail_.load(std::memory_order_acquire);
+    return (tail + slots_.size() - head) % slots_.size();
+  }
+
+  /// The maximum number of records the queue holds.
+  size_t capacity() const {
+    return slots_.size() - 1;
+  }
+
+ private:
+  /// Ring storage, one slot is always left empty to tell full from empty.
+  std::vector<AuditRecord> slots_;
+
+  /// The next slot to pop, only written by the consumer.
+  std::atomic<size_t> head_{0};
+
+  /// The next slot to push, only written by the producer.
+  std::atomic<size_t> tail_{0};
+};
+
 using AuditEventContextRef = std::shared_ptr<AuditEventContext>;
 using AuditSubscriptionContextRef = std::shared_ptr<AuditSubscriptionContext>;
 
@@ -155,16 +230,61 @@ class AuditEventPublisher
   /// Remove audit rules and close the handle.
   void tearDown() override;
 
-  /// Poll for replies to the netlink handle in a non-blocking mode.
+  /**
+   * @brief Read netlink replies in batches until the publisher ends.
+   *
+   * Status and rule replies are handled inline. Event records are copied into
+   * the record queue and parsed, then fired, by the parse thread.
+   */
   Status run() override;
 
  public:
-  AuditEventPublisher() : EventPublisher() {}
+  AuditEventPublisher() : EventPublisher(), records_(kAuditQueueSize) {}
   virtual ~AuditEventPublisher() {
     tearDown();
   }
 
+  /// Records dropped because the parse queue was full.
+  size_t droppedRecords() const {
+    return dropped_records_;
+  }
+
+  /// Records read from netlink and waiting to be parsed.
+  size_t backloggedRecords() const {
+    return records_.size();
+  }
+
+  /// Records parsed and fired to subscribers.
+  size_t processedRecords() const {
+    return processed_records_;
+  }
+
+ public:
+  /// The number of records the reader may queue ahead of the parse thread.
+  static const size_t kAuditQueueSize = 16384;
+
+  /// The maximum number of netlink messages read with a single syscall.
+  static const size_t kAuditBatchSize = 64;
+
  private:
+  /// Receive up to kAuditBatchSize replies, return the count read.
+  int readReplies();
+
+  /// Handle meta replies and queue event records from a received batch.
+  void handleReplies(size_t count);
+
+  /// Parse thread body: pop queued records, parse, and fire.
+  void parseRecords();
+
+  /// Start the parse thread.
+  void startParsing();
+
+  /// Stop and join the parse thread.
+  void stopParsing();
+
+  /// Request a status and retake control of audit if it was lost.
+  void checkStatus();
+
   /// Maintain a list of audit rule data for displaying or deleting.
   void handleListRules();
 
@@ -188,19 +308,40 @@ class AuditEventPublisher
   struct audit_status status_;
 
   /**
-   * @brief A counter of non-blocking netlink reads that contained no data.
+   * @brief The time of the most recent status request.
    *
-   * After several iterations of no data, the audit run loop will request a
-   * status. It is possible another user land daemon requested control of the
-   * audit subsystem. The kernel thread will only emit to a single handle.
+   * The run loop requests a status periodically. It is possible another user
+   * land daemon requested control of the audit subsystem. The kernel thread
+   * will only emit to a single handle.
    */
-  size_t count_{0};
+  size_t last_status_{0};
+
+  /// The kernel's lost record count at the last status reply.
+  uint32_t kernel_lost_{0};
+
+  /// The dropped record count at the last status request.
+  size_t last_dropped_{0};
 
   /// Is this process in control of the audit subsystem.
   bool control_{false};
 
-  /// The last (most recent) audit reply.
-  struct audit_reply reply_;
+  /// Reply buffers filled by a single batched read.
+  std::vector<struct audit_reply> replies_;
+
+  /// Records handed from the reader to the parse thread.
+  AuditRecordQueue records_;
+
+  /// The parse thread, running while the netlink handle is open.
+  std::unique_ptr<std::thread> parser_;
+
+  /// Set to ask the parse thread to exit.
+  std::atomic<bool> stop_parsing_{false};
+
+  /// Records dropped because the parse queue was full.
+  std::atomic<size_t> dropped_records_{0};
+
+  /// Records parsed and fired to subscribers.
+  std::atomic<size_t> processed_records_{0};
 
   /// Track all rule data added by the publisher.
   std::vector<struct AuditRuleInternal> transient_rules_;
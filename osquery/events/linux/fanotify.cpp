@@ -0,0 +1,391 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/filesystem.h>
+#include <osquery/flags.h>
+#include <osquery/logger.h>
+#include <osquery/system.h>
+
+#include "osquery/events/linux/fanotify.h"
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+FLAG(bool,
+     enable_fanotify,
+     false,
+     "Use fanotify filesystem marks for Linux file events");
+
+static const int kFANotifyMLatency = 200;
+static const size_t kFANotifyBufferSize =
+    256 * sizeof(struct fanotify_event_metadata);
+
+const std::map<uint64_t, uint32_t> kFANotifyMasks = {
+    {FAN_ACCESS, IN_ACCESS},
+    {FAN_MODIFY, IN_MODIFY},
+    {FAN_CLOSE_WRITE, IN_CLOSE_WRITE},
+    {FAN_OPEN, IN_OPEN},
+};
+
+REGISTER(FANotifyEventPublisher, "event_publisher", "fanotify");
+
+EventPublisherID& getFileEventsType() {
+  static EventPublisherID inotify_type = "inotify";
+  static EventPublisherID fanotify_type = "fanotify";
+  if (FLAGS_enable_fanotify) {
+    auto publisher = EventFactory::getEventPublisher(fanotify_type);
+    if (publisher != nullptr && !publisher->isEnding()) {
+      return fanotify_type;
+    }
+  }
+  return inotify_type;
+}
+
+/**
+ * @brief Compare the kernel's event metadata version with the headers'.
+ *
+ * Event fields cannot be read from metadata of another version. Before any
+ * filesystem is marked, a temporary file is opened to read a single event.
+ */
+static Status checkMetadataVersion(int handle) {
+  boost::system::error_code ec;
+  auto path = (fs::temp_directory_path(ec) /
+               fs::unique_path("osquery-fanotify-%%%%-%%%%-%%%%", ec))
+                  .string();
+  int fd = ::open(path.c_str(), O_CREAT | O_EXCL | O_RDONLY | O_CLOEXEC, 0600);
+  if (fd == -1) {
+    VLOG(1) << "Could not check fanotify metadata version";
+    return Status(0, "OK");
+  }
+  ::close(fd);
+
+  struct fanotify_event_metadata buffer[4];
+  ssize_t record_num = 0;
+  auto marked =
+      ::fanotify_mark(handle, FAN_MARK_ADD, FAN_OPEN, AT_FDCWD, path.c_str());
+  if (marked != -1) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+      ::close(fd);
+    }
+    record_num = ::read(handle, buffer, sizeof(buffer));
+    ::fanotify_mark(handle, FAN_MARK_REMOVE, FAN_OPEN, AT_FDCWD, path.c_str());
+  }
+  ::unlink(path.c_str());
+
+  if (record_num <= 0 || !FAN_EVENT_OK(buffer, record_num)) {
+    VLOG(1) << "Could not check fanotify metadata version";
+    return Status(0, "OK");
+  }
+
+  if (buffer[0].vers != FANOTIFY_METADATA_VERSION) {
+    // The event file descriptor cannot be found within unknown metadata.
+    return Status(1, "FANotify metadata version mismatch");
+  }
+
+  for (auto metadata = buffer; FAN_EVENT_OK(metadata, record_num);
+       metadata = FAN_EVENT_NEXT(metadata, record_num)) {
+    if (metadata->fd != FAN_NOFD) {
+      ::close(metadata->fd);
+    }
+  }
+  return Status(0, "OK");
+}
+
+Status FANotifyEventPublisher::setUp() {
+  if (!FLAGS_enable_fanotify) {
+    return Status(1, "Publisher disabled via configuration");
+  }
+
+  fanotify_handle_ =
+      ::fanotify_init(FAN_CLOEXEC | FAN_CLASS_NOTIF | FAN_NONBLOCK,
+                      O_RDONLY | O_LARGEFILE | O_CLOEXEC);
+  if (fanotify_handle_ == -1) {
+    return Status(1, "Could not start fanotify: fanotify_init failed");
+  }
+
+  // Events are read without a per-event version check.
+  auto status = checkMetadataVersion(fanotify_handle_);
+  if (!status.ok()) {
+    ::close(fanotify_handle_);
+    fanotify_handle_ = -1;
+  }
+  return status;
+}
+
+void FANotifyEventPublisher::monitorSubscription(
+    INotifySubscriptionContextRef& sc) {
+  sc->discovered_ = sc->path;
+  if (sc->path.find("**") != std::string::npos) {
+    sc->recursive = true;
+    sc->discovered_ = sc->path.substr(0, sc->path.find("**"));
+    sc->path = sc->discovered_;
+  }
+
+  if (sc->path.find('*') != std::string::npos) {
+    // Filesystem marks include every leaf, only the stem changes matching.
+    auto fullpath = fs::path(sc->path);
+    if (fullpath.filename().string().find('*') != std::string::npos) {
+      sc->discovered_ = fullpath.parent_path().string() + '/';
+    }
+
+    if (sc->discovered_.find('*') != std::string::npos) {
+      sc->recursive_match = sc->recursive;
+      sc->pattern_ = sc->path + '*';
+      return;
+    }
+  }
+
+  if (isDirectory(sc->discovered_) && sc->discovered_.back() != '/') {
+    sc->path += '/';
+    sc->discovered_ += '/';
+  }
+  sc->pattern_ = sc->path + '*';
+}
+
+bool FANotifyEventPublisher::addMark(const std::string& path, uint32_t mask) {
+  uint64_t fan_mask = 0;
+  for (const auto& bits : kFANotifyMasks) {
+    if (((mask == 0) ? kFileDefaultMasks : mask) & bits.second) {
+      fan_mask |= bits.first;
+    }
+  }
+
+  // Find the closest existing parent of the literal part of the path.
+  auto parent = fs::path(path.substr(0, path.find_first_of("*?[")));
+  struct stat parent_stat;
+  while (::stat(parent.string().c_str(), &parent_stat) != 0) {
+    if (!parent.has_parent_path() || parent == parent.root_path()) {
+      return false;
+    }
+    parent = parent.parent_path();
+  }
+
+  WriteLock lock(mark_mutex_);
+  auto& marked = marks_[parent_stat.st_dev];
+  if ((marked & fan_mask) == fan_mask) {
+    return true;
+  }
+
+  int result = -1;
+#ifdef FAN_MARK_FILESYSTEM
+  // Filesystem marks include every mount of the filesystem (Linux 4.20).
+  result = ::fanotify_mark(fanotify_handle_,
+                           FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                           fan_mask,
+                           AT_FDCWD,
+                           parent.string().c_str());
+#endif
+  if (result == -1) {
+    result = ::fanotify_mark(fanotify_handle_,
+                             FAN_MARK_ADD | FAN_MARK_MOUNT,
+                             fan_mask,
+                             AT_FDCWD,
+                             parent.string().c_str());
+  }
+
+  if (result == -1) {
+    LOG(WARNING) << "Could not add fanotify mark on: " << parent.string();
+    return false;
+  }
+  marked |= fan_mask;
+  return true;
+}
+
+void FANotifyEventPublisher::configure() {
+  if (fanotify_handle_ == -1) {
+    // This publisher has not been setup correctly.
+    return;
+  }
+
+  for (auto& sub : subscriptions_) {
+    // Marks are shared by filesystem, so every subscription is checked.
+    auto sc = getSubscriptionContext(sub->context);
+    if (sc->discovered_.empty()) {
+      monitorSubscription(sc);
+    }
+    addMark(sc->discovered_, sc->mask);
+  }
+  indexSubscriptions();
+}
+
+void FANotifyEventPublisher::indexSubscriptions() {
+  SharedWriteLock lock(index_mutex_);
+  path_index_.clear();
+  for (const auto& sub : subscriptions_) {
+    auto sc = getSubscriptionContext(sub->context);
+    path_index_.insert(sc->path, sub);
+  }
+}
+
+bool FANotifyEventPublisher::selectSubscriptions(
+    const EventContextRef& ec, SubscriptionVector& subscriptions) const {
+  if (ec == nullptr) {
+    return false;
+  }
+
+  ReadLock lock(index_mutex_);
+  if (path_index_.size() != subscriptions_.size()) {
+    // Subscriptions were added or removed since the last configure.
+    return false;
+  }
+  path_index_.find(getEventContext(ec)->path, subscriptions);
+  return true;
+}
+
+void FANotifyEventPublisher::tearDown() {
+  if (fanotify_handle_ > -1) {
+    ::close(fanotify_handle_);
+  }
+  fanotify_handle_ = -1;
+
+  WriteLock lock(mark_mutex_);
+  marks_.clear();
+}
+
+void FANotifyEventPublisher::removeSubscriptions(
+    const std::string& subscriber) {
+  if (isHandleOpen()) {
+    // Marks are shared, the next configure marks the remaining subscriptions.
+    WriteLock lock(mark_mutex_);
+#ifdef FAN_MARK_FILESYSTEM
+    ::fanotify_mark(fanotify_handle_,
+                    FAN_MARK_FLUSH | FAN_MARK_FILESYSTEM,
+                    0,
+                    AT_FDCWD,
+                    nullptr);
+#endif
+    ::fanotify_mark(fanotify_handle_,
+                    FAN_MARK_FLUSH | FAN_MARK_MOUNT,
+                    0,
+                    AT_FDCWD,
+                    nullptr);
+    marks_.clear();
+  }
+  EventPublisherPlugin::removeSubscriptions(subscriber);
+  indexSubscriptions();
+}
+
+Status FANotifyEventPublisher::run() {
+  // Event metadata must be read with the structure's alignment.
+  struct fanotify_event_metadata
+      buffer[kFANotifyBufferSize / sizeof(struct fanotify_event_metadata)];
+  fd_set set;
+
+  FD_ZERO(&set);
+  FD_SET(fanotify_handle_, &set);
+
+  struct timeval timeout = {1, 0};
+  int selector =
+      ::select(fanotify_handle_ + 1, &set, nullptr, nullptr, &timeout);
+  if (selector == -1) {
+    LOG(WARNING) << "Could not read fanotify handle";
+    return Status(1, "FANotify handle failed");
+  }
+
+  if (selector == 0) {
+    // Read timeout.
+    return Status(0, "Continue");
+  }
+
+  // Drain the queue before sleeping, a single buffer overflows under load.
+  auto pid = ::getpid();
+  while (true) {
+    ssize_t record_num = ::read(fanotify_handle_, buffer, sizeof(buffer));
+    if (record_num == -1 && errno == EINTR) {
+      continue;
+    } else if (record_num == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // The queue is empty.
+      break;
+    } else if (record_num <= 0) {
+      return Status(1, "FANotify read failed");
+    }
+
+    for (auto metadata = buffer; FAN_EVENT_OK(metadata, record_num);
+         metadata = FAN_EVENT_NEXT(metadata, record_num)) {
+      if (metadata->mask & FAN_Q_OVERFLOW) {
+        // Marks are kept when the queue overflows, only events were lost.
+        VLOG(1) << "fanotify queue overflowed, events were dropped";
+        overflow_count_++;
+      }
+
+      if (metadata->fd == FAN_NOFD) {
+        continue;
+      }
+
+      // Reading a file when decorating or hashing an event causes events.
+      if (metadata->pid != pid) {
+        auto ec = createEventContextFrom(metadata);
+        if (!ec->path.empty() && !ec->action.empty()) {
+          fire(ec);
+        }
+      }
+      ::close(metadata->fd);
+    }
+
+    if (isEnding()) {
+      break;
+    }
+  }
+
+  pauseMilli(kFANotifyMLatency);
+  return Status(0, "OK");
+}
+
+INotifyEventContextRef FANotifyEventPublisher::createEventContextFrom(
+    const struct fanotify_event_metadata* metadata) const {
+  // Subscribers expect an inotify event, translate the event mask.
+  auto event = std::make_shared<struct inotify_event>();
+  for (const auto& bits : kFANotifyMasks) {
+    if (metadata->mask & bits.first) {
+      event->mask |= bits.second;
+    }
+  }
+
+  auto ec = createEventContext();
+  ec->event = event;
+
+  // Resolve the path using the file descriptor opened for this event.
+  char path[PATH_MAX] = {0};
+  auto fd_path = "/proc/self/fd/" + std::to_string(metadata->fd);
+  auto size = ::readlink(fd_path.c_str(), path, sizeof(path) - 1);
+  if (size <= 0) {
+    return ec;
+  }
+  ec->path = std::string(path, size);
+
+  for (const auto& action : kMaskActions) {
+    if (event->mask & action.first) {
+      ec->action = action.second;
+      break;
+    }
+  }
+  return ec;
+}
+
+bool FANotifyEventPublisher::shouldFire(
+    const INotifySubscriptionContextRef& sc,
+    const INotifyEventContextRef& ec) const {
+  // The subscription may supply a required event mask.
+  if (sc->mask != 0 && !(ec->event->mask & sc->mask)) {
+    return false;
+  }
+  return matchSubscriptionPath(*sc, ec->path);
+}
+}
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <map>
+
+#include <sys/fanotify.h>
+#include <sys/types.h>
+
+#include <osquery/events.h>
+
+#include "osquery/events/linux/inotify.h"
+
+namespace osquery {
+
+/// Map of fanotify event bits to the equivalent `inotify` action bits.
+extern const std::map<uint64_t, uint32_t> kFANotifyMasks;
+
+/**
+ * @brief A Linux `fanotify` EventPublisher for file events.
+ *
+ * The publisher marks the filesystem (or mount) containing each subscribed
+ * path instead of watching every directory, so setting up a subscription
+ * does not depend on the size of the tree and new directories need no
+ * additional watches. Paths are resolved from the file descriptor attached
+ * to each event, then matched against subscriptions like INotifyEventPublisher.
+ *
+ * The publisher reuses the INotify subscription and event contexts, so the
+ * Linux file_events and yara_events subscribers can use either publisher,
+ * see getFileEventsType. Events carry `inotify` action bits translated from
+ * fanotify. Only opens, accesses, modifications, and closes after writing are
+ * reported, fanotify does not provide the file descriptor of created, moved,
+ * or deleted paths.
+ */
+class FANotifyEventPublisher
+    : public EventPublisher<INotifySubscriptionContext, INotifyEventContext> {
+  DECLARE_PUBLISHER("fanotify");
+
+ public:
+  virtual ~FANotifyEventPublisher() {
+    tearDown();
+  }
+
+  /// Create a `fanotify` handle, requires CAP_SYS_ADMIN.
+  Status setUp() override;
+
+  /// The configuration finished loading or was updated.
+  void configure() override;
+
+  /// Release the `fanotify` handle, this removes all marks.
+  void tearDown() override;
+
+  /// The calling for beginning the thread's run loop.
+  Status run() override;
+
+  /// Remove all marks and subscriptions.
+  void removeSubscriptions(const std::string& subscriber) override;
+
+ private:
+  /// Helper/specialized event context creation.
+  INotifyEventContextRef createEventContextFrom(
+      const struct fanotify_event_metadata* metadata) const;
+
+  /// Normalize a subscription path the same way as the INotify publisher.
+  void monitorSubscription(INotifySubscriptionContextRef& sc);
+
+  /**
+   * @brief Mark the filesystem containing a path for fanotify events.
+   *
+   * The path may include wildcards or not exist yet, the closest existing
+   * parent directory is used. Each filesystem is marked once per mask.
+   *
+   * @param path A subscription path.
+   * @param mask The `inotify` action mask requested by the subscription.
+   * @return success if the filesystem is marked.
+   */
+  bool addMark(const std::string& path, uint32_t mask);
+
+  /// Given a SubscriptionContext and INotifyEventContext match path and action.
+  bool shouldFire(const INotifySubscriptionContextRef& sc,
+                  const INotifyEventContextRef& ec) const override;
+
+  /// Use the path index to select candidate Subscription%s for an event.
+  bool selectSubscriptions(const EventContextRef& ec,
+                           SubscriptionVector& subscriptions) const override;
+
+  /// Rebuild the path index from the configured Subscription%s.
+  void indexSubscriptions();
+
+  /// Check if the application-global `fanotify` handle is alive.
+  bool isHandleOpen() const {
+    return fanotify_handle_ > 0;
+  }
+
+  /// The fanotify file descriptor handle.
+  std::atomic<int> fanotify_handle_{-1};
+
+  /// The fanotify event mask marked for each filesystem device.
+  std::map<dev_t, uint64_t> marks_;
+
+  /// Access to the filesystem marks.
+  Mutex mark_mutex_;
+
+  /// Subscription%s indexed by path, see selectSubscriptions.
+  INotifyPathIndex path_index_;
+
+  /// Access to the Subscription path index.
+  mutable SharedMutex index_mutex_;
+
+ public:
+  FRIEND_TEST(FANotifyTests, test_fanotify_subscription);
+  FRIEND_TEST(FANotifyTests, test_fanotify_event_context);
+};
+
+/**
+ * @brief The publisher type used by the Linux file event subscribers.
+ *
+ * This is "fanotify" when `--enable_fanotify` is set and the publisher was
+ * set up, otherwise "inotify". The type may change while the process runs,
+ * subscribers store events under the fixed "inotify" namespace.
+ */
+EventPublisherID& getFileEventsType();
+}
@@ -8,11 +8,14 @@
  *
  */
 
+#include <chrono>
 #include <sstream>
 
 #include <fnmatch.h>
 #include <linux/limits.h>
+#include <sys/epoll.h>
 
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/filesystem.hpp>
 
 #include <osquery/filesystem.h>
@@ -25,9 +28,14 @@ namespace fs = boost::filesystem;
 
 namespace osquery {
 
-static const int kINotifyMLatency = 200;
+/// Milliseconds to wait for the first event before checking for shutdown.
+static const int kINotifyEventTimeout = 1000;
+
+/// Milliseconds after the first event in which more events are coalesced.
+static const int kINotifyCoalesceWindow = 20;
+
 static const uint32_t kINotifyBufferSize =
-    (10 * ((sizeof(struct inotify_event)) + NAME_MAX + 1));
+    (64 * ((sizeof(struct inotify_event)) + NAME_MAX + 1));
 
 std::map<int, std::string> kMaskActions = {
     {IN_ACCESS, "ACCESSED"},
@@ -48,12 +56,102 @@ const uint32_t kFileAccessMasks = IN_OPEN | IN_ACCESS;
 
 REGISTER(INotifyEventPublisher, "event_publisher", "inotify");
 
+/// Characters that begin the non-literal part of an fnmatch pattern.
+static const char* kPatternCharacters = "*?[\\";
+
+void INotifyPathIndex::insert(const std::string& path,
+                              const SubscriptionRef& subscription) {
+  auto prefix = path.substr(0, path.find_first_of(kPatternCharacters));
+  boost::algorithm::to_lower(prefix);
+
+  auto node = &root_;
+  size_t start = 0;
+  for (auto end = prefix.find('/'); end != std::string::npos;
+       end = prefix.find('/', start)) {
+    auto& child = node->children[prefix.substr(start, end - start + 1)];
+    if (child == nullptr) {
+      child.reset(new Node());
+    }
+    node = child.get();
+    start = end + 1;
+  }
+
+  if (start == prefix.size()) {
+    node->subscriptions.push_back(subscription);
+  } else {
+    node->partial[prefix.substr(start)].push_back(subscription);
+    node->partial_sizes.insert(prefix.size() - start);
+  }
+  size_++;
+}
+
+void INotifyPathIndex::find(const std::string& path,
+                            SubscriptionVector& subscriptions) const {
+  auto lower_path = boost::algorithm::to_lower_copy(path);
+
+  auto node = &root_;
+  size_t start = 0;
+  while (true) {
+    subscriptions.insert(subscriptions.end(),
+                         node->subscriptions.begin(),
+                         node->subscriptions.end());
+
+    // The partial prefixes never include a '/', compare the next component.
+    auto end = lower_path.find('/', start);
+    auto component = (end == std::string::npos) ? lower_path.size() - start
+                                                : end - start;
+    for (const auto& size : node->partial_sizes) {
+      if (size > component) {
+        break;
+      }
+      auto partial = node->partial.find(lower_path.substr(start, size));
+      if (partial != node->partial.end()) {
+        subscriptions.insert(subscriptions.end(),
+                             partial->second.begin(),
+                             partial->second.end());
+      }
+    }
+
+    if (end == std::string::npos) {
+      break;
+    }
+    auto child = node->children.find(lower_path.substr(start, component + 1));
+    if (child == node->children.end()) {
+      break;
+    }
+    node = child->second.get();
+    start = end + 1;
+  }
+}
+
+void INotifyPathIndex::clear() {
+  root_.children.clear();
+  root_.subscriptions.clear();
+  root_.partial.clear();
+  root_.partial_sizes.clear();
+  size_ = 0;
+}
+
 Status INotifyEventPublisher::setUp() {
-  inotify_handle_ = ::inotify_init();
+  inotify_handle_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
   // If this does not work throw an exception.
   if (inotify_handle_ == -1) {
     return Status(1, "Could not start inotify: inotify_init failed");
   }
+
+  // The run loop waits for the handle to become readable, then drains it.
+  epoll_handle_ = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_handle_ == -1) {
+    return Status(1, "Could not start inotify: epoll_create failed");
+  }
+
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = inotify_handle_;
+  if (::epoll_ctl(epoll_handle_, EPOLL_CTL_ADD, inotify_handle_, &event) ==
+      -1) {
+    return Status(1, "Could not start inotify: epoll_ctl failed");
+  }
   return Status(0, "OK");
 }
 
@@ -83,6 +181,7 @@ bool INotifyEventPublisher::monitorSubscription(
         addMonitor(_path, sc->mask, sc->recursive, add_watch);
       }
       sc->recursive_match = sc->recursive;
+      sc->pattern_ = sc->path + '*';
       return true;
     }
   }
@@ -91,6 +190,7 @@ bool INotifyEventPublisher::monitorSubscription(
     sc->path += '/';
     sc->discovered_ += '/';
   }
+  sc->pattern_ = sc->path + '*';
   return addMonitor(sc->discovered_, sc->mask, sc->recursive, add_watch);
 }
 
@@ -110,9 +210,39 @@ void INotifyEventPublisher::configure() {
     }
     monitorSubscription(sc);
   }
+  indexSubscriptions();
+}
+
+void INotifyEventPublisher::indexSubscriptions() {
+  SharedWriteLock lock(index_mutex_);
+  path_index_.clear();
+  for (const auto& sub : subscriptions_) {
+    auto sc = getSubscriptionContext(sub->context);
+    path_index_.insert(sc->path, sub);
+  }
+}
+
+bool INotifyEventPublisher::selectSubscriptions(
+    const EventContextRef& ec, SubscriptionVector& subscriptions) const {
+  if (ec == nullptr) {
+    return false;
+  }
+
+  ReadLock lock(index_mutex_);
+  if (path_index_.size() != subscriptions_.size()) {
+    // Subscriptions were added or removed since the last configure.
+    return false;
+  }
+  path_index_.find(getEventContext(ec)->path, subscriptions);
+  return true;
 }
 
 void INotifyEventPublisher::tearDown() {
+  if (epoll_handle_ > -1) {
+    ::close(epoll_handle_);
+  }
+  epoll_handle_ = -1;
+
   if (inotify_handle_ > -1) {
     ::close(inotify_handle_);
   }
@@ -146,63 +276,104 @@ Status INotifyEventPublisher::restartMonitoring() {
 }
 
 Status INotifyEventPublisher::run() {
-  // Get a while wrapper for free.
-  char buffer[kINotifyBufferSize];
-  fd_set set;
-
-  FD_ZERO(&set);
-  FD_SET(getHandle(), &set);
-
-  struct timeval timeout = {1, 0};
-  int selector = ::select(getHandle() + 1, &set, nullptr, nullptr, &timeout);
-  if (selector == -1) {
+  struct epoll_event event;
+  int ready = ::epoll_wait(epoll_handle_, &event, 1, kINotifyEventTimeout);
+  if (ready == -1 && errno != EINTR) {
     LOG(WARNING) << "Could not read inotify handle";
     return Status(1, "INotify handle failed");
   }
 
-  if (selector == 0) {
+  if (ready <= 0) {
     // Read timeout.
     return Status(0, "Continue");
   }
-  ssize_t record_num = ::read(getHandle(), buffer, kINotifyBufferSize);
-  if (record_num == 0 || record_num == -1) {
-    return Status(1, "INotify read failed");
-  }
 
-  for (char* p = buffer; p < buffer + record_num;) {
-    // Cast the inotify struct, make shared pointer, and append to contexts.
-    auto event = reinterpret_cast<struct inotify_event*>(p);
-    if (event->mask & IN_Q_OVERFLOW) {
-      // The inotify queue was overflown (remove all paths).
-      Status stat = restartMonitoring();
-      if (!stat.ok()) {
-        return stat;
-      }
+  // Drain the queue, then keep draining for a short window so a burst of
+  // changes to the same paths is coalesced before subscribers are called.
+  std::vector<INotifyEventContextRef> events;
+  INotifyEventKeys seen;
+  auto window = std::chrono::steady_clock::now() +
+                std::chrono::milliseconds(kINotifyCoalesceWindow);
+  while (true) {
+    auto status = readEvents(events, seen);
+    if (!status.ok()) {
+      return status;
     }
 
-    if (event->mask & IN_IGNORED) {
-      // This inotify watch was removed.
-      removeMonitor(event->wd, false);
-    } else if (event->mask & IN_MOVE_SELF) {
-      // This inotify path was moved, but is still watched.
-      removeMonitor(event->wd, true);
-    } else if (event->mask & IN_DELETE_SELF) {
-      // A file was moved to replace the watched path.
-      removeMonitor(event->wd, false);
-    } else {
-      auto ec = createEventContextFrom(event);
-      if (!ec->action.empty()) {
-        fire(ec);
-      }
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         window - std::chrono::steady_clock::now())
+                         .count();
+    if (remaining <= 0 || isEnding() ||
+        ::epoll_wait(epoll_handle_, &event, 1, remaining) <= 0) {
+      break;
     }
-    // Continue to iterate
-    p += (sizeof(struct inotify_event)) + event->len;
   }
 
-  pauseMilli(kINotifyMLatency);
+  for (const auto& ec : events) {
+    fire(ec);
+  }
   return Status(0, "OK");
 }
 
+Status INotifyEventPublisher::readEvents(
+    std::vector<INotifyEventContextRef>& events, INotifyEventKeys& seen) {
+  alignas(struct inotify_event) char buffer[kINotifyBufferSize];
+  while (true) {
+    ssize_t record_num = ::read(getHandle(), buffer, kINotifyBufferSize);
+    if (record_num == -1 && errno == EINTR) {
+      continue;
+    } else if (record_num == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // The queue is empty.
+      return Status(0, "OK");
+    } else if (record_num <= 0) {
+      return Status(1, "INotify read failed");
+    }
+
+    for (char* p = buffer; p < buffer + record_num;) {
+      auto event = reinterpret_cast<struct inotify_event*>(p);
+      // Continue to iterate
+      p += (sizeof(struct inotify_event)) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // The inotify queue was overflown (remove all paths).
+        overflow_count_++;
+        Status stat = restartMonitoring();
+        if (!stat.ok()) {
+          return stat;
+        }
+        continue;
+      }
+
+      if (event->mask & IN_IGNORED) {
+        // This inotify watch was removed.
+        removeMonitor(event->wd, false);
+      } else if (event->mask & IN_MOVE_SELF) {
+        // This inotify path was moved, but is still watched.
+        removeMonitor(event->wd, true);
+      } else if (event->mask & IN_DELETE_SELF) {
+        // A file was moved to replace the watched path.
+        removeMonitor(event->wd, false);
+      } else {
+        auto key = std::make_tuple(event->wd,
+                                   event->mask,
+                                   event->cookie,
+                                   std::string((event->len > 0) ? event->name
+                                                                : ""));
+        if (!seen.insert(std::move(key)).second) {
+          // The same change was already read within this window.
+          coalesced_count_++;
+          continue;
+        }
+
+        auto ec = createEventContextFrom(event);
+        if (!ec->action.empty()) {
+          events.push_back(ec);
+        }
+      }
+    }
+  }
+}
+
 INotifyEventContextRef INotifyEventPublisher::createEventContextFrom(
     struct inotify_event* event) const {
   auto shared_event = std::make_shared<struct inotify_event>(*event);
@@ -240,19 +411,7 @@ bool INotifyEventPublisher::shouldFire(const INotifySubscriptionContextRef& sc,
     return false;
   }
 
-  if (sc->recursive && !sc->recursive_match) {
-    ssize_t found = ec->path.find(sc->path);
-    if (found != 0) {
-      return false;
-    }
-  } else if (ec->path == sc->path) {
-    return true;
-  } else if (fnmatch((sc->path + "*").c_str(),
-                     ec->path.c_str(),
-                     FNM_PATHNAME | FNM_CASEFOLD |
-                         ((sc->recursive_match) ? FNM_LEADING_DIR : 0)) != 0) {
-    // Only apply a leading-dir match if this is a recursive watch with a
-    // match requirement (an inline wildcard with ending recursive wildcard).
+  if (!matchSubscriptionPath(*sc, ec->path)) {
     return false;
   }
 
@@ -265,6 +424,28 @@ bool INotifyEventPublisher::shouldFire(const INotifySubscriptionContextRef& sc,
   return true;
 }
 
+bool matchSubscriptionPath(const INotifySubscriptionContext& sc,
+                           const std::string& path) {
+  if (sc.recursive && !sc.recursive_match) {
+    return path.compare(0, sc.path.size(), sc.path) == 0;
+  } else if (path == sc.path) {
+    return true;
+  }
+
+  // Subscriptions are configured with a pattern, others build one.
+  std::string pattern;
+  if (sc.pattern_.empty()) {
+    pattern = sc.path + '*';
+  }
+
+  // Only apply a leading-dir match if this is a recursive watch with a
+  // match requirement (an inline wildcard with ending recursive wildcard).
+  return fnmatch((sc.pattern_.empty()) ? pattern.c_str() : sc.pattern_.c_str(),
+                 path.c_str(),
+                 FNM_PATHNAME | FNM_CASEFOLD |
+                     ((sc.recursive_match) ? FNM_LEADING_DIR : 0)) == 0;
+}
+
 bool INotifyEventPublisher::addMonitor(const std::string& path,
                                        uint32_t mask,
                                        bool recursive,
@@ -347,6 +528,7 @@ void INotifyEventPublisher::removeSubscriptions(const std::string& subscriber) {
     removeMonitor(path.first, true);
   }
   EventPublisherPlugin::removeSubscriptions(subscriber);
+  indexSubscriptions();
 }
 
 bool INotifyEventPublisher::isPathMonitored(const std::string& path) const {
@@ -11,11 +11,16 @@
 #pragma once
 
 #include <map>
+#include <set>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include <sys/inotify.h>
 #include <sys/stat.h>
 
+#include <boost/noncopyable.hpp>
+
 #include <osquery/events.h>
 
 namespace osquery {
@@ -71,10 +76,25 @@ struct INotifySubscriptionContext : public SubscriptionContext {
   /// A configure-time pattern was expanded to match absolute paths.
   bool recursive_match{false};
 
+  /// The fnmatch pattern applied to event paths, built during configure.
+  std::string pattern_;
+
  private:
   friend class INotifyEventPublisher;
+  friend class FANotifyEventPublisher;
+  friend bool matchSubscriptionPath(const INotifySubscriptionContext& sc,
+                                    const std::string& path);
 };
 
+/**
+ * @brief Match an event path to a configured subscription path.
+ *
+ * Recursive subscriptions match any path below their directory, otherwise
+ * the path must match the subscription's pattern (ignoring case).
+ */
+bool matchSubscriptionPath(const INotifySubscriptionContext& sc,
+                           const std::string& path);
+
 /**
  * @brief Event details for INotifyEventPublisher events.
  */
@@ -98,9 +118,60 @@ using INotifySubscriptionContextRef =
 
 // Publisher containers
 using DescriptorVector = std::vector<int>;
+using INotifyEventKeys =
+    std::set<std::tuple<int, uint32_t, uint32_t, std::string>>;
 using PathDescriptorMap = std::map<std::string, int>;
 using DescriptorPathMap = std::map<int, std::string>;
 
+/**
+ * @brief An index of Subscription%s by the literal prefix of their paths.
+ *
+ * Subscription paths are split into '/'-terminated components and stored in
+ * a trie at the node of their last complete component. The remainder of the
+ * prefix, up to the first wildcard, is kept at that node. Finding candidates
+ * for an event path walks the trie once, so the cost depends on the depth of
+ * the path and not on the number of Subscription%s. Matching ignores case,
+ * the same as the `fnmatch` applied by `shouldFire`, so the candidates are a
+ * superset of the matching Subscription%s.
+ */
+class INotifyPathIndex : private boost::noncopyable {
+ public:
+  /// Index a Subscription using the literal prefix of a path.
+  void insert(const std::string& path, const SubscriptionRef& subscription);
+
+  /// Append Subscription%s with a prefix matching the event path.
+  void find(const std::string& path, SubscriptionVector& subscriptions) const;
+
+  /// Remove all indexed Subscription%s.
+  void clear();
+
+  /// The number of indexed Subscription%s.
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  struct Node {
+    /// Child nodes keyed by a path component, including the trailing '/'.
+    std::unordered_map<std::string, std::unique_ptr<Node>> children;
+
+    /// Subscription%s with a prefix ending at this component.
+    SubscriptionVector subscriptions;
+
+    /// Subscription%s with a prefix ending within the next component.
+    std::map<std::string, SubscriptionVector> partial;
+
+    /// The distinct lengths of the partial prefixes.
+    std::set<size_t> partial_sizes;
+  };
+
+  /// The root node, the empty prefix.
+  Node root_;
+
+  /// The number of indexed Subscription%s.
+  size_t size_{0};
+};
+
 /**
  * @brief A Linux `inotify` EventPublisher.
  *
@@ -142,6 +213,19 @@ class INotifyEventPublisher
   INotifyEventContextRef createEventContextFrom(
       struct inotify_event* event) const;
 
+  /**
+   * @brief Read queued `inotify` events until the queue is empty.
+   *
+   * Events with the same watch, mask, cookie, and name as an event already
+   * read are coalesced, the first is kept and later duplicates are counted.
+   *
+   * @param events Output, event contexts to fire in the order they were read.
+   * @param seen The keys of events read within the current window.
+   * @return success unless the handle failed or could not be restarted.
+   */
+  Status readEvents(std::vector<INotifyEventContextRef>& events,
+                    INotifyEventKeys& seen);
+
   /// Check if the application-global `inotify` handle is alive.
   bool isHandleOpen() const {
     return inotify_handle_ > 0;
@@ -182,6 +266,13 @@ class INotifyEventPublisher
   bool shouldFire(const INotifySubscriptionContextRef& mc,
                   const INotifyEventContextRef& ec) const override;
 
+  /// Use the path index to select candidate Subscription%s for an event.
+  bool selectSubscriptions(const EventContextRef& ec,
+                           SubscriptionVector& subscriptions) const override;
+
+  /// Rebuild the path index from the configured Subscription%s.
+  void indexSubscriptions();
+
   /// Get the INotify file descriptor.
   int getHandle() const {
     return inotify_handle_;
@@ -207,18 +298,30 @@ class INotifyEventPublisher
   /// The inotify file descriptor handle.
   std::atomic<int> inotify_handle_{-1};
 
+  /// The epoll descriptor used to wait for the inotify handle.
+  std::atomic<int> epoll_handle_{-1};
+
   /// Time in seconds of the last inotify restart.
   std::atomic<int> last_restart_{-1};
 
   /// Access to path and descriptor mappings.
   mutable Mutex path_mutex_;
 
+  /// Subscription%s indexed by path, see selectSubscriptions.
+  INotifyPathIndex path_index_;
+
+  /// Access to the Subscription path index.
+  mutable SharedMutex index_mutex_;
+
  public:
   friend class INotifyTests;
+  friend class INotifyBenchmark;
   FRIEND_TEST(INotifyTests, test_inotify_init);
   FRIEND_TEST(INotifyTests, test_inotify_optimization);
   FRIEND_TEST(INotifyTests, test_inotify_recursion);
   FRIEND_TEST(INotifyTests, test_inotify_match_subscription);
   FRIEND_TEST(INotifyTests, test_inotify_embedded_wildcards);
+  FRIEND_TEST(INotifyTests, test_inotify_path_index);
+  FRIEND_TEST(INotifyTests, test_inotify_coalesce);
 };
 }
@@ -68,6 +68,37 @@ TEST_F(AuditTests, test_handle_reply) {
   EXPECT_EQ(ec->fields["a2"], "c");
 }
 
+TEST_F(AuditTests, test_record_queue) {
+  AuditRecordQueue queue(2);
+  EXPECT_EQ(queue.capacity(), 2U);
+  EXPECT_EQ(queue.size(), 0U);
+
+  AuditRecord record;
+  EXPECT_FALSE(queue.pop(record));
+
+  // The queue rejects records once it is full.
+  std::string message = "audit(1440542781.644:403030): argc=1 a0=c";
+  EXPECT_TRUE(queue.push(AUDIT_EXECVE, message.data(), message.size()));
+  EXPECT_TRUE(queue.push(AUDIT_CWD, message.data(), 5));
+  EXPECT_FALSE(queue.push(AUDIT_PATH, message.data(), message.size()));
+  EXPECT_EQ(queue.size(), 2U);
+
+  // Records are popped in the order they were pushed.
+  EXPECT_TRUE(queue.pop(record));
+  EXPECT_EQ(record.type, AUDIT_EXECVE);
+  EXPECT_EQ(record.message, message);
+  EXPECT_TRUE(queue.pop(record));
+  EXPECT_EQ(record.type, AUDIT_CWD);
+  EXPECT_EQ(record.message, "audit");
+  EXPECT_FALSE(queue.pop(record));
+
+  // The ring wraps around after slots are freed.
+  EXPECT_TRUE(queue.push(AUDIT_PATH, message.data(), message.size()));
+  EXPECT_EQ(queue.size(), 1U);
+  EXPECT_TRUE(queue.pop(record));
+  EXPECT_EQ(record.type, AUDIT_PATH);
+}
+
 TEST_F(AuditTests, test_audit_value_decode) {
   // In the normal case the decoding only removes '"' characters from the ends.
   auto decoded_normal = decodeAuditValue("\"/bin/ls\"");
@@ -0,0 +1,105 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <gtest/gtest.h>
+
+#include <osquery/events.h>
+#include <osquery/filesystem.h>
+
+#include "osquery/events/linux/fanotify.h"
+#include "osquery/tests/test_util.h"
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+class FANotifyTests : public testing::Test {};
+
+TEST_F(FANotifyTests, test_fanotify_disabled) {
+  // The publisher is opt-in, file events continue to use inotify.
+  auto pub = std::make_shared<FANotifyEventPublisher>();
+  EXPECT_FALSE(pub->setUp().ok());
+  EXPECT_EQ(getFileEventsType(), "inotify");
+}
+
+TEST_F(FANotifyTests, test_fanotify_subscription) {
+  auto pub = std::make_shared<FANotifyEventPublisher>();
+
+  // Directories are normalized like inotify subscriptions.
+  auto sc = pub->createSubscriptionContext();
+  sc->path = kTestWorkingDirectory;
+  pub->monitorSubscription(sc);
+  EXPECT_EQ(sc->path.back(), '/');
+
+  auto recursive = pub->createSubscriptionContext();
+  recursive->path = "/fake/var/log/**";
+  pub->monitorSubscription(recursive);
+  EXPECT_TRUE(recursive->recursive);
+  EXPECT_EQ(recursive->path, "/fake/var/log/");
+
+  auto leaf = pub->createSubscriptionContext();
+  leaf->path = "/fake/etc/*.conf";
+  leaf->mask = IN_CLOSE_WRITE;
+  pub->monitorSubscription(leaf);
+  EXPECT_EQ(leaf->path, "/fake/etc/*.conf");
+
+  pub->subscriptions_.push_back(Subscription::create("TestSubscriber", sc));
+  pub->subscriptions_.push_back(
+      Subscription::create("TestSubscriber", recursive));
+  pub->subscriptions_.push_back(Subscription::create("TestSubscriber", leaf));
+  pub->indexSubscriptions();
+
+  // New directories below a recursive subscription need no configuration.
+  auto ec = pub->createEventContext();
+  ec->event = std::make_shared<struct inotify_event>();
+  ec->event->mask = IN_CLOSE_WRITE;
+  ec->path = "/fake/var/log/nginx/new/access.log";
+  SubscriptionVector candidates;
+  EXPECT_TRUE(pub->selectSubscriptions(ec, candidates));
+  ASSERT_EQ(candidates.size(), 1U);
+  EXPECT_EQ(candidates[0]->context, recursive);
+  EXPECT_TRUE(pub->shouldFire(recursive, ec));
+
+  ec->path = "/fake/etc/resolv.conf";
+  EXPECT_TRUE(pub->shouldFire(leaf, ec));
+  ec->event->mask = IN_MODIFY;
+  EXPECT_FALSE(pub->shouldFire(leaf, ec));
+  ec->path = "/fake/etc/passwd";
+  EXPECT_FALSE(pub->shouldFire(leaf, ec));
+}
+
+TEST_F(FANotifyTests, test_fanotify_event_context) {
+  auto pub = std::make_shared<FANotifyEventPublisher>();
+
+  auto path = kTestWorkingDirectory + "fanotify-trigger";
+  writeTextFile(path, "fanotify");
+  auto canonical = fs::canonical(path).string();
+
+  // Events include an open descriptor, the path is resolved from it.
+  struct fanotify_event_metadata metadata;
+  metadata.vers = FANOTIFY_METADATA_VERSION;
+  metadata.mask = FAN_CLOSE_WRITE;
+  metadata.fd = ::open(canonical.c_str(), O_RDONLY);
+  metadata.pid = 0;
+  ASSERT_GT(metadata.fd, 0);
+
+  auto ec = pub->createEventContextFrom(&metadata);
+  ::close(metadata.fd);
+  EXPECT_EQ(ec->path, canonical);
+  EXPECT_EQ(ec->action, "UPDATED");
+  EXPECT_EQ(ec->event->mask, static_cast<uint32_t>(IN_CLOSE_WRITE));
+  remove(path);
+}
+}
@@ -8,7 +8,9 @@
  *
  */
 
+#include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
@@ -501,4 +503,108 @@ TEST_F(INotifyTests, test_inotify_embedded_wildcards) {
   ASSERT_EQ(event_pub_->numDescriptors(), 1U);
   EXPECT_EQ(event_pub_->path_descriptors_.count(real_test_dir + "/2/1/"), 1U);
 }
+
+TEST_F(INotifyTests, test_inotify_path_index) {
+  auto pub = std::make_shared<INotifyEventPublisher>();
+
+  std::vector<std::string> paths = {
+      "/fake/etc/passwd",
+      "/fake/etc/*",
+      "/fake/ETC/hosts",
+      "/fake/var/log/**",
+      "/fake/usr/bin/s?",
+      "/fake/usr/",
+      "/fake/usr/sbin/*/local",
+  };
+  for (const auto& path : paths) {
+    auto sc = pub->createSubscriptionContext();
+    sc->path = path;
+    pub->monitorSubscription(sc, false);
+    pub->subscriptions_.push_back(Subscription::create("TestSubscriber", sc));
+  }
+  pub->indexSubscriptions();
+  EXPECT_EQ(pub->path_index_.size(), paths.size());
+
+  std::vector<std::string> events = {
+      "/fake/etc/passwd",
+      "/fake/etc/hosts",
+      "/fake/etc/ssh/sshd_config",
+      "/fake/var/log/nginx/access.log",
+      "/fake/usr/bin/ssh",
+      "/fake/usr/bin/ls",
+      "/fake/usr/sbin/x/local",
+      "/other/etc/passwd",
+  };
+  for (const auto& path : events) {
+    auto ec = pub->createEventContext();
+    ec->event = std::make_shared<struct inotify_event>();
+    ec->event->mask = IN_MODIFY;
+    ec->path = path;
+    ec->action = "UPDATED";
+
+    // The indexed candidates must include every matching subscription.
+    SubscriptionVector candidates;
+    EXPECT_TRUE(pub->selectSubscriptions(ec, candidates));
+    EXPECT_LE(candidates.size(), paths.size());
+
+    std::set<Subscription*> expected;
+    for (const auto& sub : pub->subscriptions_) {
+      if (pub->shouldFire(pub->getSubscriptionContext(sub->context), ec)) {
+        expected.insert(sub.get());
+      }
+    }
+    std::set<Subscription*> matched;
+    for (const auto& sub : candidates) {
+      if (pub->shouldFire(pub->getSubscriptionContext(sub->context), ec)) {
+        matched.insert(sub.get());
+      }
+    }
+    EXPECT_EQ(expected, matched) << path;
+  }
+
+  // An unrelated path only considers the subscriptions on its prefix.
+  auto ec = pub->createEventContext();
+  ec->path = "/other/etc/passwd";
+  SubscriptionVector candidates;
+  pub->selectSubscriptions(ec, candidates);
+  EXPECT_TRUE(candidates.empty());
+
+  // Until the publisher is configured new subscriptions use a full scan.
+  auto sc = pub->createSubscriptionContext();
+  sc->path = "/other/";
+  pub->subscriptions_.push_back(Subscription::create("TestSubscriber", sc));
+  EXPECT_FALSE(pub->selectSubscriptions(ec, candidates));
+}
+
+TEST_F(INotifyTests, test_inotify_coalesce) {
+  event_pub_ = std::make_shared<INotifyEventPublisher>();
+  EventFactory::registerEventPublisher(event_pub_);
+
+  FILE* fd = fopen(real_test_path.c_str(), "w");
+  fclose(fd);
+  event_pub_->addMonitor(real_test_path, kFileDefaultMasks, false);
+
+  // Each write is followed by a close, the kernel only merges identical
+  // events that are queued consecutively.
+  for (size_t i = 0; i < 5; i++) {
+    auto handle = ::open(real_test_path.c_str(), O_WRONLY);
+    auto written = ::write(handle, "inotify", 7);
+    EXPECT_EQ(written, 7);
+    ::close(handle);
+  }
+
+  // The queue is drained and only the first update and close are kept.
+  std::vector<INotifyEventContextRef> events;
+  INotifyEventKeys seen;
+  EXPECT_TRUE(event_pub_->readEvents(events, seen).ok());
+  EXPECT_EQ(events.size(), 2U);
+  EXPECT_EQ(event_pub_->coalescedCount(), 8U);
+  EXPECT_EQ(event_pub_->overflowCount(), 0U);
+
+  // Reading an empty queue does not block.
+  events.clear();
+  EXPECT_TRUE(event_pub_->readEvents(events, seen).ok());
+  EXPECT_TRUE(events.empty());
+  EventFactory::deregisterEventPublisher("inotify");
+}
 }
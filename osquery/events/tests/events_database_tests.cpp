@@ -8,7 +8,8 @@
  *
  */
 
-#include <boost/algorithm/string.hpp>
+#include <thread>
+
 #include <boost/filesystem/operations.hpp>
 
 #include <gtest/gtest.h>
@@ -27,6 +28,7 @@ namespace osquery {
 
 DECLARE_uint64(events_expiry);
 DECLARE_uint64(events_max);
+DECLARE_uint64(events_batch_size);
 DECLARE_bool(events_optimize);
 
 class EventsDatabaseTests : public ::testing::Test {
@@ -68,6 +70,13 @@ class DBFakeEventSubscriber : public EventSubscriber<DBFakeEventPublisher> {
     r["uptime"] = INTEGER(10);
     return add(r, t);
   }
+
+  /// Add a fake event at time t with a pid column
+  Status testAddPid(int t, int pid) {
+    Row r;
+    r["pid"] = INTEGER(pid);
+    return add(r, t);
+  }
 };
 
 TEST_F(EventsDatabaseTests, test_event_module_id) {
@@ -87,36 +96,87 @@ TEST_F(EventsDatabaseTests, test_event_add) {
   EXPECT_TRUE(status.ok());
 }
 
-TEST_F(EventsDatabaseTests, test_record_indexing) {
+TEST_F(EventsDatabaseTests, test_event_batch) {
   auto sub = std::make_shared<DBFakeEventSubscriber>();
-  auto status = sub->testAdd(2);
-  status = sub->testAdd(11);
-  status = sub->testAdd(61);
-  status = sub->testAdd((1 * 3600) + 1);
-  status = sub->testAdd((2 * 3600) + 1);
+  auto batch_size = FLAGS_events_batch_size;
+  FLAGS_events_batch_size = 4;
+
+  // Events within the flush window remain staged.
+  auto t = getUnixTime();
+  sub->testAdd(t);
+  // Keep the flush window open regardless of the test duration.
+  sub->staged_time_ = t + 3600;
+  sub->testAdd(t + 61);
+  sub->testAdd(t + 62);
+
+  auto data_key = "data." + sub->dbNamespace();
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kEvents, keys, data_key);
+  EXPECT_EQ(0U, keys.size());
+  EXPECT_EQ(3U, sub->staged_events_.size());
+
+  // Filling the staging buffer writes the batch.
+  sub->testAdd(t + 63);
+  EXPECT_EQ(0U, sub->staged_events_.size());
+  scanDatabaseKeys(kEvents, keys, data_key);
+  EXPECT_EQ(4U, keys.size());
 
-  // An "all" range, will pick up everything in the largest index.
-  auto indexes = sub->getIndexes(0, 3 * 3600);
-  auto output = boost::algorithm::join(indexes, ", ");
-  EXPECT_EQ("60.0, 60.1, 60.60, 60.120", output);
-
-  // Restrict range to "most specific", which is an index by 10.
-  indexes = sub->getIndexes(0, 5);
-  output = boost::algorithm::join(indexes, ", ");
-  // The order 10, 0th index include results with t = [0, 10).
-  EXPECT_EQ("60.0", output);
-
-  // Add specific indexes to the upper bound.
-  status = sub->testAdd((2 * 3600) + 11);
-  status = sub->testAdd((2 * 3600) + 61);
-  indexes = sub->getIndexes(2 * 3600, (2 * 3600) + 62);
-  output = boost::algorithm::join(indexes, ", ");
-  EXPECT_EQ("60.120, 60.121", output);
-
-  // Request specific lower and upper bounding.
-  indexes = sub->getIndexes(2, (2 * 3600) + 62);
-  output = boost::algorithm::join(indexes, ", ");
-  EXPECT_EQ("60.0, 60.1, 60.60, 60.120, 60.121", output);
+  // The EventID counter is persisted with the batch.
+  std::string content;
+  getDatabaseValue(kEvents, "eid." + sub->dbNamespace(), content);
+  EXPECT_EQ("4", content);
+
+  // Staged events are flushed before records are read.
+  sub->testAdd(t + 64);
+  DatabaseStringValueList records;
+  sub->getRecords(0, 0, records);
+  EXPECT_EQ(5U, records.size());
+  FLAGS_events_batch_size = batch_size;
+}
+
+TEST_F(EventsDatabaseTests, test_event_stage_age) {
+  auto sub = std::make_shared<DBFakeEventSubscriber>();
+  auto t = getUnixTime();
+  sub->testAdd(t);
+  sub->staged_time_ = t + 3600;
+  sub->testAdd(t);
+  EXPECT_EQ(2U, sub->staged_events_.size());
+
+  // Staged events within the flush window are kept without new events.
+  EXPECT_TRUE(sub->flushStagedEvents(t + 3600).ok());
+  EXPECT_EQ(2U, sub->staged_events_.size());
+
+  // Once the oldest staged event is too old, the publisher loop flushes.
+  EXPECT_TRUE(sub->flushStagedEvents(t + 3601).ok());
+  EXPECT_EQ(0U, sub->staged_events_.size());
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kEvents, keys, "data." + sub->dbNamespace());
+  EXPECT_EQ(2U, keys.size());
+}
+
+TEST_F(EventsDatabaseTests, test_record_keys) {
+  auto sub = std::make_shared<DBFakeEventSubscriber>();
+  // Add events out of time order.
+  sub->testAdd(0x10);
+  sub->testAdd(2);
+  sub->testAdd(0x10);
+
+  // Records are keyed by fixed-width hex time then EventID.
+  DatabaseStringValueList records;
+  sub->getRecords(0, 0, records);
+  ASSERT_EQ(3U, records.size());
+  auto prefix = "data." + sub->dbNamespace() + ".";
+  EXPECT_EQ(prefix + "0000000000000002" + "0000000000000002",
+            records[0].first);
+  EXPECT_EQ(prefix + "0000000000000010" + "0000000000000001",
+            records[1].first);
+  EXPECT_EQ(prefix + "0000000000000010" + "0000000000000003",
+            records[2].first);
+
+  // The value is the serialized row.
+  Row r;
+  EXPECT_TRUE(deserializeRowJSON(records[0].second, r).ok());
+  EXPECT_EQ("2", r["time"]);
 }
 
 TEST_F(EventsDatabaseTests, test_record_range) {
@@ -128,39 +188,36 @@ TEST_F(EventsDatabaseTests, test_record_range) {
   status = sub->testAdd((1 * 3600) + 1);
   status = sub->testAdd((2 * 3600) + 1);
 
-  // Search within a specific record range.
-  auto indexes = sub->getIndexes(0, 10);
-  EXPECT_EQ(1U, indexes.size());
-  auto records = sub->getRecords(indexes);
-  // This will return 3 results, ::get filters records by an absolute range.
+  // Search within a specific record range, both bounds are inclusive.
+  DatabaseStringValueList records;
+  sub->getRecords(0, 11, records);
   EXPECT_EQ(3U, records.size()); // 1, 2, 11
 
   // Search within a large bound.
-  indexes = sub->getIndexes(3, 3601);
-  // This will include the 0-10 bucket meaning 1, 2 will show up.
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(5U, records.size()); // 1, 2, 11, 61, 3601
+  records.clear();
+  sub->getRecords(3, 3601, records);
+  EXPECT_EQ(3U, records.size()); // 11, 61, 3601
 
   // Get all of the records.
-  indexes = sub->getIndexes(0, 3 * 3600);
-  records = sub->getRecords(indexes);
+  records.clear();
+  sub->getRecords(0, 3 * 3600, records);
   EXPECT_EQ(6U, records.size()); // 1, 2, 11, 61, 3601, 7201
 
   // stop = 0 is an alias for everything.
-  indexes = sub->getIndexes(0, 0);
-  records = sub->getRecords(indexes);
+  records.clear();
+  sub->getRecords(0, 0, records);
   EXPECT_EQ(6U, records.size());
 
   for (size_t j = 0; j < 30; j++) {
-    // 110 is 10 below an index (60.2).
     sub->testAdd(110 + j);
   }
 
-  indexes = sub->getIndexes(110, 0);
-  auto output = boost::algorithm::join(indexes, ", ");
-  EXPECT_EQ("60.1, 60.2, 60.60, 60.120", output);
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(33U, records.size()); // (61) 110 - 139 + 3601, 7201
+  records.clear();
+  sub->getRecords(110, 0, records);
+  EXPECT_EQ(32U, records.size()); // 110 - 139, 3601, 7201
+
+  // The query-time API applies the same range.
+  EXPECT_EQ(30U, sub->get(110, 139).size());
 }
 
 TEST_F(EventsDatabaseTests, test_record_expiration) {
@@ -173,36 +230,71 @@ TEST_F(EventsDatabaseTests, test_record_expiration) {
   status = sub->testAdd((2 * 3600) + 1);
 
   // No expiration
-  auto indexes = sub->getIndexes(0, 5000);
-  auto records = sub->getRecords(indexes);
+  DatabaseStringValueList records;
+  sub->getRecords(0, 5000, records);
   EXPECT_EQ(5U, records.size()); // 1, 2, 11, 61, 3601
 
   sub->expire_events_ = true;
   sub->expire_time_ = 10;
-  indexes = sub->getIndexes(0, 5000);
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(3U, records.size()); // 11, 61, 3601
-
-  indexes = sub->getIndexes(0, 5000);
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(3U, records.size()); // 11, 61, 3601
-
-  indexes = sub->getIndexes(0, 5000);
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(3U, records.size()); // 11, 61, 3601
-
-  indexes = sub->getIndexes(0, 5000);
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(3U, records.size()); // 11, 61, 3601
+  for (size_t i = 0; i < 3; i++) {
+    records.clear();
+    sub->getRecords(0, 5000, records);
+    EXPECT_EQ(3U, records.size()); // 11, 61, 3601
+  }
 
   // Check that get/deletes did not act on cache.
   // This implies that RocksDB is flushing the requested delete records.
   sub->expire_time_ = 0;
-  indexes = sub->getIndexes(0, 5000);
-  records = sub->getRecords(indexes);
+  records.clear();
+  sub->getRecords(0, 5000, records);
   EXPECT_EQ(3U, records.size()); // 11, 61, 3601
 }
 
+TEST_F(EventsDatabaseTests, test_indexed_records) {
+  auto sub = std::make_shared<DBFakeEventSubscriber>();
+  sub->indexed_columns_ = {"pid"};
+  sub->testAddPid(1, 1);
+  sub->testAddPid(2, 2);
+  sub->testAddPid(3, 1);
+  sub->testAddPid(4, 10);
+
+  // Only the matching records are returned, values are not prefix matched.
+  auto results = sub->get(0, 0, "pid", "1");
+  ASSERT_EQ(2U, results.size());
+  EXPECT_EQ("1", results[0]["time"]);
+  EXPECT_EQ("3", results[1]["time"]);
+  EXPECT_EQ(1U, sub->get(0, 0, "pid", "10").size());
+  EXPECT_EQ(0U, sub->get(0, 0, "pid", "3").size());
+
+  // The time range applies to indexed selects.
+  EXPECT_EQ(1U, sub->get(2, 4, "pid", "1").size());
+
+  // A table equality constraint selects using the index.
+  QueryContext context;
+  context.constraints["pid"].add(Constraint(EQUALS, "10"));
+  results = sub->genTable(context);
+  ASSERT_EQ(1U, results.size());
+  EXPECT_EQ("4", results[0]["time"]);
+
+  // Expiring records also removes their index entries.
+  auto index_key = "index." + sub->dbNamespace();
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kEvents, keys, index_key);
+  EXPECT_EQ(4U, keys.size());
+
+  sub->expire_events_ = true;
+  sub->expire_time_ = 2;
+  EXPECT_EQ(1U, sub->get(0, 0, "pid", "1").size());
+  keys.clear();
+  scanDatabaseKeys(kEvents, keys, index_key);
+  EXPECT_EQ(2U, keys.size());
+
+  // The time-ordered entries used to find expired index entries are removed.
+  keys.clear();
+  scanDatabaseKeys(kEvents, keys, "expire." + sub->dbNamespace());
+  EXPECT_EQ(2U, keys.size());
+}
+
 TEST_F(EventsDatabaseTests, test_gentable) {
   auto sub = std::make_shared<DBFakeEventSubscriber>();
   auto status = sub->testAdd(1);
@@ -212,7 +304,6 @@ TEST_F(EventsDatabaseTests, test_gentable) {
   status = sub->testAdd((1 * 3600) + 1);
   status = sub->testAdd((2 * 3600) + 1);
 
-  ASSERT_EQ(0U, sub->optimize_time_);
   ASSERT_EQ(0U, sub->expire_time_);
 
   auto t = getUnixTime();
@@ -223,11 +314,12 @@ TEST_F(EventsDatabaseTests, test_gentable) {
   // Test the expire workflow by creating a short expiration time.
   FLAGS_events_expiry = 10;
 
+  // Write the staged events before inspecting the backing store.
+  sub->flushEvents();
   std::vector<std::string> keys;
   scanDatabaseKeys("events", keys);
-  // 9 data records, 1 eid counter, 3 indexes, 15 index records.
-  // Depending on the moment, an additional 3 indexs may be introduced.
-  EXPECT_LE(16U, keys.size());
+  // 9 data records, 1 eid counter.
+  EXPECT_LE(10U, keys.size());
 
   // Perform a "select" equivalent.
   QueryContext context;
@@ -238,8 +330,6 @@ TEST_F(EventsDatabaseTests, test_gentable) {
   // The expiration time is now - events_expiry.
   EXPECT_LT(t - (FLAGS_events_expiry * 2), sub->expire_time_);
   EXPECT_GT(t, sub->expire_time_);
-  // The optimize time will not be changed.
-  ASSERT_EQ(0U, sub->optimize_time_);
 
   results = sub->genTable(context);
   EXPECT_EQ(3U, results.size());
@@ -249,7 +339,7 @@ TEST_F(EventsDatabaseTests, test_gentable) {
 
   keys.clear();
   scanDatabaseKeys("events", keys);
-  EXPECT_LE(6U, keys.size());
+  EXPECT_LE(4U, keys.size());
 }
 
 TEST_F(EventsDatabaseTests, test_optimize) {
@@ -263,8 +353,8 @@ TEST_F(EventsDatabaseTests, test_optimize) {
   kToolType = ToolType::DAEMON;
   FLAGS_events_optimize = true;
 
-  // Must also define an executing query.
-  setDatabaseValue(kPersistentSettings, kExecutingQuery, "events_db_test");
+  // Must also define an executing query on this thread.
+  Config::getInstance().recordQueryStart("events_db_test");
 
   QueryContext context;
   auto t = getUnixTime();
@@ -272,10 +362,14 @@ TEST_F(EventsDatabaseTests, test_optimize) {
   EXPECT_EQ(10U, results.size());
   // Optimization will set the time NOW as the minimum event time.
   // Thus it is not possible to set event in past.
-  EXPECT_GE(sub->optimize_time_ + 100, t);
-  EXPECT_LE(sub->optimize_time_ - 100, t);
+  std::string content;
+  getDatabaseValue("events", "optimize.events_db_test", content);
+  auto optimize_time = std::stoull(content);
+  EXPECT_GE(optimize_time + 100, t);
+  EXPECT_LE(optimize_time - 100, t);
   // The last EID returned will also be stored for duplication checks.
-  EXPECT_EQ(10U, sub->optimize_eid_);
+  getDatabaseValue("events", "optimize_eid.events_db_test", content);
+  EXPECT_EQ("10", content);
 
   for (size_t i = t + 800; i < t + 800 + 10; ++i) {
     sub->testAdd(i);
@@ -283,11 +377,26 @@ TEST_F(EventsDatabaseTests, test_optimize) {
   results = sub->genTable(context);
   EXPECT_EQ(10U, results.size());
 
-  // The optimize time should have been written to the database.
-  // It should be the same as the current (relative) optimize time.
-  std::string content;
+  // Another query keeps its own optimization state for the same table.
+  std::thread([&sub, &context]() {
+    Config::getInstance().recordQueryStart("events_db_other");
+    EXPECT_EQ(20U, sub->genTable(context).size());
+    Config::getInstance().recordQueryEnd("events_db_other");
+  }).join();
+  getDatabaseValue("events", "optimize_eid.events_db_other", content);
+  EXPECT_EQ("20", content);
   getDatabaseValue("events", "optimize.events_db_test", content);
-  EXPECT_EQ(std::to_string(sub->optimize_time_), content);
+  EXPECT_GE(std::stoull(content), optimize_time);
+
+  // Another thread's query must not read or write this query's state.
+  std::string other_name;
+  std::thread([&other_name]() {
+    other_name = Config::getExecutingQuery();
+  }).join();
+  EXPECT_TRUE(other_name.empty());
+
+  Config::getInstance().recordQueryEnd("events_db_test");
+  EXPECT_TRUE(Config::getExecutingQuery().empty());
 
   // Restore the tool type.
   kToolType = default_type;
@@ -327,16 +436,11 @@ TEST_F(EventsDatabaseTests, test_expire_check) {
         sub->testAdd(t++);
       }
 
-      // Records hold the event_id + time indexes.
-      // Data hosts the event_id + JSON content.
-      auto record_key = "records." + sub->dbNamespace();
+      // Data hosts the time + event_id keyed JSON content.
       auto data_key = "data." + sub->dbNamespace();
 
-      std::vector<std::string> records, datas;
-      scanDatabaseKeys(kEvents, records, record_key);
+      std::vector<std::string> datas;
       scanDatabaseKeys(kEvents, datas, data_key);
-
-      EXPECT_LT(records.size(), 20U);
       EXPECT_LT(datas.size(), 60U);
     }
   }
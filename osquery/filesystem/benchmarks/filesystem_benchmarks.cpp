@@ -0,0 +1,93 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/filesystem.h>
+
+#include "osquery/filesystem/fileops.h"
+#include "osquery/tests/test_util.h"
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+/// Each synthetic directory includes this many files and directories.
+const size_t kBenchmarkFanout = 10;
+
+/**
+ * @brief Create (once) a synthetic tree with a number of entries.
+ *
+ * Directories are filled breadth first, so the tree depth grows with the
+ * number of entries like a real filesystem hierarchy.
+ */
+static std::string getBenchmarkTree(size_t entries) {
+  auto root = kTestWorkingDirectory + "benchmark-tree-" +
+              std::to_string(entries) + "/";
+  if (isDirectory(root).ok()) {
+    return root;
+  }
+
+  std::vector<std::string> level = {root};
+  fs::create_directories(root);
+  size_t count = 0;
+  while (count < entries) {
+    std::vector<std::string> next;
+    for (const auto& dir : level) {
+      for (size_t i = 0; i < kBenchmarkFanout && count < entries; i++) {
+        auto child = dir + "dir" + std::to_string(i) + "/";
+        fs::create_directory(child);
+        next.push_back(child);
+        count++;
+      }
+      for (size_t i = 0; i < kBenchmarkFanout && count < entries; i++) {
+        writeTextFile(dir + "file" + std::to_string(i), "");
+        count++;
+      }
+    }
+    level.swap(next);
+  }
+  return root;
+}
+
+static void FILESYSTEM_resolve_recursive(benchmark::State& state) {
+  auto root = getBenchmarkTree(state.range_x());
+  while (state.KeepRunning()) {
+    std::vector<std::string> results;
+    resolveFilePattern(root + "%%", results, GLOB_ALL | GLOB_NO_CANON);
+  }
+}
+
+BENCHMARK(FILESYSTEM_resolve_recursive)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Arg(1000000);
+
+static void FILESYSTEM_glob_recursive(benchmark::State& state) {
+  auto root = getBenchmarkTree(state.range_x());
+  while (state.KeepRunning()) {
+    // Expand the double wildcard with a glob for each level, for comparison.
+    std::vector<std::string> results;
+    auto pattern = root + "**";
+    while (true) {
+      auto level = platformGlob(pattern);
+      if (level.empty()) {
+        break;
+      }
+      results.insert(results.end(), level.begin(), level.end());
+      pattern += "/**";
+    }
+  }
+}
+
+BENCHMARK(FILESYSTEM_glob_recursive)->Arg(10000)->Arg(100000);
+}
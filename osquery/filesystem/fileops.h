@@ -22,6 +22,7 @@
 #include <unistd.h>
 #endif
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -273,6 +274,26 @@ bool platformChmod(const std::string& path, mode_t perms);
  */
 std::vector<std::string> platformGlob(const std::string& find_path);
 
+/**
+ * @brief Walk the entries below directories, one depth at a time.
+ *
+ * This is equivalent to globbing a trailing `**` wildcard again for every
+ * level, but each directory is read once. Each level of results is sorted and
+ * marked like platformGlob: directories include a trailing separator and
+ * hidden entries are not included. Symlinks to a parent directory, which
+ * would be a cycle, are not walked.
+ *
+ * @param dirs The directories to walk, each with a trailing separator.
+ * @param depth The maximum number of levels to walk.
+ * @param folders Only report directories, files are not included.
+ * @param predicate Called with each level of results, return false to stop.
+ */
+void platformWalk(
+    const std::vector<std::string>& dirs,
+    size_t depth,
+    bool folders,
+    const std::function<bool(const std::vector<std::string>&)>& predicate);
+
 /**
  * @brief Checks to see if the current user has the permissions to perform a
  *        specified operation on a file.
@@ -8,6 +8,7 @@
  *
  */
 
+#include <algorithm>
 #include <sstream>
 
 #include <fcntl.h>
@@ -143,12 +144,25 @@ Status readFile(const fs::path& path,
 
   off_t total_bytes = 0;
   if (file_size == 0 || block_size > 0) {
-    // Reset block size to a sane minimum.
+    // Reset block size to a sane minimum, and at most the size of the file.
     block_size = (block_size < 4096) ? 4096 : block_size;
+    if (file_size > 0 && static_cast<off_t>(block_size) > file_size) {
+      block_size = std::max(static_cast<size_t>(file_size), (size_t)4096);
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    // Blocks are read in order, allow the kernel to read ahead aggressively.
+    ::posix_fadvise(handle.fd->nativeHandle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
     ssize_t part_bytes = 0;
     bool overflow = false;
+    std::string part;
     do {
-      std::string part(block_size, '\0');
+      // Reuse the block buffer unless the predicate has taken ownership.
+      if (part.size() != block_size) {
+        part.assign(block_size, '\0');
+      }
       part_bytes = handle.fd->read(&part[0], block_size);
       if (part_bytes > 0) {
         total_bytes += static_cast<off_t>(part_bytes);
@@ -263,23 +277,34 @@ static void genGlobs(std::string path,
   // Use our helped escape/replace for wildcards.
   replaceGlobWildcards(path, limits);
 
-  // Generate a glob set and recurse for double star.
-  size_t glob_index = 0;
-  while (++glob_index < kMaxRecursiveGlobs) {
-    auto glob_results = platformGlob(path);
-
-    for (auto const& result_path : glob_results) {
-      results.push_back(result_path);
+  // Generate a glob set, the double star is expanded by walking below it.
+  auto glob_results = platformGlob(path);
+  results.insert(results.end(), glob_results.begin(), glob_results.end());
+
+  // The end state is a non-recursive ending or empty set of matches.
+  size_t wild = path.rfind("**");
+  // Allow a trailing slash after the double wild indicator.
+  if (glob_results.size() > 0 && wild < path.size() &&
+      wild >= path.size() - 3) {
+    // Each matched directory is read once, instead of globbing every level.
+    std::vector<std::string> dirs;
+    for (const auto& result_path : glob_results) {
+      if (result_path.back() == '/' || result_path.back() == '\\') {
+        dirs.push_back(result_path);
+      }
     }
 
-    // The end state is a non-recursive ending or empty set of matches.
-    size_t wild = path.rfind("**");
-    // Allow a trailing slash after the double wild indicator.
-    if (glob_results.size() == 0 || wild > path.size() ||
-        wild < path.size() - 3) {
-      break;
-    }
-    path += "/**";
+    // Files are not needed when folders are requested (or the pattern ends
+    // with a trailing slash).
+    bool folders = (path.back() == '/' || path.back() == '\\' ||
+                    (limits & GLOB_FILES) == 0);
+    platformWalk(dirs,
+                 kMaxRecursiveGlobs - 2,
+                 folders,
+                 [&results](const std::vector<std::string>& level) {
+                   results.insert(results.end(), level.begin(), level.end());
+                   return true;
+                 });
   }
 
   // Prune results based on settings/requested glob limitations.
@@ -8,7 +8,10 @@
  *
  */
 
+#include <ctype.h>
+#include <fcntl.h>
 #include <linux/limits.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <boost/filesystem.hpp>
@@ -16,6 +19,8 @@
 #include <osquery/filesystem.h>
 #include <osquery/logger.h>
 
+#include "osquery/filesystem/linux/proc.h"
+
 namespace osquery {
 
 const std::string kLinuxProcPath = "/proc";
@@ -77,4 +82,235 @@ Status procReadDescriptor(const std::string& process,
     return Status(1, "Could not read path");
   }
 }
+
+/// Skip blanks and return the length of the next blank-delimited field.
+static inline size_t nextProcField(const char*& cursor,
+                                   const char* end,
+                                   const char*& field) {
+  while (cursor < end && (*cursor == ' ' || *cursor == '\t')) {
+    cursor++;
+  }
+
+  field = cursor;
+  while (cursor < end && *cursor != ' ' && *cursor != '\t' &&
+         *cursor != '\n') {
+    cursor++;
+  }
+  return cursor - field;
+}
+
+/// Compare a status key, which is not nul-terminated, to an expected key.
+static inline bool isProcKey(const char* key,
+                             size_t length,
+                             const char* expected) {
+  return strlen(expected) == length && strncmp(key, expected, length) == 0;
+}
+
+/// Fill the real, effective, and saved IDs from a Uid or Gid status value.
+static inline void readProcIDs(const char* value,
+                               const char* end,
+                               std::string& real,
+                               std::string& effective,
+                               std::string& saved) {
+  // Format is: R E S F
+  const char* fields[4];
+  size_t lengths[4];
+  size_t count = 0;
+  const char* field = nullptr;
+  for (size_t length = nextProcField(value, end, field); length > 0;
+       length = nextProcField(value, end, field)) {
+    if (count == 4) {
+      return;
+    }
+    fields[count] = field;
+    lengths[count++] = length;
+  }
+
+  if (count == 4) {
+    real.assign(fields[0], lengths[0]);
+    effective.assign(fields[1], lengths[1]);
+    saved.assign(fields[2], lengths[2]);
+  }
+}
+
+void parseProcStat(const char* data, size_t size, ProcStat& stat) {
+  // Start parsing stats from ") <MODE>...", the name may contain spaces.
+  auto end = data + size;
+  auto start = static_cast<const char*>(memrchr(data, ')', size));
+  if (start == nullptr || end <= start + 2) {
+    return;
+  }
+
+  // Fields are scanned in place, the index is relative to the mode.
+  const char* cursor = start + 2;
+  const char* field = nullptr;
+  size_t index = 0;
+  for (size_t length = nextProcField(cursor, end, field);
+       length > 0 && index <= 19;
+       length = nextProcField(cursor, end, field), index++) {
+    switch (index) {
+    case 0:
+      stat.state.assign(field, length);
+      break;
+    case 1:
+      stat.parent.assign(field, length);
+      break;
+    case 2:
+      stat.group.assign(field, length);
+      break;
+    case 11:
+      stat.user_time.assign(field, length);
+      break;
+    case 12:
+      stat.system_time.assign(field, length);
+      break;
+    case 16:
+      stat.nice.assign(field, length);
+      break;
+    case 17:
+      stat.threads.assign(field, length);
+      break;
+    case 19:
+      // The start time is reported in clock ticks.
+      stat.start_time = std::to_string(strtoull(field, nullptr, 10) / 100);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+void parseProcStatus(const char* data, size_t size, ProcStat& stat) {
+  auto end = data + size;
+  for (auto line = data; line < end;) {
+    // Status lines are formatted: Key: Value....\n.
+    auto line_end = static_cast<const char*>(memchr(line, '\n', end - line));
+    if (line_end == nullptr) {
+      line_end = end;
+    }
+
+    auto colon = static_cast<const char*>(memchr(line, ':', line_end - line));
+    if (colon != nullptr) {
+      // Trim the value, it is tab-aligned.
+      const char* value = colon + 1;
+      while (value < line_end &&
+             isspace(static_cast<unsigned char>(*value))) {
+        value++;
+      }
+      const char* value_end = line_end;
+      while (value_end > value &&
+             isspace(static_cast<unsigned char>(*(value_end - 1)))) {
+        value_end--;
+      }
+
+      // There are specific fields from each detail.
+      size_t key_length = colon - line;
+      size_t value_length = value_end - value;
+      if (isProcKey(line, key_length, "Name")) {
+        stat.name.assign(value, value_length);
+      } else if (isProcKey(line, key_length, "VmRSS") && value_length > 3) {
+        // Memory is reported in kB.
+        stat.resident_size.assign(value, value_length - 3);
+        stat.resident_size += "000";
+      } else if (isProcKey(line, key_length, "VmSize") && value_length > 3) {
+        // Memory is reported in kB.
+        stat.total_size.assign(value, value_length - 3);
+        stat.total_size += "000";
+      } else if (isProcKey(line, key_length, "Gid")) {
+        readProcIDs(value,
+                    value_end,
+                    stat.real_gid,
+                    stat.effective_gid,
+                    stat.saved_gid);
+      } else if (isProcKey(line, key_length, "Uid")) {
+        readProcIDs(value,
+                    value_end,
+                    stat.real_uid,
+                    stat.effective_uid,
+                    stat.saved_uid);
+      }
+    }
+    line = line_end + 1;
+  }
+}
+
+/// The initial reader buffer, enough for most stat and status content.
+const size_t kProcReaderBufferSize = 4096;
+
+ProcReader::ProcReader(const std::string& root) {
+  root_ = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  buffer_.resize(kProcReaderBufferSize);
+  buffer_[0] = 0;
+  path_.reserve(32);
+}
+
+ProcReader::~ProcReader() {
+  if (root_ >= 0) {
+    close(root_);
+  }
+}
+
+void ProcReader::setPath(const std::string& pid, const char* attr) {
+  path_.assign(pid);
+  path_ += '/';
+  path_ += attr;
+}
+
+Status ProcReader::read(const std::string& pid, const char* attr) {
+  size_ = 0;
+  buffer_[0] = 0;
+  if (root_ < 0) {
+    return Status(1, "Cannot open " + kLinuxProcPath);
+  }
+
+  setPath(pid, attr);
+  int fd = openat(root_, path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return Status(1, "Cannot open process attribute");
+  }
+
+  while (true) {
+    // Always leave space for the nul terminator.
+    if (size_ + 1 >= buffer_.size()) {
+      buffer_.resize(buffer_.size() * 2);
+    }
+
+    auto bytes = ::read(fd, &buffer_[size_], buffer_.size() - size_ - 1);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    } else if (bytes < 0) {
+      close(fd);
+      size_ = 0;
+      buffer_[0] = 0;
+      return Status(1, "Cannot read process attribute");
+    } else if (bytes == 0) {
+      break;
+    }
+    size_ += bytes;
+  }
+
+  close(fd);
+  buffer_[size_] = 0;
+  return Status(0, "OK");
+}
+
+Status ProcReader::readLink(const std::string& pid,
+                            const char* attr,
+                            std::string& target) {
+  if (root_ < 0) {
+    return Status(1, "Cannot open " + kLinuxProcPath);
+  }
+
+  setPath(pid, attr);
+  char link_path[PATH_MAX];
+  auto bytes =
+      readlinkat(root_, path_.c_str(), link_path, sizeof(link_path) - 1);
+  if (bytes < 0) {
+    target.clear();
+    return Status(1, "Cannot read process link");
+  }
+
+  target.assign(link_path, bytes);
+  return Status(0, "OK");
+}
 }
@@ -0,0 +1,117 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/status.h>
+
+namespace osquery {
+
+/// The procfs mount point.
+extern const std::string kLinuxProcPath;
+
+/// Process attributes parsed from `/proc/<pid>/stat` and `status`.
+struct ProcStat {
+  // Output from string parsing /proc/<pid>/status.
+  std::string name; // Name:
+  std::string real_uid; // Uid: * - - -
+  std::string real_gid; // Gid: * - - -
+  std::string effective_uid; // Uid: - * - -
+  std::string effective_gid; // Gid: - * - -
+  std::string saved_uid; // Uid: - - * -
+  std::string saved_gid; // Gid: - - * -
+
+  std::string resident_size; // VmRSS:
+  std::string total_size; // VmSize:
+
+  // Output from sring parsing /proc/<pid>/stat.
+  std::string state;
+  std::string parent;
+  std::string group;
+  std::string nice;
+  std::string threads;
+
+  std::string user_time;
+  std::string system_time;
+  std::string start_time;
+};
+
+/**
+ * @brief Parse the content of `/proc/<pid>/stat` in place.
+ *
+ * Fields are read after the last ')', the command name may contain spaces
+ * and parentheses. Fields missing from truncated content are left empty.
+ */
+void parseProcStat(const char* data, size_t size, ProcStat& stat);
+
+/// Parse the Name, Uid, Gid, VmRSS, and VmSize of `/proc/<pid>/status`.
+void parseProcStatus(const char* data, size_t size, ProcStat& stat);
+
+/**
+ * @brief A reader for small `/proc` pseudo-files that reuses one buffer.
+ *
+ * The generic readFile stats each path, checks ownership, and allocates per
+ * block read. Process attributes are generated by the kernel on each read so
+ * none of that is needed. This reader opens attributes relative to a
+ * descriptor of the proc root and reads them into a buffer that is kept
+ * between reads, such that callers may scan content in place.
+ *
+ * A reader is not thread safe, use one per thread.
+ */
+class ProcReader : private boost::noncopyable {
+ public:
+  explicit ProcReader(const std::string& root = kLinuxProcPath);
+  ~ProcReader();
+
+  /**
+   * @brief Read the content of `<root>/<pid>/<attr>`.
+   *
+   * On success the content is available from data() until the next read.
+   */
+  Status read(const std::string& pid, const char* attr);
+
+  /// Read the target of the `<root>/<pid>/<attr>` symlink.
+  Status readLink(const std::string& pid,
+                  const char* attr,
+                  std::string& target);
+
+  /// The content of the last read, always followed by a nul terminator.
+  const char* data() const {
+    return buffer_.data();
+  }
+
+  /// The size of the last read's content.
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  /// Fill the relative path of a process attribute.
+  void setPath(const std::string& pid, const char* attr);
+
+ private:
+  /// An open descriptor to the proc root, or -1.
+  int root_{-1};
+
+  /// Content storage, grown as needed and never shrunk.
+  std::vector<char> buffer_;
+
+  /// The size of the last read's content.
+  size_t size_{0};
+
+  /// Relative path storage for the current attribute.
+  std::string path_;
+};
+}
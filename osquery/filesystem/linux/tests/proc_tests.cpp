@@ -0,0 +1,110 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "osquery/filesystem/linux/proc.h"
+
+namespace osquery {
+
+class ProcTests : public testing::Test {};
+
+/// Content of a /proc/<pid>/stat, the command name is the second field.
+static std::string getStatFixture(const std::string& comm) {
+  return "4242 (" + comm +
+         ") S 1 4242 4242 0 -1 4194560 2172 0 0 0 25 13 0 0 20 0 7 0 "
+         "123400 20480000 512 18446744073709551615 1 1 0 0 0 0 0 4096 "
+         "16387 0 0 0 17 3 0 0 0 0 0\n";
+}
+
+TEST_F(ProcTests, test_parse_stat) {
+  ProcStat stat;
+  auto content = getStatFixture("osqueryd");
+  parseProcStat(content.data(), content.size(), stat);
+  EXPECT_EQ(stat.state, "S");
+  EXPECT_EQ(stat.parent, "1");
+  EXPECT_EQ(stat.group, "4242");
+  EXPECT_EQ(stat.user_time, "25");
+  EXPECT_EQ(stat.system_time, "13");
+  EXPECT_EQ(stat.nice, "0");
+  // Threads is the 20th field, not the virtual memory size.
+  EXPECT_EQ(stat.threads, "7");
+  // The start time is in clock ticks.
+  EXPECT_EQ(stat.start_time, "1234");
+}
+
+TEST_F(ProcTests, test_parse_stat_comm) {
+  // A command name may contain spaces and parentheses.
+  ProcStat stat;
+  auto content = getStatFixture("a) R 99 (b c");
+  parseProcStat(content.data(), content.size(), stat);
+  EXPECT_EQ(stat.state, "S");
+  EXPECT_EQ(stat.parent, "1");
+  EXPECT_EQ(stat.threads, "7");
+
+  stat = ProcStat();
+  content = getStatFixture(") )");
+  parseProcStat(content.data(), content.size(), stat);
+  EXPECT_EQ(stat.state, "S");
+  EXPECT_EQ(stat.threads, "7");
+}
+
+TEST_F(ProcTests, test_parse_stat_truncated) {
+  ProcStat stat;
+  std::string content = "4242 (name) Z 1";
+  parseProcStat(content.data(), content.size(), stat);
+  EXPECT_EQ(stat.state, "Z");
+  EXPECT_EQ(stat.parent, "1");
+  EXPECT_TRUE(stat.threads.empty());
+  EXPECT_TRUE(stat.start_time.empty());
+
+  stat = ProcStat();
+  content = "4242 (name)";
+  parseProcStat(content.data(), content.size(), stat);
+  EXPECT_TRUE(stat.state.empty());
+}
+
+TEST_F(ProcTests, test_parse_status) {
+  ProcStat stat;
+  std::string content =
+      "Name:\tmy (proc) name\n"
+      "Umask:\t0022\n"
+      "State:\tS (sleeping)\n"
+      "Uid:\t1000\t1001\t1002\t1003\n"
+      "Gid:\t100\t101\t102\t103\n"
+      "VmSize:\t   20000 kB\n"
+      "VmRSS:\t     512 kB\n"
+      "Threads:\t7\n";
+  parseProcStatus(content.data(), content.size(), stat);
+  EXPECT_EQ(stat.name, "my (proc) name");
+  EXPECT_EQ(stat.real_uid, "1000");
+  EXPECT_EQ(stat.effective_uid, "1001");
+  EXPECT_EQ(stat.saved_uid, "1002");
+  EXPECT_EQ(stat.real_gid, "100");
+  EXPECT_EQ(stat.effective_gid, "101");
+  EXPECT_EQ(stat.saved_gid, "102");
+  // Memory is reported in kB.
+  EXPECT_EQ(stat.total_size, "20000000");
+  EXPECT_EQ(stat.resident_size, "512000");
+}
+
+TEST_F(ProcTests, test_parse_status_ids) {
+  // Incomplete ID lists are ignored, a final line may omit the newline.
+  ProcStat stat;
+  std::string content = "Uid:\t1000\t1000\n"
+                        "Gid:\t0\t0\t0\t0";
+  parseProcStatus(content.data(), content.size(), stat);
+  EXPECT_TRUE(stat.real_uid.empty());
+  EXPECT_EQ(stat.real_gid, "0");
+  EXPECT_EQ(stat.saved_gid, "0");
+}
+}
@@ -8,7 +8,9 @@
  *
  */
 
+#include <dirent.h>
 #include <glob.h>
+#include <limits.h>
 #include <pwd.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,6 +20,8 @@
 #include <sys/time.h>
 #include <sys/types.h>
 
+#include <algorithm>
+
 #include <boost/optional.hpp>
 
 #include <osquery/filesystem.h>
@@ -300,6 +304,100 @@ std::vector<std::string> platformGlob(const std::string& find_path) {
   return results;
 }
 
+/// Check if a symlinked directory resolves to a parent of (or the same) dir.
+static bool isParentDirectory(const std::string& link, const std::string& dir) {
+  char resolved[PATH_MAX] = {0};
+  if (::realpath(link.c_str(), resolved) == nullptr) {
+    return true;
+  }
+  std::string target = resolved;
+  if (::realpath(dir.c_str(), resolved) == nullptr) {
+    return true;
+  }
+  std::string parent = resolved;
+  if (target == "/" || target == parent) {
+    return true;
+  }
+  return (parent.compare(0, target.size() + 1, target + '/') == 0);
+}
+
+void platformWalk(
+    const std::vector<std::string>& dirs,
+    size_t depth,
+    bool folders,
+    const std::function<bool(const std::vector<std::string>&)>& predicate) {
+  // Each entry of a level is paired with a flag to walk it in the next level.
+  std::vector<std::pair<std::string, bool>> entries;
+  std::vector<std::string> level = dirs;
+  std::vector<std::string> results;
+  while (depth-- > 0 && !level.empty()) {
+    entries.clear();
+    for (const auto& dir : level) {
+      int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (fd < 0) {
+        // Like glob, unreadable directories are skipped.
+        continue;
+      }
+
+      auto dp = ::fdopendir(fd);
+      if (dp == nullptr) {
+        ::close(fd);
+        continue;
+      }
+
+      struct dirent* entry = nullptr;
+      while ((entry = ::readdir(dp)) != nullptr) {
+        // A wildcard does not match hidden entries, or '.' and '..'.
+        if (entry->d_name[0] == '.') {
+          continue;
+        }
+
+        // Most filesystems report the entry type, only stat when they do not.
+        struct stat sb;
+        auto type = entry->d_type;
+        if (type == DT_UNKNOWN &&
+            ::fstatat(fd, entry->d_name, &sb, AT_SYMLINK_NOFOLLOW) == 0) {
+          if (S_ISLNK(sb.st_mode)) {
+            type = DT_LNK;
+          } else if (S_ISDIR(sb.st_mode)) {
+            type = DT_DIR;
+          }
+        }
+
+        bool is_dir = (type == DT_DIR);
+        bool walk = is_dir;
+        if (type == DT_LNK && ::fstatat(fd, entry->d_name, &sb, 0) == 0 &&
+            S_ISDIR(sb.st_mode)) {
+          // Do not walk a symlink to a parent directory, this is a cycle.
+          is_dir = true;
+          walk = !isParentDirectory(dir + entry->d_name, dir);
+        }
+
+        if (is_dir || !folders) {
+          entries.push_back(std::make_pair(
+              dir + entry->d_name + ((is_dir) ? "/" : ""), walk));
+        }
+      }
+      ::closedir(dp);
+    }
+
+    // Sort each level, matching the order of glob results.
+    std::sort(entries.begin(), entries.end());
+    level.clear();
+    results.clear();
+    for (const auto& found : entries) {
+      if (found.second) {
+        level.push_back(found.first);
+      }
+      results.push_back(found.first);
+    }
+
+    if (results.empty() || !predicate(results)) {
+      break;
+    }
+  }
+}
+
 int platformAccess(const std::string& path, mode_t mode) {
   return ::access(path.c_str(), mode);
 }
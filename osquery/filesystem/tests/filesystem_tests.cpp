@@ -268,6 +268,44 @@ TEST_F(FilesystemTests, test_wildcard_double_folders) {
                            .string()));
 }
 
+TEST_F(FilesystemTests, test_wildcard_double_order) {
+  std::vector<std::string> results;
+  resolveFilePattern(kFakeDirectory + "/%%", results);
+
+  // Recursive results are ordered by depth, then sorted like glob.
+  auto level1 = std::find(results.begin(),
+                          results.end(),
+                          fs::path(kFakeDirectory + "/deep11/level1.txt")
+                              .make_preferred()
+                              .string());
+  auto level2 = std::find(results.begin(),
+                          results.end(),
+                          fs::path(kFakeDirectory + "/deep1/deep2/level2.txt")
+                              .make_preferred()
+                              .string());
+  ASSERT_NE(level1, results.end());
+  ASSERT_NE(level2, results.end());
+  EXPECT_LT(level1, level2);
+  EXPECT_TRUE(std::is_sorted(results.begin(), level1));
+}
+
+#ifndef WIN32
+TEST_F(FilesystemTests, test_wildcard_double_symlink_cycle) {
+  auto link = kFakeDirectory + "/deep1/deep2/parent";
+  boost::system::error_code ec;
+  fs::create_directory_symlink(kFakeDirectory, link, ec);
+  ASSERT_FALSE(ec);
+
+  // The symlink is included but a cycle is not walked.
+  std::vector<std::string> results;
+  resolveFilePattern(kFakeDirectory + "/%%", results);
+  EXPECT_EQ(results.size(), 21U);
+  EXPECT_TRUE(contains(results, link + "/"));
+  EXPECT_FALSE(contains(results, link + "/root.txt"));
+  fs::remove(link, ec);
+}
+#endif
+
 TEST_F(FilesystemTests, test_wildcard_end_last_component) {
   std::vector<std::string> results;
   auto status = resolveFilePattern(kFakeDirectory + "/%11/%sh", results);
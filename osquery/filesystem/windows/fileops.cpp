@@ -15,6 +15,7 @@
 #include <io.h>
 #include <sddl.h>
 
+#include <algorithm>
 #include <memory>
 #include <regex>
 #include <vector>
@@ -1201,6 +1202,39 @@ std::vector<std::string> platformGlob(const std::string& find_path) {
   return results;
 }
 
+void platformWalk(
+    const std::vector<std::string>& dirs,
+    size_t depth,
+    bool folders,
+    const std::function<bool(const std::vector<std::string>&)>& predicate) {
+  std::vector<std::string> level = dirs;
+  std::vector<std::string> results;
+  while (depth-- > 0 && !level.empty()) {
+    results.clear();
+    for (const auto& dir : level) {
+      auto entries = platformGlob(dir + "*");
+      results.insert(results.end(), entries.begin(), entries.end());
+    }
+
+    // Sort each level, matching the order of glob results.
+    std::sort(results.begin(), results.end());
+    level.clear();
+    for (const auto& found : results) {
+      if (found.back() == '\\' || found.back() == '/') {
+        level.push_back(found);
+      }
+    }
+
+    if (folders) {
+      results = level;
+    }
+
+    if (results.empty() || !predicate(results)) {
+      break;
+    }
+  }
+}
+
 boost::optional<std::string> getHomeDirectory() {
   std::vector<char> profile(MAX_PATH);
   auto value = getEnvVar("USERPROFILE");
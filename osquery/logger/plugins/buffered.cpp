@@ -10,6 +10,8 @@
 
 #include <algorithm>
 #include <chrono>
+#include <future>
+#include <set>
 #include <thread>
 
 #include <boost/property_tree/ptree.hpp>
@@ -50,50 +52,97 @@ Status BufferedLogForwarder::setUp() {
   return Status(0);
 }
 
+void BufferedLogForwarder::addToBatch(std::vector<LogBatch>& batches,
+                                      const std::string& type,
+                                      const std::string& index) {
+  if (batches.empty() || batches.back().indexes.size() >= max_log_lines_) {
+    batches.push_back(LogBatch());
+    batches.back().type = type;
+  }
+
+  auto& batch = batches.back();
+  batch.indexes.push_back(index);
+  std::string value;
+  if (getDatabaseValue(kLogs, index, value)) {
+    batch.lines.push_back(std::move(value));
+  }
+}
+
+void BufferedLogForwarder::sendBatches(std::vector<LogBatch*>& batches) {
+  size_t inflight = std::max<size_t>(max_inflight_, 1);
+  for (size_t i = 0; i < batches.size(); i += inflight) {
+    size_t end = std::min(i + inflight, batches.size());
+    if (end - i == 1) {
+      // There is nothing to pipeline, send within the forwarder's thread.
+      batches[i]->status = send(batches[i]->lines, batches[i]->type);
+      continue;
+    }
+
+    std::vector<std::future<Status>> requests;
+    for (size_t j = i; j < end; j++) {
+      auto batch = batches[j];
+      requests.push_back(std::async(std::launch::async, [this, batch]() {
+        return send(batch->lines, batch->type);
+      }));
+    }
+
+    for (size_t j = i; j < end; j++) {
+      batches[j]->status = requests[j - i].get();
+    }
+  }
+}
+
 void BufferedLogForwarder::check() {
-  // Get a list of all the buffered log items, with a max of 1024 lines.
+  // Get a list of the buffered log items, with a max of 1024 lines for each
+  // request allowed in flight.
   std::vector<std::string> indexes;
-  auto status = scanDatabaseKeys(kLogs, indexes, index_name_, max_log_lines_);
+  size_t max_lines = max_log_lines_ * std::max<size_t>(max_inflight_, 1);
+  auto status = scanDatabaseKeys(kLogs, indexes, index_name_, max_lines);
 
-  // For each index, accumulate the log line into the result or status set.
-  std::vector<std::string> results, statuses;
+  // For each index, accumulate the log line into a result or status batch.
+  std::vector<LogBatch> results, statuses;
   iterate(indexes, ([&results, &statuses, this](std::string& index) {
-            std::string value;
-            auto& target = isResultIndex(index) ? results : statuses;
-            if (getDatabaseValue(kLogs, index, value)) {
-              target.push_back(std::move(value));
+            if (isResultIndex(index)) {
+              addToBatch(results, "result", index);
+            } else {
+              addToBatch(statuses, "status", index);
             }
           }));
 
   // If any results/statuses were found in the flushed buffer, send.
-  if (results.size() > 0) {
-    status = send(results, "result");
-    if (!status.ok()) {
-      VLOG(1) << "Error sending results to logger: " << status.getMessage();
-    } else {
-      // Clear the results logs once they were sent.
-      iterate(indexes, ([this](std::string& index) {
-                if (!isResultIndex(index)) {
-                  return;
-                }
-                deleteValueWithCount(kLogs, index);
-              }));
+  std::vector<LogBatch*> batches;
+  for (auto& batch : results) {
+    if (batch.lines.size() > 0) {
+      batches.push_back(&batch);
     }
   }
+  for (auto& batch : statuses) {
+    if (batch.lines.size() > 0) {
+      batches.push_back(&batch);
+    }
+  }
+  sendBatches(batches);
+
+  // Only a contiguous prefix of each type is acknowledged, logs following a
+  // failed batch are retried in order with it.
+  std::set<std::string> failed;
+  for (auto& batch : batches) {
+    if (failed.count(batch->type) > 0) {
+      continue;
+    }
 
-  if (statuses.size() > 0) {
-    status = send(statuses, "status");
-    if (!status.ok()) {
-      VLOG(1) << "Error sending status to logger: " << status.getMessage();
-    } else {
-      // Clear the status logs once they were sent.
-      iterate(indexes, ([this](std::string& index) {
-                if (!isStatusIndex(index)) {
-                  return;
-                }
-                deleteValueWithCount(kLogs, index);
-              }));
+    if (!batch->status.ok()) {
+      VLOG(1) << "Error sending "
+              << ((batch->type == "result") ? "results" : "status")
+              << " to logger: " << batch->status.getMessage();
+      failed.insert(batch->type);
+      continue;
     }
+
+    // Clear the logs once they were sent, failed batches are retried.
+    iterate(batch->indexes, ([this](std::string& index) {
+              deleteValueWithCount(kLogs, index);
+            }));
   }
 
   // Purge any logs exceeding the max after our send attempt
@@ -121,6 +121,9 @@ class BufferedLogForwarder : public InternalRunnable {
    * The log_data provided to send must be mutable.
    * To optimize for smaller memory, this will be moved into place within the
    * constructed property tree before sending.
+   *
+   * If max_inflight_ is greater than one, send is called concurrently from
+   * multiple threads.
    */
   virtual Status send(std::vector<std::string>& log_data,
                       const std::string& log_type) = 0;
@@ -128,9 +131,12 @@ class BufferedLogForwarder : public InternalRunnable {
   /**
    * @brief Check for new logs and send.
    *
-   * Scan the logs domain for up to max_log_lines_ log lines.
-   * Sort those lines into status and request types then forward (send) each
-   * set. On success, clear the data and indexes. Calls purge upon completion.
+   * Scan the logs domain for up to max_log_lines_ log lines for each request
+   * allowed in flight (max_inflight_). Sort those lines into status and
+   * request batches of at most max_log_lines_ then forward (send) each batch,
+   * concurrently if more than one request is allowed in flight. Clear the data
+   * and indexes of successful batches up to the first failure of each type,
+   * later batches are resent in order. Calls purge upon completion.
    */
   void check();
 
@@ -151,6 +157,29 @@ class BufferedLogForwarder : public InternalRunnable {
   bool isStatusIndex(const std::string& index);
 
  private:
+  /// Buffered log lines forwarded with a single call to send().
+  struct LogBatch {
+    /// The log type, either "result" or "status".
+    std::string type;
+
+    /// Backing store indexes of the lines in this batch.
+    std::vector<std::string> indexes;
+
+    /// The buffered log lines.
+    std::vector<std::string> lines;
+
+    /// The status of sending this batch.
+    Status status;
+  };
+
+  /// Read a log line into the last batch of a type, adding batches as needed.
+  void addToBatch(std::vector<LogBatch>& batches,
+                  const std::string& type,
+                  const std::string& index);
+
+  /// Send batches, with up to max_inflight_ requests in flight.
+  void sendBatches(std::vector<LogBatch*>& batches);
+
   /// Helper for isResultIndex/isStatusIndex
   bool isIndex(const std::string& index, bool results);
 
@@ -185,9 +214,18 @@ class BufferedLogForwarder : public InternalRunnable {
   /// Seconds between flushing logs
   std::chrono::seconds log_period_;
 
-  /// Max number of logs to flush per check
+  /// Max number of logs to flush per request
   size_t max_log_lines_;
 
+  /**
+   * @brief Max number of requests in flight per check
+   *
+   * Subclasses with a thread-safe send() may pipeline batches of logs to
+   * hide the latency of each request. The default sends one batch of each
+   * log type at a time.
+   */
+  size_t max_inflight_{1};
+
   /**
    * @brief Name to use in index
    *
@@ -10,8 +10,9 @@
 
 #include <gtest/gtest.h>
 
-#include <osquery/logger.h>
 #include <osquery/database.h>
+#include <osquery/flags.h>
+#include <osquery/logger.h>
 
 #include "osquery/tests/test_additional_util.h"
 #include "osquery/tests/test_util.h"
@@ -22,6 +23,8 @@ namespace pt = boost::property_tree;
 
 namespace osquery {
 
+DECLARE_bool(logger_tls_compress);
+
 class TLSLoggerTests : public testing::Test {
  public:
   void runCheck(const std::shared_ptr<TLSLogForwarder>& runner) {
@@ -78,4 +81,51 @@ TEST_F(TLSLoggerTests, test_send) {
   TLSServerRunner::unsetClientConfig();
   TLSServerRunner::stop();
 }
+
+TEST_F(TLSLoggerTests, test_send_inflight) {
+  // Start a server.
+  TLSServerRunner::start();
+  TLSServerRunner::setClientConfig();
+  FLAGS_logger_tls_compress = true;
+
+  // More lines than a single request allows, sent as compressed batches.
+  auto forwarder = std::make_shared<TLSLogForwarder>();
+  for (size_t i = 0; i < 2500; i++) {
+    forwarder->logString("{\"inflight_json\": " + std::to_string(i) + "}");
+  }
+
+  runCheck(forwarder);
+  FLAGS_logger_tls_compress = false;
+
+  // Stop the server.
+  TLSServerRunner::unsetClientConfig();
+  TLSServerRunner::stop();
+
+  // Each batch was acknowledged, the buffer is empty.
+  std::vector<std::string> indexes;
+  scanDatabaseKeys(kLogs, indexes, "tls");
+  EXPECT_EQ(0U, indexes.size());
+}
+
+TEST_F(TLSLoggerTests, test_send_malformed) {
+  // Start a server.
+  TLSServerRunner::start();
+  TLSServerRunner::setClientConfig();
+
+  // Malformed lines are dropped, they do not fail the batch.
+  auto forwarder = std::make_shared<TLSLogForwarder>();
+  forwarder->logString("{\"valid_json\": [1, 2.5, \"three\"]}");
+  forwarder->logString("{\"corrupt_json\": tru}");
+  forwarder->logString("{\"truncated_json\": \"value}");
+  forwarder->logString("{\"trailing_json\": 1},");
+  runCheck(forwarder);
+
+  // Stop the server.
+  TLSServerRunner::unsetClientConfig();
+  TLSServerRunner::stop();
+
+  std::vector<std::string> indexes;
+  scanDatabaseKeys(kLogs, indexes, "tls");
+  EXPECT_EQ(0U, indexes.size());
+}
 }
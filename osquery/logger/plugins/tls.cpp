@@ -8,6 +8,9 @@
  *
  */
 
+#include <algorithm>
+#include <cctype>
+
 #include <boost/property_tree/ptree.hpp>
 
 #include <osquery/enroll.h>
@@ -41,6 +44,11 @@ FLAG(uint64,
 
 FLAG(bool, logger_tls_compress, false, "GZip compress TLS/HTTPS request body");
 
+FLAG(uint64,
+     logger_tls_inflight,
+     4,
+     "Max concurrent TLS/HTTPS requests when flushing logs");
+
 REGISTER(TLSLoggerPlugin, "logger", "tls");
 
 TLSLogForwarder::TLSLogForwarder()
@@ -48,6 +56,156 @@ TLSLogForwarder::TLSLogForwarder()
                            std::chrono::seconds(FLAGS_logger_tls_period),
                            kTLSMaxLogLines) {
   uri_ = TLSRequestHelper::makeURI(FLAGS_logger_tls_endpoint);
+  max_inflight_ = std::max<size_t>(FLAGS_logger_tls_inflight, 1);
+}
+
+/// Scan a JSON string starting at the opening quote, i is moved past it.
+static bool scanJSONString(const std::string& line, size_t& i) {
+  for (++i; i < line.size(); ++i) {
+    auto c = static_cast<unsigned char>(line[i]);
+    if (c == '"') {
+      ++i;
+      return true;
+    } else if (c < 0x20) {
+      return false;
+    } else if (c == '\\') {
+      if (++i >= line.size()) {
+        return false;
+      }
+      if (line[i] == 'u') {
+        for (size_t j = 0; j < 4; ++j) {
+          if (++i >= line.size() ||
+              !::isxdigit(static_cast<unsigned char>(line[i]))) {
+            return false;
+          }
+        }
+      } else if (std::string("\"\\/bfnrt").find(line[i]) ==
+                 std::string::npos) {
+        return false;
+      }
+    }
+  }
+  return false;
+}
+
+/// Scan a JSON number, i is moved past it.
+static bool scanJSONNumber(const std::string& line, size_t& i) {
+  auto digits = ([&line, &i]() {
+    size_t start = i;
+    while (i < line.size() && ::isdigit(static_cast<unsigned char>(line[i]))) {
+      ++i;
+    }
+    return i > start;
+  });
+
+  if (line[i] == '-') {
+    ++i;
+  }
+  if (i < line.size() && line[i] == '0') {
+    ++i;
+  } else if (!digits()) {
+    return false;
+  }
+  if (i < line.size() && line[i] == '.') {
+    ++i;
+    if (!digits()) {
+      return false;
+    }
+  }
+  if (i < line.size() && (line[i] == 'e' || line[i] == 'E')) {
+    ++i;
+    if (i < line.size() && (line[i] == '+' || line[i] == '-')) {
+      ++i;
+    }
+    return digits();
+  }
+  return true;
+}
+
+/**
+ * @brief Check that a buffered log line is a JSON object, without parsing it.
+ *
+ * Lines are spliced into the request body verbatim, a single malformed line
+ * would make the server reject the whole batch. This validates the grammar
+ * in one pass without building a property tree.
+ */
+static bool isJSONObject(const std::string& line) {
+  enum Expect { kValue, kValueOrEnd, kKey, kKeyOrEnd, kColon, kCommaOrEnd };
+
+  // The open containers, '{' or '['.
+  std::string stack;
+  auto expect = kValue;
+  size_t i = line.find_first_not_of(" \t\r\n");
+  if (i == std::string::npos || line[i] != '{') {
+    return false;
+  }
+
+  while (true) {
+    i = line.find_first_not_of(" \t\r\n", i);
+    if (i == std::string::npos) {
+      return false;
+    }
+
+    auto c = line[i];
+    bool closed = false;
+    if (expect == kValue || expect == kValueOrEnd) {
+      if (c == ']' && expect == kValueOrEnd) {
+        closed = true;
+      } else if (c == '{' || c == '[') {
+        stack.push_back(c);
+        expect = (c == '{') ? kKeyOrEnd : kValueOrEnd;
+        ++i;
+        continue;
+      } else if (c == '"') {
+        if (!scanJSONString(line, i)) {
+          return false;
+        }
+      } else if (c == '-' || ::isdigit(static_cast<unsigned char>(c))) {
+        if (!scanJSONNumber(line, i)) {
+          return false;
+        }
+      } else if (line.compare(i, 4, "true") == 0 ||
+                 line.compare(i, 4, "null") == 0) {
+        i += 4;
+      } else if (line.compare(i, 5, "false") == 0) {
+        i += 5;
+      } else {
+        return false;
+      }
+      expect = kCommaOrEnd;
+    } else if (expect == kKey || expect == kKeyOrEnd) {
+      if (c == '}' && expect == kKeyOrEnd) {
+        closed = true;
+      } else if (c != '"' || !scanJSONString(line, i)) {
+        return false;
+      } else {
+        expect = kColon;
+      }
+    } else if (expect == kColon) {
+      if (c != ':') {
+        return false;
+      }
+      ++i;
+      expect = kValue;
+    } else if (c == ',') {
+      ++i;
+      expect = (stack.back() == '{') ? kKey : kValue;
+    } else if (c == ((stack.back() == '{') ? '}' : ']')) {
+      closed = true;
+    } else {
+      return false;
+    }
+
+    if (closed) {
+      ++i;
+      stack.pop_back();
+      if (stack.empty()) {
+        // Only whitespace may follow the object.
+        return line.find_first_not_of(" \t\r\n", i) == std::string::npos;
+      }
+      expect = kCommaOrEnd;
+    }
+  }
 }
 
 Status TLSLoggerPlugin::logString(const std::string& s) {
@@ -88,43 +246,66 @@ void TLSLoggerPlugin::init(const std::string& name,
 
 Status TLSLogForwarder::send(std::vector<std::string>& log_data,
                              const std::string& log_type) {
+  // Serialize the request parameters, the log lines are appended as 'data'.
   pt::ptree params;
-  params.put<std::string>("node_key", getNodeKey("tls"));
+  if (!FLAGS_tls_node_api) {
+    params.put<std::string>("node_key", getNodeKey("tls"));
+  }
   params.put<std::string>("log_type", log_type);
 
-  {
-    // Read each logged line into JSON and populate a list of lines.
-    // The result list will use the 'data' key.
-    pt::ptree children;
-    iterate(log_data,
-            ([&children](std::string& item) {
-              // Enforce a max log line size for TLS logging.
-              if (item.size() > FLAGS_logger_tls_max) {
-                LOG(WARNING) << "Line exceeds TLS logger max: " << item.size();
-                return;
-              }
-
-              pt::ptree child;
-              try {
-                std::stringstream input;
-                input << item;
-                std::string().swap(item);
-                pt::read_json(input, child);
-              } catch (const pt::json_parser::json_parser_error& /* e */) {
-                // The log line entered was not valid JSON, skip it.
-                return;
-              }
-              children.push_back(std::make_pair("", std::move(child)));
-            }));
-    params.add_child("data", std::move(children));
+  std::string header;
+  auto status = JSONSerializer().serialize(params, header);
+  if (!status.ok()) {
+    return status;
   }
+  header.erase(header.find_last_of('}'));
+  header += ",\"data\":[";
 
-  // The response body is ignored (status is set appropriately by
-  // TLSRequestHelper::go())
-  std::string response;
-  if (FLAGS_logger_tls_compress) {
-    params.put("_compress", true);
+  // Buffered lines are already JSON, append (and compress) them in place
+  // rather than parsing each line into a property tree and serializing again.
+  bool compress = FLAGS_logger_tls_compress;
+  GzipCompressor compressor;
+  std::string body;
+  auto append = ([compress, &compressor, &body](const std::string& data) {
+    if (compress) {
+      return compressor.append(data);
+    }
+    body += data;
+    return true;
+  });
+
+  bool appended = append(header);
+  bool first = true;
+  iterate(log_data, ([&append, &appended, &first](std::string& item) {
+            // Enforce a max log line size for TLS logging.
+            if (item.size() > FLAGS_logger_tls_max) {
+              LOG(WARNING) << "Line exceeds TLS logger max: " << item.size();
+              return;
+            }
+
+            if (!isJSONObject(item)) {
+              // The log line is not valid JSON, drop it from the batch.
+              LOG(WARNING) << "Dropping malformed JSON log line of size "
+                           << item.size();
+              return;
+            }
+
+            appended = appended && append((first) ? item : "," + item);
+            first = false;
+            std::string().swap(item);
+          }));
+  appended = appended && append("]}");
+  if (compress && appended) {
+    appended = compressor.finish(body);
   }
-  return TLSRequestHelper::go<JSONSerializer>(uri_, params, response);
+
+  if (!appended) {
+    return Status(1, "Could not compress TLS log data");
+  }
+
+  // The response body is ignored (status is set appropriately by
+  // TLSRequestHelper::post())
+  pt::ptree response;
+  return TLSRequestHelper::post<JSONSerializer>(uri_, body, compress, response);
 }
 }
@@ -480,6 +480,54 @@ Status RegistryFactory::callTable(const std::string& table_name,
   }
 }
 
+Status RegistryFactory::callTable(const std::string& table_name,
+                                  QueryContext& context,
+                                  ColumnarQueryData& results) {
+  auto& tables = registry("table")->items_;
+  if (tables.count(table_name) > 0) {
+    auto plugin = std::dynamic_pointer_cast<TablePlugin>(tables.at(table_name));
+    plugin->generateColumnar(context, results);
+    return Status(0);
+  }
+
+  // Extension tables advertise support for columnar results in route info.
+  bool columnar = false;
+  auto& routes = registry("table")->routes_;
+  if (routes.count(table_name) > 0) {
+    for (const auto& route : routes.at(table_name)) {
+      if (route.count("id") > 0 && route.at("id") == "encoding" &&
+          route.count("encoding") > 0 &&
+          route.at("encoding") == kTableColumnarEncoding) {
+        columnar = true;
+      }
+    }
+  }
+
+  PluginResponse response;
+  if (!columnar) {
+    // Older extension tables respond with rows, these are adapted.
+    auto status = callTable(table_name, context, response);
+    results.append(response);
+    return status;
+  }
+
+  PluginRequest request = {{"action", "generate"},
+                           {"encoding", kTableColumnarEncoding}};
+  TablePlugin::setRequestFromContext(context, request);
+  auto status = call("table", table_name, request, response);
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (response.size() == 1 && response[0].count("encoding") > 0 &&
+      response[0].at("encoding") == kTableColumnarEncoding &&
+      response[0].count("results") > 0) {
+    return results.deserialize(response[0].at("results"));
+  }
+  results.append(response);
+  return status;
+}
+
 Status RegistryFactory::setActive(const std::string& registry_name,
                                   const std::string& item_name) {
   WriteLock lock(instance().mutex_);
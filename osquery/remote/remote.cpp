@@ -11,50 +11,84 @@
 #include <string>
 #include <cstring>
 
-#include <zlib.h>
+#include "osquery/remote/requests.h"
 
 namespace osquery {
 
 #define MOD_GZIP_ZLIB_WINDOWSIZE 15
 #define MOD_GZIP_ZLIB_CFACTOR 9
 
-std::string compressString(const std::string& data) {
-  z_stream zs;
-  memset(&zs, 0, sizeof(zs));
-
-  if (deflateInit2(&zs,
-                   Z_BEST_COMPRESSION,
-                   Z_DEFLATED,
-                   MOD_GZIP_ZLIB_WINDOWSIZE + 16,
-                   MOD_GZIP_ZLIB_CFACTOR,
-                   Z_DEFAULT_STRATEGY) != Z_OK) {
-    return std::string();
+GzipCompressor::GzipCompressor() {
+  memset(&stream_, 0, sizeof(stream_));
+  valid_ = (deflateInit2(&stream_,
+                         Z_BEST_COMPRESSION,
+                         Z_DEFLATED,
+                         MOD_GZIP_ZLIB_WINDOWSIZE + 16,
+                         MOD_GZIP_ZLIB_CFACTOR,
+                         Z_DEFAULT_STRATEGY) == Z_OK);
+}
+
+GzipCompressor::~GzipCompressor() {
+  if (valid_) {
+    deflateEnd(&stream_);
   }
+}
 
-  zs.next_in = (Bytef*)data.data();
-  zs.avail_in = static_cast<uInt>(data.size());
+bool GzipCompressor::deflateInput(const char* data, size_t size, int flush) {
+  if (!valid_) {
+    return false;
+  }
 
-  int ret = Z_OK;
-  std::string output;
+  stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream_.avail_in = static_cast<uInt>(size);
 
-  {
-    char buffer[16384] = {0};
-    while (ret == Z_OK) {
-      zs.next_out = reinterpret_cast<Bytef*>(buffer);
-      zs.avail_out = sizeof(output);
+  char buffer[16384];
+  int ret = Z_OK;
+  do {
+    stream_.next_out = reinterpret_cast<Bytef*>(buffer);
+    stream_.avail_out = sizeof(buffer);
 
-      ret = deflate(&zs, Z_FINISH);
-      if (output.size() < zs.total_out) {
-        output.append(buffer, zs.total_out - output.size());
-      }
+    ret = deflate(&stream_, flush);
+    if (ret == Z_STREAM_ERROR) {
+      valid_ = false;
+      return false;
     }
+    output_.append(buffer, sizeof(buffer) - stream_.avail_out);
+  } while (stream_.avail_out == 0);
+
+  if (flush == Z_FINISH && ret != Z_STREAM_END) {
+    valid_ = false;
+    return false;
+  }
+  return true;
+}
+
+bool GzipCompressor::append(const std::string& data) {
+  return append(data.data(), data.size());
+}
+
+bool GzipCompressor::append(const char* data, size_t size) {
+  return deflateInput(data, size, Z_NO_FLUSH);
+}
+
+bool GzipCompressor::finish(std::string& output) {
+  if (!deflateInput(nullptr, 0, Z_FINISH)) {
+    return false;
   }
 
-  deflateEnd(&zs);
-  if (ret != Z_STREAM_END) {
+  output = std::move(output_);
+  output_.clear();
+  deflateEnd(&stream_);
+  valid_ = false;
+  return true;
+}
+
+std::string compressString(const std::string& data) {
+  GzipCompressor compressor;
+  std::string output;
+  if (!compressor.append(data) || !compressor.finish(output)) {
     return std::string();
   }
-
   return output;
 }
 }
@@ -14,8 +14,11 @@
 #include <utility>
 #include <string>
 
+#include <boost/noncopyable.hpp>
 #include <boost/property_tree/ptree.hpp>
 
+#include <zlib.h>
+
 #include <osquery/logger.h>
 #include <osquery/status.h>
 
@@ -34,6 +37,49 @@ class Serializer;
  */
 std::string compressString(const std::string& data);
 
+/**
+ * @brief Incrementally compress data using GZip.
+ *
+ * Callers that assemble a large request body may compress each part as it is
+ * produced, rather than holding the complete uncompressed body in memory and
+ * compressing it in a second pass. The output is equivalent to compressString.
+ */
+class GzipCompressor : private boost::noncopyable {
+ public:
+  GzipCompressor();
+  ~GzipCompressor();
+
+  /// Compress and buffer the next part of the input.
+  bool append(const std::string& data);
+
+  /// Compress and buffer the next part of the input.
+  bool append(const char* data, size_t size);
+
+  /**
+   * @brief Finish the GZip stream and move out the compressed output.
+   *
+   * The compressor cannot be appended to after finishing.
+   *
+   * @param output The compressed output.
+   * @return false if the compressor failed to initialize or compress.
+   */
+  bool finish(std::string& output);
+
+ private:
+  /// Deflate input into the output buffer using a zlib flush mode.
+  bool deflateInput(const char* data, size_t size, int flush);
+
+ private:
+  /// The zlib deflate stream state.
+  z_stream stream_;
+
+  /// Compressed output produced so far.
+  std::string output_;
+
+  /// Set if the stream was initialized and has not failed or finished.
+  bool valid_{false};
+};
+
 /**
  * @brief Abstract base class for remote transport implementations
  *
@@ -236,6 +282,21 @@ class Request {
     return transport_->sendRequest(serialized, options_.get("compress", false));
   }
 
+  /**
+   * @brief Send a request to the destination with serialized parameters
+   *
+   * Callers that build large request bodies may serialize (and optionally
+   * compress, see GzipCompressor and the "compressed" option) the parameters
+   * themselves instead of building a property tree.
+   *
+   * @param serialized The serialized parameters
+   *
+   * @return success or failure of the operation
+   */
+  Status call(const std::string& serialized) {
+    return transport_->sendRequest(serialized, options_.get("compress", false));
+  }
+
   /**
    * @brief Get the request response
    *
@@ -154,4 +154,21 @@ TEST_F(RequestsTests, test_compression) {
   EXPECT_EQ(compressed, expected);
   EXPECT_LT(compressed.size(), uncompressed.size());
 }
+
+TEST_F(RequestsTests, test_compression_stream) {
+  std::string uncompressed = "stringstringstringstring";
+  for (size_t i = 0; i < 10; i++) {
+    uncompressed += uncompressed;
+  }
+
+  // Compressing parts of the input produces the same GZip stream.
+  GzipCompressor compressor;
+  for (size_t i = 0; i < uncompressed.size(); i += 1000) {
+    EXPECT_TRUE(compressor.append(uncompressed.substr(i, 1000)));
+  }
+
+  std::string compressed;
+  EXPECT_TRUE(compressor.finish(compressed));
+  EXPECT_EQ(compressed, compressString(uncompressed));
+}
 }
@@ -28,6 +28,9 @@ const std::string kTLSCiphers =
     "DH+3DES:RSA+AESGCM:RSA+AES:RSA+3DES:!aNULL:!MD5";
 const std::string kTLSUserAgentBase = "osquery/";
 
+/// Maximum number of idle clients kept for reuse per set of TLS options.
+const size_t kTLSMaxIdleClients = 4;
+
 /// TLS server hostname.
 CLI_FLAG(string,
          tls_hostname,
@@ -151,6 +154,52 @@ http::client TLSTransport::getClient() {
   return client;
 }
 
+/// Idle clients, keyed by the TLS options used to create them.
+static std::map<std::string, std::vector<TLSTransport::ClientRef>>&
+idleClients() {
+  static std::map<std::string, std::vector<TLSTransport::ClientRef>> clients;
+  return clients;
+}
+
+/// Access to the idle clients.
+static Mutex& idleClientsMutex() {
+  static Mutex mutex;
+  return mutex;
+}
+
+std::string TLSTransport::getClientKey() {
+  std::string key = server_certificate_file_ + ":" + client_certificate_file_ +
+                    ":" + client_private_key_file_ + ":" +
+                    options_.get<std::string>("hostname", "") + ":" +
+                    ((verify_peer_) ? "1" : "0");
+#if defined(DEBUG)
+  key += (FLAGS_tls_allow_unsafe) ? ":1" : ":0";
+#endif
+  return key;
+}
+
+TLSTransport::ClientRef TLSTransport::acquireClient(const std::string& key) {
+  {
+    WriteLock lock(idleClientsMutex());
+    auto& clients = idleClients()[key];
+    if (!clients.empty()) {
+      auto client = clients.back();
+      clients.pop_back();
+      return client;
+    }
+  }
+  return std::make_shared<http::client>(getClient());
+}
+
+void TLSTransport::releaseClient(const std::string& key,
+                                 const ClientRef& client) {
+  WriteLock lock(idleClientsMutex());
+  auto& clients = idleClients()[key];
+  if (clients.size() < kTLSMaxIdleClients) {
+    clients.push_back(client);
+  }
+}
+
 inline bool tlsFailure(const std::string& what) {
   if (what.find("Error") == 0 || what.find("refused") != std::string::npos) {
     return false;
@@ -163,19 +212,21 @@ Status TLSTransport::sendRequest() {
     return Status(1, "Cannot create TLS request for non-HTTPS protocol URI");
   }
 
-  auto client = getClient();
+  auto key = getClientKey();
+  auto client = acquireClient(key);
   http::client::request r(destination_);
   decorateRequest(r);
 
   VLOG(1) << "TLS/HTTPS GET request to URI: " << destination_;
   try {
-    response_ = client.get(r);
+    response_ = client->get(r);
     const auto& response_body = body(response_);
     if (FLAGS_verbose && FLAGS_tls_dump) {
       fprintf(stdout, "%s\n", std::string(response_body).c_str());
     }
     response_status_ =
         serializer_->deserialize(response_body, response_params_);
+    releaseClient(key, client);
   } catch (const std::exception& e) {
     return Status((tlsFailure(e.what())) ? 2 : 1,
                   std::string("Request error: ") + e.what());
@@ -188,7 +239,8 @@ Status TLSTransport::sendRequest(const std::string& params, bool compress) {
     return Status(1, "Cannot create TLS request for non-HTTPS protocol URI");
   }
 
-  auto client = getClient();
+  auto key = getClientKey();
+  auto client = acquireClient(key);
   http::client::request r(destination_);
   decorateRequest(r);
   if (compress) {
@@ -208,11 +260,15 @@ Status TLSTransport::sendRequest(const std::string& params, bool compress) {
     fprintf(stdout, "%s\n", params.c_str());
   }
 
+  // The caller may have compressed the parameters while serializing.
+  bool compressed = options_.get("compressed", false);
   try {
     if (verb == HTTP_POST) {
-      response_ = client.post(r, (compress) ? compressString(params) : params);
+      response_ = client->post(
+          r, (compress && !compressed) ? compressString(params) : params);
     } else {
-      response_ = client.put(r, (compress) ? compressString(params) : params);
+      response_ = client->put(
+          r, (compress && !compressed) ? compressString(params) : params);
     }
 
     const auto& response_body = body(response_);
@@ -221,6 +277,7 @@ Status TLSTransport::sendRequest(const std::string& params, bool compress) {
     }
     response_status_ =
         serializer_->deserialize(response_body, response_params_);
+    releaseClient(key, client);
   } catch (const std::exception& e) {
     return Status((tlsFailure(e.what())) ? 2 : 1,
                   std::string("Request error: ") + e.what());
@@ -136,6 +136,28 @@ class TLSTransport : public Transport {
 
   boost::network::http::client getClient();
 
+  /// A shared HTTP client, reused between requests.
+  using ClientRef = std::shared_ptr<boost::network::http::client>;
+
+ private:
+  /**
+   * @brief Get an idle client created with equivalent options, or a new one.
+   *
+   * Creating a client sets up an I/O service, resolver, and TLS context.
+   * Clients are returned to a small process-wide idle list after a request
+   * completes, so consecutive and concurrent requests (such as pipelined log
+   * batches) do not repeat that setup.
+   *
+   * @param key The client options key, see getClientKey.
+   */
+  ClientRef acquireClient(const std::string& key);
+
+  /// Return a client to the idle list after a successful request.
+  void releaseClient(const std::string& key, const ClientRef& client);
+
+  /// Identify the TLS options used by getClient.
+  std::string getClientKey();
+
  private:
   /// Testing-only, disable peer verification.
   void disableVerifyPeer() {
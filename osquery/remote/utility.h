@@ -131,28 +131,51 @@ class TLSRequestHelper : private boost::noncopyable {
     if (!status.ok()) {
       return status;
     }
+    return checkResponse(output);
+  }
 
-    // Receive config or key rejection
-    if (output.count("node_invalid") > 0) {
-      auto invalid = output.get("node_invalid", "");
-      if (invalid == "1" || invalid == "true" || invalid == "True") {
-        if (!FLAGS_disable_reenrollment) {
-          clearNodeKey();
-        }
+  /**
+   * @brief Send a TLS POST request with a serialized body
+   *
+   * The body is sent as-is, the caller must include the node_key when
+   * `tls_node_api` is not used. This allows large bodies, such as buffered
+   * logs, to be serialized and compressed while they are assembled.
+   *
+   * @param uri is the URI to send the request to
+   * @param body is the serialized (and optionally compressed) body
+   * @param compressed is true if the body was compressed using GZip
+   * @param output is the ptree which will be populated with the deserialized
+   * results
+   *
+   * @return a Status object indicating the success or failure of the operation
+   */
+  template <class TSerializer>
+  static Status post(const std::string& uri,
+                     const std::string& body,
+                     bool compressed,
+                     boost::property_tree::ptree& output) {
+    std::string uri_suffix;
+    if (FLAGS_tls_node_api) {
+      uri_suffix = "&node_key=" + getNodeKey("tls");
+    }
 
-        std::string message = "Request failed: Invalid node key";
-        if (output.count("error") > 0) {
-          message += ": " + output.get("error", "<unknown>");
-        }
-        return Status(1, message);
-      }
+    auto request = Request<TLSTransport, TSerializer>(uri + uri_suffix);
+    request.setOption("hostname", FLAGS_tls_hostname);
+    if (compressed) {
+      request.setOption("compress", true);
+      request.setOption("compressed", true);
     }
 
-    if (output.count("error") > 0) {
-      return Status(1, "Request failed: " + output.get("error", "<unknown>"));
+    auto status = request.call(body);
+    if (!status.ok()) {
+      return status;
     }
 
-    return Status(0, "OK");
+    status = request.getResponse(output);
+    if (!status.ok()) {
+      return status;
+    }
+    return checkResponse(output);
   }
 
   /**
@@ -261,5 +284,31 @@ class TLSRequestHelper : private boost::noncopyable {
     params.put("_get", true);
     return TLSRequestHelper::go<TSerializer>(uri, params, output, attempts);
   }
+
+ private:
+  /// Check a deserialized response for node key rejections and errors.
+  static Status checkResponse(const boost::property_tree::ptree& output) {
+    // Receive config or key rejection
+    if (output.count("node_invalid") > 0) {
+      auto invalid = output.get("node_invalid", "");
+      if (invalid == "1" || invalid == "true" || invalid == "True") {
+        if (!FLAGS_disable_reenrollment) {
+          clearNodeKey();
+        }
+
+        std::string message = "Request failed: Invalid node key";
+        if (output.count("error") > 0) {
+          message += ": " + output.get("error", "<unknown>");
+        }
+        return Status(1, message);
+      }
+    }
+
+    if (output.count("error") > 0) {
+      return Status(1, "Request failed: " + output.get("error", "<unknown>"));
+    }
+
+    return Status(0, "OK");
+  }
 };
 }
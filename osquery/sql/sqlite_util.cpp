@@ -8,6 +8,10 @@
  *
  */
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
 #include <osquery/core.h>
 #include <osquery/flags.h>
 #include <osquery/logger.h>
@@ -28,6 +32,22 @@ FLAG(string,
      "Not Specified",
      "Comma-delimited list of table names to be disabled");
 
+FLAG(uint64,
+     sql_pool_size,
+     4,
+     "Attached SQLite connections kept for concurrent queries");
+
+FLAG(uint64,
+     sql_statement_cache_size,
+     256,
+     "Prepared SQLite statements kept for each connection");
+
+/// The longest a query waits for a pooled connection before opening one.
+const std::chrono::milliseconds kSQLPoolWait(100);
+
+/// Incremented when tables change, expiring every cached statement.
+static std::atomic<size_t> kStatementGeneration{0};
+
 using SQLiteDBInstanceRef = std::shared_ptr<SQLiteDBInstance>;
 
 /**
@@ -119,7 +139,7 @@ std::string getStringForSQLiteReturnCode(int code) {
 
 Status SQLiteSQLPlugin::query(const std::string& q, QueryData& results) const {
   auto dbc = SQLiteDBManager::get();
-  auto result = queryInternal(q, results, dbc->db());
+  auto result = queryInternal(q, results, dbc);
   dbc->clearAffectedTables();
   return result;
 }
@@ -132,7 +152,7 @@ Status SQLiteSQLPlugin::getQueryColumns(const std::string& q,
 
 SQLInternal::SQLInternal(const std::string& q) {
   auto dbc = SQLiteDBManager::get();
-  status_ = queryInternal(q, results_, dbc->db());
+  status_ = queryInternal(q, results_, dbc);
 
   // One of the advantages of using SQLInternal (aside from the Registry-bypass)
   // is the ability to "deep-inspect" the table attributes and actions.
@@ -154,10 +174,17 @@ Status SQLiteSQLPlugin::attach(const std::string& name) {
   // primary database. To allow this, getConnection can explicitly request the
   // primary instance and avoid the contention decisions.
   auto dbc = SQLiteDBManager::getConnection(true);
-  return attachTableInternal(name, statement, dbc);
+  status = attachTableInternal(name, statement, dbc);
+
+  // Pooled connections pick up the table the next time they are used.
+  SQLiteDBManager::instance().addTableChange(name);
+  SQLiteStatementCache::invalidate();
+  return status;
 }
 
 void SQLiteSQLPlugin::detach(const std::string& name) {
+  SQLiteDBManager::instance().addTableChange(name);
+  SQLiteStatementCache::invalidate();
   auto dbc = SQLiteDBManager::get();
   if (!dbc->isPrimary()) {
     return;
@@ -170,9 +197,8 @@ SQLiteDBInstance::SQLiteDBInstance(sqlite3*& db, std::mutex& mtx)
   if (lock_.owns_lock()) {
     primary_ = true;
   } else {
+    // The DB manager will check out a pooled connection instead.
     db_ = nullptr;
-    VLOG(1) << "DBManager contention: opening transient SQLite database";
-    init();
   }
 }
 
@@ -231,7 +257,25 @@ void SQLiteDBInstance::clearAffectedTables() {
   affected_tables_.clear();
 }
 
+SQLiteStatementCache* SQLiteDBInstance::getStatementCache() {
+  if (isPrimary() && !managed_) {
+    // The primary connection's statements are kept by the managed instance.
+    return SQLiteDBManager::getConnection(true)->getStatementCache();
+  }
+
+  if (!managed_ || FLAGS_sql_statement_cache_size == 0) {
+    return nullptr;
+  }
+
+  if (statements_ == nullptr) {
+    statements_.reset(new SQLiteStatementCache(db_));
+  }
+  return statements_.get();
+}
+
 SQLiteDBInstance::~SQLiteDBInstance() {
+  // Statements are finalized before the connection is closed.
+  statements_.reset();
   if (!isPrimary()) {
     sqlite3_close(db_);
   } else {
@@ -279,13 +323,110 @@ SQLiteDBInstanceRef SQLiteDBManager::getConnection(bool primary) {
 
   // Create a 'database connection' for the managed database instance.
   auto instance = std::make_shared<SQLiteDBInstance>(self.db_, self.mutex_);
-  if (!instance->isPrimary()) {
+  if (instance->isPrimary()) {
+    return instance;
+  }
+
+  lock.unlock();
+  return self.checkout();
+}
+
+SQLiteDBInstanceRef SQLiteDBManager::checkout() {
+  std::unique_lock<std::mutex> lock(pool_mutex_);
+  auto limit = static_cast<size_t>(FLAGS_sql_pool_size);
+  if (idle_.empty() && pool_.size() >= limit && limit > 0) {
+    // Every pooled connection is in use, wait briefly for one to be returned.
+    auto start = std::chrono::steady_clock::now();
+    pool_returned_.wait_for(lock, kSQLPoolWait, [this]() {
+      return !idle_.empty();
+    });
+    auto waited = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    pool_stats_.waits++;
+    pool_stats_.wait_usec += waited.count();
+  }
+
+  SQLiteDBInstanceRef owner = nullptr;
+  std::set<std::string> changes;
+  bool created = false;
+  if (!idle_.empty()) {
+    // Collect the table changes this connection has not seen.
+    auto* instance = idle_.back();
+    idle_.pop_back();
+    for (const auto& pooled : pool_) {
+      if (pooled.get() == instance) {
+        owner = pooled;
+      }
+    }
+    changes.swap(instance->table_changes_);
+  } else if (pool_.size() < limit) {
+    // Grow the pool, the new connection is fully attached below.
+    owner = std::make_shared<SQLiteDBInstance>();
+    owner->managed_ = true;
+    pool_.push_back(owner);
+    created = true;
+  } else {
+    pool_stats_.transients++;
+    lock.unlock();
+    VLOG(1) << "DBManager contention: opening transient SQLite database";
+    auto instance = std::make_shared<SQLiteDBInstance>();
     attachVirtualTables(instance);
+    return instance;
   }
-  return instance;
+  pool_stats_.checkouts++;
+  lock.unlock();
+
+  if (created) {
+    attachVirtualTables(owner);
+  }
+
+  // Replay attach and detach requests that happened while the connection was
+  // idle. Only the changed tables are recreated.
+  PluginResponse response;
+  for (const auto& name : changes) {
+    detachTableInternal(name, owner->db());
+    if (Registry::exists("table", name) &&
+        Registry::call("table", name, {{"action", "columns"}}, response)
+            .ok()) {
+      attachTableInternal(name, columnDefinition(response, true), owner);
+    }
+  }
+
+  // The caller's reference returns the connection to the pool.
+  return SQLiteDBInstanceRef(owner.get(), [](SQLiteDBInstance* instance) {
+    SQLiteDBManager::instance().release(instance);
+  });
+}
+
+void SQLiteDBManager::release(SQLiteDBInstance* instance) {
+  instance->clearAffectedTables();
+
+  std::unique_lock<std::mutex> lock(pool_mutex_);
+  idle_.push_back(instance);
+  lock.unlock();
+  pool_returned_.notify_one();
+}
+
+void SQLiteDBManager::addTableChange(const std::string& name) {
+  // Repeated changes to a table are replayed once, the set stays bounded.
+  std::unique_lock<std::mutex> lock(pool_mutex_);
+  for (const auto& pooled : pool_) {
+    pooled->table_changes_.insert(name);
+  }
+}
+
+SQLiteDBPoolStats SQLiteDBManager::getPoolStats() {
+  auto& self = instance();
+  std::unique_lock<std::mutex> lock(self.pool_mutex_);
+  auto stats = self.pool_stats_;
+  stats.size = self.pool_.size();
+  stats.idle = self.idle_.size();
+  return stats;
 }
 
 SQLiteDBManager::~SQLiteDBManager() {
+  idle_.clear();
+  pool_.clear();
   connection_ = nullptr;
   if (db_ != nullptr) {
     sqlite3_close(db_);
@@ -357,18 +498,183 @@ int queryDataCallback(void* argument, int argc, char* argv[], char* column[]) {
   return 0;
 }
 
-Status queryInternal(const std::string& q, QueryData& results, sqlite3* db) {
-  char* err = nullptr;
-  sqlite3_exec(db, q.c_str(), queryDataCallback, &results, &err);
-  sqlite3_db_release_memory(db);
-  if (err != nullptr) {
-    auto error_string = std::string(err);
-    sqlite3_free(err);
-    return Status(1, "Error running query: " + error_string);
+void SQLiteStatementCache::invalidate() {
+  kStatementGeneration++;
+}
+
+sqlite3_stmt* SQLiteStatementCache::get(const std::string& q) {
+  size_t generation = kStatementGeneration;
+  if (generation_ != generation) {
+    // Tables were attached or detached since the statements were prepared.
+    clear();
+    generation_ = generation;
+  }
+
+  auto statement = index_.find(q);
+  if (statement == index_.end()) {
+    return nullptr;
+  }
+
+  statements_.splice(statements_.begin(), statements_, statement->second);
+  return statement->second->second;
+}
+
+void SQLiteStatementCache::put(const std::string& q, sqlite3_stmt* stmt) {
+  auto limit = static_cast<size_t>(FLAGS_sql_statement_cache_size);
+  if (limit == 0 || index_.count(q) > 0) {
+    sqlite3_finalize(stmt);
+    return;
+  }
+
+  statements_.emplace_front(q, stmt);
+  index_[q] = statements_.begin();
+  while (statements_.size() > limit) {
+    auto& oldest = statements_.back();
+    sqlite3_finalize(oldest.second);
+    index_.erase(oldest.first);
+    statements_.pop_back();
+  }
+}
+
+void SQLiteStatementCache::clear() {
+  for (auto& statement : statements_) {
+    sqlite3_finalize(statement.second);
+  }
+  statements_.clear();
+  index_.clear();
+}
+
+/// Read a result column without converting integers through SQLite's text.
+static inline std::string getColumnValue(sqlite3_stmt* stmt, int column) {
+  switch (sqlite3_column_type(stmt, column)) {
+  case SQLITE_NULL:
+    return "";
+  case SQLITE_INTEGER:
+    return std::to_string(sqlite3_column_int64(stmt, column));
+  case SQLITE_TEXT: {
+    auto text = sqlite3_column_text(stmt, column);
+    auto bytes = sqlite3_column_bytes(stmt, column);
+    return (text != nullptr)
+               ? std::string(reinterpret_cast<const char*>(text), bytes)
+               : "";
+  }
+  default: {
+    // Floats keep SQLite's formatting, blobs end at the first NUL.
+    auto text = sqlite3_column_text(stmt, column);
+    return (text != nullptr) ? reinterpret_cast<const char*>(text) : "";
+  }
+  }
+}
+
+/// Step a prepared statement until done, appending each result row.
+static int stepStatement(sqlite3_stmt* stmt, QueryData& results) {
+  // Order the result columns by name once, such that each row is filled from
+  // the end of the map. A repeated name keeps the last column.
+  std::vector<std::pair<std::string, int>> layout;
+  auto count = sqlite3_column_count(stmt);
+  layout.reserve(count);
+  for (int i = 0; i < count; i++) {
+    auto name = sqlite3_column_name(stmt, i);
+    if (name != nullptr) {
+      layout.emplace_back(name, i);
+    }
+  }
+  std::stable_sort(layout.begin(),
+                   layout.end(),
+                   [](const std::pair<std::string, int>& a,
+                      const std::pair<std::string, int>& b) {
+                     return a.first < b.first;
+                   });
+  auto last = std::unique(layout.rbegin(),
+                          layout.rend(),
+                          [](const std::pair<std::string, int>& a,
+                             const std::pair<std::string, int>& b) {
+                            return a.first == b.first;
+                          });
+  layout.erase(layout.begin(), last.base());
+
+  int rc = SQLITE_OK;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    Row r;
+    for (const auto& column : layout) {
+      r.emplace_hint(
+          r.end(), column.first, getColumnValue(stmt, column.second));
+    }
+    results.push_back(std::move(r));
+  }
+  return rc;
+}
+
+/// Execute each statement within a query, optionally reusing statements.
+static Status queryStatements(const std::string& q,
+                              QueryData& results,
+                              sqlite3* db,
+                              SQLiteStatementCache* cache) {
+  if (cache != nullptr) {
+    auto stmt = cache->get(q);
+    if (stmt != nullptr) {
+      auto rc = stepStatement(stmt, results);
+      std::string error = (rc != SQLITE_DONE) ? sqlite3_errmsg(db) : "";
+      sqlite3_reset(stmt);
+      if (rc != SQLITE_DONE) {
+        return Status(1, "Error running query: " + error);
+      }
+      return Status(0, "OK");
+    }
+  }
+
+  const char* end = q.c_str() + q.size();
+  const char* tail = q.c_str();
+  while (tail != nullptr && *tail != 0) {
+    const char* start = tail;
+    sqlite3_stmt* stmt = nullptr;
+    auto rc = sqlite3_prepare_v2(db, start, -1, &stmt, &tail);
+    if (rc != SQLITE_OK) {
+      std::string error = sqlite3_errmsg(db);
+      return Status(1, "Error running query: " + error);
+    }
+
+    if (stmt == nullptr) {
+      // The remaining text was whitespace or a comment.
+      continue;
+    }
+
+    rc = stepStatement(stmt, results);
+    if (rc != SQLITE_DONE) {
+      std::string error = sqlite3_errmsg(db);
+      sqlite3_finalize(stmt);
+      return Status(1, "Error running query: " + error);
+    }
+
+    // Only queries of a single statement are kept prepared.
+    bool single = (start == q.c_str()) && std::all_of(tail, end, [](char c) {
+                    return std::isspace(static_cast<unsigned char>(c)) != 0;
+                  });
+    if (cache != nullptr && single) {
+      sqlite3_reset(stmt);
+      cache->put(q, stmt);
+    } else {
+      sqlite3_finalize(stmt);
+    }
   }
   return Status(0, "OK");
 }
 
+Status queryInternal(const std::string& q, QueryData& results, sqlite3* db) {
+  auto status = queryStatements(q, results, db, nullptr);
+  sqlite3_db_release_memory(db);
+  return status;
+}
+
+Status queryInternal(const std::string& q,
+                     QueryData& results,
+                     const SQLiteDBInstanceRef& instance) {
+  auto db = instance->db();
+  auto status = queryStatements(q, results, db, instance->getStatementCache());
+  sqlite3_db_release_memory(db);
+  return status;
+}
+
 Status getQueryColumnsInternal(const std::string& q,
                                TableColumns& columns,
                                sqlite3* db) {
@@ -11,9 +11,15 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
+#include <list>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <set>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <sqlite3.h>
 
@@ -27,6 +33,54 @@ namespace osquery {
 
 class SQLiteDBManager;
 
+/**
+ * @brief A least-recently-used set of prepared statements for a connection.
+ *
+ * The scheduler executes the same SQL text every interval, keeping statements
+ * prepared avoids parsing and planning each execution. Every statement is
+ * finalized when a virtual table is attached or detached through the
+ * registry, as plans reference the previous tables.
+ */
+class SQLiteStatementCache : private boost::noncopyable {
+ public:
+  explicit SQLiteStatementCache(sqlite3* db) : db_(db) {}
+  ~SQLiteStatementCache() {
+    clear();
+  }
+
+  /// Find a prepared statement for a query, or nullptr.
+  sqlite3_stmt* get(const std::string& q);
+
+  /// Keep a reset statement prepared from a query, the cache takes ownership.
+  void put(const std::string& q, sqlite3_stmt* stmt);
+
+  /// Finalize every cached statement.
+  void clear();
+
+  /// The number of cached statements.
+  size_t size() const {
+    return statements_.size();
+  }
+
+  /// Expire the statements of every connection.
+  static void invalidate();
+
+ private:
+  /// The connection statements are prepared on.
+  sqlite3* db_{nullptr};
+
+  /// The table generation the cached statements were prepared within.
+  size_t generation_{0};
+
+  /// Statements and their SQL text, ordered from most recently used.
+  std::list<std::pair<std::string, sqlite3_stmt*>> statements_;
+
+  /// Lookup from SQL text into the ordered statements.
+  std::unordered_map<std::string,
+                     std::list<std::pair<std::string, sqlite3_stmt*>>::iterator>
+      index_;
+};
+
 /**
  * @brief An RAII wrapper around an `sqlite3` object.
  *
@@ -35,8 +89,8 @@ class SQLiteDBManager;
  * database is needed during the life of an osquery tool.
  *
  * If there is resource contention (multiple threads want access to the SQLite
- * abstraction layer), then the SQLiteDBManager will provide a transient
- * SQLiteDBInstance.
+ * abstraction layer), then the SQLiteDBManager will provide a pooled, or as a
+ * last resort a transient, SQLiteDBInstance.
  */
 class SQLiteDBInstance : private boost::noncopyable {
  public:
@@ -68,6 +122,14 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Clear per-query state of a table affected by the use of this instance.
   void clearAffectedTables();
 
+  /**
+   * @brief The prepared statements of this instance's connection.
+   *
+   * Only the primary and pooled connections cache statements, transient
+   * connections return nullptr.
+   */
+  SQLiteStatementCache* getStatementCache();
+
  private:
   /// Handle the primary/forwarding requests for table attribute accesses.
   TableAttributes getAttributes() const;
@@ -84,6 +146,9 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Track whether this instance is managed internally by the DB manager.
   bool managed_{false};
 
+  /// Tables attached or detached since a pooled instance was checked out.
+  std::set<std::string> table_changes_;
+
   /// Either the managed primary database or an ephemeral instance.
   sqlite3* db_{nullptr};
 
@@ -93,16 +158,41 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Vector of tables that need their constraints cleared after execution.
   std::map<std::string, VirtualTableContent*> affected_tables_;
 
+  /// Prepared statements kept for a managed connection.
+  std::unique_ptr<SQLiteStatementCache> statements_;
+
  private:
   friend class SQLiteDBManager;
   friend class SQLInternal;
 
  private:
   FRIEND_TEST(SQLiteUtilTests, test_affected_tables);
+  FRIEND_TEST(SQLiteUtilTests, test_sqlite_connection_pool);
 };
 
 using SQLiteDBInstanceRef = std::shared_ptr<SQLiteDBInstance>;
 
+/// Counters describing the use of the SQLiteDBManager connection pool.
+struct SQLiteDBPoolStats {
+  /// The number of attached connections owned by the pool.
+  size_t size{0};
+
+  /// The number of pooled connections not checked out.
+  size_t idle{0};
+
+  /// Pooled connections handed out on primary contention.
+  size_t checkouts{0};
+
+  /// Checkouts that waited for a connection to be returned.
+  size_t waits{0};
+
+  /// The total time spent waiting, in microseconds.
+  size_t wait_usec{0};
+
+  /// Transient connections created because the pool was exhausted.
+  size_t transients{0};
+};
+
 /**
  * @brief osquery internal SQLite DB abstraction resource management.
  *
@@ -153,6 +243,9 @@ class SQLiteDBManager : private boost::noncopyable {
    */
   static bool isDisabled(const std::string& table_name);
 
+  /// Inspect the connection pool counters.
+  static SQLiteDBPoolStats getPoolStats();
+
  protected:
   SQLiteDBManager();
   virtual ~SQLiteDBManager();
@@ -183,9 +276,44 @@ class SQLiteDBManager : private boost::noncopyable {
   /// Request a connection, optionally request the primary connection.
   static SQLiteDBInstanceRef getConnection(bool primary = false);
 
+  /**
+   * @brief Check out a warm connection from the pool.
+   *
+   * Pooled connections have every virtual table attached when created. Tables
+   * attached or detached since a connection was last used are replayed before
+   * it is returned. If the pool is exhausted this waits briefly for a return
+   * then falls back to a transient connection.
+   */
+  SQLiteDBInstanceRef checkout();
+
+  /// Return a checked out connection to the pool.
+  void release(SQLiteDBInstance* instance);
+
+  /// Record a table attach or detach that pooled connections must replay.
+  void addTableChange(const std::string& name);
+
+ private:
+  /// Protects the pool members and their table changes.
+  std::mutex pool_mutex_;
+
+  /// Signaled when a pooled connection is returned.
+  std::condition_variable pool_returned_;
+
+  /// Every pooled connection, checked out or not.
+  std::vector<SQLiteDBInstanceRef> pool_;
+
+  /// Pooled connections that may be checked out.
+  std::vector<SQLiteDBInstance*> idle_;
+
+  /// Counters for the connection pool.
+  SQLiteDBPoolStats pool_stats_;
+
  private:
   friend class SQLiteDBInstance;
   friend class SQLiteSQLPlugin;
+
+ private:
+  FRIEND_TEST(SQLiteUtilTests, test_sqlite_connection_pool);
 };
 
 /**
@@ -269,6 +397,20 @@ extern const std::map<std::string, QueryPlanner::Opcode> kSQLOpcodes;
  */
 Status queryInternal(const std::string& q, QueryData& results, sqlite3* db);
 
+/**
+ * @brief SQLite Internal: Execute a query using a connection's cached
+ * prepared statements.
+ *
+ * @param q the query to execute
+ * @param results The QueryData struct to emit row on query success.
+ * @param instance the connection to execute query q against
+ *
+ * @return A status indicating SQL query results.
+ */
+Status queryInternal(const std::string& q,
+                     QueryData& results,
+                     const SQLiteDBInstanceRef& instance);
+
 /**
  * @brief SQLite Intern: Analyze a query, providing information about the
  * result columns
@@ -64,6 +64,107 @@ TEST_F(SQLiteUtilTests, test_sqlite_instance) {
   EXPECT_EQ(internal_db, SQLiteDBManager::get()->db());
 }
 
+TEST_F(SQLiteUtilTests, test_sqlite_connection_pool) {
+  // Hold the primary such that further requests are contended.
+  auto primary = SQLiteDBManager::get();
+  ASSERT_TRUE(primary->isPrimary());
+
+  auto stats = SQLiteDBManager::getPoolStats();
+  sqlite3* pooled_db = nullptr;
+  {
+    auto pooled = SQLiteDBManager::get();
+    EXPECT_FALSE(pooled->isPrimary());
+    EXPECT_NE(pooled->db(), primary->db());
+    pooled_db = pooled->db();
+
+    // The pooled connection has the virtual tables attached.
+    QueryData results;
+    EXPECT_TRUE(queryInternal("select * from time", results, pooled_db).ok());
+    EXPECT_EQ(results.size(), 1U);
+  }
+
+  // The connection was returned, and is reused rather than reopened.
+  auto pooled = SQLiteDBManager::get();
+  EXPECT_EQ(pooled->db(), pooled_db);
+
+  auto after = SQLiteDBManager::getPoolStats();
+  EXPECT_EQ(after.checkouts, stats.checkouts + 2);
+  EXPECT_GE(after.size, 1U);
+  EXPECT_EQ(after.transients, stats.transients);
+
+  // A changed table is replayed once on the next checkout.
+  pooled.reset();
+  std::map<SQLiteDBInstance*, size_t> pending;
+  for (const auto& instance : SQLiteDBManager::instance().pool_) {
+    pending[instance.get()] = instance->table_changes_.size();
+  }
+  SQLiteDBManager::instance().addTableChange("time");
+  SQLiteDBManager::instance().addTableChange("time");
+  for (const auto& instance : SQLiteDBManager::instance().pool_) {
+    EXPECT_LE(instance->table_changes_.size(), pending[instance.get()] + 1);
+    EXPECT_EQ(instance->table_changes_.count("time"), 1U);
+  }
+  pooled = SQLiteDBManager::get();
+  EXPECT_TRUE(pooled->table_changes_.empty());
+  QueryData results;
+  EXPECT_TRUE(queryInternal("select * from time", results, pooled->db()).ok());
+  EXPECT_EQ(results.size(), 1U);
+}
+
+TEST_F(SQLiteUtilTests, test_statement_cache) {
+  auto dbc = SQLiteDBManager::get();
+  ASSERT_TRUE(dbc->isPrimary());
+  auto cache = dbc->getStatementCache();
+  ASSERT_NE(cache, nullptr);
+
+  // A constrained query is prepared once and reused.
+  std::string query = "select * from file where path = '/'";
+  QueryData first;
+  EXPECT_TRUE(queryInternal(query, first, dbc).ok());
+  dbc->clearAffectedTables();
+  auto size = cache->size();
+  EXPECT_NE(cache->get(query), nullptr);
+
+  // The reused plan restores the cleared table constraints.
+  QueryData second;
+  EXPECT_TRUE(queryInternal(query, second, dbc).ok());
+  dbc->clearAffectedTables();
+  EXPECT_EQ(cache->size(), size);
+  EXPECT_EQ(second.size(), 1U);
+  EXPECT_EQ(first, second);
+
+  // Multiple statements are not kept.
+  QueryData multiple;
+  auto status = queryInternal("select 1 as a; select 2 as a", multiple, dbc);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(multiple.size(), 2U);
+  EXPECT_EQ(cache->size(), size);
+
+  // Attaching or detaching tables expires the statements.
+  SQLiteStatementCache::invalidate();
+  EXPECT_EQ(cache->get(query), nullptr);
+  EXPECT_EQ(cache->size(), 0U);
+
+  // Transient connections do not keep statements.
+  EXPECT_EQ(SQLiteDBManager::getUnique()->getStatementCache(), nullptr);
+}
+
+TEST_F(SQLiteUtilTests, test_typed_results) {
+  auto dbc = getTestDBC();
+  QueryData results;
+  std::string query = "select 1 as a, 1.5 as b, 'x' as c, NULL as d, 2 as a";
+  auto status = queryInternal(query, results, dbc->db());
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(results.size(), 1U);
+
+  // A repeated column name keeps the last column, as with sqlite3_exec.
+  Row expected = {{"a", "2"}, {"b", "1.5"}, {"c", "x"}, {"d", ""}};
+  EXPECT_EQ(results[0], expected);
+
+  status = queryInternal("select * from does_not_exist", results, dbc->db());
+  EXPECT_FALSE(status.ok());
+}
+
 TEST_F(SQLiteUtilTests, test_direct_query_execution) {
   auto dbc = getTestDBC();
   QueryData results;
@@ -120,6 +120,7 @@ TEST_F(VirtualTableTests, test_tableplugin_aliases) {
       {{"id", "columnAlias"}, {"name", "name2"}, {"target", "name"}},
       {{"id", "columnAlias"}, {"name", "user_name"}, {"target", "username"}},
       {{"attributes", "0"}, {"id", "attributes"}},
+      {{"encoding", "columnar"}, {"id", "encoding"}},
   };
   EXPECT_EQ(response, expected_response);
 
@@ -163,6 +164,121 @@ TEST_F(VirtualTableTests, test_sqlite3_attach_vtable) {
       results[0]["sql"]);
 }
 
+class columnarTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("id", BIGINT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("ratio", DOUBLE_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  ColumnAliasSet columnAliases() const override {
+    return {{"name", {"label"}}};
+  }
+
+ public:
+  void generateColumnar(QueryContext& context,
+                        ColumnarQueryData& results) override {
+    for (long long i = 0; i < 3; i++) {
+      results.addRow();
+      results.setInteger(0, i);
+      results.setDouble(1, i / 2.0);
+      if (i > 0) {
+        results.setText(2, "name" + std::to_string(i));
+      }
+    }
+  }
+};
+
+TEST_F(VirtualTableTests, test_columnar_table) {
+  Registry::add<columnarTablePlugin>("table", "columnar");
+  auto dbc = SQLiteDBManager::getUnique();
+  PluginResponse response;
+  Registry::call("table", "columnar", {{"action", "columns"}}, response);
+  attachTableInternal("columnar", columnDefinition(response, true), dbc);
+
+  QueryData results;
+  auto status = queryInternal(
+      "SELECT id, ratio, name, label FROM columnar WHERE id > 0 "
+      "AND typeof(id) = 'integer' AND typeof(ratio) = 'real';",
+      results,
+      dbc->db());
+  EXPECT_TRUE(status.ok());
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_EQ(results[0]["id"], "1");
+  EXPECT_EQ(results[0]["ratio"], "0.5");
+  EXPECT_EQ(results[0]["name"], "name1");
+  EXPECT_EQ(results[0]["label"], "name1");
+
+  // Unset cells are NULL.
+  results.clear();
+  queryInternal(
+      "SELECT id FROM columnar WHERE name IS NULL;", results, dbc->db());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["id"], "0");
+}
+
+class generatorTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", INTEGER_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("text", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  bool usesGenerator() const override {
+    return true;
+  }
+
+  void generator(RowYield& yield, QueryContext& context) override {
+    for (size_t i = 0; i < 1000; i++) {
+      generated++;
+      Row r = {{"i", INTEGER(i)}, {"text", "row" + std::to_string(i)}};
+      yield(r);
+    }
+  }
+
+  QueryData generate(QueryContext& context) override {
+    return generateAll(context);
+  }
+
+  static size_t generated;
+};
+
+size_t generatorTablePlugin::generated{0};
+
+TEST_F(VirtualTableTests, test_table_generator) {
+  Registry::add<generatorTablePlugin>("table", "generator");
+  auto dbc = SQLiteDBManager::getUnique();
+  PluginResponse columns;
+  Registry::call("table", "generator", {{"action", "columns"}}, columns);
+  attachTableInternal("generator", columnDefinition(columns), dbc);
+
+  QueryData results;
+  auto status =
+      queryInternal("SELECT * FROM generator LIMIT 3;", results, dbc->db());
+  EXPECT_TRUE(status.ok());
+  ASSERT_EQ(results.size(), 3U);
+  EXPECT_EQ(results[2]["i"], "2");
+  EXPECT_EQ(results[2]["text"], "row2");
+  // The generator stops once SQLite has enough rows.
+  EXPECT_LT(generatorTablePlugin::generated, 10U);
+
+  results.clear();
+  queryInternal("SELECT count(*) AS c FROM generator;", results, dbc->db());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["c"], "1000");
+
+  // The registry call API collects every row.
+  PluginResponse response;
+  Registry::call("table", "generator", {{"action", "generate"}}, response);
+  EXPECT_EQ(response.size(), 1000U);
+}
+
 TEST_F(VirtualTableTests, test_sqlite3_table_joins) {
   // Get a database connection.
   auto dbc = SQLiteDBManager::getUnique();
@@ -422,6 +538,63 @@ TEST_F(VirtualTableTests, test_table_cache) {
   ASSERT_EQ(results[0]["data"], "awesome_data");
 }
 
+class filteredCacheTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  TableAttributes attributes() const override {
+    return TableAttributes::CACHEABLE;
+  }
+
+ public:
+  QueryData generate(QueryContext& context) override {
+    scans++;
+
+    // Like many tables, filter on a column that is not an index.
+    QueryData results;
+    for (const std::string name : {"a", "b", "c"}) {
+      if (context.constraints["name"].notExistsOrMatches(name)) {
+        results.push_back({{"name", name}});
+      }
+    }
+    return results;
+  }
+
+  size_t scans{0};
+};
+
+TEST_F(VirtualTableTests, test_table_result_cache) {
+  TableResultCache::instance().clear();
+  auto table = std::make_shared<filteredCacheTablePlugin>();
+  table->setName("filtered_cache");
+  Registry::registry("table")->add(table);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("filtered_cache", table->columnDefinition(), dbc);
+
+  QueryData results;
+  queryInternal(
+      "SELECT * FROM filtered_cache WHERE name = 'a';", results, dbc->db());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(table->scans, 1U);
+
+  // Filtered results are not reused by an unfiltered query.
+  results.clear();
+  queryInternal("SELECT * FROM filtered_cache;", results, dbc->db());
+  EXPECT_EQ(results.size(), 3U);
+  EXPECT_EQ(table->scans, 2U);
+
+  // The same query reuses the cached results.
+  results.clear();
+  queryInternal("SELECT * FROM filtered_cache;", results, dbc->db());
+  EXPECT_EQ(results.size(), 3U);
+  EXPECT_EQ(table->scans, 2U);
+  TableResultCache::instance().clear();
+}
+
 class indexIOptimizedTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
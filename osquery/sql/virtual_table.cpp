@@ -9,6 +9,7 @@
  */
 
 #include <atomic>
+#include <cstdlib>
 
 #include <osquery/core.h>
 #include <osquery/flags.h>
@@ -117,9 +118,25 @@ int xDestroy(sqlite3_vtab* p) {
   return SQLITE_OK;
 }
 
+/// Replace the cursor data with the current row from the table's generator.
+static inline void loadGeneratedRow(BaseCursor* pCur) {
+  pCur->data.clear();
+  if (*pCur->generator) {
+    pCur->data.append(pCur->generator->get());
+    pCur->n = pCur->row + 1;
+  } else {
+    // The generator is complete.
+    pCur->n = pCur->row;
+  }
+}
+
 int xNext(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
   pCur->row++;
+  if (pCur->generator != nullptr) {
+    (*pCur->generator)();
+    loadGeneratedRow(pCur);
+  }
   return SQLITE_OK;
 }
 
@@ -229,63 +246,45 @@ int xCreate(sqlite3* db,
 int xColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col) {
   BaseCursor* pCur = (BaseCursor*)cur;
   const auto* pVtab = (VirtualTable*)cur->pVtab;
-  if (col >= static_cast<int>(pVtab->content->columns.size())) {
+  const auto& data = pCur->rows();
+  if (col >= static_cast<int>(pVtab->content->columns.size()) ||
+      static_cast<size_t>(col) >= data.columns()) {
     // Requested column index greater than column set size.
     return SQLITE_ERROR;
   }
-  if (pCur->row >= pCur->data.size()) {
+  // Generated tables only keep the current row.
+  auto row = (pCur->generator != nullptr) ? 0 : pCur->row;
+  if (row >= data.size()) {
     // Request row index greater than row set size.
     return SQLITE_ERROR;
   }
 
-  auto& column_name = std::get<0>(pVtab->content->columns[col]);
-  auto& type = std::get<1>(pVtab->content->columns[col]);
-  if (pVtab->content->aliases.count(column_name)) {
-    // Overwrite the aliased column with the type and name of the new column.
-    type = std::get<1>(
-        pVtab->content->columns[pVtab->content->aliases.at(column_name)]);
-    column_name = std::get<0>(
-        pVtab->content->columns[pVtab->content->aliases.at(column_name)]);
+  size_t column = col;
+  const auto& column_name = std::get<0>(pVtab->content->columns[column]);
+  if (std::get<1>(pVtab->content->columns[column]) == UNKNOWN_TYPE &&
+      pVtab->content->aliases.count(column_name)) {
+    // Read the aliased column's cells from the target column.
+    column = pVtab->content->aliases.at(column_name);
   }
 
-  // Attempt to cast each xFilter-populated row/column to the SQLite type.
-  const auto& value = pCur->data[pCur->row][column_name];
-  if (pCur->data[pCur->row].count(column_name) == 0) {
-    // Missing content.
-    VLOG(1) << "Error " << column_name << " is empty";
+  // The cells were typed when the cursor data was generated.
+  auto type = data.columnType(column);
+  if (data.isNull(row, column)) {
     sqlite3_result_null(ctx);
   } else if (type == TEXT_TYPE) {
-    sqlite3_result_text(
-        ctx, value.c_str(), static_cast<int>(value.size()), SQLITE_STATIC);
+    // Generated rows are replaced as the cursor advances, text is copied.
+    const auto& value = data.getText(row, column);
+    sqlite3_result_text(ctx,
+                        value.c_str(),
+                        static_cast<int>(value.size()),
+                        (pCur->generator != nullptr) ? SQLITE_TRANSIENT
+                                                     : SQLITE_STATIC);
   } else if (type == INTEGER_TYPE) {
-    long afinite;
-    if (!safeStrtol(value, 0, afinite) || afinite < INT_MIN ||
-        afinite > INT_MAX) {
-      VLOG(1) << "Error casting " << column_name << " (" << value
-              << ") to INTEGER";
-      sqlite3_result_null(ctx);
-    } else {
-      sqlite3_result_int(ctx, (int)afinite);
-    }
+    sqlite3_result_int(ctx, static_cast<int>(data.getInteger(row, column)));
   } else if (type == BIGINT_TYPE || type == UNSIGNED_BIGINT_TYPE) {
-    long long afinite;
-    if (!safeStrtoll(value, 0, afinite)) {
-      VLOG(1) << "Error casting " << column_name << " (" << value
-              << ") to BIGINT";
-      sqlite3_result_null(ctx);
-    } else {
-      sqlite3_result_int64(ctx, afinite);
-    }
+    sqlite3_result_int64(ctx, data.getInteger(row, column));
   } else if (type == DOUBLE_TYPE) {
-    char* end = nullptr;
-    double afinite = strtod(value.c_str(), &end);
-    if (end == nullptr || end == value.c_str() || *end != '\0') {
-      VLOG(1) << "Error casting " << column_name << " (" << value
-              << ") to DOUBLE";
-      sqlite3_result_null(ctx);
-    } else {
-      sqlite3_result_double(ctx, afinite);
-    }
+    sqlite3_result_double(ctx, data.getDouble(row, column));
   } else {
     LOG(ERROR) << "Error unknown column type " << column_name;
   }
@@ -383,12 +382,46 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
        std::to_string(constraints.size()) + " idx=" +
        std::to_string(pIdxInfo->idxNum) + "]");
 #endif
+  // Record the constraint set within the plan. A cached prepared statement is
+  // executed again after the table's tracked constraints were cleared.
+  if (!constraints.empty()) {
+    std::string index;
+    for (const auto& constraint : constraints) {
+      index += std::to_string(constraint.second.op) + ":" + constraint.first;
+      index += ",";
+    }
+    pIdxInfo->idxStr = sqlite3_mprintf("%s", index.c_str());
+    pIdxInfo->needToFreeIdxStr = 1;
+  }
+
   // Add the constraint set to the table's tracked constraints.
   pVtab->content->constraints[pIdxInfo->idxNum] = std::move(constraints);
   pIdxInfo->estimatedCost = cost;
   return SQLITE_OK;
 }
 
+/// Parse the constraint set recorded as a plan's index string by xBestIndex.
+static ConstraintSet getIndexConstraints(const char* idxStr) {
+  ConstraintSet constraints;
+  std::string index(idxStr);
+  size_t start = 0;
+  while (start < index.size()) {
+    auto separator = index.find(':', start);
+    auto end = index.find(',', start);
+    if (separator == std::string::npos || end == std::string::npos ||
+        separator > end) {
+      break;
+    }
+
+    auto op = std::strtoul(index.c_str() + start, nullptr, 10);
+    constraints.push_back(std::make_pair(
+        index.substr(separator + 1, end - separator - 1),
+        Constraint(static_cast<unsigned char>(op))));
+    start = end + 1;
+  }
+  return constraints;
+}
+
 static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
                    int idxNum,
                    const char* idxStr,
@@ -401,7 +434,11 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
 
   pCur->row = 0;
   pCur->n = 0;
-  QueryContext context(content);
+  // A previous generator is stopped before its context is replaced.
+  pCur->generator.reset();
+  pCur->cached.reset();
+  pCur->context.reset(new QueryContext(content));
+  auto& context = *pCur->context;
 
   // Track required columns, this is different than the requirements check
   // that occurs within BestIndex because this scan includes a cursor.
@@ -442,6 +479,11 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
        std::to_string(argc) + " idx=" + std::to_string(idxNum) + "]");
 #endif
 
+  // Restore the constraint set of a plan reused by a cached statement.
+  if (idxStr != nullptr && content->constraints.count(idxNum) == 0) {
+    content->constraints[idxNum] = getIndexConstraints(idxStr);
+  }
+
   // Iterate over every argument to xFilter, filling in constraint values.
   if (content->constraints.size() > 0) {
     auto& constraints = content->constraints[idxNum];
@@ -500,12 +542,36 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
                  << table_doc(pVtab->content->name);
   }
 
-  // Reset the virtual table contents.
-  pCur->data.clear();
+  // Reset the virtual table contents, cells are typed by the table columns.
+  pCur->data.reset(content->columns);
   options.clear();
 
   // Generate the row data set.
   plan("Scanning rows for cursor (" + std::to_string(pCur->id) + ")");
+  pCur->generator = TablePlugin::startGenerator(pVtab->content->name, context);
+  if (pCur->generator != nullptr) {
+    // Rows are pulled from the table's generator as the cursor advances.
+    loadGeneratedRow(pCur);
+    return SQLITE_OK;
+  }
+
+  // Fresh results of a cacheable table are shared between queries.
+  auto ttl = TableResultCache::getTTL(content->attributes);
+  if (ttl > 0) {
+    auto& cache = TableResultCache::instance();
+    auto key = TableResultCache::getKey(context);
+    pCur->cached = cache.find(content->name, key, ttl);
+    if (pCur->cached == nullptr) {
+      auto results = std::make_shared<ColumnarQueryData>(content->columns);
+      Registry::callTable(content->name, context, *results);
+      cache.insert(content->name, key, results);
+      pCur->cached = std::move(results);
+    }
+
+    pCur->n = pCur->cached->size();
+    return SQLITE_OK;
+  }
+
   Registry::callTable(pVtab->content->name, context, pCur->data);
 
   // Set the number of rows.
@@ -41,14 +41,33 @@ struct BaseCursor : private boost::noncopyable {
   /// Track cursors for optional planner output.
   size_t id{0};
 
-  /// Table data generated from last access.
-  QueryData data;
+  /// Typed, columnar table data generated from last access.
+  ColumnarQueryData data;
+
+  /// Results shared with the TableResultCache, read instead of data.
+  std::shared_ptr<const ColumnarQueryData> cached;
+
+  /// The table data the cursor reads.
+  const ColumnarQueryData& rows() const {
+    return (cached != nullptr) ? *cached : data;
+  }
 
   /// Current cursor position.
   size_t row{0};
 
   /// Total number of rows.
   size_t n{0};
+
+  /// The query context, kept for the lifetime of a table's row generator.
+  std::unique_ptr<QueryContext> context;
+
+  /**
+   * @brief An optional pull-based row generator.
+   *
+   * If the table yields rows the data only contains the current row, and
+   * the generator is advanced with the cursor.
+   */
+  std::unique_ptr<RowGenerator::pull_type> generator;
 };
 
 /**
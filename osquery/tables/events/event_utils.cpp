@@ -8,9 +8,12 @@
  *
  */
 
+#include <algorithm>
+#include <ctime>
+
 #include <osquery/events.h>
+#include <osquery/filesystem.h>
 #include <osquery/hash.h>
-#include <osquery/sql.h>
 
 #include "osquery/tables/events/event_utils.h"
 
@@ -20,23 +23,131 @@ const std::set<std::string> kCommonFileColumns = {
     "inode", "uid", "gid", "mode", "size", "atime", "mtime", "ctime",
 };
 
-void decorateFileEvent(const std::string& path, bool hash, Row& r) {
-  auto results = SQL::selectAllFrom("file", "path", EQUALS, path);
-  if (results.size() == 1) {
-    auto& row = results.at(0);
-    for (const auto& key : kCommonFileColumns) {
-      if (row.count(key) > 0) {
-        r[key] = row.at(key);
-      }
+/// The number of file identities kept by the shared decoration cache.
+const size_t kFileDecorationCacheSize = 4096;
+
+FileDecorationCache& FileDecorationCache::get() {
+  static FileDecorationCache cache(kFileDecorationCacheSize);
+  return cache;
+}
+
+bool FileDecorationCache::lookup(const FileIdentity& id,
+                                 FileDecoration& decoration) {
+  WriteLock lock(mutex_);
+  auto it = index_.find(id);
+  if (it == index_.end()) {
+    return false;
+  }
+
+  // Move the entry to the front of the usage list.
+  entries_.splice(entries_.begin(), entries_, it->second);
+  decoration = it->second->second;
+  return true;
+}
+
+void FileDecorationCache::update(
+    const FileIdentity& id,
+    const std::function<void(FileDecoration&)>& modify) {
+  WriteLock lock(mutex_);
+  auto it = index_.find(id);
+  if (it != index_.end()) {
+    entries_.splice(entries_.begin(), entries_, it->second);
+  } else {
+    if (capacity_ == 0) {
+      return;
+    }
+
+    if (entries_.size() >= capacity_) {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
     }
+    entries_.emplace_front(id, FileDecoration());
+    index_[id] = entries_.begin();
+  }
+  modify(entries_.front().second);
+}
+
+void FileDecorationCache::clear() {
+  WriteLock lock(mutex_);
+  index_.clear();
+  entries_.clear();
+}
+
+size_t FileDecorationCache::size() {
+  WriteLock lock(mutex_);
+  return entries_.size();
+}
+
+FileIdentity getFileIdentity(const struct stat& file_stat) {
+#ifdef __APPLE__
+  const auto& mtime = file_stat.st_mtimespec;
+  const auto& ctime = file_stat.st_ctimespec;
+#else
+  const auto& mtime = file_stat.st_mtim;
+  const auto& ctime = file_stat.st_ctim;
+#endif
+
+  FileIdentity id;
+  id.device = file_stat.st_dev;
+  id.inode = file_stat.st_ino;
+  id.size = file_stat.st_size;
+  id.mtime = mtime.tv_sec;
+  id.mtime_nsec = mtime.tv_nsec;
+  id.ctime = ctime.tv_sec;
+  id.ctime_nsec = ctime.tv_nsec;
+  return id;
+}
+
+bool isFileIdentityStable(const struct stat& file_stat) {
+  auto changed = std::max(file_stat.st_mtime, file_stat.st_ctime);
+  return std::time(nullptr) - changed >= kHashCacheSettleTime;
+}
+
+void decorateFileStat(const struct stat& file_stat, Row& r) {
+  r["inode"] = BIGINT(file_stat.st_ino);
+  r["uid"] = BIGINT(file_stat.st_uid);
+  r["gid"] = BIGINT(file_stat.st_gid);
+  r["mode"] = lsperms(file_stat.st_mode);
+  r["size"] = BIGINT(file_stat.st_size);
+  r["atime"] = BIGINT(file_stat.st_atime);
+  r["mtime"] = BIGINT(file_stat.st_mtime);
+  r["ctime"] = BIGINT(file_stat.st_ctime);
+}
+
+void decorateFileEvent(const std::string& path, bool hash, Row& r) {
+  struct stat file_stat;
+  bool exists = (stat(path.c_str(), &file_stat) == 0);
+  if (exists) {
+    decorateFileStat(file_stat, r);
   }
 
   if (hash) {
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-    r["md5"] = std::move(hashes.md5);
-    r["sha1"] = std::move(hashes.sha1);
-    r["sha256"] = std::move(hashes.sha256);
+    // Reuse the hashes of unchanged content, hash once per identity.
+    // Recently changed files are always hashed, like the backing store cache.
+    auto& cache = FileDecorationCache::get();
+    FileDecoration decoration;
+    bool cacheable = exists && isFileIdentityStable(file_stat);
+    if (!cacheable || !cache.lookup(getFileIdentity(file_stat), decoration) ||
+        !decoration.hashed) {
+      auto hashes = hashMultiFromFileCached(
+          HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
+      decoration.md5 = std::move(hashes.md5);
+      decoration.sha1 = std::move(hashes.sha1);
+      decoration.sha256 = std::move(hashes.sha256);
+      if (cacheable && !decoration.md5.empty()) {
+        cache.update(getFileIdentity(file_stat),
+                     [&decoration](FileDecoration& cached) {
+                       cached.hashed = true;
+                       cached.md5 = decoration.md5;
+                       cached.sha1 = decoration.sha1;
+                       cached.sha256 = decoration.sha256;
+                     });
+      }
+    }
+
+    r["md5"] = std::move(decoration.md5);
+    r["sha1"] = std::move(decoration.sha1);
+    r["sha256"] = std::move(decoration.sha256);
     // Hashed determines the success/status of hashing, -1 failed, 1 success.
     r["hashed"] = (r.at("md5").empty()) ? "-1" : "1";
   } else {
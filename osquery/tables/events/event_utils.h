@@ -10,9 +10,18 @@
 
 #pragma once
 
+#include <sys/stat.h>
+
+#include <functional>
+#include <list>
+#include <map>
 #include <set>
 #include <string>
+#include <tuple>
+
+#include <boost/noncopyable.hpp>
 
+#include <osquery/core.h>
 #include <osquery/tables.h>
 
 namespace osquery {
@@ -20,6 +29,109 @@ namespace osquery {
 /// List of columns decorated for file events.
 extern const std::set<std::string> kCommonFileColumns;
 
+/**
+ * @brief The identity of a file's content.
+ *
+ * A rewrite changes the size or the modification and status change times.
+ * Times include nanoseconds where the filesystem provides them.
+ */
+struct FileIdentity {
+  dev_t device{0};
+  ino_t inode{0};
+  off_t size{0};
+  time_t mtime{0};
+  long mtime_nsec{0};
+  time_t ctime{0};
+  long ctime_nsec{0};
+
+  bool operator<(const FileIdentity& other) const {
+    return std::tie(device, inode, size, mtime, mtime_nsec, ctime, ctime_nsec) <
+           std::tie(other.device,
+                    other.inode,
+                    other.size,
+                    other.mtime,
+                    other.mtime_nsec,
+                    other.ctime,
+                    other.ctime_nsec);
+  }
+};
+
+/// Content-derived event decorations, cached per file identity.
+struct FileDecoration {
+  /// Set when the hashes below have been computed.
+  bool hashed{false};
+
+  std::string md5;
+  std::string sha1;
+  std::string sha256;
+
+  /// Content scan results (such as YARA matches) by scan name.
+  std::map<std::string, Row> scans;
+};
+
+/**
+ * @brief A small LRU of file decorations shared by event subscribers.
+ *
+ * Events often fire several times for unchanged content: the same binary is
+ * executed repeatedly, or a file is touched without a write. Subscribers stat
+ * the target once and reuse hashes or scan results for a known identity.
+ */
+class FileDecorationCache : private boost::noncopyable {
+ public:
+  explicit FileDecorationCache(size_t capacity) : capacity_(capacity) {}
+
+  /// The cache shared by the file, process, and YARA event subscribers.
+  static FileDecorationCache& get();
+
+  /// Copy the decoration for an identity, false if it is not cached.
+  bool lookup(const FileIdentity& id, FileDecoration& decoration);
+
+  /// Create or modify the decoration for an identity, evicting the oldest.
+  void update(const FileIdentity& id,
+              const std::function<void(FileDecoration&)>& modify);
+
+  /// Remove all decorations, for example when scan rules change.
+  void clear();
+
+  /// The number of cached identities.
+  size_t size();
+
+ private:
+  using Entry = std::pair<FileIdentity, FileDecoration>;
+
+  /// The maximum number of cached identities.
+  size_t capacity_{0};
+
+  /// Entries ordered from most to least recently used.
+  std::list<Entry> entries_;
+
+  /// Lookup from identity into the usage list.
+  std::map<FileIdentity, std::list<Entry>::iterator> index_;
+
+  Mutex mutex_;
+};
+
+/// Read the identity of a file from its stat information.
+FileIdentity getFileIdentity(const struct stat& file_stat);
+
+/**
+ * @brief Check if decorations of a file may be cached by its identity.
+ *
+ * A file changed within kHashCacheSettleTime may be written again without
+ * changing its identity, if the filesystem's timestamps are coarse.
+ */
+bool isFileIdentityStable(const struct stat& file_stat);
+
+/**
+ * @brief Fill in the common file columns from a stat of the event's path.
+ *
+ * This uses the same formatting as the `file` table without a SQL query.
+ *
+ * @param file_stat The result of a single stat of the target path.
+ * @param r The output parameter row structure.
+ */
+void decorateFileStat(const struct stat& file_stat, Row& r);
+
 /**
  * @brief A helper function for each platform's implementation of file_events.
  *
@@ -16,6 +16,7 @@
 #include <osquery/logger.h>
 #include <osquery/tables.h>
 
+#include "osquery/events/linux/fanotify.h"
 #include "osquery/events/linux/inotify.h"
 #include "osquery/tables/events/event_utils.h"
 
@@ -36,6 +37,16 @@ class FileEventSubscriber : public EventSubscriber<INotifyEventPublisher> {
   /// Walk the configuration's file paths, create subscriptions.
   void configure() override;
 
+  /// Use the fanotify publisher when it is enabled.
+  EventPublisherID& getType() const override {
+    return getFileEventsType();
+  }
+
+  /// Events are stored under the same namespace for either publisher.
+  EventPublisherID dbNamespace() const override {
+    return "inotify." + getName();
+  }
+
   /**
    * @brief This exports a single Callback for INotifyEventPublisher events.
    *
@@ -8,11 +8,12 @@
  *
  */
 
+#include <sys/stat.h>
+
 #include <boost/algorithm/hex.hpp>
 
 #include <osquery/config.h>
 #include <osquery/logger.h>
-#include <osquery/sql.h>
 #include <osquery/system.h>
 
 #include "osquery/events/linux/audit.h"
@@ -124,11 +125,12 @@ inline void updateAuditRow(const AuditEventContextRef& ec, Row& r) {
     r["owner_uid"] = fields.count("ouid") ? fields.at("ouid") : "0";
     r["owner_gid"] = fields.count("ogid") ? fields.at("ogid") : "0";
 
-    auto qd = SQL::selectAllFrom("file", "path", EQUALS, r.at("path"));
-    if (qd.size() == 1) {
-      r["ctime"] = qd.front().at("ctime");
-      r["atime"] = qd.front().at("atime");
-      r["mtime"] = qd.front().at("mtime");
+    // A single stat, the file table is too expensive for an exec callback.
+    struct stat file_stat;
+    if (stat(r.at("path").c_str(), &file_stat) == 0) {
+      r["ctime"] = BIGINT(file_stat.st_ctime);
+      r["atime"] = BIGINT(file_stat.st_atime);
+      r["mtime"] = BIGINT(file_stat.st_mtime);
       r["btime"] = "0";
     }
 
@@ -8,10 +8,14 @@
  *
  */
 
+#include <stdio.h>
+#include <sys/stat.h>
+
 #include <gtest/gtest.h>
 
 #include <osquery/config.h>
 #include <osquery/events.h>
+#include <osquery/filesystem.h>
 #include <osquery/flags.h>
 #include <osquery/logger.h>
 #include <osquery/registry.h>
@@ -73,6 +77,65 @@ TEST_F(FileEventsTableTests, test_table_empty) {
   EXPECT_EQ(results.size(), 0U);
 }
 
+TEST_F(FileEventsTableTests, test_decoration_cache) {
+  FileDecorationCache cache(2);
+
+  FileIdentity first;
+  first.inode = 1;
+  FileIdentity second;
+  second.inode = 2;
+  FileIdentity third;
+  third.inode = 3;
+
+  FileDecoration decoration;
+  EXPECT_FALSE(cache.lookup(first, decoration));
+
+  cache.update(first, [](FileDecoration& d) { d.md5 = "first"; });
+  cache.update(second, [](FileDecoration& d) { d.md5 = "second"; });
+  EXPECT_EQ(cache.size(), 2U);
+
+  // A lookup makes the first identity the most recently used.
+  EXPECT_TRUE(cache.lookup(first, decoration));
+  EXPECT_EQ(decoration.md5, "first");
+
+  // The least recently used identity is evicted.
+  cache.update(third, [](FileDecoration& d) { d.md5 = "third"; });
+  EXPECT_EQ(cache.size(), 2U);
+  EXPECT_FALSE(cache.lookup(second, decoration));
+  EXPECT_TRUE(cache.lookup(first, decoration));
+
+  // A content change is a new identity.
+  first.mtime = 1;
+  EXPECT_FALSE(cache.lookup(first, decoration));
+  second.inode = 1;
+  second.mtime_nsec = 1;
+  EXPECT_FALSE(cache.lookup(second, decoration));
+
+  cache.clear();
+  EXPECT_EQ(cache.size(), 0U);
+}
+
+TEST_F(FileEventsTableTests, test_decorate_rewrite) {
+  auto path = kTestWorkingDirectory + "decorate-rewrite";
+  writeTextFile(path, "first");
+
+  // Recently written content is hashed and not cached.
+  struct stat file_stat;
+  ASSERT_EQ(::stat(path.c_str(), &file_stat), 0);
+  EXPECT_FALSE(isFileIdentityStable(file_stat));
+  Row first;
+  decorateFileEvent(path, true, first);
+  EXPECT_EQ(first["hashed"], "1");
+
+  // A rewrite of the same size, within the same second, is hashed again.
+  writeTextFile(path, "again");
+  Row second;
+  decorateFileEvent(path, true, second);
+  EXPECT_EQ(second["size"], first["size"]);
+  EXPECT_NE(second["md5"], first["md5"]);
+  remove(path);
+}
+
 class FileEventsTestsConfigPlugin : public ConfigPlugin {
  public:
   Status genConfig(std::map<std::string, std::string>& config) override {
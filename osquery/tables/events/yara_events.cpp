@@ -8,6 +8,8 @@
  *
  */
 
+#include <sys/stat.h>
+
 #include <map>
 #include <string>
 
@@ -18,9 +20,11 @@
 #ifdef __APPLE__
 #include "osquery/events/darwin/fsevents.h"
 #elif __linux__
+#include "osquery/events/linux/fanotify.h"
 #include "osquery/events/linux/inotify.h"
 #endif
 
+#include "osquery/tables/events/event_utils.h"
 #include "osquery/tables/other/yara_utils.h"
 
 #ifdef CONCAT
@@ -59,6 +63,18 @@ class YARAEventSubscriber : public FileEventSubscriber {
 
   void configure() override;
 
+#ifdef __linux__
+  /// Use the fanotify publisher when it is enabled.
+  EventPublisherID& getType() const override {
+    return getFileEventsType();
+  }
+
+  /// Events are stored under the same namespace for either publisher.
+  EventPublisherID dbNamespace() const override {
+    return "inotify." + getName();
+  }
+#endif
+
  private:
   /**
    * @brief This exports a single Callback for FSEventsEventPublisher events.
@@ -84,6 +100,9 @@ REGISTER(YARAEventSubscriber, "event_subscriber", "yara_events");
 void YARAEventSubscriber::configure() {
   removeSubscriptions();
 
+  // Cached scan results are only valid for the rules that produced them.
+  FileDecorationCache::get().clear();
+
   // There is a special yara parser that tracks the related top-level keys.
   auto plugin = Config::getParser("yara");
   if (plugin == nullptr || plugin.get() == nullptr) {
@@ -163,17 +182,41 @@ Status YARAEventSubscriber::Callback(const FileEventContextRef& ec,
     return Status(1, "Yara parser unknown.");
   }
 
-  auto rules = yaraParser->rules();
+  // Content that was already scanned for this category is not scanned again.
+  auto category = r.at("category");
+  auto scan_name = "yara." + category;
+  // Recently changed content is always scanned.
+  struct stat file_stat;
+  bool cacheable = (stat(ec->path.c_str(), &file_stat) == 0) &&
+                   isFileIdentityStable(file_stat);
+  FileDecoration decoration;
+  if (cacheable &&
+      FileDecorationCache::get().lookup(getFileIdentity(file_stat),
+                                        decoration) &&
+      decoration.scans.count(scan_name) > 0) {
+    for (const auto& column : decoration.scans.at(scan_name)) {
+      r[column.first] = column.second;
+    }
+    if (ec->action != "" && r.at("matches").size() > 0) {
+      add(r);
+    }
+    return Status(0, "OK");
+  }
 
   // Use the category as a lookup into the yara file_paths. The value will be
   // a list of signature groups to scan with.
-  auto category = r.at("category");
   const auto& yara_config = parser->getData();
   const auto& yara_paths = yara_config.get_child("file_paths");
   const auto& sig_groups = yara_paths.find(category);
   for (const auto& rule : sig_groups->second) {
     const std::string group = rule.second.data();
-    int result = yr_rules_scan_file(rules[group],
+    // Hold the rules for the scan in case the group is recompiled.
+    YARARules rules;
+    std::string rules_hash;
+    if (!yaraParser->getRules(group, rules, rules_hash)) {
+      continue;
+    }
+    int result = yr_rules_scan_file(rules.get(),
                                     ec->path.c_str(),
                                     SCAN_FLAGS_FAST_MODE,
                                     YARACallback,
@@ -185,6 +228,18 @@ Status YARAEventSubscriber::Callback(const FileEventContextRef& ec,
     }
   }
 
+  if (cacheable) {
+    Row scan = {{"count", r.at("count")},
+                {"matches", r.at("matches")},
+                {"strings", r.at("strings")},
+                {"tags", r.at("tags")}};
+    FileDecorationCache::get().update(
+        getFileIdentity(file_stat),
+        [&scan_name, &scan](FileDecoration& cached) {
+          cached.scans[scan_name] = scan;
+        });
+  }
+
   if (ec->action != "" && r.at("matches").size() > 0) {
     add(r);
   }
@@ -260,7 +260,7 @@ void DeviceHelper::generateFiles(const std::string& partition,
   }
 }
 
-MultiHashes hashInode(TskFsFile* file) {
+MultiHashes hashInode(TskFsFile* file, const std::string& identity) {
   Hash md5(HASH_TYPE_MD5);
   Hash sha1(HASH_TYPE_SHA1);
   Hash sha256(HASH_TYPE_SHA256);
@@ -277,6 +277,17 @@ MultiHashes hashInode(TskFsFile* file) {
     return MultiHashes();
   }
 
+  // Reuse the hashes of an inode whose size and change times are unchanged.
+  auto version = std::to_string(size) + "." +
+                 std::to_string(meta->getMTime()) + "." +
+                 std::to_string(meta->getCTime());
+  MultiHashes dhs;
+  int mask = HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256;
+  if (getCachedHashes(identity, version, mask, dhs)) {
+    delete meta;
+    return dhs;
+  }
+
   // Allocate some heap memory and iterate over reading a chunk and updating.
   auto buffer_size = (size < 4096) ? size : 4096;
   auto* buffer = (char*)malloc(buffer_size * sizeof(char));
@@ -303,10 +314,11 @@ MultiHashes hashInode(TskFsFile* file) {
   delete meta;
 
   // Convert the set of hashes into a device hashes transport.
-  MultiHashes dhs;
+  dhs.mask = mask;
   dhs.md5 = md5.digest();
   dhs.sha1 = sha1.digest();
   dhs.sha256 = sha256.digest();
+  setCachedHashes(identity, version, dhs);
   return dhs;
 }
 
@@ -349,7 +361,8 @@ QueryData genDeviceHash(QueryContext& context) {
                   r["partition"] = address;
                   r["inode"] = inode;
 
-                  auto hashes = hashInode(file);
+                  auto hashes = hashInode(
+                      file, "tsk." + dev + "." + address + "." + inode);
                   r["md5"] = std::move(hashes.md5);
                   r["sha1"] = std::move(hashes.sha1);
                   r["sha256"] = std::move(hashes.sha256);
@@ -8,6 +8,8 @@
  *
  */
 
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include <osquery/filesystem.h>
@@ -73,4 +75,44 @@ TEST_F(YARATest, test_match_false) {
   // Should have 0 count
   EXPECT_TRUE(r["count"] == "0");
 }
+
+TEST_F(YARATest, test_rules_hash) {
+  writeTextFile(ruleFile, alwaysTrue);
+  auto hash = hashRuleFiles({ruleFile});
+  EXPECT_EQ(hash, hashRuleFiles({ruleFile}));
+
+  // Cached scan results are not reused for changed signatures.
+  remove(ruleFile);
+  writeTextFile(ruleFile, alwaysFalse);
+  EXPECT_NE(hash, hashRuleFiles({ruleFile}));
+}
+
+TEST_F(YARATest, test_concurrent_scans) {
+  YR_RULES* rules = nullptr;
+  EXPECT_EQ(yr_initialize(), ERROR_SUCCESS);
+  writeTextFile(ruleFile, alwaysTrue);
+  ASSERT_TRUE(compileSingleFile(ruleFile, &rules).ok());
+
+  // Threads share the compiled rules, each scan reports its own matches.
+  std::vector<Row> rows(4);
+  std::vector<std::thread> threads;
+  for (auto& r : rows) {
+    threads.emplace_back([rules, &r]() {
+      r["count"] = "0";
+      r["matches"] = "";
+      yr_rules_scan_file(
+          rules, ls.c_str(), SCAN_FLAGS_FAST_MODE, YARACallback, (void*)&r, 0);
+      yr_finalize_thread();
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  yr_rules_destroy(rules);
+
+  for (auto& r : rows) {
+    EXPECT_EQ(r["count"], "1");
+    EXPECT_EQ(r["matches"], "always_true");
+  }
+}
 }
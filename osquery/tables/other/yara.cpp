@@ -8,13 +8,21 @@
  *
  */
 
+#include <sys/stat.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include <boost/filesystem.hpp>
 
 #include <osquery/filesystem.h>
+#include <osquery/flags.h>
 #include <osquery/logger.h>
 #include <osquery/tables.h>
 #include <osquery/status.h>
 
+#include "osquery/tables/events/event_utils.h"
 #include "osquery/tables/other/yara_utils.h"
 
 #ifdef CONCAT
@@ -23,8 +31,57 @@
 #include <yara.h>
 
 namespace osquery {
+
+FLAG(uint64, yara_threads, 4, "Number of threads used by yara table scans");
+
+FLAG(uint64,
+     yara_scan_timeout,
+     0,
+     "Seconds before a yara table scan of a file is stopped (0 = none)");
+
+FLAG(uint64,
+     yara_scan_rate,
+     0,
+     "Max bytes per second read by yara table scans (0 = unlimited)");
+
 namespace tables {
 
+/// A scan of a path using the rules from one signature group.
+struct YARAScan {
+  std::string path;
+  std::string group;
+  /// Held for the scan so replaced rules are not destroyed while in use.
+  YARARules rules;
+  std::string rules_hash;
+};
+
+/**
+ * @brief Pace yara table scans to an average number of bytes per second.
+ *
+ * Each scan reserves the time needed to read its file at the configured rate,
+ * concurrent scans wait for the reservations before them.
+ */
+static void throttleScan(size_t bytes) {
+  if (FLAGS_yara_scan_rate == 0) {
+    return;
+  }
+
+  static Mutex mutex;
+  static std::chrono::steady_clock::time_point next;
+
+  std::chrono::steady_clock::duration pause;
+  {
+    WriteLock lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    if (next < now) {
+      next = now;
+    }
+    pause = next - now;
+    next += std::chrono::microseconds(bytes * 1000000 / FLAGS_yara_scan_rate);
+  }
+  std::this_thread::sleep_for(pause);
+}
+
 void doYARAScan(YR_RULES* rules,
                 const std::string& path,
                 QueryData& results,
@@ -44,10 +101,101 @@ void doYARAScan(YR_RULES* rules,
   r["sigfile"] = std::string(sigfile);
 
   // Perform the scan, using the static YARA subscriber callback.
-  int result = yr_rules_scan_file(
-      rules, path.c_str(), SCAN_FLAGS_FAST_MODE, YARACallback, (void*)&r, 0);
+  int result = yr_rules_scan_file(rules,
+                                  path.c_str(),
+                                  SCAN_FLAGS_FAST_MODE,
+                                  YARACallback,
+                                  (void*)&r,
+                                  static_cast<int>(FLAGS_yara_scan_timeout));
   if (result == ERROR_SUCCESS) {
     results.push_back(std::move(r));
+  } else if (result == ERROR_SCAN_TIMEOUT) {
+    VLOG(1) << "YARA scan timed out: " << path;
+  }
+}
+
+/**
+ * @brief Scan a path, reusing results for content scanned with the same rules.
+ *
+ * Results are cached by file identity (device, inode, size, and precise
+ * mtime and ctime) in the file decoration cache shared with the YARA event
+ * subscriber. Files changed within the settle time are always scanned, a
+ * write within the same clock tick would otherwise reuse a stale result.
+ */
+static void doCachedYARAScan(const YARAScan& scan, QueryData& results) {
+  struct stat file_stat;
+  if (::stat(scan.path.c_str(), &file_stat) != 0) {
+    return;
+  }
+
+  auto identity = getFileIdentity(file_stat);
+  auto scan_name = "yara.rules." + scan.rules_hash;
+  bool cacheable = !scan.rules_hash.empty() && isFileIdentityStable(file_stat);
+  FileDecoration decoration;
+  if (cacheable && FileDecorationCache::get().lookup(identity, decoration) &&
+      decoration.scans.count(scan_name) > 0) {
+    Row r = decoration.scans.at(scan_name);
+    r["path"] = scan.path;
+    r["sig_group"] = scan.group;
+    r["sigfile"] = scan.group;
+    results.push_back(std::move(r));
+    return;
+  }
+
+  throttleScan(static_cast<size_t>(file_stat.st_size));
+  doYARAScan(scan.rules.get(), scan.path, results, scan.group, scan.group);
+  if (cacheable && !results.empty()) {
+    Row cached = {{"count", results.back().at("count")},
+                  {"matches", results.back().at("matches")},
+                  {"strings", results.back().at("strings")},
+                  {"tags", results.back().at("tags")}};
+    FileDecorationCache::get().update(
+        identity, [&scan_name, &cached](FileDecoration& entry) {
+          entry.scans[scan_name] = cached;
+        });
+  }
+}
+
+/**
+ * @brief Scan many paths with a pool of threads.
+ *
+ * Each thread scans the next unclaimed path using the shared compiled rules,
+ * YARA keeps a separate scan context for each thread. Results keep the order
+ * of the scans.
+ */
+static void doYARAScans(const std::vector<YARAScan>& scans,
+                        QueryData& results) {
+  std::vector<QueryData> scan_results(scans.size());
+
+  // YARA allows a limited number of threads to scan with the same rules.
+  auto threads = std::min(static_cast<size_t>(FLAGS_yara_threads),
+                          static_cast<size_t>(YR_MAX_THREADS));
+  threads = std::min(threads, scans.size());
+
+  std::atomic<size_t> next{0};
+  auto scan_files = ([&scans, &scan_results, &next]() {
+    for (size_t i = next++; i < scans.size(); i = next++) {
+      doCachedYARAScan(scans[i], scan_results[i]);
+    }
+  });
+
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < threads; i++) {
+    workers.emplace_back([&scan_files]() {
+      scan_files();
+      // Release the thread-local YARA state, such as the regex cache.
+      yr_finalize_thread();
+    });
+  }
+  scan_files();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  for (auto& scan_result : scan_results) {
+    for (auto& r : scan_result) {
+      results.push_back(std::move(r));
+    }
   }
 }
 
@@ -79,7 +227,6 @@ QueryData genYara(QueryContext& context) {
     LOG(ERROR) << "YARA config parser plugin has no pointer";
     return results;
   }
-  auto& rules = yaraParser->rules();
 
   // Collect all paths specified too.
   auto paths = context.constraints["path"].getAll(EQUALS);
@@ -104,12 +251,16 @@ QueryData genYara(QueryContext& context) {
 
   // Compile all sigfiles into a map.
   for (const auto& file : sigfiles) {
-    // Check if this "ad-hoc" signature file has not been used/compiled.
-    if (rules.count(file) == 0) {
-      // If this is a relative path append the default yara search path.
-      auto path = (file[0] != '/') ? std::string("/etc/osquery/yara/") : "";
-      path += file;
+    // If this is a relative path append the default yara search path.
+    auto path = (file[0] != '/') ? std::string("/etc/osquery/yara/") : "";
+    path += file;
 
+    // Check if this "ad-hoc" signature file was not compiled or was edited.
+    auto rules_hash = hashRuleFiles({path});
+    YARARules rules;
+    std::string compiled_hash;
+    if (!yaraParser->getRules(file, rules, compiled_hash) ||
+        compiled_hash != rules_hash) {
       YR_RULES* tmp_rules = nullptr;
       auto status = compileSingleFile(path, &tmp_rules);
       if (!status.ok()) {
@@ -118,23 +269,39 @@ QueryData genYara(QueryContext& context) {
       }
       // Cache the compiled rules by setting the unique signature file path
       // as the lookup name. Additional signature file uses will skip the
-      // compile step and be added as rule groups.
-      rules[file] = tmp_rules;
+      // compile step and be added as rule groups. Scans still holding the
+      // previous rules release them when they complete.
+      yaraParser->setRules(file, makeYARARules(tmp_rules), rules_hash);
     }
     // Assemble an "ad-hoc" group using the signature file path as the name.
     groups.insert(file);
   }
 
+  // Every path is scanned with the same rules, even if they are replaced.
+  std::map<std::string, std::pair<YARARules, std::string>> group_rules;
+  for (const auto& group : groups) {
+    YARARules rules;
+    std::string rules_hash;
+    if (yaraParser->getRules(group, rules, rules_hash)) {
+      group_rules[group] = std::make_pair(rules, rules_hash);
+    }
+  }
+
   // Scan every path pair.
+  std::vector<YARAScan> scans;
   for (const auto& path : paths) {
     // Scan using the signature groups.
-    for (const auto& group : groups) {
-      if (rules.count(group) > 0) {
-        doYARAScan(rules[group], path.c_str(), results, group, group);
-      }
+    for (const auto& group : group_rules) {
+      YARAScan scan;
+      scan.path = path;
+      scan.group = group.first;
+      scan.rules = group.second.first;
+      scan.rules_hash = group.second.second;
+      scans.push_back(std::move(scan));
     }
   }
 
+  doYARAScans(scans, results);
   return results;
 }
 }
@@ -12,6 +12,7 @@
 #include <string>
 
 #include <osquery/config.h>
+#include <osquery/hash.h>
 #include <osquery/logger.h>
 
 #include "osquery/tables/other/yara_utils.h"
@@ -102,13 +103,21 @@ Status compileSingleFile(const std::string &file, YR_RULES **rules) {
   return Status(0, "OK");
 }
 
+YARARules makeYARARules(YR_RULES *rules) {
+  return YARARules(rules, [](YR_RULES *r) {
+    if (r != nullptr) {
+      yr_rules_destroy(r);
+    }
+  });
+}
+
 /**
  * Given a vector of strings, attempt to compile them and store the result
  * in the map under the given category.
  */
 Status handleRuleFiles(const std::string &category,
                        const pt::ptree &rule_files,
-                       std::map<std::string, YR_RULES *> &rules) {
+                       std::map<std::string, YARARules> &rules) {
   YR_COMPILER *compiler = nullptr;
   int result = yr_compiler_create(&compiler);
   if (result != ERROR_SUCCESS) {
@@ -146,12 +155,8 @@ Status handleRuleFiles(const std::string &category,
       yr_compiler_destroy(compiler);
       return Status(1, "YARA load error " + std::to_string(result));
     } else if (result == ERROR_SUCCESS) {
-      // If there are already rules there, destroy them and put new ones in.
-      if (rules.count(category) > 0) {
-        yr_rules_destroy(rules[category]);
-      }
-
-      rules[category] = tmp_rules;
+      // If there are already rules there, release them and put new ones in.
+      rules[category] = makeYARARules(tmp_rules);
     } else {
       compiled = true;
       // Try to compile the rules.
@@ -178,12 +183,14 @@ Status handleRuleFiles(const std::string &category,
 
   if (compiled) {
     // All the rules for this category have been compiled, save them in the map.
-    result = yr_compiler_get_rules(compiler, &rules[category]);
+    YR_RULES *tmp_rules = nullptr;
+    result = yr_compiler_get_rules(compiler, &tmp_rules);
 
     if (result != ERROR_SUCCESS) {
       yr_compiler_destroy(compiler);
       return Status(1, "Insufficient memory to get YARA rules");
     }
+    rules[category] = makeYARARules(tmp_rules);
   }
 
   if (compiler != nullptr) {
@@ -240,6 +247,34 @@ int YARACallback(int message, void *message_data, void *user_data) {
   return CALLBACK_CONTINUE;
 }
 
+std::string hashRuleFiles(const std::vector<std::string> &files) {
+  std::string content;
+  for (const auto &file : files) {
+    content += file + ":" + hashFromFile(HASH_TYPE_SHA256, file) + ";";
+  }
+  return hashFromBuffer(HASH_TYPE_SHA256, content.data(), content.size());
+}
+
+bool YARAConfigParserPlugin::getRules(const std::string &group,
+                                      YARARules &rules,
+                                      std::string &hash) {
+  WriteLock lock(rules_mutex_);
+  if (rules_.count(group) == 0) {
+    return false;
+  }
+  rules = rules_.at(group);
+  hash = (rules_hashes_.count(group) > 0) ? rules_hashes_.at(group) : "";
+  return true;
+}
+
+void YARAConfigParserPlugin::setRules(const std::string &group,
+                                      const YARARules &rules,
+                                      const std::string &hash) {
+  WriteLock lock(rules_mutex_);
+  rules_[group] = rules;
+  rules_hashes_[group] = hash;
+}
+
 Status YARAConfigParserPlugin::setUp() {
   int result = yr_initialize();
   if (result != ERROR_SUCCESS) {
@@ -261,11 +296,26 @@ Status YARAConfigParserPlugin::update(const std::string &source,
     data_.add_child("signatures", signatures);
     for (const auto &element : signatures) {
       VLOG(1) << "Compiling YARA signature group: " << element.first;
-      auto status = handleRuleFiles(element.first, element.second, rules_);
+      // Compile without the lock, scans keep using the previous rules.
+      std::map<std::string, YARARules> compiled;
+      auto status = handleRuleFiles(element.first, element.second, compiled);
       if (!status.ok()) {
         VLOG(1) << "YARA rule compile error: " << status.getMessage();
         return status;
       }
+
+      std::vector<std::string> files;
+      for (const auto &item : element.second) {
+        auto rule = item.second.get("", "");
+        if (rule[0] != '/') {
+          rule = std::string("/etc/osquery/yara/") + rule;
+        }
+        files.push_back(rule);
+      }
+      if (compiled.count(element.first) > 0) {
+        setRules(
+            element.first, compiled.at(element.first), hashRuleFiles(files));
+      }
     }
   }
 
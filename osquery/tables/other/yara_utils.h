@@ -8,7 +8,11 @@
  *
  */
 
+#include <map>
+#include <memory>
+
 #include <osquery/config.h>
+#include <osquery/core.h>
 #include <osquery/tables.h>
 
 #ifdef CONCAT
@@ -28,12 +32,31 @@ void YARACompilerCallback(int error_level,
 
 Status compileSingleFile(const std::string& file, YR_RULES** rule);
 
+/**
+ * @brief Compiled rules shared by every scan using them.
+ *
+ * Rules replaced after a signature change are destroyed once the last scan
+ * holding them completes.
+ */
+using YARARules = std::shared_ptr<YR_RULES>;
+
+/// Take ownership of compiled rules, see YARARules.
+YARARules makeYARARules(YR_RULES* rules);
+
 Status handleRuleFiles(const std::string& category,
                        const pt::ptree& rule_files,
-                       std::map<std::string, YR_RULES*>& rules);
+                       std::map<std::string, YARARules>& rules);
 
 int YARACallback(int message, void* message_data, void* user_data);
 
+/**
+ * @brief Identify compiled rules by the content of their signature files.
+ *
+ * Scan results cached for a file are only reused with rules compiled from
+ * the same signature file content.
+ */
+std::string hashRuleFiles(const std::vector<std::string>& files);
+
 /**
  * @brief A simple ConfigParserPlugin for a "yara" dictionary key.
  *
@@ -49,14 +72,34 @@ class YARAConfigParserPlugin : public ConfigParserPlugin {
   /// Request a single "yara" top level key.
   std::vector<std::string> keys() const override { return {"yara"}; }
 
-  // Retrieve compiled rules.
-  std::map<std::string, YR_RULES*>& rules() { return rules_; }
+  /**
+   * @brief Retrieve the compiled rules for a group.
+   *
+   * @param group The signature group or ad-hoc signature file.
+   * @param rules Output, the compiled rules, kept alive while held.
+   * @param hash Output, the signature content hash, see hashRuleFiles.
+   * @return true if the group has compiled rules.
+   */
+  bool getRules(const std::string& group,
+                YARARules& rules,
+                std::string& hash);
+
+  /// Replace the compiled rules and signature content hash for a group.
+  void setRules(const std::string& group,
+                const YARARules& rules,
+                const std::string& hash);
 
   Status setUp() override;
 
  private:
   // Store compiled rules in a map (group => rules).
-  std::map<std::string, YR_RULES*> rules_;
+  std::map<std::string, YARARules> rules_;
+
+  // Store the signature content hash of each group, see hashRuleFiles.
+  std::map<std::string, std::string> rules_hashes_;
+
+  /// Protect the rules and hashes from concurrent table and event scans.
+  Mutex rules_mutex_;
 
   /// Store the signatures and file_paths and compile the rules.
   Status update(const std::string& source, const ParserConfig& config) override;
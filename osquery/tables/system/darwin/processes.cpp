@@ -353,7 +353,7 @@ void genMemoryRegion(int pid,
                      const vm_size_t& size,
                      struct vm_region_submap_info_64& info,
                      const std::map<vm_address_t, std::string>& libraries,
-                     QueryData& results) {
+                     RowYield& yield) {
   Row r;
   r["pid"] = INTEGER(pid);
 
@@ -422,16 +422,21 @@ void genMemoryRegion(int pid,
   r["inode"] = "0";
 
   // Increment the address/region request offset.
-  results.push_back(r);
+  // The consumer may move a yielded row, yield copies of the region.
+  {
+    Row region = r;
+    yield(region);
+  }
 
   // Submaps or offsets into regions may contain libraries mapped from the
   // dyld cache.
   for (const auto& library : libraries) {
     if (library.first > address && library.first < (address + size)) {
-      r["offset"] = INTEGER(info.offset + (library.first - address));
-      r["path"] = library.second;
-      r["pseudo"] = "0";
-      results.push_back(r);
+      Row mapped = r;
+      mapped["offset"] = INTEGER(info.offset + (library.first - address));
+      mapped["path"] = library.second;
+      mapped["pseudo"] = "0";
+      yield(mapped);
     }
   }
 }
@@ -517,9 +522,21 @@ void genProcessLibraries(const mach_port_t& task,
   }
 }
 
-void genProcessMemoryMap(int pid, QueryData& results) {
-  mach_port_t task = MACH_PORT_NULL;
-  kern_return_t status = task_for_pid(mach_task_self(), pid, &task);
+/// A task port released when a row generator is stopped early.
+struct TaskPort {
+  ~TaskPort() {
+    if (port != MACH_PORT_NULL) {
+      mach_port_deallocate(mach_task_self(), port);
+    }
+  }
+
+  mach_port_t port{MACH_PORT_NULL};
+};
+
+void genProcessMemoryMap(int pid, RowYield& yield) {
+  TaskPort task_port;
+  kern_return_t status = task_for_pid(mach_task_self(), pid, &task_port.port);
+  auto task = task_port.port;
   if (status != KERN_SUCCESS) {
     // Cannot request memory map for pid (permissions, invalid).
     return;
@@ -554,24 +571,16 @@ void genProcessMemoryMap(int pid, QueryData& results) {
       continue;
     }
 
-    genMemoryRegion(pid, address, size, info, libraries, results);
+    genMemoryRegion(pid, address, size, info, libraries, yield);
     address += size;
   }
-
-  if (task != MACH_PORT_NULL) {
-    mach_port_deallocate(mach_task_self(), task);
-  }
 }
 
-QueryData genProcessMemoryMap(QueryContext& context) {
-  QueryData results;
-
+void genProcessMemoryMap(RowYield& yield, QueryContext& context) {
   auto pidlist = getProcList(context);
   for (const auto& pid : pidlist) {
-    genProcessMemoryMap(pid, results);
+    genProcessMemoryMap(pid, yield);
   }
-
-  return results;
 }
 }
 }
@@ -10,6 +10,7 @@
 
 #include <string>
 #include <map>
+#include <memory>
 
 #include <stdlib.h>
 #include <unistd.h>
@@ -62,13 +63,19 @@ void genProcessEnvironment(struct procstat* pstat,
 
 void genProcessMap(struct procstat* pstat,
                    struct kinfo_proc* proc,
-                   QueryData& results) {
+                   RowYield& yield) {
   struct kinfo_vmentry* vmentry;
   unsigned int i;
   unsigned int cnt = 0;
 
   vmentry = procstat_getvmmap(pstat, proc, &cnt);
   if (vmentry != nullptr) {
+    // The map is released when a row generator is stopped early.
+    auto vmmap = std::shared_ptr<struct kinfo_vmentry>(
+        vmentry,
+        [pstat](struct kinfo_vmentry* entry) {
+          procstat_freevmmap(pstat, entry);
+        });
     for (i = 0; i < cnt; i++) {
       Row r;
 
@@ -100,10 +107,8 @@ void genProcessMap(struct procstat* pstat,
         r["pseudo"] = INTEGER("0");
       }
 
-      results.push_back(r);
+      yield(r);
     }
-
-    procstat_freevmmap(pstat, vmentry);
   }
 }
 
@@ -219,19 +224,19 @@ QueryData genProcessEnvs(QueryContext& context) {
   return results;
 }
 
-QueryData genProcessMemoryMap(QueryContext& context) {
-  QueryData results;
+void genProcessMemoryMap(RowYield& yield, QueryContext& context) {
   struct kinfo_proc* procs = nullptr;
   struct procstat* pstat = nullptr;
 
   auto cnt = getProcesses(context, &pstat, &procs);
 
+  // The process list is released when a row generator is stopped early.
+  auto cleanup = std::shared_ptr<struct procstat>(
+      pstat,
+      [procs](struct procstat* handle) { procstatCleanup(handle, procs); });
   for (size_t i = 0; i < cnt; i++) {
-    genProcessMap(pstat, &procs[i], results);
+    genProcessMap(pstat, &procs[i], yield);
   }
-
-  procstatCleanup(pstat, procs);
-  return results;
 }
 }
 }
@@ -0,0 +1,82 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/filesystem.h>
+#include <osquery/tables.h>
+
+#include "osquery/filesystem/linux/proc.h"
+#include "osquery/tests/test_util.h"
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+namespace tables {
+
+void genProcess(ProcReader& reader,
+                const std::string& pid,
+                QueryData& results);
+
+/// Nul-delimited arguments, as found in a process's cmdline.
+const char kBenchmarkCmdline[] = "/usr/bin/osqueryd\0--flagfile\0/etc/osquery";
+
+/// Create a fake proc root with a number of process directories.
+static std::string makeProcRoot(size_t count) {
+  auto root = kTestWorkingDirectory + "processes_" + std::to_string(count);
+  if (fs::exists(root + "/" + std::to_string(count))) {
+    return root;
+  }
+
+  for (size_t i = 1; i <= count; i++) {
+    auto pid = std::to_string(i);
+    auto path = root + "/" + pid;
+    fs::create_directories(path);
+
+    writeTextFile(path + "/stat",
+                  pid + " (osqueryd worker) S 1 " + pid + " " + pid +
+                      " 0 -1 4194560 1320 0 0 0 12 4 0 0 20 0 7 0 "
+                      "4242 118566912 4096 18446744073709551615\n");
+    writeTextFile(path + "/status",
+                  "Name:\tosqueryd worker\nUmask:\t0022\n"
+                  "State:\tS (sleeping)\n"
+                  "Tgid:\t" + pid + "\nPid:\t" + pid + "\nPPid:\t1\n"
+                  "Uid:\t0\t0\t0\t0\nGid:\t0\t0\t0\t0\nFDSize:\t64\n"
+                  "VmPeak:\t  120000 kB\nVmSize:\t  115788 kB\n"
+                  "VmRSS:\t   16384 kB\nThreads:\t7\n");
+    writeTextFile(
+        path + "/cmdline",
+        std::string(kBenchmarkCmdline, sizeof(kBenchmarkCmdline) - 1));
+  }
+  return root;
+}
+
+static void TABLES_linux_processes(benchmark::State& state) {
+  auto count = static_cast<size_t>(state.range_x());
+  ProcReader reader(makeProcRoot(count));
+
+  std::vector<std::string> pids;
+  for (size_t i = 1; i <= count; i++) {
+    pids.push_back(std::to_string(i));
+  }
+
+  while (state.KeepRunning()) {
+    QueryData results;
+    for (const auto& pid : pids) {
+      genProcess(reader, pid, results);
+    }
+  }
+}
+
+BENCHMARK(TABLES_linux_processes)->Arg(1000)->Arg(5000)->Arg(20000);
+}
+}
@@ -25,6 +25,7 @@
 #include <osquery/tables.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/filesystem/linux/proc.h"
 
 namespace osquery {
 namespace tables {
@@ -34,11 +35,12 @@ inline std::string getProcAttr(const std::string& attr,
   return "/proc/" + pid + "/" + attr;
 }
 
-inline std::string readProcCMDLine(const std::string& pid) {
-  auto attr = getProcAttr("cmdline", pid);
-
+inline std::string readProcCMDLine(ProcReader& reader,
+                                   const std::string& pid) {
   std::string content;
-  readFile(attr, content);
+  if (reader.read(pid, "cmdline").ok()) {
+    content.assign(reader.data(), reader.size());
+  }
   // Remove \0 delimiters.
   std::replace_if(content.begin(),
                   content.end(),
@@ -49,18 +51,12 @@ inline std::string readProcCMDLine(const std::string& pid) {
   return content;
 }
 
-inline std::string readProcLink(const std::string& attr,
+inline std::string readProcLink(ProcReader& reader,
+                                const char* attr,
                                 const std::string& pid) {
   // The exe is a symlink to the binary on-disk.
-  auto attr_path = getProcAttr(attr, pid);
-
   std::string result;
-  char link_path[PATH_MAX] = {0};
-  auto bytes = readlink(attr_path.c_str(), link_path, sizeof(link_path) - 1);
-  if (bytes >= 0) {
-    result = std::string(link_path);
-  }
-
+  reader.readLink(pid, attr, result);
   return result;
 }
 
@@ -134,7 +130,7 @@ void genProcessEnvironment(const std::string& pid, QueryData& results) {
   }
 }
 
-void genProcessMap(const std::string& pid, QueryData& results) {
+void genProcessMap(const std::string& pid, RowYield& yield) {
   auto map = getProcAttr("maps", pid);
 
   std::string content;
@@ -179,122 +175,42 @@ void genProcessMap(const std::string& pid, QueryData& results) {
 
     // BSS with name in pathname.
     r["pseudo"] = (fields[4] == "0" && !r["path"].empty()) ? "1" : "0";
-    results.push_back(std::move(r));
+    yield(r);
   }
 }
 
-struct SimpleProcStat {
-  // Output from string parsing /proc/<pid>/status.
-  std::string name; // Name:
-  std::string real_uid; // Uid: * - - -
-  std::string real_gid; // Gid: * - - -
-  std::string effective_uid; // Uid: - * - -
-  std::string effective_gid; // Gid: - * - -
-  std::string saved_uid; // Uid: - - * -
-  std::string saved_gid; // Gid: - - * -
-
-  std::string resident_size; // VmRSS:
-  std::string total_size; // VmSize:
-
-  // Output from sring parsing /proc/<pid>/stat.
-  std::string state;
-  std::string parent;
-  std::string group;
-  std::string nice;
-  std::string threads;
-
-  std::string user_time;
-  std::string system_time;
-  std::string start_time;
-};
-
-static inline SimpleProcStat getProcStat(const std::string& pid) {
-  SimpleProcStat stat;
-  std::string content;
-
-  if (readFile(getProcAttr("stat", pid), content).ok()) {
-    auto start = content.find_last_of(")");
-    // Start parsing stats from ") <MODE>..."
-    if (start == std::string::npos || content.size() <= start + 2) {
-      return stat;
-    }
-    auto details = osquery::split(content.substr(start + 2), " ");
-    if (details.size() <= 19) {
-      return stat;
-    }
-
-    stat.state = details.at(0);
-    stat.parent = details.at(1);
-    stat.group = details.at(2);
-    stat.user_time = details.at(11);
-    stat.system_time = details.at(12);
-    stat.nice = details.at(16);
-    stat.threads = details.at(20);
-    try {
-      stat.start_time = TEXT(AS_LITERAL(BIGINT_LITERAL, details.at(19)) / 100);
-    } catch (const boost::bad_lexical_cast& e) {
-      stat.start_time = "-1";
-    }
+static inline ProcStat getProcStat(ProcReader& reader,
+                                   const std::string& pid) {
+  ProcStat stat;
+  if (reader.read(pid, "stat").ok()) {
+    parseProcStat(reader.data(), reader.size(), stat);
   }
 
-  if (readFile(getProcAttr("status", pid), content).ok()) {
-    for (const auto& line : osquery::split(content, "\n")) {
-      // Status lines are formatted: Key: Value....\n.
-      auto detail = osquery::split(line, ":", 1);
-      if (detail.size() != 2) {
-        continue;
-      }
-
-      // There are specific fields from each detail.
-      if (detail.at(0) == "Name") {
-        stat.name = detail.at(1);
-      } else if (detail.at(0) == "VmRSS") {
-        detail[1].erase(detail.at(1).end() - 3, detail.at(1).end());
-        // Memory is reported in kB.
-        stat.resident_size = detail.at(1) + "000";
-      } else if (detail.at(0) == "VmSize") {
-        detail[1].erase(detail.at(1).end() - 3, detail.at(1).end());
-        // Memory is reported in kB.
-        stat.total_size = detail.at(1) + "000";
-      } else if (detail.at(0) == "Gid") {
-        // Format is: R E - -
-        auto gid_detail = osquery::split(detail.at(1), "\t");
-        if (gid_detail.size() == 4) {
-          stat.real_gid = gid_detail.at(0);
-          stat.effective_gid = gid_detail.at(1);
-          stat.saved_gid = gid_detail.at(2);
-        }
-      } else if (detail.at(0) == "Uid") {
-        auto uid_detail = osquery::split(detail.at(1), "\t");
-        if (uid_detail.size() == 4) {
-          stat.real_uid = uid_detail.at(0);
-          stat.effective_uid = uid_detail.at(1);
-          stat.saved_uid = uid_detail.at(2);
-        }
-      }
-    }
+  if (reader.read(pid, "status").ok()) {
+    parseProcStatus(reader.data(), reader.size(), stat);
   }
-
   return stat;
 }
 
-void genProcess(const std::string& pid, QueryData& results) {
+void genProcess(ProcReader& reader,
+                const std::string& pid,
+                QueryData& results) {
   // Parse the process stat and status.
-  auto proc_stat = getProcStat(pid);
+  auto proc_stat = getProcStat(reader, pid);
 
   Row r;
   r["pid"] = pid;
   r["parent"] = proc_stat.parent;
-  r["path"] = readProcLink("exe", pid);
+  r["path"] = readProcLink(reader, "exe", pid);
   r["name"] = proc_stat.name;
   r["pgroup"] = proc_stat.group;
   r["state"] = proc_stat.state;
   r["nice"] = proc_stat.nice;
   r["threads"] = proc_stat.threads;
   // Read/parse cmdline arguments.
-  r["cmdline"] = readProcCMDLine(pid);
-  r["cwd"] = readProcLink("cwd", pid);
-  r["root"] = readProcLink("root", pid);
+  r["cmdline"] = readProcCMDLine(reader, pid);
+  r["cwd"] = readProcLink(reader, "cwd", pid);
+  r["root"] = readProcLink(reader, "root", pid);
   r["uid"] = proc_stat.real_uid;
   r["euid"] = proc_stat.effective_uid;
   r["suid"] = proc_stat.saved_uid;
@@ -353,15 +269,17 @@ void genProcess(const std::string& pid, QueryData& results) {
   r["system_time"] = proc_stat.system_time;
   r["start_time"] = proc_stat.start_time;
 
-  results.push_back(r);
+  results.push_back(std::move(r));
 }
 
 QueryData genProcesses(QueryContext& context) {
   QueryData results;
 
+  // A single reader, and its buffer, is used for every process.
+  ProcReader reader;
   auto pidlist = getProcList(context);
   for (const auto& pid : pidlist) {
-    genProcess(pid, results);
+    genProcess(reader, pid, results);
   }
 
   return results;
@@ -378,15 +296,11 @@ QueryData genProcessEnvs(QueryContext& context) {
   return results;
 }
 
-QueryData genProcessMemoryMap(QueryContext& context) {
-  QueryData results;
-
+void genProcessMemoryMap(RowYield& yield, QueryContext& context) {
   auto pidlist = getProcList(context);
   for (const auto& pid : pidlist) {
-    genProcessMap(pid, results);
+    genProcessMap(pid, yield);
   }
-
-  return results;
 }
 }
 }
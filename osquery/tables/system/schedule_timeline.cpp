@@ -0,0 +1,40 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <osquery/system.h>
+#include <osquery/tables.h>
+
+#include "osquery/dispatcher/scheduler.h"
+
+namespace osquery {
+namespace tables {
+
+/// Seconds of planned executions reported.
+const size_t kScheduleTimelineSpan{3600};
+
+QueryData genScheduleTimeline(QueryContext& context) {
+  QueryData results;
+
+  auto entries = SchedulePlanner::get().timeline(getUnixTime(),
+                                                 kScheduleTimelineSpan);
+  for (const auto& entry : entries) {
+    Row r;
+    r["time"] = BIGINT(entry.time);
+    r["name"] = entry.name;
+    r["interval"] = INTEGER(entry.query.interval);
+    r["phase"] = INTEGER(entry.query.phase);
+    r["cost"] = DOUBLE(entry.query.cost);
+    r["load"] = DOUBLE(entry.load);
+    results.push_back(r);
+  }
+  return results;
+}
+}
+}
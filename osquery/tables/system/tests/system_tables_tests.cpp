@@ -8,9 +8,13 @@
  *
  */
 
+#include <boost/filesystem/path.hpp>
+
 #include <gtest/gtest.h>
 
 #include <osquery/core.h>
+#include <osquery/filesystem.h>
+#include <osquery/hash.h>
 #include <osquery/logger.h>
 #include <osquery/sql.h>
 #include <osquery/tables.h>
@@ -59,6 +63,18 @@ TEST_F(SystemsTablesTests, test_processes) {
   EXPECT_EQ(results.rows().size(), 0U);
 }
 
+TEST_F(SystemsTablesTests, test_process_memory_map) {
+  // Rows are generated, a limit stops the generator early.
+  auto results =
+      SQL("select pid, path from process_memory_map where pid in "
+          "(select pid from osquery_info) limit 2");
+  ASSERT_EQ(results.rows().size(), 2U);
+  EXPECT_EQ(results.rows()[0].at("pid"), results.rows()[1].at("pid"));
+
+  results = SQL("select pid from process_memory_map where pid = -1");
+  EXPECT_EQ(results.rows().size(), 0U);
+}
+
 TEST_F(SystemsTablesTests, test_processes_memory_cpu) {
   auto results = SQL("select * from osquery_info join processes using (pid)");
   long long bytes;
@@ -116,5 +132,29 @@ TEST_F(SystemsTablesTests, test_abstract_joins) {
           "path LIKE '\\Windows\\%';");
   ASSERT_GT(results.rows().size(), 1U);
 }
+TEST_F(SystemsTablesTests, test_hash) {
+  auto path = kTestWorkingDirectory + "hash-table";
+  writeTextFile(path, "hash table content");
+
+  // The hash table generates typed cells read directly by the cursor.
+  auto results =
+      SQL("select path, directory, md5, sha256 from hash where path = '" +
+          path + "'");
+  ASSERT_EQ(results.rows().size(), 1U);
+  EXPECT_EQ(results.rows()[0].at("path"), path);
+  EXPECT_EQ(results.rows()[0].at("md5"), hashFromFile(HASH_TYPE_MD5, path));
+  EXPECT_EQ(results.rows()[0].at("sha256"),
+            hashFromFile(HASH_TYPE_SHA256, path));
+
+  // Constraints on generated cells are applied by SQLite.
+  auto directory = boost::filesystem::path(path).parent_path().string();
+  results = SQL("select path from hash where directory = '" + directory +
+                "' and path = '" + path + "'");
+  EXPECT_EQ(results.rows().size(), 1U);
+  results = SQL("select path from hash where path = '" + path +
+                "' and md5 = 'invalid'");
+  EXPECT_TRUE(results.rows().empty());
+  remove(path);
+}
 }
 }
@@ -36,7 +36,7 @@ const std::map<fs::file_type, std::string> kTypeNames{
 void genFileInfo(const fs::path& path,
                  const fs::path& parent,
                  const std::string& pattern,
-                 QueryData& results) {
+                 RowYield& yield) {
   // Must provide the path, filename, directory separate from boost path->string
   // helpers to match any explicit (query-parsed) predicate constraints.
 #if !defined(WIN32)
@@ -91,12 +91,10 @@ void genFileInfo(const fs::path& path,
     r["type"] = "unknown";
   }
 
-  results.push_back(r);
+  yield(r);
 }
 
-QueryData genFile(QueryContext& context) {
-  QueryData results;
-
+void genFile(RowYield& yield, QueryContext& context) {
   // Resolve file paths for EQUALS and LIKE operations.
   auto paths = context.constraints["path"].getAll(EQUALS);
   context.expandConstraints(
@@ -118,7 +116,7 @@ QueryData genFile(QueryContext& context) {
   // Iterate through each of the resolved/supplied paths.
   for (const auto& path_string : paths) {
     fs::path path = path_string;
-    genFileInfo(path, path.parent_path(), "", results);
+    genFileInfo(path, path.parent_path(), "", yield);
   }
 
   // Resolve directories for EQUALS and LIKE operations.
@@ -149,14 +147,12 @@ QueryData genFile(QueryContext& context) {
       // Iterate over the directory and generate info for each regular file.
       fs::directory_iterator begin(directory_string), end;
       for (; begin != end; ++begin) {
-        genFileInfo(begin->path(), directory_string, "", results);
+        genFileInfo(begin->path(), directory_string, "", yield);
       }
     } catch (const fs::filesystem_error& /* e */) {
       continue;
     }
   }
-
-  return results;
 }
 }
 }
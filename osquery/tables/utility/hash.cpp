@@ -19,31 +19,57 @@ namespace fs = boost::filesystem;
 namespace osquery {
 namespace tables {
 
-void genHashForFile(const std::string& path,
-                    const std::string& dir,
-                    QueryContext& context,
-                    QueryData& results) {
-  // Must provide the path, filename, directory separate from boost path->string
-  // helpers to match any explicit (query-parsed) predicate constraints.
-  Row r;
-  if (context.isCached(path)) {
-    r = context.getCache(path);
-  } else {
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-
-    r["path"] = path;
-    r["directory"] = dir;
-    r["md5"] = std::move(hashes.md5);
-    r["sha1"] = std::move(hashes.sha1);
-    r["sha256"] = std::move(hashes.sha256);
-    context.setCache(path, r);
+void genHashForFiles(
+    const std::vector<std::pair<std::string, std::string>>& files,
+    QueryContext& context,
+    ColumnarQueryData& results) {
+  // Files already hashed within this query are reused, the rest are hashed
+  // together so independent files may be read and hashed concurrently.
+  std::vector<std::string> paths;
+  std::map<std::string, size_t> hashed;
+  for (const auto& file : files) {
+    if (!context.isCached(file.first) && hashed.count(file.first) == 0) {
+      hashed[file.first] = paths.size();
+      paths.push_back(file.first);
+    }
+  }
+  auto hashes = hashMultiFromFiles(
+      HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, paths);
+
+  // Cells are written by column ordinal, the column names are looked up once.
+  auto path_column = results.columnIndex("path");
+  auto directory_column = results.columnIndex("directory");
+  auto md5_column = results.columnIndex("md5");
+  auto sha1_column = results.columnIndex("sha1");
+  auto sha256_column = results.columnIndex("sha256");
+
+  results.reserve(results.size() + files.size());
+  for (const auto& file : files) {
+    // Must provide the path, filename, directory separate from boost
+    // path->string helpers to match any explicit (query-parsed) predicate
+    // constraints.
+    if (context.isCached(file.first)) {
+      results.append(context.getCache(file.first));
+      continue;
+    }
+
+    const auto& file_hashes = hashes[hashed.at(file.first)];
+    results.addRow();
+    results.setText(path_column, file.first);
+    results.setText(directory_column, file.second);
+    results.setText(md5_column, file_hashes.md5);
+    results.setText(sha1_column, file_hashes.sha1);
+    results.setText(sha256_column, file_hashes.sha256);
+    context.setCache(file.first,
+                     {{"path", file.first},
+                      {"directory", file.second},
+                      {"md5", file_hashes.md5},
+                      {"sha1", file_hashes.sha1},
+                      {"sha256", file_hashes.sha256}});
   }
-  results.push_back(r);
 }
 
-QueryData genHash(QueryContext& context) {
-  QueryData results;
+void genHash(QueryContext& context, ColumnarQueryData& results) {
   boost::system::error_code ec;
 
   // The query must provide a predicate with constraints including path or
@@ -66,14 +92,15 @@ QueryData genHash(QueryContext& context) {
         return status;
       }));
 
-  // Iterate through the file paths, adding the hash results
+  // Iterate through the file paths, collecting the files to hash.
+  std::vector<std::pair<std::string, std::string>> files;
   for (const auto& path_string : paths) {
     boost::filesystem::path path = path_string;
     if (!boost::filesystem::is_regular_file(path, ec)) {
       continue;
     }
 
-    genHashForFile(path_string, path.parent_path().string(), context, results);
+    files.emplace_back(path_string, path.parent_path().string());
   }
 
   // Now loop through constraints using the directory column constraint.
@@ -106,13 +133,12 @@ QueryData genHash(QueryContext& context) {
     boost::filesystem::directory_iterator begin(directory), end;
     for (; begin != end; ++begin) {
       if (boost::filesystem::is_regular_file(begin->path(), ec)) {
-        genHashForFile(
-            begin->path().string(), directory_string, context, results);
+        files.emplace_back(begin->path().string(), directory_string);
       }
     }
   }
 
-  return results;
+  genHashForFiles(files, context, results);
 }
 }
 }
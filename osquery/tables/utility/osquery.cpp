@@ -45,11 +45,15 @@ QueryData genOsqueryEvents(QueryContext& context) {
       r["subscriptions"] = INTEGER(pubref->numSubscriptions());
       r["events"] = INTEGER(pubref->numEvents());
       r["refreshes"] = INTEGER(pubref->restartCount());
+      r["overflows"] = INTEGER(pubref->overflowCount());
+      r["coalesced"] = INTEGER(pubref->coalescedCount());
       r["active"] = (pubref->hasStarted() && !pubref->isEnding()) ? "1" : "0";
     } else {
       r["subscriptions"] = "0";
       r["events"] = "0";
       r["refreshes"] = "0";
+      r["overflows"] = "0";
+      r["coalesced"] = "0";
       r["active"] = "-1";
     }
     results.push_back(r);
@@ -62,6 +66,8 @@ QueryData genOsqueryEvents(QueryContext& context) {
     r["type"] = "subscriber";
     // Subscribers will never 'restart'.
     r["refreshes"] = "0";
+    r["overflows"] = "0";
+    r["coalesced"] = "0";
 
     auto subref = EventFactory::getEventSubscriber(subscriber);
     if (subref != nullptr) {
@@ -231,6 +237,23 @@ QueryData genOsqueryInfo(QueryContext& context) {
   return results;
 }
 
+QueryData genOsqueryTableCache(QueryContext& context) {
+  QueryData results;
+
+  auto stats = TableResultCache::instance().getStats();
+  for (const auto& table : stats) {
+    Row r;
+    r["name"] = table.first;
+    r["hits"] = BIGINT(table.second.hits);
+    r["misses"] = BIGINT(table.second.misses);
+    r["evictions"] = BIGINT(table.second.evictions);
+    r["entries"] = INTEGER(table.second.entries);
+    r["size"] = BIGINT(table.second.bytes);
+    results.push_back(r);
+  }
+  return results;
+}
+
 QueryData genOsquerySchedule(QueryContext& context) {
   QueryData results;
 
@@ -247,6 +270,9 @@ QueryData genOsquerySchedule(QueryContext& context) {
         r["user_time"] = "0";
         r["system_time"] = "0";
         r["average_memory"] = "0";
+        r["cpu_time"] = "0";
+        r["peak_memory"] = "0";
+        r["output_rows"] = "0";
         r["last_executed"] = "0";
 
         // Report optional performance information.
@@ -259,6 +285,9 @@ QueryData genOsquerySchedule(QueryContext& context) {
               r["user_time"] = BIGINT(perf.user_time);
               r["system_time"] = BIGINT(perf.system_time);
               r["average_memory"] = BIGINT(perf.average_memory);
+              r["cpu_time"] = BIGINT(perf.cpu_time);
+              r["peak_memory"] = BIGINT(perf.peak_memory);
+              r["output_rows"] = BIGINT(perf.output_rows);
             });
 
         results.push_back(r);
@@ -212,6 +212,14 @@ class TableState(Singleton):
             if len(set(all_options).intersection(NON_CACHEABLE)) > 0:
                 print(lightred("Table cannot be marked cacheable: %s" % (path)))
                 exit(1)
+        for attr in ["columnar", "generator"]:
+            if attr not in self.attributes:
+                continue
+            if "cacheable" in self.attributes or self.class_name != "" or \
+                    ("columnar" in self.attributes and
+                     "generator" in self.attributes):
+                print(lightred("Table cannot be marked %s: %s" % (attr, path)))
+                exit(1)
         if self.table_name == "" or self.function == "":
             print(lightred("Invalid table spec: %s" % (path)))
             exit(1)
@@ -249,7 +257,8 @@ class TableState(Singleton):
             aliases=self.aliases,
             has_options=self.has_options,
             has_column_aliases=self.has_column_aliases,
-            attribute_set=[TABLE_ATTRIBUTES[attr] for attr in self.attributes],
+            attribute_set=[TABLE_ATTRIBUTES[attr] for attr in self.attributes
+                           if attr in TABLE_ATTRIBUTES],
         )
 
         with open(path, "w+") as file_h:
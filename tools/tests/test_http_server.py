@@ -19,9 +19,11 @@ import ssl
 import sys
 import thread
 import threading
+import zlib
 
 # Create a simple TLS/HTTP server.
 from BaseHTTPServer import BaseHTTPRequestHandler, HTTPServer
+from SocketServer import ThreadingMixIn
 from urlparse import parse_qs
 
 EXAMPLE_CONFIG = {
@@ -103,7 +105,10 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
         debug("RealSimpleHandler::post %s" % self.path)
         self._set_headers()
         content_len = int(self.headers.getheader('content-length', 0))
-        request = json.loads(self.rfile.read(content_len))
+        body = self.rfile.read(content_len)
+        if self.headers.getheader('content-encoding', '') == 'gzip':
+            body = zlib.decompress(body, 16 + zlib.MAX_WBITS)
+        request = json.loads(body)
         debug("Request: %s" % str(request))
 
         if self.path == '/enroll':
@@ -183,6 +188,11 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
         self.wfile.write(json.dumps(response))
 
 
+class ThreadedHTTPServer(ThreadingMixIn, HTTPServer):
+    '''Handle concurrent requests, such as pipelined log batches'''
+    daemon_threads = True
+
+
 def handler():
     print("[DEBUG] Shutting down HTTP server via timeout (%d) seconds."
           % (ARGS.timeout))
@@ -254,7 +264,7 @@ if __name__ == '__main__':
         timer = threading.Timer(ARGS.timeout, handler)
         timer.start()
 
-    httpd = HTTPServer(('localhost', ARGS.port), RealSimpleHandler)
+    httpd = ThreadedHTTPServer(('localhost', ARGS.port), RealSimpleHandler)
     if ARGS.tls:
         if 'SSLContext' in vars(ssl):
             ctx = ssl.SSLContext(ssl.PROTOCOL_SSLv23)